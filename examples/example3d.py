@@ -31,6 +31,6 @@ extrusion.label = "base"
 model.add_widget(TextButton(wires))
 model.add_widget(TextButton(extrusion))
 # create balloon text for wires
-model.add_widget(BalloonText(wires))
+model.add_widget(BalloonText(wires, model))
 # render model
 model.render()
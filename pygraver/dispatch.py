@@ -0,0 +1,408 @@
+# -*- coding: utf-8 -*-
+'''
+Job dispatcher submodule.
+
+This submodule provides classes to distribute engraving jobs over a pool of
+identical machines. Jobs are streamed to every machine concurrently; a machine
+that fails is taken out of the pool and its current job goes back to the queue.
+'''
+
+import asyncio
+import math
+import re
+import time
+import logging
+from serial import SerialException
+from .core import types
+from .machine import Machine
+from .exceptions import *
+
+__all__ = ["Job", "MachineStats", "Dispatcher"]
+
+class Job(object):
+    '''
+    Engraving job.
+
+    A job is either a collection of paths or depth passes (traced with the
+    machine's *trace* command format) or a list of G-code lines sent as they
+    are. Paths may be kept compressed while the job is queued
+    (CompressedPathGroup); they're decoded one at a time when commands are
+    made.
+
+    Attributes:
+        name (str): job name
+        content (PathGroup, CompressedPathGroup, DepthPasses, list[Path] or list[str]): job content
+        attempts (int): number of times the job was started
+        machine (Machine|None): machine that completed the job, or None
+        error (Exception|None): last error that occurred while running the job, or None
+        estimate (float): estimated duration, in seconds (set when job is queued)
+    '''
+    _move_re = re.compile(r"^G0?[01](\s|$)", re.IGNORECASE)
+    _word_re = re.compile(r"([A-Z])\s*(-?\d*\.?\d+)", re.IGNORECASE)
+
+    def __init__(self, content:'types.PathGroup|types.CompressedPathGroup|types.DepthPasses|types.Path|list[types.Path]|list[str]|str', name:str=""):
+        '''
+        Constructor.
+
+        Args:
+            content (PathGroup|CompressedPathGroup|DepthPasses|Path|list[Path]|list[str]|str): paths or depth passes to trace, or G-code (one command per line)
+            name (str): job name
+
+        Raises:
+            ValueError: if content is empty
+        '''
+        if isinstance(content, str):
+            content = content.splitlines()
+        elif isinstance(content, types.Path):
+            content = [content]
+        if len(content) == 0:
+            raise ValueError("Job content must not be empty.")
+        self.content = content
+        self.name = name
+        self.attempts = 0
+        self.machine = None
+        self.error = None
+        self.estimate = 0.0
+
+    def is_gcode(self) -> bool:
+        '''
+        Tell if job is made of G-code lines.
+
+        Returns:
+            bool: True if job content is G-code, False if it is made of paths
+        '''
+        return not isinstance(self.content, (types.PathGroup, types.CompressedPathGroup, types.DepthPasses)) and isinstance(self.content[0], str)
+
+    def iter_commands(self, machine:Machine):
+        '''
+        Produce command lines to send to given machine, one at a time.
+
+        Args:
+            machine (Machine): machine that will run the job; its feed rate and endstop settings are used for paths
+
+        Yields:
+            str: command line, without comments; empty lines are skipped
+        '''
+        if self.is_gcode():
+            for line in self.content:
+                cmd = line.split(";")[0].strip()
+                if len(cmd) > 0:
+                    yield cmd
+            return
+        # absolute positioning is needed for trace commands
+        yield "G90"
+        if isinstance(self.content, types.DepthPasses):
+            yield from machine.make_pass_commands(self.content)
+            return
+        if isinstance(self.content, types.CompressedPathGroup):
+            # coordinates are decoded directly, without creating points
+            for k in range(len(self.content)):
+                xs, ys, zs, cs = self.content.decode(k)
+                yield from machine.make_trace_commands(xs=xs, ys=ys, zs=zs, cs=cs)
+            return
+        for path in self.content:
+            yield from machine.make_trace_commands(path)
+
+    def get_commands(self, machine:Machine) -> 'list[str]':
+        '''
+        Get command lines to send to given machine.
+
+        Args:
+            machine (Machine): machine that will run the job; its feed rate and endstop settings are used for paths
+
+        Returns:
+            list[str]: command lines, without comments and empty lines
+        '''
+        return list(self.iter_commands(machine))
+
+    def estimate_duration(self, machine:Machine) -> float:
+        '''
+        Estimate job duration from move lengths and feed rates.
+
+        Notes:
+            Accelerations are ignored; this is meant to compare jobs with each other.
+
+        Args:
+            machine (Machine): machine that would run the job
+
+        Returns:
+            float: estimated duration, in seconds
+        '''
+        position = {"X":0.0, "Y":0.0, "Z":0.0, "C":0.0}
+        feed_rate = machine.feed_rate
+        duration = 0.0
+        for cmd in self.iter_commands(machine):
+            words = {k.upper(): float(v) for k, v in self._word_re.findall(cmd)}
+            if cmd.upper().startswith("G4"):
+                # dwell time is given in ms (P) or s (S)
+                duration += words.get("P", 0.0)/1000.0 + words.get("S", 0.0)
+                continue
+            if not self._move_re.match(cmd):
+                continue
+            feed_rate = words.get("F", feed_rate)
+            distance = 0.0
+            for axis in position:
+                if axis in words:
+                    distance += (words[axis] - position[axis])**2
+                    position[axis] = words[axis]
+            # feed rate is in units per minute
+            if feed_rate > 0:
+                duration += 60.0*math.sqrt(distance)/feed_rate
+        return duration
+
+
+class MachineStats(object):
+    '''
+    Statistics for one machine of a dispatcher pool.
+
+    Attributes:
+        machine (Machine): machine
+        online (bool): False if the machine failed and was taken out of the pool
+        jobs (int): number of completed jobs
+        failures (int): number of failed jobs
+        lines (int): number of acknowledged command lines
+        busy_time (float): time spent running jobs, in seconds
+        estimated_time (float): estimated duration of completed jobs, in seconds
+    '''
+    def __init__(self, machine:Machine):
+        self.machine = machine
+        self.online = True
+        self.jobs = 0
+        self.failures = 0
+        self.lines = 0
+        self.busy_time = 0.0
+        self.estimated_time = 0.0
+
+
+class Dispatcher(object):
+    '''
+    Distribute jobs over a pool of machines.
+
+    Jobs are sorted by decreasing estimated duration and each machine takes
+    the next job as soon as it is idle (longest processing time first), which
+    keeps the total time close to optimal for identical machines. Every machine
+    streams its job concurrently with the others.
+
+    When a machine fails (serial error, timeout, error reply), its connection
+    is closed, it is taken out of the pool and its job is queued again, unless
+    the job already failed max_attempts times.
+
+    Attributes:
+        machines (list[Machine]): machine pool
+        stats (list[MachineStats]): statistics for each machine
+        completed (list[Job]): completed jobs
+        failed (list[Job]): jobs that couldn't be completed
+    '''
+    def __init__(self, machines:'list[Machine]', max_attempts:int=2, window:int=1, timeout:float|None=None):
+        '''
+        Constructor.
+
+        Args:
+            machines (list[Machine]): machine pool; connections must not be open, the dispatcher opens and closes them
+            max_attempts (int): number of times a job may be started before it is considered failed (default: 2)
+            window (int): number of command lines sent ahead of acknowledgements (default: 1)
+            timeout (float|None): timeout for each command, in seconds (default: None = use machine timeout)
+
+        Raises:
+            ValueError: if machine pool is empty or if max_attempts or window are smaller than 1
+        '''
+        if len(machines) == 0:
+            raise ValueError("Machine pool must not be empty.")
+        if max_attempts < 1:
+            raise ValueError("Number of attempts must be at least 1.")
+        if window < 1:
+            raise ValueError("Window size must be at least 1.")
+        self.machines = list(machines)
+        self.stats = [MachineStats(machine) for machine in self.machines]
+        self.max_attempts = max_attempts
+        self.window = window
+        self.timeout = timeout
+        self.completed = []
+        self.failed = []
+        self.requeued = 0
+        self.__queue = []
+        self.__running = 0
+        self.__condition = None
+        self.__start_time = None
+        self.__end_time = None
+
+    def add_job(self, job:'Job|types.PathGroup|list[str]|str', name:str="") -> Job:
+        '''
+        Add a job to the queue.
+
+        Args:
+            job (Job|PathGroup|CompressedPathGroup|DepthPasses|Path|list[Path]|list[str]|str): job, or job content
+            name (str): job name, if job content is given
+
+        Returns:
+            Job: queued job
+        '''
+        if not isinstance(job, Job):
+            job = Job(job, name)
+        job.estimate = job.estimate_duration(self.machines[0])
+        self.__queue.append(job)
+        self.__queue.sort(key=lambda j: j.estimate, reverse=True)
+        return job
+
+    def get_pending(self) -> 'list[Job]':
+        '''
+        Get jobs waiting in queue.
+
+        Returns:
+            list[Job]: queued jobs, in the order they will be started
+        '''
+        return list(self.__queue)
+
+    pending = property(get_pending)
+
+    async def _stream(self, stats:MachineStats, commands) -> None:
+        '''
+        Stream command lines to a machine (see Machine.stream).
+
+        Args:
+            stats (MachineStats): machine statistics
+            commands (Iterable[str]): command lines, consumed as they're sent
+        '''
+        def on_ack():
+            stats.lines += 1
+
+        await stats.machine.stream(commands, self.window, self.timeout, on_ack)
+
+    async def _next_job(self) -> 'Job|None':
+        '''
+        Take next job from queue, waiting while other machines may requeue theirs.
+
+        Returns:
+            Job|None: next job, or None if there is nothing left to do
+        '''
+        async with self.__condition:
+            while len(self.__queue) == 0 and self.__running > 0:
+                await self.__condition.wait()
+            if len(self.__queue) == 0:
+                return None
+            self.__running += 1
+            return self.__queue.pop(0)
+
+    async def _finish_job(self, job:Job, requeue:bool) -> None:
+        '''
+        Release a job taken from queue.
+
+        Args:
+            job (Job): job
+            requeue (bool): if True, put job back in queue
+        '''
+        async with self.__condition:
+            self.__running -= 1
+            if requeue:
+                self.requeued += 1
+                self.__queue.append(job)
+                self.__queue.sort(key=lambda j: j.estimate, reverse=True)
+            self.__condition.notify_all()
+
+    async def _worker(self, stats:MachineStats) -> None:
+        '''
+        Run jobs on a machine until queue is empty or machine fails.
+
+        Args:
+            stats (MachineStats): machine statistics
+        '''
+        machine = stats.machine
+        try:
+            await machine.open()
+        except (SerialException, OSError, ValueError) as e:
+            logging.error("Cannot open machine on port {}: {}".format(machine.port, e))
+            stats.online = False
+            async with self.__condition:
+                self.__condition.notify_all()
+            return
+
+        while True:
+            job = await self._next_job()
+            if job is None:
+                break
+            job.attempts += 1
+            start = time.monotonic()
+            try:
+                await self._stream(stats, job.iter_commands(machine))
+            except (SerialException, OSError, EOFError, asyncio.TimeoutError, InvalidAnswerException) as e:
+                logging.error("Machine on port {} failed while running job '{}': {!r}".format(machine.port, job.name, e))
+                stats.busy_time += time.monotonic() - start
+                stats.failures += 1
+                stats.online = False
+                job.error = e
+                requeue = job.attempts < self.max_attempts
+                if not requeue:
+                    self.failed.append(job)
+                await self._finish_job(job, requeue)
+                break
+            stats.busy_time += time.monotonic() - start
+            stats.jobs += 1
+            stats.estimated_time += job.estimate
+            job.machine = machine
+            self.completed.append(job)
+            await self._finish_job(job, False)
+
+        try:
+            await machine.close(timeout=self.timeout)
+        except (SerialException, OSError, asyncio.TimeoutError):
+            pass
+
+    async def run(self) -> bool:
+        '''
+        Run every queued job.
+
+        Returns:
+            bool: True if every job was completed, False otherwise
+        '''
+        self.__condition = asyncio.Condition()
+        self.__running = 0
+        self.__start_time = time.monotonic()
+        self.__end_time = None
+        await asyncio.gather(*[self._worker(stats) for stats in self.stats if stats.online])
+        self.__end_time = time.monotonic()
+        # jobs left over when no machine remains online
+        self.failed.extend(self.__queue)
+        self.__queue = []
+        return len(self.failed) == 0
+
+    def get_metrics(self) -> dict:
+        '''
+        Get aggregate throughput metrics.
+
+        Returns:
+            dict: metrics with the following keys:
+                - elapsed (float): wall-clock time of last run, in seconds
+                - completed (int): number of completed jobs
+                - failed (int): number of failed jobs
+                - requeued (int): number of times a job was put back in queue
+                - pending (int): number of queued jobs
+                - lines (int): number of acknowledged command lines
+                - online (int): number of machines still in the pool
+                - jobs_per_hour (float): completed jobs per hour
+                - lines_per_second (float): acknowledged lines per second
+                - utilization (float): fraction of machine time spent running jobs
+                - speedup (float): estimated duration of completed jobs over elapsed time
+        '''
+        if self.__start_time is None:
+            elapsed = 0.0
+        else:
+            end = self.__end_time if self.__end_time is not None else time.monotonic()
+            elapsed = end - self.__start_time
+        lines = sum(s.lines for s in self.stats)
+        busy = sum(s.busy_time for s in self.stats)
+        estimated = sum(s.estimated_time for s in self.stats)
+        return {
+            "elapsed": elapsed,
+            "completed": len(self.completed),
+            "failed": len(self.failed),
+            "requeued": self.requeued,
+            "pending": len(self.__queue),
+            "lines": lines,
+            "online": sum(1 for s in self.stats if s.online),
+            "jobs_per_hour": 3600.0*len(self.completed)/elapsed if elapsed > 0 else 0.0,
+            "lines_per_second": lines/elapsed if elapsed > 0 else 0.0,
+            "utilization": busy/(elapsed*len(self.stats)) if elapsed > 0 else 0.0,
+            "speedup": estimated/elapsed if elapsed > 0 else 0.0,
+        }
+
+    metrics = property(get_metrics)
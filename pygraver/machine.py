@@ -13,6 +13,12 @@ in the RepRap wiki (http://reprap.org/wiki/G-code) may help determine compatibil
 
 import asyncio
 import serial_asyncio
+import hashlib
+import json
+import os
+import time
+from array import array
+from bisect import bisect_right
 from serial import SerialException
 from .core import types, render
 from .render import StyledPath
@@ -20,6 +26,428 @@ from .exceptions import *
 import re
 import logging
 
+class PathIndex(object):
+    '''
+    Flat index over the points of a group of paths, in tracing order.
+
+    Paths are referenced, not copied: they must not be modified while the
+    index is in use.
+
+    Attributes:
+        paths (PathGroup or list[Path]): indexed paths
+        offsets (array): index of first point of each path, followed by the total number of points
+    '''
+    def __init__(self, paths:'types.PathGroup|list[types.Path]|types.Path'):
+        '''
+        Constructor.
+
+        Args:
+            paths (PathGroup, list[Path] or Path): paths to index
+        '''
+        if isinstance(paths, types.Path):
+            paths = [paths]
+        self.paths = paths
+        self.offsets = array("q", [0])
+        for path in paths:
+            self.offsets.append(self.offsets[-1] + len(path))
+
+    def __len__(self) -> int:
+        return self.offsets[-1]
+
+    def locate(self, idx:int) -> 'tuple[int, int]':
+        '''
+        Find path and point matching a flat index.
+
+        Args:
+            idx (int): flat point index
+
+        Returns:
+            tuple[int, int]: path index and point index in path
+
+        Raises:
+            IndexError: if index is out of range
+        '''
+        if idx < 0 or idx >= len(self):
+            raise IndexError("Point index out of range.")
+        # empty paths share their offset with the next path: the last one is the right one
+        n = bisect_right(self.offsets, idx) - 1
+        return n, idx - self.offsets[n]
+
+    def index(self, path_idx:int, point_idx:int) -> int:
+        '''
+        Get flat index of a point.
+
+        Args:
+            path_idx (int): path index
+            point_idx (int): point index in path
+
+        Returns:
+            int: flat point index
+
+        Raises:
+            IndexError: if path or point index is out of range
+        '''
+        if path_idx < 0 or path_idx >= len(self.offsets) - 1:
+            raise IndexError("Path index out of range.")
+        if point_idx < 0 or point_idx >= self.offsets[path_idx + 1] - self.offsets[path_idx]:
+            raise IndexError("Point index out of range.")
+        return self.offsets[path_idx] + point_idx
+
+    def point(self, idx:int) -> types.Point:
+        '''
+        Get a copy of a point.
+
+        Args:
+            idx (int): flat point index
+
+        Returns:
+            types.Point: point
+        '''
+        n, k = self.locate(idx)
+        pt = self.paths[n][k]
+        return types.Point(pt.x, pt.y, pt.z, pt.c)
+
+    def digest(self) -> str:
+        '''
+        Compute a digest of point coordinates, to recognize paths.
+
+        Returns:
+            str: hexadecimal SHA-1 digest
+        '''
+        h = hashlib.sha1()
+        for path in self.paths:
+            h.update(array("q", [len(path)]).tobytes())
+            for coords in (path.xs, path.ys, path.zs, path.cs):
+                h.update(array("d", coords).tobytes())
+        return h.hexdigest()
+
+
+class _Coordinates(object):
+    '''
+    Point coordinates stored in a flat array (4 values per point), for moves
+    that aren't taken from paths.
+    '''
+    def __init__(self):
+        self.values = array("d")
+
+    def __len__(self) -> int:
+        return len(self.values)//4
+
+    def append(self, pt:types.Point) -> int:
+        self.values.extend((pt.x, pt.y, pt.z, pt.c))
+        return len(self) - 1
+
+    def set(self, idx:int, pt:types.Point) -> None:
+        self.values[4*idx:4*idx + 4] = array("d", (pt.x, pt.y, pt.z, pt.c))
+
+    def point(self, idx:int) -> types.Point:
+        return types.Point(*self.values[4*idx:4*idx + 4])
+
+
+class HistorySegment(object):
+    '''
+    Movements traced with one tool size.
+
+    Positions are stored as runs of consecutive indices into point sources
+    (path indices, or a coordinate array for isolated moves); points are
+    only built when they are read.
+
+    Attributes:
+        tool_size (float): tool size in relative units
+        color (list[int]): path color
+        shape (render.Shape3D or None): associated shape, if a model is set
+    '''
+    def __init__(self, tool_size:float=1.0, color:'list[int]'=[0, 0, 0, 255]):
+        '''
+        Constructor.
+
+        Args:
+            tool_size (float): tool size in relative units
+            color (list[int]): RGBA color (with 8-bit components)
+        '''
+        self.tool_size = tool_size
+        self.color = color
+        self.shape = None
+        # runs of [source, first index, last index + 1]
+        self._runs = []
+        self._size = 0
+
+    def __len__(self) -> int:
+        return self._size
+
+    def append(self, source:'PathIndex|_Coordinates', idx:int) -> None:
+        '''
+        Append a position.
+
+        Args:
+            source (PathIndex or _Coordinates): point source
+            idx (int): point index in source
+        '''
+        if len(self._runs) > 0 and self._runs[-1][0] is source and self._runs[-1][2] == idx:
+            self._runs[-1][2] += 1
+        else:
+            self._runs.append([source, idx, idx + 1])
+        self._size += 1
+
+    def pop(self) -> 'tuple[PathIndex|_Coordinates, int]':
+        '''
+        Remove last position.
+
+        Returns:
+            tuple: point source and point index in source
+        '''
+        run = self._runs[-1]
+        run[2] -= 1
+        if run[2] == run[1]:
+            self._runs.pop()
+        self._size -= 1
+        return run[0], run[2]
+
+    def __getitem__(self, idx:int) -> types.Point:
+        if idx < 0:
+            idx += self._size
+        if idx < 0 or idx >= self._size:
+            raise IndexError("Position index out of range.")
+        if idx == self._size - 1:
+            source, _, stop = self._runs[-1]
+            return source.point(stop - 1)
+        for source, start, stop in self._runs:
+            if idx < stop - start:
+                return source.point(start + idx)
+            idx -= stop - start
+
+    def __iter__(self):
+        for source, start, stop in self._runs:
+            for idx in range(start, stop):
+                yield source.point(idx)
+
+    def to_path(self) -> StyledPath:
+        '''
+        Build a path from positions.
+
+        Returns:
+            StyledPath: path with segment tool size and color
+        '''
+        points = list(self)
+        return StyledPath(
+            xs=[pt.x for pt in points], ys=[pt.y for pt in points], zs=[pt.z for pt in points], cs=[pt.c for pt in points],
+            tool_size=self.tool_size, color=self.color
+        )
+
+
+class MoveLog(object):
+    '''
+    Compact log of machine movements, split in segments of constant tool size.
+
+    Moves taken from paths are logged as indices into the traced paths
+    (which are referenced, not copied); other moves are logged as
+    coordinates in a flat array.
+    '''
+    def __init__(self):
+        self._coordinates = _Coordinates()
+        self._model = None
+        self.segments = [HistorySegment()]
+        self.append(types.Point())
+
+    def __len__(self) -> int:
+        return len(self.segments)
+
+    def __getitem__(self, idx:int) -> HistorySegment:
+        return self.segments[idx]
+
+    def __iter__(self):
+        return iter(self.segments)
+
+    def append(self, pt:types.Point) -> None:
+        '''
+        Log a position given by its coordinates.
+
+        Args:
+            pt (types.Point): position
+        '''
+        self.segments[-1].append(self._coordinates, self._coordinates.append(pt))
+
+    def append_index(self, source:PathIndex, idx:int) -> None:
+        '''
+        Log a position taken from indexed paths.
+
+        Args:
+            source (PathIndex): indexed paths
+            idx (int): flat point index
+        '''
+        self.segments[-1].append(source, idx)
+
+    def add(self, entry:'types.Point|tuple[PathIndex, int]') -> None:
+        '''
+        Log a position given either by its coordinates or by a path index and a point index.
+
+        Args:
+            entry (types.Point or tuple[PathIndex, int]): position
+        '''
+        if isinstance(entry, types.Point):
+            self.append(entry)
+        else:
+            self.append_index(*entry)
+
+    def get_last(self) -> types.Point:
+        '''
+        Get last position.
+
+        Returns:
+            types.Point: copy of last position
+        '''
+        return self.segments[-1][-1]
+
+    def set_last(self, pt:types.Point) -> None:
+        '''
+        Replace last position (e.g. when machine coordinates are set).
+
+        Args:
+            pt (types.Point): new position
+        '''
+        source, idx = self.segments[-1].pop()
+        if source is self._coordinates and idx == len(source) - 1:
+            source.set(idx, pt)
+            self.segments[-1].append(source, idx)
+        else:
+            self.append(pt)
+
+    last = property(get_last, set_last)
+
+    def set_tool_size(self, tool_size:float) -> None:
+        '''
+        Set tool size; a new segment is started if some moves were made with another tool size.
+
+        Args:
+            tool_size (float): tool size, in relative units
+        '''
+        last = self.segments[-1]
+        if len(last) > 1 and last.tool_size != tool_size:
+            # new segment starts where the last one ends
+            source, idx = last.pop()
+            last.append(source, idx)
+            segment = HistorySegment(tool_size, last.color)
+            segment.append(source, idx)
+            self.segments.append(segment)
+        self.segments[-1].tool_size = tool_size
+
+    def set_model(self, model:'render.Model|None') -> None:
+        '''
+        Set render model; one shape is created per segment.
+
+        Args:
+            model (render.Model|None): model to use to render movements, or None for no model.
+        '''
+        self._model = model
+        for segment in self.segments:
+            segment.shape = None
+        self.refresh()
+
+    def refresh(self) -> None:
+        '''
+        Update shapes of render model with new moves (only the last segment can change).
+        '''
+        if self._model is None:
+            return
+        for segment in self.segments:
+            if segment.shape is None:
+                segment.shape = render.CartesianWire(segment.to_path(), segment.tool_size, segment.color)
+                segment.shape.label = "Tool: {}".format(segment.tool_size)
+                self._model.add_shape(segment.shape)
+        segment = self.segments[-1]
+        segment.shape.set_path(segment.to_path(), segment.tool_size, segment.color)
+
+
+class Checkpoint(object):
+    '''
+    Progress of a job traced from a group of paths.
+
+    Progress is the number of acknowledged moves, i.e. the flat index (see
+    PathIndex) of the first move that must be sent again to resume the job.
+    A digest of the paths makes sure that a job is resumed with the paths it
+    was started with. If a file name is given, progress is saved to it as a
+    small JSON document while the job runs.
+
+    Attributes:
+        filename (str|None): file to save progress to, or None
+        digest (str): digest of traced paths (empty until the job is started)
+        total (int): number of moves in job
+        done (int): number of acknowledged moves
+        interval (float): minimum time between two saves while the job runs, in seconds
+    '''
+    def __init__(self, filename:str|None=None, digest:str="", total:int=0, done:int=0, interval:float=1.0):
+        '''
+        Constructor.
+
+        Args:
+            filename (str|None): file to save progress to, or None
+            digest (str): digest of traced paths
+            total (int): number of moves in job
+            done (int): number of acknowledged moves
+            interval (float): minimum time between two saves while the job runs, in seconds
+        '''
+        self.filename = filename
+        self.digest = digest
+        self.total = total
+        self.done = done
+        self.interval = interval
+        self._saved = 0.0
+
+    @classmethod
+    def load(cls, filename:str) -> 'Checkpoint':
+        '''
+        Load checkpoint from file.
+
+        Args:
+            filename (str): checkpoint file
+
+        Returns:
+            Checkpoint: loaded checkpoint; progress will be saved to the same file
+
+        Raises:
+            ValueError: if file content isn't a valid checkpoint
+        '''
+        with open(filename, "r") as f:
+            try:
+                data = json.load(f)
+                return cls(filename, str(data["digest"]), int(data["total"]), int(data["done"]))
+            except (ValueError, KeyError, TypeError):
+                raise ValueError("Invalid checkpoint file: {}.".format(filename))
+
+    def save(self) -> None:
+        '''
+        Save progress to file, if a file name is set.
+        The file is replaced at once, so that it is never left half-written.
+        '''
+        self._saved = time.monotonic()
+        if self.filename is None:
+            return
+        tmp_name = "{}.tmp".format(self.filename)
+        with open(tmp_name, "w") as f:
+            json.dump({"digest": self.digest, "total": self.total, "done": self.done}, f)
+        os.replace(tmp_name, self.filename)
+
+    def acknowledge(self, n_moves:int=1) -> None:
+        '''
+        Count acknowledged moves; progress is saved if last save is older than *interval*.
+
+        Args:
+            n_moves (int): number of acknowledged moves
+        '''
+        self.done += n_moves
+        if time.monotonic() - self._saved >= self.interval:
+            self.save()
+
+    def is_complete(self) -> bool:
+        '''
+        Tell if every move of the job was acknowledged.
+
+        Returns:
+            bool: True if job is complete
+        '''
+        return len(self.digest) > 0 and self.done >= self.total
+
+
 class Machine(object):
     '''
     Machine handling class.
@@ -30,8 +458,7 @@ class Machine(object):
     Attributes:
         port (str): logical serial port path
         ser (serial.Serial or None): serial connection object, if created, or None
-        history (list): list of every movement since object creation
-        (see display_history for informations on history entries format)
+        history (MoveLog): log of every movement since object creation, split in segments of constant tool size
     
     Note:
         This class assumes that the machine has 3 linear axes (x,y,z) and one rotary axis perpendicular
@@ -61,8 +488,7 @@ class Machine(object):
         self._feed_rate = 100.0
         self._endstops = True
         # history (for display purpose)
-        self.history = [StyledPath()]
-        self.history[-1].append(types.Point())
+        self.history = MoveLog()
         self.__model = None
 
     def set_port(self, port:str) -> None:
@@ -207,12 +633,7 @@ class Machine(object):
         '''
         if tool_size<=0:
             raise ValueError("Tool size must be strictly positive.")
-        if len(self.history[-1])>1:
-            if self.history[-1].tool_size != tool_size:
-                new_path = StyledPath()
-                new_path.append(self.history[-1][-1])
-                self.history.append(new_path)
-        self.history[-1].tool_size = tool_size
+        self.history.set_tool_size(tool_size)
 
     def get_tool_size(self) -> float:
         '''
@@ -412,10 +833,7 @@ class Machine(object):
             asyncio.TimeoutError: if machine didn't answer within timeout
         '''
         if self.__writer is None:
-            if len(self.history)>0:
-                return self.history[-1][-1]
-            else:
-                return types.Point()
+            return self.history.last
 
         rep = await self.ask(cmd="M114", n_lines=2, timeout=timeout)
 
@@ -423,12 +841,13 @@ class Machine(object):
             raise asyncio.TimeoutError("Machine didn't answer within timeout.")
 
         pt = types.Point()
+        last = self.history.last
         for ax in self._axes:
             match = re.search("(?i)({}:(?: |)(?:-|)[0-9]{{1,8}}(?:\.|)[0-9]{{0,8}})".format(ax).encode("utf-8"), rep[0])
             if match is not None:
                 setattr(pt, self._axes[ax], float(match.group(1).split(b":")[1]))
             else:
-                setattr(pt, self._axes[ax], getattr(self.history[-1][-1], self._axes[ax]))
+                setattr(pt, self._axes[ax], getattr(last, self._axes[ax]))
         
         return pt
     
@@ -471,9 +890,11 @@ class Machine(object):
             return await self.set_position(x=position.x, y=position.y, z=position.z, c=position.c, timeout=timeout)
         
         new_pos = self._parse_position(**kwargs)
-        if len(self.history)>0:
+        if len(new_pos)>0:
+            pt = self.history.last
             for key in new_pos:
-                setattr(self.history[-1][-1], self._axes[key], new_pos[key])
+                setattr(pt, self._axes[key], new_pos[key])
+            self.history.last = pt
         
         if self.__writer is None or len(new_pos)==0:
             return False
@@ -563,9 +984,10 @@ class Machine(object):
         )
         
         pt = types.Point()
-        self.history[-1].append(pt)
         for ax in new_pos:
             setattr(pt, self._axes[ax], new_pos[ax])
+        self.history.append(pt)
+        self.history.refresh()
         
         return (await self.ask(cmd=cmd, n_lines=2, timeout=timeout)) is not None
 
@@ -664,10 +1086,110 @@ class Machine(object):
         '''
         # switches motors on (state=True) or off (state=False)
         return await len(self.ask(cmd="M84 S30" if state else "M18", timeout=timeout))==1
+
+    async def probe(self, x:float=0.0, y:float=0.0, c:float|None=None, timeout:float|None=None) -> float:
+        '''
+        Measure stock height with the Z probe at given position.
         
-    async def trace(self, path:types.Path|None=None, xs:'list[float]|None'=None, ys:'list[float]|None'=None, zs:'list[float]|None'=None, cs:'list[float]|None'=None, timeout:float|None=None) -> bool:
+        Args:
+            x (float): x coordinate of probed point
+            y (float): y coordinate of probed point
+            c (float|None): if given, rotate to this c coordinate before probing
+            timeout (float|None): timeout in seconds, or None for infinite.
+        
+        Returns:
+            float: measured height
+        
+        Raises:
+            SerialException: if no machine connection is open
+            asyncio.TimeoutError: if machine didn't answer within timeout
+            InvalidAnswerException: if machine answer doesn't contain a height
         '''
-        Trace given path.
+        if self.__writer is None:
+            raise SerialException("No machine connection is open.")
+        
+        if c is not None and not await self.abs_move(c=c, timeout=timeout):
+            raise asyncio.TimeoutError("Machine didn't answer within timeout.")
+        
+        # G30 with S-1 reports probed height without changing machine coordinates
+        rep = await self.ask(cmd="G30 X{:f} Y{:f} S-1".format(x, y), n_lines=2, timeout=timeout)
+        if rep is None or len(rep)!=2:
+            raise asyncio.TimeoutError("Machine didn't answer within timeout.")
+        
+        match = re.search(b"(?i)Z:\\s*(-?[0-9]{1,8}(?:\\.[0-9]{0,8})?)", rep[0])
+        if match is None:
+            raise InvalidAnswerException("Probe answer doesn't contain a height: {}".format(rep[0]))
+        return float(match.group(1))
+
+    async def probe_grid(self, x0:float, y0:float, dx:float, dy:float, nx:int, ny:int, timeout:float|None=None) -> types.HeightMap:
+        '''
+        Probe flat stock on a regular grid and make a height map from it.
+        
+        Points are probed row by row, alternating directions to reduce travel.
+        
+        Args:
+            x0 (float): grid origin along x
+            y0 (float): grid origin along y
+            dx (float): grid step along x
+            dy (float): grid step along y
+            nx (int): number of points along x
+            ny (int): number of points along y
+            timeout (float|None): timeout in seconds for each point, or None for infinite.
+        
+        Returns:
+            types.HeightMap: height map with bilinear interpolation
+        '''
+        heights = [0.0]*(nx*ny)
+        for j in range(ny):
+            columns = range(nx) if j%2==0 else reversed(range(nx))
+            for i in columns:
+                heights[j*nx + i] = await self.probe(x=x0 + i*dx, y=y0 + j*dy, timeout=timeout)
+        return types.HeightMap(x0, y0, dx, dy, nx, ny, heights)
+
+    async def probe_ring(self, x0:float, dx:float, nx:int, nc:int, radius:float, y:float=0.0, timeout:float|None=None) -> types.HeightMap:
+        '''
+        Probe cylindrical stock on rings of c positions and make a height map from it.
+        
+        Args:
+            x0 (float): position of first ring along x
+            dx (float): distance between rings along x
+            nx (int): number of rings
+            nc (int): number of points on each ring (evenly spread over one revolution)
+            radius (float): nominal stock radius
+            y (float): y coordinate of probed points (default: 0)
+            timeout (float|None): timeout in seconds for each point, or None for infinite.
+        
+        Returns:
+            types.HeightMap: height map in axial coordinates, with bilinear interpolation
+        '''
+        dc = 360.0/nc
+        heights = [0.0]*(nx*nc)
+        for j in range(nc):
+            columns = range(nx) if j%2==0 else reversed(range(nx))
+            for i in columns:
+                heights[j*nx + i] = await self.probe(x=x0 + i*dx, y=y, c=j*dc, timeout=timeout)
+        return types.HeightMap(x0, 0.0, dx, dc, nx, nc, heights, types.HeightMapCoordinates.Axial, radius)
+
+    async def probe_points(self, points:'list[types.Point]', regularization:float=0.0, timeout:float|None=None) -> types.HeightMap:
+        '''
+        Probe flat stock at given points and fit a thin-plate spline through them.
+        
+        Args:
+            points (list[types.Point]): points to probe (only x and y are used)
+            regularization (float): spline smoothing parameter (default: 0 = spline goes through measurements)
+            timeout (float|None): timeout in seconds for each point, or None for infinite.
+        
+        Returns:
+            types.HeightMap: height map with thin-plate spline interpolation
+        '''
+        xs = [pt.x for pt in points]
+        ys = [pt.y for pt in points]
+        zs = [await self.probe(x=pt.x, y=pt.y, timeout=timeout) for pt in points]
+        return types.HeightMap(xs, ys, zs, regularization)
+        
+    def make_trace_commands(self, path:types.Path|None=None, xs:'list[float]|None'=None, ys:'list[float]|None'=None, zs:'list[float]|None'=None, cs:'list[float]|None'=None) -> 'list[str]':
+        '''
+        Make the command lines needed to trace given path.
         
         Args:
             path (Optional[Path]): path to trace
@@ -675,10 +1197,9 @@ class Machine(object):
             ys (Optional[list]): point vector for y coordinates
             zs (Optional[list]): point vector for z coordinates
             cs (Optional[list]): point vector for c coordinates
-            timeout (float|None): timeout in seconds, or None for infinite.
         
         Returns:
-            bool: True if successful, False otherwise
+            list[str]: one move command per point (absolute positioning is assumed)
         
         Notes:
             path argument takes precedence over xs, ys, zs, and cs
@@ -688,7 +1209,7 @@ class Machine(object):
             
         '''
         if path is not None:
-            return await self.trace(xs=path.xs, ys=path.ys, zs=path.zs, cs=path.cs, timeout=timeout)
+            return self.make_trace_commands(xs=path.xs, ys=path.ys, zs=path.zs, cs=path.cs)
         
         if xs is None and ys is None and zs is None and cs is None:
             raise ValueError("At least one vector must be specified.")
@@ -708,15 +1229,8 @@ class Machine(object):
         if zs is None: zs = [0]*Npts
         if cs is None: cs = [0]*Npts
         
-        # set to absolute mode
-        await self.ask(cmd="G90", timeout=timeout)
-        success = True
-        tasks = []
-        loop = asyncio.get_event_loop()
-        for n in range(Npts):
-            pt = types.Point(xs[n], ys[n], zs[n], cs[n])
-            self.history[-1].append(pt)
-            chain = "G1 X{xpos:f} Y{ypos:f} Z{zpos:f} C{cpos:f} F{feed_rate:f} {es_code}{endstops:d}".format(
+        return [
+            "G1 X{xpos:f} Y{ypos:f} Z{zpos:f} C{cpos:f} F{feed_rate:f} {es_code}{endstops:d}".format(
                 xpos = xs[n],
                 ypos = ys[n],
                 zpos = zs[n],
@@ -725,12 +1239,358 @@ class Machine(object):
                 es_code = self._endstops_code,
                 endstops = self._endstops
             )
+            for n in range(Npts)
+        ]
+
+    def make_pass_commands(self, passes:types.DepthPasses):
+        '''
+        Make the command lines needed to trace given depth passes.
+
+        Commands are produced one at a time, as passes are computed, so that
+        a deep multi-pass job is never held in memory as a whole.
+
+        Args:
+            passes (types.DepthPasses): depth passes to trace
+
+        Yields:
+            str: one move command per point (absolute positioning is assumed); feed rate is scaled by pass feed factor
+        '''
+        for x, y, z, c, factor in passes:
+            yield "G1 X{xpos:f} Y{ypos:f} Z{zpos:f} C{cpos:f} F{feed_rate:f} {es_code}{endstops:d}".format(
+                xpos = x,
+                ypos = y,
+                zpos = z,
+                cpos = c,
+                feed_rate = self._feed_rate*factor,
+                es_code = self._endstops_code,
+                endstops = self._endstops
+            )
+
+    async def trace_passes(self, passes:types.DepthPasses, window:int=64, timeout:float|None=None) -> bool:
+        '''
+        Trace given depth passes.
+
+        At most *window* lines are sent ahead of acknowledgements.
+
+        Args:
+            passes (types.DepthPasses): depth passes to trace
+            window (int): number of command lines sent before waiting for answers
+            timeout (float|None): timeout in seconds, or None for infinite.
+
+        Returns:
+            bool: True if successful, False otherwise
+
+        Raises:
+            ValueError: if window is smaller than 1
+        '''
+        async def moves():
+            for chain, (x, y, z, c, _) in zip(self.make_pass_commands(passes), passes):
+                yield chain, types.Point(x, y, z, c)
+
+        return await self._stream_moves(moves(), window, timeout)
+
+    async def trace_pipeline(self, pipeline:types.Pipeline, outputs:'list[str]|None'=None, window:int=64, timeout:float|None=None) -> bool:
+        '''
+        Trace paths produced by a pipeline, as they are produced.
+
+        Output chunks are awaited in a worker thread, so that pipeline stages
+        keep running while moves are sent; the first moves are sent as soon as
+        the first chunk is out. At most *window* lines are sent ahead of
+        acknowledgements.
+
+        Args:
+            pipeline (types.Pipeline): pipeline to run (it is started if needed)
+            outputs (list[str]|None): names of output stages to trace, or None for every output
+            window (int): number of command lines sent before waiting for answers
+            timeout (float|None): timeout in seconds, or None for infinite.
+
+        Returns:
+            bool: True if successful, False otherwise
+
+        Raises:
+            ValueError: if window is smaller than 1
+        '''
+        loop = asyncio.get_event_loop()
+        chunks = iter(pipeline)
+
+        async def moves():
+            while True:
+                output = await loop.run_in_executor(None, next, chunks, None)
+                if output is None:
+                    return
+                name, chunk = output
+                if outputs is not None and name not in outputs:
+                    continue
+                source = PathIndex(chunk)
+                idx = 0
+                for path in chunk:
+                    for chain in self.make_trace_commands(path=path):
+                        yield chain, (source, idx)
+                        idx += 1
+
+        return await self._stream_moves(moves(), window, timeout)
+
+    async def trace_group(self, paths:'types.PathGroup|list[types.Path]', checkpoint:'Checkpoint|str|None'=None, start:'int|tuple[int, int]|None'=None,
+                          safe_height:float|None=None, window:int=64, timeout:float|None=None) -> bool:
+        '''
+        Trace a group of paths, keeping track of acknowledged moves so that the job can be resumed.
+
+        Moves are indexed by their position in the paths, flattened in tracing
+        order (see PathIndex), and at most *window* lines are sent ahead of
+        acknowledgements; only moves acknowledged with "ok" count as done. When the
+        job doesn't start at first move, the tool is lifted to *safe_height*,
+        moved above the last acknowledged position and lowered to it before
+        tracing resumes.
+
+        Args:
+            paths (PathGroup or list[Path]): paths to trace
+            checkpoint (Checkpoint|str|None): checkpoint, or name of checkpoint file (an existing file is loaded, so that an interrupted job resumes where it stopped and a completed job isn't traced again), or None
+            start (int|tuple[int, int]|None): first move to send, as a flat index or a (path index, point index) pair; takes precedence over checkpoint progress
+            safe_height (float|None): height of re-approach moves, above stock top; required when job doesn't start at first move
+            window (int): number of command lines sent before waiting for answers
+            timeout (float|None): timeout in seconds, or None for infinite.
+
+        Returns:
+            bool: True if successful, False otherwise
+
+        Raises:
+            ValueError: if window is smaller than 1, if checkpoint was made for other paths, or if job resumes without safe height
+            IndexError: if start is out of range
+            InvalidAnswerException: if machine replied with an error
+        '''
+        if window < 1:
+            raise ValueError("Window must be at least 1.")
+        source = PathIndex(paths)
+        digest = source.digest()
+        if checkpoint is None:
+            checkpoint = Checkpoint()
+        elif isinstance(checkpoint, str):
+            checkpoint = Checkpoint.load(checkpoint) if os.path.exists(checkpoint) else Checkpoint(checkpoint)
+        if len(checkpoint.digest) == 0:
+            checkpoint.digest = digest
+            checkpoint.total = len(source)
+        elif checkpoint.digest != digest or checkpoint.total != len(source):
+            raise ValueError("Checkpoint doesn't match paths.")
+
+        if start is None:
+            start = checkpoint.done
+        elif isinstance(start, tuple):
+            start = source.index(*start)
+        if start < 0 or start > len(source):
+            raise IndexError("Start index out of range.")
+        checkpoint.done = start
+        checkpoint.save()
+        if start == len(source):
+            return True
+        if start > 0 and safe_height is None:
+            raise ValueError("A safe height is needed to resume a job.")
+
+        try:
+            if start > 0:
+                # re-approach: up, over last acknowledged position, then down at feed rate
+                pt = source.point(start - 1)
+                height = max(pt.z, safe_height)
+                lifted = types.Point(pt.x, pt.y, height, pt.c)
+                settings = " F{:f} {}{:d}".format(self._feed_rate, self._endstops_code, self._endstops)
+                approach = [
+                    ("G90", None),
+                    (self._make_position_string("G0", {"Z": height}) + settings, lifted),
+                    (self._make_position_string("G0", {"X": pt.x, "Y": pt.y, "C": pt.c}) + settings, lifted),
+                    (self.make_trace_commands(xs=[pt.x], ys=[pt.y], zs=[pt.z], cs=[pt.c])[0], pt),
+                ]
+                for chain, pos in approach:
+                    if pos is not None:
+                        self.history.append(pos)
+                    try:
+                        await self.stream([chain], timeout=timeout)
+                    except (asyncio.TimeoutError, SerialException, EOFError):
+                        return False
+
+            async def moves():
+                path_idx, point_idx = source.locate(start)
+                for n in range(path_idx, len(source.offsets) - 1):
+                    path = source.paths[n]
+                    if len(path) == 0:
+                        continue
+                    commands = self.make_trace_commands(path=path)
+                    for k in range(point_idx if n == path_idx else 0, len(commands)):
+                        yield commands[k], (source, source.offsets[n] + k)
+
+            return await self._stream_moves(moves(), window, timeout, checkpoint)
+        finally:
+            # keep exact progress, whatever stopped the job
+            checkpoint.save()
+
+    async def acknowledge(self, timeout:float|None=None) -> None:
+        '''
+        Wait for the acknowledgement of one command line.
+
+        Lines other than acknowledgements and errors (echo, busy, ...) are informative and skipped.
+
+        Args:
+            timeout (float|None): timeout in seconds, or None for infinite.
+
+        Raises:
+            asyncio.TimeoutError: if machine didn't answer within timeout
+            InvalidAnswerException: if machine replied with an error
+            SerialException: if connection is closed
+        '''
+        ok = self._response_ok.encode("utf-8")
+        while True:
+            line = await self.readline(timeout)
+            if line is None:
+                raise SerialException("Machine connection is closed.")
+            line = line.strip()
+            if line.startswith(ok):
+                return
+            if line.lower().startswith(b"error") or line.startswith(b"!!"):
+                raise InvalidAnswerException(line.decode("utf-8", "replace"))
+
+    async def stream(self, commands, window:int=1, timeout:float|None=None, on_ack=None) -> int:
+        '''
+        Send command lines, keeping at most *window* lines ahead of acknowledgements.
+
+        Commands are taken from the iterable as they're sent, so that generators
+        are never expanded as a whole.
+
+        Args:
+            commands (Iterable[str] or AsyncIterable[str]): command lines
+            window (int): number of command lines sent ahead of acknowledgements
+            timeout (float|None): timeout in seconds, or None for infinite.
+            on_ack (callable|None): function called (without argument) after each acknowledged line
+
+        Returns:
+            int: number of acknowledged lines
+
+        Raises:
+            ValueError: if window is smaller than 1
+            asyncio.TimeoutError: if machine didn't answer within timeout
+            InvalidAnswerException: if machine replied with an error
+            SerialException: if connection is closed
+        '''
+        if window < 1:
+            raise ValueError("Window must be at least 1.")
+
+        async def lines():
+            if hasattr(commands, "__aiter__"):
+                async for cmd in commands:
+                    yield cmd
+            else:
+                for cmd in commands:
+                    yield cmd
+
+        pending = 0
+        acknowledged = 0
+        async for cmd in lines():
+            await self.write(cmd=cmd, timeout=timeout)
+            pending += 1
+            if pending < window:
+                continue
+            await self.acknowledge(timeout)
+            pending -= 1
+            acknowledged += 1
+            if on_ack is not None:
+                on_ack()
+        while pending > 0:
+            await self.acknowledge(timeout)
+            pending -= 1
+            acknowledged += 1
+            if on_ack is not None:
+                on_ack()
+        return acknowledged
+
+    async def _stream_moves(self, moves, window:int, timeout:float|None=None, checkpoint:Checkpoint|None=None) -> bool:
+        '''
+        Send move commands, keeping at most *window* lines ahead of acknowledgements (see stream).
+
+        Args:
+            moves (AsyncIterable[tuple[str, types.Point|tuple[PathIndex, int]]]): command lines and corresponding positions (see MoveLog.add)
+            window (int): number of command lines sent ahead of acknowledgements
+            timeout (float|None): timeout in seconds, or None for infinite.
+            checkpoint (Checkpoint|None): checkpoint counting acknowledged moves, or None
+
+        Returns:
+            bool: True if successful, False if machine didn't answer or connection is closed
+
+        Raises:
+            ValueError: if window is smaller than 1
+            InvalidAnswerException: if machine replied with an error
+        '''
+        if window < 1:
+            raise ValueError("Window must be at least 1.")
+
+        async def commands():
+            async for chain, entry in moves:
+                self.history.add(entry)
+                yield chain
+
+        acknowledged = 0
+        def on_ack():
+            nonlocal acknowledged
+            acknowledged += 1
+            if checkpoint is not None:
+                checkpoint.acknowledge()
+            if acknowledged % window == 0:
+                self.history.refresh()
+
+        try:
+            # set to absolute mode
+            await self.stream(["G90"], timeout=timeout)
+            await self.stream(commands(), window, timeout, on_ack)
+        except (asyncio.TimeoutError, SerialException, EOFError):
+            return False
+        finally:
+            self.history.refresh()
+        return await self.wait(timeout=timeout)
+
+    async def trace(self, path:types.Path|None=None, xs:'list[float]|None'=None, ys:'list[float]|None'=None, zs:'list[float]|None'=None, cs:'list[float]|None'=None, timeout:float|None=None) -> bool:
+        '''
+        Trace given path.
+        
+        Args:
+            path (Optional[Path]): path to trace
+            xs (Optional[list]): point vector for x coordinates
+            ys (Optional[list]): point vector for y coordinates
+            zs (Optional[list]): point vector for z coordinates
+            cs (Optional[list]): point vector for c coordinates
+            timeout (float|None): timeout in seconds, or None for infinite.
+        
+        Returns:
+            bool: True if successful, False otherwise
+        
+        Notes:
+            path argument takes precedence over xs, ys, zs, and cs
+        
+        Raises:
+            ValueError: if all point vectors are omitted
+            
+        '''
+        if path is not None:
+            commands = self.make_trace_commands(path=path)
+        else:
+            commands = self.make_trace_commands(xs=xs, ys=ys, zs=zs, cs=cs)
+            Npts = len(commands)
+            if xs is None: xs = [0]*Npts
+            if ys is None: ys = [0]*Npts
+            if zs is None: zs = [0]*Npts
+            if cs is None: cs = [0]*Npts
+            path = types.Path(xs=xs, ys=ys, zs=zs, cs=cs)
+        source = PathIndex(path)
+        
+        # set to absolute mode
+        await self.ask(cmd="G90", timeout=timeout)
+        success = True
+        tasks = []
+        loop = asyncio.get_event_loop()
+        for n, chain in enumerate(commands):
+            self.history.append_index(source, n)
             tasks.append(asyncio.ensure_future(self.write(cmd=chain, timeout=timeout), loop=loop))
         
         # send command lines
         await asyncio.wait(tasks)
         # read answers => len(path)*"ok" if succesful, None if failed
         success = success and (await self.wait_answer(n_lines=len(tasks), timeout=timeout) is not None)
+        self.history.refresh()
         return success and await self.wait(timeout=timeout)
         
     def set_model(self, model:render.Model) -> None:
@@ -741,11 +1601,7 @@ class Machine(object):
             model (render.Model|None): model to use to render movements, or None for no model.
         '''
         self.__model = model
-        for path in self.history:
-            shape = render.CartesianWire(path, path.tool_size, path.color)
-            shape.label = "Tool: {}".format(path.tool_size)
-            model.add_shape(shape)
-            path.shape = shape
+        self.history.set_model(model)
     
     def get_model(self) -> render.Model|None:
         '''
@@ -775,6 +1631,7 @@ class SyncMachine():
     term_char = property(lambda self: self.__machine.term_char, lambda self, term_char: setattr(self.__machine, "term_char", term_char))
     response_ok = property(lambda self: self.__machine.response_ok, lambda self, response_ok: setattr(self.__machine, "response_ok", response_ok))
     tool_size = property(lambda self: self.__machine.tool_size, lambda self, tool_size: setattr(self.__machine, "tool_size", tool_size))
+    history = property(lambda self: self.__machine.history)
 
     def disable_endstops(self) -> None:
         self.__machine.disable_endstops()
@@ -836,3 +1693,25 @@ class SyncMachine():
     
     def trace(self, path:types.Path|None=None, xs=None, ys=None, zs=None, cs=None, timeout:float=None) -> None:
         return self.__loop.run_until_complete(self.__machine.trace(path, xs, ys, zs, cs, timeout))
+
+    def trace_passes(self, passes:types.DepthPasses, window:int=64, timeout:float|None=None) -> bool:
+        return self.__loop.run_until_complete(self.__machine.trace_passes(passes, window, timeout))
+
+    def trace_pipeline(self, pipeline:types.Pipeline, outputs:'list[str]|None'=None, window:int=64, timeout:float|None=None) -> bool:
+        return self.__loop.run_until_complete(self.__machine.trace_pipeline(pipeline, outputs, window, timeout))
+
+    def trace_group(self, paths:'types.PathGroup|list[types.Path]', checkpoint:'Checkpoint|str|None'=None, start:'int|tuple[int, int]|None'=None,
+                    safe_height:float|None=None, window:int=64, timeout:float|None=None) -> bool:
+        return self.__loop.run_until_complete(self.__machine.trace_group(paths, checkpoint, start, safe_height, window, timeout))
+
+    def probe(self, x:float=0.0, y:float=0.0, c:float|None=None, timeout:float|None=None) -> float:
+        return self.__loop.run_until_complete(self.__machine.probe(x, y, c, timeout))
+
+    def probe_grid(self, x0:float, y0:float, dx:float, dy:float, nx:int, ny:int, timeout:float|None=None) -> types.HeightMap:
+        return self.__loop.run_until_complete(self.__machine.probe_grid(x0, y0, dx, dy, nx, ny, timeout))
+
+    def probe_ring(self, x0:float, dx:float, nx:int, nc:int, radius:float, y:float=0.0, timeout:float|None=None) -> types.HeightMap:
+        return self.__loop.run_until_complete(self.__machine.probe_ring(x0, dx, nx, nc, radius, y, timeout))
+
+    def probe_points(self, points:'list[types.Point]', regularization:float=0.0, timeout:float|None=None) -> types.HeightMap:
+        return self.__loop.run_until_complete(self.__machine.probe_points(points, regularization, timeout))
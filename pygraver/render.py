@@ -505,14 +505,17 @@ class BalloonText(vtkBalloonWidget):
         # force render
         self.GetInteractor().GetRenderWindow().Render()
     
-    def __init__(self, shape:render.Shape3D) -> None:
+    def __init__(self, shape:render.Shape3D, model:render.Model|None=None) -> None:
         '''
         Constructor.
         
         Args:
             shape (render.Shape3D): associated shape
+            model (render.Model or None): if given, hovered actors are found with the model's spatial index instead of testing every actor
         '''
         self.shape = shape
+        if model is not None:
+            self.SetPicker(model.picker)
         repr = vtkBalloonRepresentation()
         repr.SetBalloonLayoutToImageRight()
         repr.SetPadding(20)
@@ -6,18 +6,67 @@ from trame.ui.vuetify import SinglePageLayout
 from trame.widgets import vuetify, vtk
 from trame.app import asynchronous, Server
 
-from vtkmodules.vtkRenderingCore import vtkRenderWindow
+from vtkmodules.vtkCommonCore import vtkCommand
+from vtkmodules.vtkRenderingCore import vtkRenderWindow, vtkWindowToImageFilter
+from vtkmodules.vtkIOImage import vtkJPEGWriter
+
+import asyncio
+import time
+
+
+def count_triangles(window:vtkRenderWindow) -> int:
+    '''
+    Count triangles displayed in a render window (visible actors only).
+
+    Polygons with n points count as n-2 triangles, as do triangle strips.
+
+    Args:
+        window (vtkRenderWindow): window to look into.
+
+    Returns:
+        int: number of triangles.
+    '''
+    count = 0
+    renderers = window.GetRenderers()
+    renderers.InitTraversal()
+    for _ in range(renderers.GetNumberOfItems()):
+        actors = renderers.GetNextItem().GetActors()
+        actors.InitTraversal()
+        for _ in range(actors.GetNumberOfItems()):
+            actor = actors.GetNextActor()
+            mapper = actor.GetMapper()
+            if not actor.GetVisibility() or mapper is None:
+                continue
+            data = mapper.GetInput()
+            if data is None or not hasattr(data, "GetPolys"):
+                continue
+            for cells in (data.GetPolys(), data.GetStrips()):
+                # connectivity size minus 2 per cell
+                count += max(0, cells.GetNumberOfConnectivityIds() - 2*cells.GetNumberOfCells())
+    return count
 
 
 class WebLayout(SinglePageLayout):
     '''
     A basic web layout class which is made to update its content dynamically.
 
+    The scene can be rendered in two ways:
+
+    - local rendering: geometry is sent to the browser, which renders it (smooth
+      interaction, but heavy for the client with big models);
+    - remote rendering: the server renders offscreen and streams compressed
+      images; image quality and resolution are lowered during interaction to
+      keep frame time near a target.
+
+    In 'auto' mode, remote rendering is used when the scene has more triangles
+    than a given limit; the mode is checked again on each refresh. The window
+    is only switched to offscreen rendering once remote rendering is selected.
+
     Note that the correct manner to instantiate this class is:
 
         with WebLayout(args...) as layout:
             pass
-    
+
     Using the classical assignment syntax (layout = WebLayout(...)) won't work.
     '''
     @asynchronous.task
@@ -29,42 +78,228 @@ class WebLayout(SinglePageLayout):
         '''
         pass
 
-    def __init__(self, server:Server, window: vtkRenderWindow) -> None:
+    def __init__(self, server:Server, window: vtkRenderWindow, mode:str="auto", max_local_triangles:int=500000,
+                 target_frame_time:float=1/15, max_bandwidth:float=0, still_quality:int=90) -> None:
         '''
         Constructor.
-        
+
         Args:
             server (Server): trame server object.
             window (vtkRenderWindow): window to display on server.
+            mode (str): 'local', 'remote' or 'auto'.
+            max_local_triangles (int): in 'auto' mode, largest number of triangles rendered locally.
+            target_frame_time (float): frame time (in seconds) to aim at during remote interaction.
+            max_bandwidth (float): largest estimated stream rate in remote mode, in bytes per second (0 for no limit).
+            still_quality (int): JPEG quality of still images in remote mode (0-100).
         '''
+        if mode not in ("local", "remote", "auto"):
+            raise ValueError("Rendering mode must be 'local', 'remote' or 'auto'.")
         super().__init__(server)
+        self._window = window
+        self._mode = mode
+        self.max_local_triangles = max_local_triangles
+        self.target_frame_time = target_frame_time
+        self.max_bandwidth = max_bandwidth
+        self.still_quality = still_quality
+        # frame statistics, updated by render window observers
+        self._render_start = 0.0
+        self._frame_times = []
+        self._frame_count = 0
+        self._metrics = {"mode": "local", "triangles": 0, "frame_time": 0.0, "fps": 0.0,
+                         "bytes_per_second": 0.0, "frame_bytes": 0, "quality": 0, "ratio": 1.0}
+        window.AddObserver(vtkCommand.StartEvent, self._on_render_start)
+        window.AddObserver(vtkCommand.EndEvent, self._on_render_end)
+
         ctrl = server.controller
+        state = server.state
+        state.pyg_remote = False
+        state.pyg_interactive_quality = 60
+        state.pyg_interactive_ratio = 0.5
+        state.pyg_metrics = ""
         self.title.set_text("PyGraver")
-        self.icon.click = ctrl.view_update
+        self.icon.click = self.refresh
         # toolbar
         with self.toolbar:
             # toolbar components
             vuetify.VSpacer()
+            vuetify.VChip("{{ pyg_metrics }}", small=True, outlined=True)
             vuetify.VDivider(vertical=True, classes="mx-2")
-            with vuetify.VBtn(icon=True, click="$refs.view.resetCamera()"):
+            with vuetify.VBtn(icon=True, click=self.reset_camera):
                 vuetify.VIcon("mdi-crop-free")
-        
+
         with self.content:
             # content components
             with vuetify.VContainer(
                 fluid=True,
                 classes="pa-0 fill-height",
             ):
-                view = vtk.VtkLocalView(window, namespace="view")
-                ctrl.view_update = view.update
-                ctrl.view_reset_camera = view.reset_camera
-                ctrl.on_server_ready.add(view.update)
-        
+                # only the active view is mounted: local view doesn't send geometry in remote mode
+                self._local_view = vtk.VtkLocalView(window, namespace="view", v_if="!pyg_remote")
+                self._remote_view = vtk.VtkRemoteView(
+                    window,
+                    namespace="remote_view",
+                    v_if="pyg_remote",
+                    interactive_quality=("pyg_interactive_quality", 60),
+                    interactive_ratio=("pyg_interactive_ratio", 0.5),
+                    still_quality=still_quality,
+                    still_ratio=1,
+                )
+                ctrl.view_update = self.update_view
+                ctrl.view_reset_camera = self.reset_camera
+                ctrl.on_server_ready.add(self.update_view)
+
         ctrl.on_server_ready.add(self.refresh_function)
+        ctrl.on_server_ready.add(self._metrics_loop)
         ctrl.flush_content = self.flush_content
-    
-    def refresh(self) -> None:
-        '''Force rendering.
+
+    @property
+    def mode(self) -> str:
+        '''Rendering mode setting ('local', 'remote' or 'auto').'''
+        return self._mode
+
+    @mode.setter
+    def mode(self, value:str) -> None:
+        if value not in ("local", "remote", "auto"):
+            raise ValueError("Rendering mode must be 'local', 'remote' or 'auto'.")
+        self._mode = value
+        self.refresh()
+
+    @property
+    def remote(self) -> bool:
+        '''True if scene is currently rendered on server.'''
+        return bool(self.server.state.pyg_remote)
+
+    @property
+    def metrics(self) -> dict:
+        '''
+        Rendering metrics: active mode, triangle count, mean frame time (s) and
+        frame rate of server renders, estimated stream rate and size of last
+        frame (bytes), current interactive JPEG quality and resolution ratio.
+        '''
+        return dict(self._metrics)
+
+    def _on_render_start(self, obj, event) -> None:
+        '''Render window observer: frame start.'''
+        self._render_start = time.perf_counter()
+
+    def _on_render_end(self, obj, event) -> None:
+        '''Render window observer: frame end.'''
+        self._frame_times.append(time.perf_counter() - self._render_start)
+        self._frame_count += 1
+
+    def _select_mode(self) -> bool:
+        '''
+        Choose between local and remote rendering.
+
+        Returns:
+            bool: True if rendering mode changed.
+        '''
+        triangles = count_triangles(self._window)
+        self._metrics["triangles"] = triangles
+        if self._mode == "auto":
+            remote = triangles > self.max_local_triangles
+        else:
+            remote = self._mode == "remote"
+        if remote and not self._window.GetOffScreenRendering():
+            # remote frames are rendered in an offscreen buffer (software rendering is fine);
+            # it's only switched on once remote rendering is actually needed
+            self._window.SetOffScreenRendering(1)
+        changed = remote != bool(self.server.state.pyg_remote)
+        self.server.state.pyg_remote = remote
+        self._metrics["mode"] = "remote" if remote else "local"
+        return changed
+
+    def _frame_size(self, quality:int, ratio:float) -> int:
+        '''
+        Estimate size of a streamed frame by encoding current window content.
+
+        Args:
+            quality (int): JPEG quality.
+            ratio (float): resolution ratio.
+
+        Returns:
+            int: frame size in bytes.
+        '''
+        grabber = vtkWindowToImageFilter()
+        grabber.SetInput(self._window)
+        grabber.ShouldRerenderOff()
+        grabber.ReadFrontBufferOff()
+        grabber.SetScale(1)
+        grabber.Update()
+        writer = vtkJPEGWriter()
+        writer.SetInputData(grabber.GetOutput())
+        writer.SetQuality(quality)
+        writer.WriteToMemoryOn()
+        writer.Write()
+        # JPEG size scales roughly with pixel count
+        return int(writer.GetResult().GetNumberOfTuples()*ratio*ratio)
+
+    def _adapt(self, frame_time:float, bytes_per_second:float) -> None:
+        '''
+        Adjust interactive image quality and resolution to meet target frame time and bandwidth.
+
+        Args:
+            frame_time (float): mean frame time over last period.
+            bytes_per_second (float): estimated stream rate over last period.
+        '''
+        state = self.server.state
+        quality = state.pyg_interactive_quality
+        ratio = state.pyg_interactive_ratio
+        too_slow = frame_time > 1.2*self.target_frame_time
+        too_big = self.max_bandwidth > 0 and bytes_per_second > self.max_bandwidth
+        if too_slow or too_big:
+            ratio = max(0.2, ratio*0.8)
+            quality = max(20, quality - 10)
+        elif frame_time < 0.6*self.target_frame_time and (self.max_bandwidth == 0 or bytes_per_second < 0.6*self.max_bandwidth):
+            ratio = min(1.0, ratio*1.25)
+            quality = min(self.still_quality, quality + 10)
+        state.pyg_interactive_quality = quality
+        state.pyg_interactive_ratio = ratio
+
+    @asynchronous.task
+    async def _metrics_loop(self, **kwargs):
+        '''
+        Periodically compute rendering metrics and adapt remote stream quality.
+        '''
+        period = 1.0
+        while True:
+            await asyncio.sleep(period)
+            frames, self._frame_count = self._frame_count, 0
+            times, self._frame_times = self._frame_times, []
+            state = self.server.state
+            frame_time = sum(times)/len(times) if times else 0.0
+            frame_bytes = self._metrics["frame_bytes"]
+            bytes_per_second = 0.0
+            if state.pyg_remote and frames > 0:
+                frame_bytes = self._frame_size(state.pyg_interactive_quality, state.pyg_interactive_ratio)
+                bytes_per_second = frame_bytes*frames/period
+                self._adapt(frame_time, bytes_per_second)
+            self._metrics.update(frame_time=frame_time, fps=frames/period, bytes_per_second=bytes_per_second,
+                                 frame_bytes=frame_bytes, quality=state.pyg_interactive_quality,
+                                 ratio=state.pyg_interactive_ratio)
+            state.pyg_metrics = "{} | {:,} tri | {:.0f} ms | {:.1f} kB/s".format(
+                self._metrics["mode"], self._metrics["triangles"], 1000*frame_time, bytes_per_second/1000)
+            state.flush()
+
+    def update_view(self, **kwargs) -> None:
+        '''Push scene to active view.
+        '''
+        self._select_mode()
+        if self.server.state.pyg_remote:
+            self._remote_view.update()
+        else:
+            self._local_view.update()
+
+    def reset_camera(self, **kwargs) -> None:
+        '''Reset camera of active view.
+        '''
+        if self.server.state.pyg_remote:
+            self._remote_view.reset_camera()
+        else:
+            self._local_view.reset_camera()
+
+    def refresh(self, **kwargs) -> None:
+        '''Force rendering; rendering mode is checked again in 'auto' mode.
         '''
         self.server.controller.view_update()
         self.server.state.flush()
@@ -0,0 +1,44 @@
+#include "render/picker.h"
+#include "render/wire.h"
+
+#include "types/point.h"
+#include "types/path.h"
+
+#include <chrono>
+#include <gtest/gtest.h>
+
+using namespace pygraver;
+using namespace pygraver::render;
+using namespace pygraver::types;
+using namespace testing;
+
+static std::shared_ptr<WireCollection> make_wires(const size_t n) {
+    std::vector<std::shared_ptr<Path>> paths;
+    for (size_t i=0; i<n; i++) {
+        auto path = std::make_shared<Path>(0);
+        for (auto j=0; j<4; j++)
+            path->emplace_back(std::make_shared<Point>(j, 2.0*i, 0, 0));
+        paths.emplace_back(path);
+    }
+    return std::make_shared<WireCollection>(paths, 0.5, std::vector<uint8_t>{0,0,0});
+}
+
+TEST(PickerBenchmark, Latency) {
+    const size_t n = 2000;
+    auto wires = make_wires(n);
+    auto picker = Picker();
+    picker.add_shape(wires);
+    const size_t count = 1000;
+    auto start = std::chrono::steady_clock::now();
+    for (size_t k=0; k<count; k++) {
+        auto i = (k*37) % n;
+        double p1[3] = {2, 2.0*i, 10};
+        double p2[3] = {2, 2.0*i, -10};
+        auto result = picker.pick(p1, p2);
+        ASSERT_TRUE(result.has_value());
+        EXPECT_EQ(result->path_index, (int64_t)i);
+        EXPECT_EQ(result->point_index, 2);
+    }
+    auto elapsed = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+    RecordProperty("mean_pick_latency_us", std::to_string(elapsed/count));
+}
@@ -0,0 +1,31 @@
+#include "types/point.h"
+#include "types/path.h"
+#include "types/pathgroup.h"
+#include "types/displacement.h"
+
+#include <chrono>
+#include <gtest/gtest.h>
+
+using namespace pygraver;
+using namespace pygraver::types;
+
+TEST(DisplacementBenchmark, Throughput) {
+    std::vector<double> pixels(1000*1000);
+    for (size_t i=0; i<pixels.size(); i++)
+        pixels[i] = (i*2654435761u % 1000)/1000.0;
+    auto disp = Displacement(pixels, 1000, 1000, 0, 0, 0.1, 0.05);
+    std::vector<std::shared_ptr<Path>> paths;
+    for (auto k=0; k<200; k++) {
+        auto path = std::make_shared<Path>(0);
+        path->reserve(5000);
+        for (auto i=0; i<5000; i++)
+            path->emplace_back(std::make_shared<Point>(0.02*i, 0.5*k, 0, 0));
+        paths.push_back(path);
+    }
+    auto pg = std::make_shared<PathGroup>(paths);
+    auto start = std::chrono::steady_clock::now();
+    auto res = disp.apply(pg);
+    auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    EXPECT_EQ(res->size(), 200);
+    RecordProperty("points_per_second", std::to_string(1e6/elapsed));
+}
@@ -0,0 +1,37 @@
+#include "types/point.h"
+#include "types/path.h"
+#include "types/pathgroup.h"
+#include "types/heightmap.h"
+
+#include <chrono>
+#include <gtest/gtest.h>
+
+using namespace pygraver;
+using namespace pygraver::types;
+
+// plane z = 0.1*x + 0.2*y sampled on a 11x11 grid with unit steps
+static std::shared_ptr<HeightMap> make_plane() {
+    std::vector<double> heights;
+    for (auto j=0; j<11; j++)
+        for (auto i=0; i<11; i++)
+            heights.push_back(0.1*i + 0.2*j);
+    return std::make_shared<HeightMap>(0, 0, 1, 1, 11, 11, heights);
+}
+
+TEST(HeightMapBenchmark, Throughput) {
+    auto map = make_plane();
+    std::vector<std::shared_ptr<Path>> paths;
+    for (auto k=0; k<100; k++) {
+        auto path = std::make_shared<Path>(0);
+        path->reserve(10000);
+        for (auto i=0; i<10000; i++)
+            path->emplace_back(std::make_shared<Point>(0.001*i, 0.1*k, 0, 0));
+        paths.push_back(path);
+    }
+    auto pg = std::make_shared<PathGroup>(paths);
+    auto start = std::chrono::steady_clock::now();
+    auto res = map->apply(pg);
+    auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    EXPECT_EQ(res->size(), 100);
+    RecordProperty("points_per_second", std::to_string(1e6/elapsed));
+}
@@ -0,0 +1,57 @@
+#include "types/point.h"
+#include "types/path.h"
+#include "types/pathgroup.h"
+
+#include <chrono>
+#include <gtest/gtest.h>
+
+using namespace pygraver;
+using namespace pygraver::types;
+
+TEST(PathGroupBenchmark, RemoveOverlapsThroughput) {
+    // every line is emitted twice, second time in reverse order
+    std::vector<std::shared_ptr<Path>> paths;
+    for (auto copy=0; copy<2; copy++) {
+        for (auto k=0; k<500; k++) {
+            auto path = std::make_shared<Path>(0);
+            path->reserve(1001);
+            for (auto i=0; i<=1000; i++) {
+                auto x = copy == 0 ? 0.01*i : 10 - 0.01*i;
+                path->emplace_back(std::make_shared<Point>(x, 0.1*k, 0, 0));
+            }
+            paths.push_back(path);
+        }
+    }
+    auto start = std::chrono::steady_clock::now();
+    auto [pg, removed] = PathGroup(paths).remove_overlaps(1e-6);
+    auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    EXPECT_EQ(pg->size(), 500);
+    EXPECT_NEAR(removed, 5000, 1e-6);
+    RecordProperty("segments_per_second", std::to_string(1e6/elapsed));
+}
+
+TEST(PathGroupBenchmark, QueryThroughput) {
+    // grid of long paths: 1000 rows of 1000 segments
+    std::vector<std::shared_ptr<Path>> paths;
+    for (auto k=0; k<1000; k++) {
+        auto path = std::make_shared<Path>(0);
+        path->reserve(1001);
+        for (auto i=0; i<=1000; i++)
+            path->emplace_back(std::make_shared<Point>(0.01*i, 0.01*k, 0, 0));
+        paths.push_back(path);
+    }
+    auto pg = PathGroup(paths);
+    auto start = std::chrono::steady_clock::now();
+    pg.query({0, 0, 0, 0});
+    auto build = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    start = std::chrono::steady_clock::now();
+    size_t found = 0;
+    for (auto i=0; i<10000; i++) {
+        found += pg.query({0.001*i, 0.001*i + 0.0005, 0.001*i + 0.001, 0.001*i + 0.001}).size();
+        found += pg.nearest(std::make_shared<Point>(0.001*i + 0.0003, 0.001*i + 0.0051, 0, 0)).first;
+    }
+    auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    EXPECT_GT(found, 0);
+    RecordProperty("index_build_seconds", std::to_string(build));
+    RecordProperty("queries_per_second", std::to_string(2e4/elapsed));
+}
@@ -0,0 +1,55 @@
+#include "types/point.h"
+#include "types/path.h"
+#include "types/surface.h"
+
+#include <chrono>
+#include <cmath>
+#include <gtest/gtest.h>
+
+using namespace pygraver;
+using namespace pygraver::types;
+
+TEST(SurfaceBenchmark, SnapRounding) {
+    // guilloche-like rosettes, each rotated by a tiny angle from the previous one:
+    // edges nearly overlap, which is hard on floating precision overlays
+    std::vector<std::shared_ptr<Path>> loops;
+    for (auto k=0; k<40; k++) {
+        auto path = std::make_shared<Path>(0);
+        path->reserve(721);
+        for (auto i=0; i<=720; i++) {
+            auto t = 2*M_PI*(i % 720)/720 + 1e-9*k;
+            auto r = 1 + 0.2*cos(12*t);
+            path->emplace_back(std::make_shared<Point>(r*cos(t), r*sin(t), 0, 0));
+        }
+        loops.push_back(path);
+    }
+    for (auto grid_size: {0.0, 1e-6}) {
+        size_t failures = 0, surfaces = 0;
+        auto start = std::chrono::steady_clock::now();
+        try {
+            auto s = Surface(loops);
+            s.set_grid_size(grid_size);
+            surfaces = s.combine().size();
+        } catch (const std::exception &) {
+            failures++;
+        }
+        for (size_t k=1; k<loops.size(); k++) {
+            auto s1 = std::make_shared<Surface>(loops[k-1]);
+            auto s2 = std::make_shared<Surface>(loops[k]->scale(1 + 1e-9, std::make_shared<Point>()));
+            s1->set_grid_size(grid_size);
+            try {
+                s1->boolean_operation(s2, BooleanOperation::SymmetricDifference);
+            } catch (const std::exception &) {
+                failures++;
+            }
+        }
+        auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        std::string mode = grid_size > 0 ? "fixed" : "floating";
+        RecordProperty(mode + "_seconds", std::to_string(elapsed));
+        RecordProperty(mode + "_failures", std::to_string(failures));
+        if (grid_size > 0) {
+            EXPECT_EQ(failures, 0);
+            EXPECT_EQ(surfaces, 1);
+        }
+    }
+}
@@ -10,7 +10,14 @@
 #include "types/point.h"
 #include "types/path.h"
 #include "types/surface.h"
+#include "types/heightcorrector.h"
+#include "types/heightmap.h"
+#include "types/displacement.h"
 #include "types/pathgroup.h"
+#include "types/depthpasses.h"
+#include "types/pipeline.h"
+#include "types/keepout.h"
+#include "types/compressedpathgroup.h"
 #include "svg/exports.h"
 #include "render/exports.h"
 
@@ -28,7 +35,14 @@ PYBIND11_MODULE(core, m) {
     types::py_point_exports(m_types);
     types::py_path_exports(m_types);
     types::py_surface_exports(m_types);
+    types::py_heightcorrector_exports(m_types);
+    types::py_heightmap_exports(m_types);
+    types::py_displacement_exports(m_types);
     types::py_pathgroup_exports(m_types);
+    types::py_depthpasses_exports(m_types);
+    types::py_pipeline_exports(m_types);
+    types::py_keepout_exports(m_types);
+    types::py_compressedpathgroup_exports(m_types);
 
     auto m_svg = m.def_submodule("svg", "SVG parsing routines");
     py_svg_exports(m_svg);
@@ -11,6 +11,7 @@
 #include "extrusion.h"
 #include "marker.h"
 #include "wire.h"
+#include "playback.h"
 #include "model.h"
 #include "exports.h"
 
@@ -21,6 +22,7 @@ namespace pygraver::render {
         py_cylinder_exports(mod);
         py_marker_exports(mod);
         py_wire_exports(mod);
+        py_playback_exports(mod);
 
         py_model_exports(mod);
     }
@@ -4,8 +4,8 @@
  *  Author: Vincent Paeder
  *  License: MIT
  */
+#include <unordered_map>
 #include <vtkAppendPolyData.h>
-#include <vtkLinearExtrusionFilter.h>
 #include <vtkPolyData.h>
 #include <vtkPolygon.h>
 #include <vtkDelaunay2D.h>
@@ -23,6 +23,33 @@ namespace pygraver::render {
     /** \brief Shorthand for geos::geom::Coordinate class. */
     using GEOSCoordinate = geos::geom::Coordinate;
 
+    /** \brief Append number of paths, then number of points and coordinates of each path to a geometry key.
+     *  \param key: key to append to.
+     *  \param paths: paths to append.
+     */
+    static void append_paths(std::vector<double> & key, const std::vector<std::shared_ptr<Path>> & paths) {
+        key.push_back(paths.size());
+        for (auto & path: paths) {
+            key.push_back(path->size());
+            for (auto pt: *path) {
+                key.push_back(pt->x);
+                key.push_back(pt->y);
+                key.push_back(pt->z);
+                key.push_back(pt->c);
+            }
+        }
+    }
+
+    /** \brief Boundary edge of a cap, oriented like the cell it belongs to. */
+    struct CapEdge {
+        /** \brief Edge end point index. */
+        vtkIdType end;
+        /** \brief True if cell normal points against extrusion direction. */
+        bool flip;
+        /** \brief Number of cells sharing this edge. */
+        size_t count;
+    };
+
     vtkSmartPointer<vtkPolyData> make_polydata(std::shared_ptr<Surface> surf) {
         auto nbnd = surf->get_contours().size();
         auto nh = surf->get_holes().size();
@@ -42,36 +69,33 @@ namespace pygraver::render {
         auto cells_h = vtkSmartPointer<vtkCellArray>::New();
         // create container for points
         auto points = vtkSmartPointer<vtkPoints>::New();
+        points->SetDataTypeToDouble();
         points->SetNumberOfPoints(npts);
         size_t offset = 0; // point index offset
         // fill points for boundaries
         for (auto bnd: surf->get_contours()) {
-            auto p = bnd->is_ccw() ? bnd : bnd->flip();
+            // reversed paths are read backwards instead of being flipped
+            auto n = bnd->size() - bnd->is_closed();
             auto poly_bnd = vtkSmartPointer<vtkPolygon>::New();
-            auto n = p->size() - p->is_closed();
             PYG_LOG_D("Adding {} boundary points to PolyData (total={}).", n, offset+n);
+            copy_points(points, offset, *bnd, n, !bnd->is_ccw());
             poly_bnd->GetPointIds()->SetNumberOfIds(n);
-            for (auto i=0; i<n; i++) {
-                PYG_LOG_D("Adding point {}: {},{},{}", offset+i, (*p)[i]->x, (*p)[i]->y, (*p)[i]->z);
-                points->SetPoint(offset+i, (*p)[i]->x, (*p)[i]->y, (*p)[i]->z);
+            for (auto i=0; i<n; i++)
                 poly_bnd->GetPointIds()->SetId(i, offset+i);
-            }
             offset += n;
             // each boundary makes one polygon that makes one PolyData cell
             cells_bnd->InsertNextCell(poly_bnd);
         }
         // fill points for holes
         for (auto h: surf->get_holes()) {
-            auto p = !h->is_ccw() ? h : h->flip();
+            // reversed paths are read backwards instead of being flipped
+            auto n = h->size() - h->is_closed();
             auto poly_h = vtkSmartPointer<vtkPolygon>::New();
-            auto n = p->size() - p->is_closed();
             PYG_LOG_D("Adding {} hole points to PolyData (total={}).", n, offset+n);
+            copy_points(points, offset, *h, n, h->is_ccw());
             poly_h->GetPointIds()->SetNumberOfIds(n);
-            for (auto i=0; i<n; i++) {
-                PYG_LOG_D("Adding point {}: {},{},{}", offset+i, (*p)[i]->x, (*p)[i]->y, (*p)[i]->z);
-                points->SetPoint(offset+i, (*p)[i]->x, (*p)[i]->y, (*p)[i]->z);
+            for (auto i=0; i<n; i++)
                 poly_h->GetPointIds()->SetId(i, offset+i);
-            }
             offset += n;
             // each hole makes one polygon that makes one PolyData cell
             cells_h->InsertNextCell(poly_h);
@@ -134,12 +158,12 @@ namespace pygraver::render {
         auto n = path->size();
         PYG_LOG_I("Creating PolyData with {} points.", n);
 
+        points->SetDataTypeToDouble();
         points->SetNumberOfPoints(n);
+        copy_points(points, 0, *path, n);
         polygon->GetPointIds()->SetNumberOfIds(n);
-        for (auto i=0; i<n; i++) {
-            points->SetPoint(i, (*path)[i]->x, (*path)[i]->y, (*path)[i]->z);
+        for (auto i=0; i<n; i++)
             polygon->GetPointIds()->SetId(i, i);
-        }        
         auto cells = vtkSmartPointer<vtkCellArray>::New();
         cells->InsertNextCell(polygon);
         auto polydata = vtkSmartPointer<vtkPolyData>::New();
@@ -151,18 +175,102 @@ namespace pygraver::render {
 
     vtkSmartPointer<vtkPolyData> extrude(vtkSmartPointer<vtkPolyData> data,
                                          std::shared_ptr<Point> axis,
-                                         std::shared_ptr<Point> centre,
                                          const double length) {
         PYG_LOG_I("Extruding vtkPolyData 0x{:x}", (uint64_t)data.GetPointer());
-        auto extr_filter = vtkSmartPointer<vtkLinearExtrusionFilter>::New();
-        extr_filter->SetInputData(data);
-        extr_filter->SetExtrusionTypeToNormalExtrusion();
-        extr_filter->SetCapping(1);
-        extr_filter->SetVector(axis->x, axis->y, axis->z);
-        extr_filter->SetExtrusionPoint(centre->x, centre->y, centre->z);
-        extr_filter->SetScaleFactor(length);
-        extr_filter->Update();
-        return extr_filter->GetOutput();
+        const double d[3] = {axis->x*length, axis->y*length, axis->z*length};
+        // points: cap points (0 to n-1), then shifted cap points (n to 2n-1)
+        auto n = data->GetNumberOfPoints();
+        auto in_points = data->GetPoints();
+        auto points = vtkSmartPointer<vtkPoints>::New();
+        points->SetDataTypeToDouble();
+        points->SetNumberOfPoints(2*n);
+        for (vtkIdType i=0; i<n; i++) {
+            double pt[3];
+            in_points->GetPoint(i, pt);
+            points->SetPoint(i, pt);
+            points->SetPoint(n+i, pt[0]+d[0], pt[1]+d[1], pt[2]+d[2]);
+        }
+        // caps: each cell is copied on both ends, facing outwards; edges
+        // used by a single cell form the boundary rings
+        auto polys = vtkSmartPointer<vtkCellArray>::New();
+        std::unordered_map<vtkIdType, std::unordered_map<vtkIdType, CapEdge>> edges;
+        auto cells = data->GetPolys();
+        const vtkIdType *pts;
+        vtkIdType npts;
+        std::vector<vtkIdType> ids;
+        cells->InitTraversal();
+        while (cells->GetNextCell(npts, pts)) {
+            if (npts < 3) continue;
+            // cell normal (Newell's method)
+            double normal[3] = {0, 0, 0};
+            for (vtkIdType j=0; j<npts; j++) {
+                double a[3], b[3];
+                in_points->GetPoint(pts[j], a);
+                in_points->GetPoint(pts[(j+1)%npts], b);
+                normal[0] += (a[1] - b[1])*(a[2] + b[2]);
+                normal[1] += (a[2] - b[2])*(a[0] + b[0]);
+                normal[2] += (a[0] - b[0])*(a[1] + b[1]);
+            }
+            bool flip = normal[0]*d[0] + normal[1]*d[1] + normal[2]*d[2] < 0;
+            ids.resize(npts);
+            for (vtkIdType j=0; j<npts; j++)
+                ids[j] = pts[flip ? j : npts-1-j];
+            polys->InsertNextCell(npts, ids.data());
+            for (vtkIdType j=0; j<npts; j++)
+                ids[j] = n + pts[flip ? npts-1-j : j];
+            polys->InsertNextCell(npts, ids.data());
+            for (vtkIdType j=0; j<npts; j++) {
+                auto a = pts[j], b = pts[(j+1)%npts];
+                auto reverse = edges.find(b);
+                if (reverse != edges.end() && reverse->second.count(a)) {
+                    reverse->second[a].count++;
+                } else {
+                    auto & edge = edges[a][b];
+                    edge.end = b;
+                    edge.flip = flip;
+                    edge.count++;
+                }
+            }
+        }
+        // side walls: one triangle strip per boundary ring, following edges
+        std::unordered_map<vtkIdType, std::vector<CapEdge>> boundary;
+        for (auto & [a, ends]: edges)
+            for (auto & [b, edge]: ends)
+                if (edge.count == 1)
+                    boundary[a].push_back(edge);
+        auto strips = vtkSmartPointer<vtkCellArray>::New();
+        auto next_edge = [&](const vtkIdType a, const bool flip, CapEdge & edge) {
+            auto it = boundary.find(a);
+            if (it == boundary.end()) return false;
+            auto & candidates = it->second;
+            for (auto e = candidates.begin(); e != candidates.end(); e++) {
+                if (e->flip != flip) continue;
+                edge = *e;
+                candidates.erase(e);
+                if (candidates.empty()) boundary.erase(it);
+                return true;
+            }
+            return false;
+        };
+        while (!boundary.empty()) {
+            auto start = boundary.begin()->first;
+            auto flip = boundary.begin()->second.front().flip;
+            ids.clear();
+            auto add_point = [&](const vtkIdType a) {
+                ids.push_back(flip ? a : n + a);
+                ids.push_back(flip ? n + a : a);
+            };
+            add_point(start);
+            CapEdge edge;
+            for (auto a = start; next_edge(a, flip, edge); a = edge.end)
+                add_point(edge.end);
+            strips->InsertNextCell(ids.size(), ids.data());
+        }
+        auto polydata = vtkSmartPointer<vtkPolyData>::New();
+        polydata->SetPoints(points);
+        polydata->SetPolys(polys);
+        polydata->SetStrips(strips);
+        return polydata;
     }
 
     Extrusion::Extrusion() {
@@ -199,37 +307,26 @@ namespace pygraver::render {
                               std::shared_ptr<Point> axis,
                               const std::vector<uint8_t> & color) {
         PYG_LOG_V("Setting contour for extrusion 0x{:x} from surface 0x{:x}", (uint64_t)this, (uint64_t)contour.get());
-        auto surfaces = contour->combine();
-        if (surfaces.size()==0)
-            throw std::invalid_argument("Surface must contain at least one contour.");
-        // normalize axis
-        double raxis = axis->radius();
-        if (raxis==0)
-            throw std::invalid_argument("Axis must have non-zero length.");
-        this->axis[0] = axis->x/raxis;
-        this->axis[1] = axis->y/raxis;
-        this->axis[2] = axis->z/raxis;
-        // limits for color LUT
-        double zmin = std::numeric_limits<double>::max();
-        double zmax = -std::numeric_limits<double>::max();
-        // process each sub-surface separately
-        auto append = vtkSmartPointer<vtkAppendPolyData>::New();
-        for (auto s: surfaces) {
-            if (s->get_contours().size() == 0)
-                continue;
-
-            auto centroid = s->get_centroid();
-            if (centroid->z<zmin) zmin = centroid->z;
-            if (centroid->z>zmax) zmax = centroid->z;
-            auto shape = extrude(make_polydata(s), axis, centroid, length);
-            append->SetInputData(shape);
+        std::vector<double> key = {contour->get_grid_size()};
+        append_paths(key, contour->get_contours());
+        append_paths(key, contour->get_holes());
+        if (this->caps.empty() || key != this->caps_key) {
+            auto surfaces = contour->combine();
+            if (surfaces.size()==0)
+                throw std::invalid_argument("Surface must contain at least one contour.");
+            // triangulate each sub-surface separately
+            std::vector<vtkSmartPointer<vtkPolyData>> caps;
+            for (auto s: surfaces) {
+                if (s->get_contours().size() == 0)
+                    continue;
+                caps.emplace_back(make_polydata(s));
+            }
+            this->caps = std::move(caps);
+            this->caps_key = std::move(key);
+        } else {
+            PYG_LOG_D("Reusing cached triangulation for extrusion 0x{:x}", (uint64_t)this);
         }
-        append->Update();
-        // create actor for shape
-        this->set_item(0, append->GetOutput());
-        // set base colors
-        this->set_base_color(color);
-        this->set_highlight_color(Shape3D::make_highlight_color(color));
+        this->set_extrusion(length, axis, color);
     }
 
     void Extrusion::set_shape(std::shared_ptr<Path> contour,
@@ -239,6 +336,18 @@ namespace pygraver::render {
         PYG_LOG_V("Setting contour for extrusion 0x{:x} from path 0x{:x}", (uint64_t)this, (uint64_t)contour.get());
         if (contour->size()<4 || !contour->is_closed())
             throw std::invalid_argument("Contour must be closed.");
+        // a path is cheap to convert: no need to look up cache
+        this->caps = {make_polydata(contour)};
+        this->caps_key.clear();
+        this->set_extrusion(length, axis, color);
+    }
+
+    void Extrusion::set_extrusion(const double length,
+                                  std::shared_ptr<Point> axis,
+                                  const std::vector<uint8_t> & color) {
+        PYG_LOG_V("Setting extrusion parameters for extrusion 0x{:x}", (uint64_t)this);
+        if (this->caps.empty())
+            throw std::out_of_range("Extrusion has no contour.");
         // normalize axis
         double raxis = axis->radius();
         if (raxis==0)
@@ -246,14 +355,21 @@ namespace pygraver::render {
         this->axis[0] = axis->x/raxis;
         this->axis[1] = axis->y/raxis;
         this->axis[2] = axis->z/raxis;
-        // extrude base surface
-        auto xy = contour->to_cartesian();
-        auto centroid = contour->get_centroid();
+        vtkSmartPointer<vtkPolyData> shape;
+        if (this->caps.size() == 1) {
+            shape = extrude(this->caps[0], axis, length);
+        } else {
+            auto append = vtkSmartPointer<vtkAppendPolyData>::New();
+            for (auto & cap: this->caps)
+                append->AddInputData(extrude(cap, axis, length));
+            append->Update();
+            shape = append->GetOutput();
+        }
         // set base colors
         this->set_base_color(color);
         this->set_highlight_color(Shape3D::make_highlight_color(color));
         // create actor for shape
-        this->set_item(0, extrude(make_polydata(xy), axis, centroid, length));
+        this->set_item(0, shape);
     }
 
     std::vector<std::tuple<vtkSmartPointer<vtkActor>, std::string>> Extrusion::get_interactive() {
@@ -269,6 +385,7 @@ namespace pygraver::render {
             .def(py::init<std::shared_ptr<Path>, const double, std::shared_ptr<Point>, const std::vector<uint8_t> &>(), py::arg("contour"), py::arg("length"), py::arg("axis"), py::arg("color"))
             .def("set_shape", set_shape_surface, py::arg("contour"), py::arg("length"), py::arg("axis"), py::arg("color"))
             .def("set_shape", set_shape_path, py::arg("contour"), py::arg("length"), py::arg("axis"), py::arg("color"))
+            .def("set_extrusion", &Extrusion::set_extrusion, py::arg("length"), py::arg("axis"), py::arg("color"))
             ;
     }
 
@@ -30,15 +30,18 @@ namespace pygraver::render {
     vtkSmartPointer<vtkPolyData> make_polydata(std::shared_ptr<Path> path);
 
     /** \brief Extrude a vtkPolyData object with given parameters.
+     *
+     *  Polygons are copied on both ends, facing outwards, and side walls are
+     *  made of one triangle strip per boundary ring (edges used by a single
+     *  polygon).
+     *
      *  \param data: pointer to the vtkPolyData object to extrude.
      *  \param axis: extrusion axis.
-     *  \param centre: extrusion centre.
      *  \param length: extrusion length.
      *  \returns pointer to a vtkPolyData object.
      */
     vtkSmartPointer<vtkPolyData> extrude(vtkSmartPointer<vtkPolyData> data,
                                          std::shared_ptr<Point> axis,
-                                         std::shared_ptr<Point> centre,
                                          const double length);
 
     /** \brief A shape representing the extrusion of an arbitrary contour. */
@@ -47,6 +50,13 @@ namespace pygraver::render {
         /** \brief Extrusion axis. */
         double axis[3];
 
+        /** \brief Cached cap triangulation of each sub-surface. */
+        std::vector<vtkSmartPointer<vtkPolyData>> caps;
+
+        /** \brief Geometry caps were computed from: grid size, then contours and holes
+         *  (number of paths, then number of points and coordinates of each path); empty for a path. */
+        std::vector<double> caps_key;
+
         /** \brief Position to color mapping function.
          *  \param pos: position.
          *  \returns index along color scale.
@@ -83,6 +93,10 @@ namespace pygraver::render {
                   const std::vector<uint8_t> & color);
 
         /** \brief Set extruded contour.
+         *
+         *  Cap triangulation is cached: if the surface has the same geometry
+         *  as the last one, only extrusion and colors are computed again.
+         *
          *  \param contour: pointer to a surface object.
          *  \param length: extrusion length.
          *  \param axis: extrusion axis.
@@ -104,6 +118,15 @@ namespace pygraver::render {
                        std::shared_ptr<Point> axis,
                        const std::vector<uint8_t> & color);
 
+        /** \brief Change extrusion parameters, keeping current contour.
+         *  \param length: extrusion length.
+         *  \param axis: extrusion axis.
+         *  \param color: RGB or RGBA color.
+         */
+        void set_extrusion(const double length,
+                           std::shared_ptr<Point> axis,
+                           const std::vector<uint8_t> & color);
+
         /** \brief Get actors that can be interactive (clickable, hoverable, ...).
          *  \returns vector of actors and associated messages.
         */
@@ -7,6 +7,9 @@
 #include <vtkRenderWindowInteractor.h>
 #include <vtkCollectionIterator.h>
 
+#include <algorithm>
+#include <thread>
+
 #include <pybind11/stl.h>
 
 #include "../log.h"
@@ -16,6 +19,7 @@
 
 #include "marker.h"
 #include "extrusion.h"
+#include "wire.h"
 
 #include "model.h"
 #include "vtkevents.h"
@@ -31,6 +35,7 @@ namespace pygraver::render {
         auto interactor = vtkSmartPointer<vtkRenderWindowInteractor>::New();
         auto interstyle = vtkSmartPointer<vtkCustomInteractorStyle>::New();
         interactor->SetRenderWindow(this->window);
+        interactor->SetPicker(this->get_picker());
         interstyle->SetCurrentRenderer(this->renderer);
         interstyle->set_model(this);
         interactor->SetInteractorStyle(interstyle);
@@ -50,7 +55,7 @@ namespace pygraver::render {
     }
 
 
-    Model::Model() {
+    Model::Model() : max_workers(std::max(1u, std::thread::hardware_concurrency())) {
         PYG_LOG_V("Creating 3D model 0x{:x}", (uint64_t)this);
         // create renderer
         this->renderer = vtkSmartPointer<vtkRenderer>::New();
@@ -61,6 +66,13 @@ namespace pygraver::render {
 
     Model::~Model() {
         PYG_LOG_V("Deleting 3D model 0x{:x}", (uint64_t)this);
+        // builders that haven't started are dropped; running ones must be done before the model goes away
+        {
+            std::lock_guard<std::mutex> lock(this->builders_mutex);
+            this->queued_builders.clear();
+        }
+        for (auto & worker: this->workers)
+            worker.wait();
     }
 
 
@@ -85,12 +97,14 @@ namespace pygraver::render {
             actor = dynamic_cast<vtkActor*>(shape->get_actors()->GetNextProp());
         }
         this->shapes.emplace_back(shape);
+        this->picker.add_shape(shape);
     }
 
 
     void Model::remove_shape(std::shared_ptr<Shape3D> shape) {
         if (this->has_shape(shape)) {
             this->shapes.erase(std::find(this->shapes.begin(), this->shapes.end(), shape));
+            this->picker.remove_shape(shape);
             shape->get_actors()->InitTraversal();
             auto actor = dynamic_cast<vtkActor*>(shape->get_actors()->GetNextProp());
             while (actor != nullptr) {
@@ -107,6 +121,151 @@ namespace pygraver::render {
     }
 
 
+    void Model::add_shape_async(std::function<std::shared_ptr<Shape3D>()> builder) {
+        PYG_LOG_V("Queuing shape construction for model 0x{:x}", (uint64_t)this);
+        // each shape has its own VTK pipeline, so shapes can be built concurrently
+        std::packaged_task<std::shared_ptr<Shape3D>()> task(std::move(builder));
+        this->pending_shapes.emplace_back(task.get_future());
+        {
+            std::lock_guard<std::mutex> lock(this->builders_mutex);
+            this->queued_builders.emplace_back(std::move(task));
+            // running workers take queued builders as soon as they are free
+            if (this->active_workers >= this->max_workers) return;
+            this->active_workers++;
+        }
+        this->workers.erase(std::remove_if(this->workers.begin(), this->workers.end(), [](const std::future<void> & worker) {
+            return worker.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+        }), this->workers.end());
+        this->workers.emplace_back(std::async(std::launch::async, [this]() { this->run_builders(); }));
+    }
+
+
+    void Model::run_builders() {
+        while (true) {
+            std::packaged_task<std::shared_ptr<Shape3D>()> task;
+            {
+                std::lock_guard<std::mutex> lock(this->builders_mutex);
+                if (this->queued_builders.empty()) {
+                    this->active_workers--;
+                    return;
+                }
+                task = std::move(this->queued_builders.front());
+                this->queued_builders.pop_front();
+            }
+            // exceptions are stored in the task future
+            task();
+        }
+    }
+
+
+    void Model::add_wires_async(const std::vector<std::shared_ptr<Path>> & paths,
+                                const double diameter,
+                                const std::vector<uint8_t> & color,
+                                const unsigned int sides) {
+        this->add_shape_async([paths, diameter, color, sides]() -> std::shared_ptr<Shape3D> {
+            return std::make_shared<WireCollection>(paths, diameter, color, sides);
+        });
+    }
+
+
+    std::shared_ptr<Playback> Model::add_playback(const std::vector<std::shared_ptr<Path>> & paths,
+                                                  const std::vector<uint8_t> & color,
+                                                  const double tool_diameter,
+                                                  const double tool_length,
+                                                  const double line_width,
+                                                  const size_t chunk_size) {
+        auto playback = std::make_shared<Playback>(paths, color, tool_diameter, tool_length, line_width, chunk_size);
+        this->add_shape(playback);
+        return playback;
+    }
+
+
+    void Model::add_extrusion_async(std::shared_ptr<Surface> contour,
+                                    const double length,
+                                    std::shared_ptr<Point> axis,
+                                    const std::vector<uint8_t> & color) {
+        this->add_shape_async([contour, length, axis, color]() -> std::shared_ptr<Shape3D> {
+            return std::make_shared<Extrusion>(contour, length, axis, color);
+        });
+    }
+
+
+    size_t Model::collect_pending() {
+        if (this->pending_shapes.empty()) return 0;
+        auto was_empty = this->shapes.empty();
+        // take every finished shape first, so that a failed build doesn't hold back the others
+        std::vector<std::shared_ptr<Shape3D>> built;
+        auto it = this->pending_shapes.begin();
+        while (it != this->pending_shapes.end()) {
+            if (it->wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+                it++;
+                continue;
+            }
+            auto task = std::move(*it);
+            it = this->pending_shapes.erase(it);
+            try {
+                built.emplace_back(task.get());
+            } catch (...) {
+                if (!this->build_error)
+                    this->build_error = std::current_exception();
+            }
+        }
+        for (auto & shape: built)
+            this->add_shape(shape);
+        PYG_LOG_D("Added {} shapes to model 0x{:x}; {} pending", built.size(), (uint64_t)this, this->pending_shapes.size());
+        // first shapes to show up define the view
+        if (!built.empty() && was_empty)
+            this->renderer->ResetCamera();
+        return built.size();
+    }
+
+
+    size_t Model::process_pending() {
+        auto added = this->collect_pending();
+        if (this->build_error) {
+            auto error = this->build_error;
+            this->build_error = nullptr;
+            std::rethrow_exception(error);
+        }
+        return added;
+    }
+
+
+    size_t Model::wait_pending() {
+        for (auto & task: this->pending_shapes)
+            task.wait();
+        return this->process_pending();
+    }
+
+
+    std::optional<std::tuple<std::shared_ptr<Shape3D>, int64_t, int64_t>> Model::py_pick(const std::vector<double> & p1, const std::vector<double> & p2) {
+        if (p1.size()!=3 || p2.size()!=3)
+            throw std::invalid_argument("A point must have 3 components.");
+        auto result = this->pick(&p1[0], &p2[0]);
+        if (!result.has_value())
+            return std::nullopt;
+        return std::make_tuple(result->shape, result->path_index, result->point_index);
+    }
+
+
+    std::optional<std::tuple<std::shared_ptr<Shape3D>, int64_t, int64_t>> Model::py_pick_display(const double x, const double y) {
+        auto picker = this->get_picker();
+        if (!picker->Pick(x, y, 0, this->get_renderer()))
+            return std::nullopt;
+        auto & result = picker->get_result();
+        return std::make_tuple(result->shape, result->path_index, result->point_index);
+    }
+
+
+    vtkSmartPointer<vtkModelPicker> Model::get_picker() {
+        if (this->prop_picker == nullptr) {
+            this->prop_picker = vtkSmartPointer<vtkModelPicker>::New();
+            this->prop_picker->set_model(this);
+        }
+        return this->prop_picker;
+    }
+
+
     void Model::add_widget(vtkSmartPointer<vtkAbstractWidget> widget) {
         if (this->has_widget(widget)) return;
         if (this->window == nullptr) this->create_window();
@@ -131,6 +290,7 @@ namespace pygraver::render {
     void Model::render() {
         if (this->renderer == nullptr || this->window == nullptr)
             this->create_window();
+        this->process_pending();
         this->renderer->ResetCamera();
         this->window->Render();
         this->window->GetInteractor()->Start();
@@ -144,6 +304,16 @@ namespace pygraver::render {
             .def("add_shape", &Model::add_shape, py::arg("shape"))
             .def("remove_shape", &Model::remove_shape, py::arg("shape"))
             .def("has_shape", &Model::has_shape, py::arg("shape"))
+            .def("pick", &Model::py_pick, py::arg("point1"), py::arg("point2"))
+            .def("pick_display", &Model::py_pick_display, py::arg("x"), py::arg("y"))
+            .def("update_picking", &Model::update_picking)
+            .def_property_readonly("picker", &Model::get_picker, py::return_value_policy::reference)
+            .def("add_wires_async", &Model::add_wires_async, py::arg("paths"), py::arg("diameter"), py::arg("color"), py::arg("sides")=4)
+            .def("add_extrusion_async", &Model::add_extrusion_async, py::arg("contour"), py::arg("length"), py::arg("axis"), py::arg("color"))
+            .def("add_playback", &Model::add_playback, py::arg("paths"), py::arg("color"), py::arg("tool_diameter"), py::arg("tool_length"), py::arg("line_width")=2, py::arg("chunk_size")=4096)
+            .def("process_pending", &Model::process_pending)
+            .def("wait_pending", &Model::wait_pending, py::call_guard<py::gil_scoped_release>())
+            .def_property_readonly("pending_count", &Model::get_pending_count)
             .def_property("background_color", &Model::get_background_color, &Model::set_background_color)
             .def("render", &Model::render)
             .def_property_readonly("renderer", &Model::get_renderer, py::return_value_policy::reference)
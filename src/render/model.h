@@ -7,6 +7,11 @@
 #pragma once
 #include <vector>
 #include <unordered_map>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <future>
+#include <mutex>
 #include <vtkSmartPointer.h>
 #include <vtkPolyData.h>
 #include <vtkRenderer.h>
@@ -18,6 +23,8 @@
 #include "../types/pathgroup.h"
 #include "../types/surface.h"
 #include "shape3d.h"
+#include "playback.h"
+#include "picker.h"
 #include "vtkpybind.h"
 #include "../log.h"
 
@@ -54,6 +61,40 @@ namespace pygraver::render {
         /** \brief Background color. */
         std::vector<uint8_t> bg_color = {255, 255, 255};
 
+        /** \brief Shapes being built on worker threads.
+         * 
+         *  This is only accessed from the thread owning the model; workers
+         *  hand finished shapes over through their future.
+         */
+        std::vector<std::future<std::shared_ptr<Shape3D>>> pending_shapes;
+
+        /** \brief Shape builders waiting for a worker, in submission order. */
+        std::deque<std::packaged_task<std::shared_ptr<Shape3D>()>> queued_builders;
+
+        /** \brief Mutex protecting queued_builders and active_workers. */
+        std::mutex builders_mutex;
+
+        /** \brief Number of workers currently running builders. */
+        size_t active_workers = 0;
+
+        /** \brief Largest number of workers running at the same time. */
+        size_t max_workers;
+
+        /** \brief Worker threads, including finished ones not cleaned up yet. */
+        std::vector<std::future<void>> workers;
+
+        /** \brief Worker loop: run queued builders until none is left. */
+        void run_builders();
+
+        /** \brief First error thrown by a shape builder and not reported yet. */
+        std::exception_ptr build_error;
+
+        /** \brief Spatial index of shape actors used for picking. */
+        Picker picker;
+
+        /** \brief VTK picker relying on spatial index. */
+        vtkSmartPointer<vtkModelPicker> prop_picker;
+
         /** \brief Create window object. */
         void create_window();
 
@@ -117,6 +158,130 @@ namespace pygraver::render {
         */
         bool has_shape(std::shared_ptr<Shape3D> shape);
 
+        /** \brief Build a shape on a worker thread and add it to the model when done.
+         * 
+         *  Shapes are added by process_pending, which is called periodically
+         *  while the model is rendered; they show up progressively.
+         *  Builders are queued and run by at most one worker per hardware
+         *  thread. The builder must not call into Python.
+         * 
+         *  \param builder: function creating the shape.
+        */
+        void add_shape_async(std::function<std::shared_ptr<Shape3D>()> builder);
+
+        /** \brief Build a wire collection on a worker thread. See WireCollection constructor for arguments.
+         *  \param paths: collection of paths.
+         *  \param diameter: wire diameter.
+         *  \param color: RGB or RGBA color.
+         *  \param sides: number of sides (>=4).
+        */
+        void add_wires_async(const std::vector<std::shared_ptr<Path>> & paths,
+                             const double diameter,
+                             const std::vector<uint8_t> & color,
+                             const unsigned int sides=4);
+
+        /** \brief Build an extrusion on a worker thread. See Extrusion constructor for arguments.
+         *  \param contour: pointer to a surface object.
+         *  \param length: extrusion length.
+         *  \param axis: extrusion axis.
+         *  \param color: RGB or RGBA color.
+        */
+        void add_extrusion_async(std::shared_ptr<Surface> contour,
+                                 const double length,
+                                 std::shared_ptr<Point> axis,
+                                 const std::vector<uint8_t> & color);
+
+        /** \brief Build job playback and add it to the model. See Playback constructor for arguments.
+         *  \param paths: job paths, in execution order.
+         *  \param color: RGB or RGBA color.
+         *  \param tool_diameter: tool marker diameter.
+         *  \param tool_length: tool marker length.
+         *  \param line_width: width of path lines, in pixels.
+         *  \param chunk_size: number of segments per chunk (>0).
+         *  \returns playback shape, to be driven by position reports or a clock.
+        */
+        std::shared_ptr<Playback> add_playback(const std::vector<std::shared_ptr<Path>> & paths,
+                                               const std::vector<uint8_t> & color,
+                                               const double tool_diameter,
+                                               const double tool_length,
+                                               const double line_width=2,
+                                               const size_t chunk_size=4096);
+
+        /** \brief Add shapes whose construction has finished, keeping build errors for later.
+         * 
+         *  This must be called from the thread owning the model. Every
+         *  finished shape is added, even if another one failed; the first
+         *  build error is kept until process_pending or wait_pending is called.
+         * 
+         *  \returns number of added shapes.
+        */
+        size_t collect_pending();
+
+        /** \brief Add shapes whose construction has finished.
+         * 
+         *  This must be called from the thread owning the model.
+         *  The first exception thrown while building a shape since last call
+         *  is re-thrown here, once finished shapes are added.
+         * 
+         *  \returns number of added shapes.
+        */
+        size_t process_pending();
+
+        /** \brief Wait until all shapes are built and add them.
+         * 
+         *  Build errors are re-thrown as in process_pending.
+         * 
+         *  \returns number of added shapes.
+        */
+        size_t wait_pending();
+
+        /** \brief Get number of shapes still being built or waiting to be added.
+         *  \returns number of pending shapes.
+        */
+        size_t get_pending_count() const { return this->pending_shapes.size(); }
+
+        /** \brief Find closest shape crossed by a line segment.
+         *  \param p1: segment start, in world coordinates.
+         *  \param p2: segment end, in world coordinates.
+         *  \returns pick result, if any shape is crossed.
+        */
+        std::optional<PickResult> pick(const double p1[3], const double p2[3]) {
+            return this->picker.pick(p1, p2);
+        }
+
+        /** \brief Python wrapper for pick.
+         *  \param p1: segment start, in world coordinates.
+         *  \param p2: segment end, in world coordinates.
+         *  \returns tuple with picked shape, path index and point index, if any shape is crossed.
+        */
+        std::optional<std::tuple<std::shared_ptr<Shape3D>, int64_t, int64_t>> py_pick(const std::vector<double> & p1, const std::vector<double> & p2);
+
+        /** \brief Pick shape at given display position.
+         *  \param x: x display coordinate.
+         *  \param y: y display coordinate.
+         *  \returns tuple with picked shape, path index and point index, if any shape is under given position.
+        */
+        std::optional<std::tuple<std::shared_ptr<Shape3D>, int64_t, int64_t>> py_pick_display(const double x, const double y);
+
+        /** \brief Get VTK picker relying on model's spatial index.
+         * 
+         *  This can be given to VTK widgets (e.g. vtkBalloonWidget::SetPicker)
+         *  to replace their default picker.
+         * 
+         *  \returns pointer to picker.
+        */
+        vtkSmartPointer<vtkModelPicker> get_picker();
+
+        /** \brief Mark picking index as outdated.
+         *
+         *  This isn't needed after shapes were modified: added, replaced or moved
+         *  actors are detected at next pick. This forces a full rebuild, and is only
+         *  needed after an actor user transform was modified in place.
+        */
+        void update_picking() {
+            this->picker.invalidate();
+        }
+
         /** \brief Add widget.
          *  \param widget: pointer to widget object.
         */
@@ -0,0 +1,435 @@
+/** \file picker.cpp
+ *  \brief Implementation file for Picker class.
+ *
+ *  Author: Vincent Paeder
+ *  License: MIT
+ */
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <vtkActorCollection.h>
+#include <vtkAssemblyPath.h>
+#include <vtkCell.h>
+#include <vtkDataArray.h>
+#include <vtkMapper.h>
+#include <vtkPointData.h>
+#include <vtkRenderer.h>
+
+#include "picker.h"
+#include "model.h"
+#include "../log.h"
+
+namespace pygraver::render {
+
+    /** \brief Maximum number of actors in a BVH leaf. */
+    static const size_t max_leaf_size = 4;
+
+    /** \brief Tolerance for pick tests. */
+    static const double pick_tolerance = 1e-6;
+
+    /** \brief Intersect a line segment with an axis-aligned box.
+     *  \param p1: segment start.
+     *  \param d: segment direction (end - start).
+     *  \param b: box bounds (xmin, xmax, ymin, ymax, zmin, zmax).
+     *  \param tmax: largest relative position to consider.
+     *  \returns true if segment crosses box before tmax.
+     */
+    static bool segment_crosses_box(const double p1[3], const double d[3], const std::array<double, 6> & b, const double tmax) {
+        double t0 = 0, t1 = tmax;
+        for (auto a=0; a<3; a++) {
+            auto lo = b[2*a] - pick_tolerance;
+            auto hi = b[2*a+1] + pick_tolerance;
+            if (d[a] == 0) {
+                if (p1[a] < lo || p1[a] > hi) return false;
+                continue;
+            }
+            auto ta = (lo - p1[a])/d[a];
+            auto tb = (hi - p1[a])/d[a];
+            if (ta > tb) std::swap(ta, tb);
+            t0 = std::max(t0, ta);
+            t1 = std::min(t1, tb);
+            if (t0 > t1) return false;
+        }
+        return true;
+    }
+
+    /** \brief Merge bounds.
+     *  \param b: bounds to extend.
+     *  \param other: bounds to include.
+     */
+    static void merge_bounds(std::array<double, 6> & b, const std::array<double, 6> & other) {
+        for (auto a=0; a<3; a++) {
+            b[2*a] = std::min(b[2*a], other[2*a]);
+            b[2*a+1] = std::max(b[2*a+1], other[2*a+1]);
+        }
+    }
+
+    /** \brief Get bounds no segment can cross, to be extended with merge_bounds.
+     *  \returns empty bounds.
+     */
+    static std::array<double, 6> empty_bounds() {
+        return {std::numeric_limits<double>::max(), -std::numeric_limits<double>::max(),
+                std::numeric_limits<double>::max(), -std::numeric_limits<double>::max(),
+                std::numeric_limits<double>::max(), -std::numeric_limits<double>::max()};
+    }
+
+    /** \brief Get actor bounds.
+     *  \param actor: actor.
+     *  \returns bounds in world coordinates; empty actors get bounds no segment can cross.
+     */
+    static std::array<double, 6> get_actor_bounds(vtkActor * actor) {
+        std::array<double, 6> b = {1, -1, 1, -1, 1, -1};
+        auto bounds = actor->GetBounds();
+        if (bounds != nullptr && bounds[0] <= bounds[1])
+            std::copy(bounds, bounds+6, b.begin());
+        return b;
+    }
+
+
+    class Picker::Observer : public vtkCommand {
+    public:
+        /** \brief Create a new instance. This is necessary for VTK. */
+        static Observer* New() {
+            return new Observer;
+        }
+
+        /** \brief Picker to notify. */
+        Picker * picker = nullptr;
+
+        /** \brief Actor to mark as modified. */
+        vtkActor * actor = nullptr;
+
+        /** \brief Mark actor as modified.
+         *  \param caller: observed object.
+         *  \param event: event ID.
+         *  \param data: event data.
+         */
+        void Execute(vtkObject * caller, unsigned long event, void * data) override {
+            this->picker->modified.insert(this->actor);
+        }
+    };
+
+
+    Picker::~Picker() {
+        for (auto & entry: this->entries)
+            this->unwatch(entry);
+    }
+
+    void Picker::index_actors(std::shared_ptr<Shape3D> shape) {
+        auto actors = shape->get_actors();
+        actors->InitTraversal();
+        size_t idx = 0;
+        for (;;) {
+            auto actor = actors->GetNextActor();
+            if (actor == nullptr) break;
+            Entry entry;
+            entry.shape = shape;
+            entry.actor = actor;
+            entry.actor_index = idx++;
+            this->entries.emplace_back(std::move(entry));
+        }
+    }
+
+    bool Picker::unindex_actors(std::shared_ptr<Shape3D> shape) {
+        auto it = std::partition(this->entries.begin(), this->entries.end(),
+                                 [&shape](const Entry & e) { return e.shape != shape; });
+        if (it == this->entries.end()) return false;
+        for (auto e = it; e != this->entries.end(); e++)
+            this->unwatch(*e);
+        this->entries.erase(it, this->entries.end());
+        return true;
+    }
+
+    void Picker::watch(Entry & entry) {
+        if (entry.observer == nullptr) {
+            auto observer = vtkSmartPointer<Observer>::New();
+            observer->picker = this;
+            observer->actor = entry.actor;
+            entry.observer = observer;
+            entry.actor_tag = entry.actor->AddObserver(vtkCommand::ModifiedEvent, entry.observer);
+        }
+        auto mapper = entry.actor->GetMapper();
+        if (mapper != entry.mapper) {
+            if (entry.mapper != nullptr)
+                entry.mapper->RemoveObserver(entry.mapper_tag);
+            entry.mapper = mapper;
+            if (mapper != nullptr)
+                entry.mapper_tag = mapper->AddObserver(vtkCommand::ModifiedEvent, entry.observer);
+        }
+        vtkDataObject * input = mapper != nullptr ? mapper->GetInput() : nullptr;
+        if (input != entry.input) {
+            if (entry.input != nullptr)
+                entry.input->RemoveObserver(entry.input_tag);
+            entry.input = input;
+            if (input != nullptr)
+                entry.input_tag = input->AddObserver(vtkCommand::ModifiedEvent, entry.observer);
+        }
+    }
+
+    void Picker::unwatch(Entry & entry) {
+        if (entry.observer == nullptr) return;
+        entry.actor->RemoveObserver(entry.actor_tag);
+        if (entry.mapper != nullptr)
+            entry.mapper->RemoveObserver(entry.mapper_tag);
+        if (entry.input != nullptr)
+            entry.input->RemoveObserver(entry.input_tag);
+        entry.observer = nullptr;
+        entry.mapper = nullptr;
+        entry.input = nullptr;
+    }
+
+    void Picker::add_shape(std::shared_ptr<Shape3D> shape) {
+        PYG_LOG_V("Indexing shape 0x{:x} for picking", (uint64_t)shape.get());
+        this->shapes.push_back({shape, shape->get_actors()->GetMTime()});
+        this->index_actors(shape);
+        this->dirty = true;
+    }
+
+    void Picker::remove_shape(std::shared_ptr<Shape3D> shape) {
+        this->shapes.erase(std::remove_if(this->shapes.begin(), this->shapes.end(),
+                                          [&shape](const IndexedShape & s) { return s.shape == shape; }),
+                           this->shapes.end());
+        if (this->unindex_actors(shape))
+            this->dirty = true;
+    }
+
+    bool Picker::outdated() {
+        auto changed = false;
+        for (auto & indexed: this->shapes) {
+            auto time = indexed.shape->get_actors()->GetMTime();
+            if (time == indexed.actors_time) continue;
+            PYG_LOG_V("Indexing actors of shape 0x{:x} again for picking", (uint64_t)indexed.shape.get());
+            this->unindex_actors(indexed.shape);
+            this->index_actors(indexed.shape);
+            indexed.actors_time = time;
+            changed = true;
+        }
+        return changed;
+    }
+
+    void Picker::invalidate() {
+        this->dirty = true;
+    }
+
+    void Picker::update_entry(Entry & entry) {
+        entry.bounds = get_actor_bounds(entry.actor);
+        if (entry.actor->GetIsIdentity()) {
+            entry.inverse = nullptr;
+        } else {
+            entry.inverse = vtkSmartPointer<vtkMatrix4x4>::New();
+            vtkMatrix4x4::Invert(entry.actor->GetMatrix(), entry.inverse);
+        }
+        this->watch(entry);
+    }
+
+    void Picker::build() {
+        PYG_LOG_V("Building picking BVH over {} actors", this->entries.size());
+        for (auto & entry: this->entries)
+            this->update_entry(entry);
+        this->nodes.clear();
+        this->nodes.reserve(2*this->entries.size()/max_leaf_size + 1);
+        this->nodes.emplace_back();
+        this->build_node(0, 0, this->entries.size());
+        this->entry_index.clear();
+        for (size_t i=0; i<this->entries.size(); i++)
+            this->entry_index[this->entries[i].actor] = i;
+        this->modified.clear();
+        this->dirty = false;
+    }
+
+    void Picker::refit() {
+        // computing bounds may trigger events; these are handled at next pick
+        auto actors = std::move(this->modified);
+        this->modified.clear();
+        std::vector<size_t> leaves;
+        for (auto actor: actors) {
+            auto it = this->entry_index.find(actor);
+            if (it == this->entry_index.end()) continue;
+            auto & entry = this->entries[it->second];
+            this->update_entry(entry);
+            leaves.push_back(entry.leaf);
+        }
+        std::sort(leaves.begin(), leaves.end());
+        leaves.erase(std::unique(leaves.begin(), leaves.end()), leaves.end());
+        PYG_LOG_V("Refitting {} leaves of picking BVH", leaves.size());
+        for (auto leaf: leaves) {
+            auto bounds = empty_bounds();
+            auto & node = this->nodes[leaf];
+            for (auto i=node.first; i<node.first+node.count; i++)
+                merge_bounds(bounds, this->entries[i].bounds);
+            node.bounds = bounds;
+            // ancestors above an unchanged node are up to date
+            for (auto parent = node.parent; parent >= 0; parent = this->nodes[parent].parent) {
+                auto child = this->nodes[parent].child;
+                bounds = this->nodes[child].bounds;
+                merge_bounds(bounds, this->nodes[child+1].bounds);
+                if (bounds == this->nodes[parent].bounds) break;
+                this->nodes[parent].bounds = bounds;
+            }
+        }
+    }
+
+    void Picker::build_node(const size_t node, const size_t first, const size_t count) {
+        auto bounds = empty_bounds();
+        auto centres = bounds;
+        for (auto i=first; i<first+count; i++) {
+            merge_bounds(bounds, this->entries[i].bounds);
+            auto & b = this->entries[i].bounds;
+            std::array<double, 6> c = {
+                (b[0]+b[1])/2, (b[0]+b[1])/2,
+                (b[2]+b[3])/2, (b[2]+b[3])/2,
+                (b[4]+b[5])/2, (b[4]+b[5])/2};
+            merge_bounds(centres, c);
+        }
+        this->nodes[node].bounds = bounds;
+        if (count <= max_leaf_size) {
+            this->nodes[node].first = first;
+            this->nodes[node].count = count;
+            for (auto i=first; i<first+count; i++)
+                this->entries[i].leaf = node;
+            return;
+        }
+        // split along axis with largest spread of centres
+        auto axis = 0;
+        for (auto a=1; a<3; a++)
+            if (centres[2*a+1]-centres[2*a] > centres[2*axis+1]-centres[2*axis])
+                axis = a;
+        auto begin = this->entries.begin() + first;
+        auto middle = begin + count/2;
+        std::nth_element(begin, middle, begin + count, [axis](const Entry & e1, const Entry & e2) {
+            return e1.bounds[2*axis] + e1.bounds[2*axis+1] < e2.bounds[2*axis] + e2.bounds[2*axis+1];
+        });
+        auto child = this->nodes.size();
+        this->nodes[node].child = child;
+        this->nodes.emplace_back();
+        this->nodes.emplace_back();
+        this->nodes[child].parent = node;
+        this->nodes[child+1].parent = node;
+        this->build_node(child, first, count/2);
+        this->build_node(child+1, first + count/2, count - count/2);
+    }
+
+    void Picker::pick_entry(Entry & entry, const double p1[3], const double p2[3], std::optional<PickResult> & result) {
+        if (!entry.actor->GetVisibility() || !entry.actor->GetPickable())
+            return;
+        auto data = vtkPolyData::SafeDownCast(entry.actor->GetMapper()->GetInput());
+        if (data == nullptr || data->GetNumberOfCells() == 0)
+            return;
+        // locators are kept until actor data changes
+        if (entry.locator == nullptr || entry.data != data || data->GetMTime() > entry.data_time) {
+            entry.locator = vtkSmartPointer<vtkCellLocator>::New();
+            entry.locator->SetDataSet(data);
+            entry.locator->BuildLocator();
+            entry.data = data;
+            entry.data_time = data->GetMTime();
+        }
+        // pick segment in actor data coordinates
+        double q1[4] = {p1[0], p1[1], p1[2], 1};
+        double q2[4] = {p2[0], p2[1], p2[2], 1};
+        if (entry.inverse != nullptr) {
+            entry.inverse->MultiplyPoint(q1, q1);
+            entry.inverse->MultiplyPoint(q2, q2);
+            for (auto a=0; a<3; a++) {
+                q1[a] /= q1[3];
+                q2[a] /= q2[3];
+            }
+        }
+        double t, x[3], pcoords[3];
+        int sub_id;
+        vtkIdType cell_id;
+        if (!entry.locator->IntersectWithLine(q1, q2, pick_tolerance, t, x, pcoords, sub_id, cell_id))
+            return;
+        if (result.has_value() && result->t <= t)
+            return;
+
+        PickResult res;
+        res.shape = entry.shape;
+        res.actor = entry.actor;
+        res.t = t;
+        for (auto a=0; a<3; a++)
+            res.position[a] = p1[a] + t*(p2[a]-p1[a]);
+        // closest cell point gives path indices
+        auto cell = data->GetCell(cell_id);
+        vtkIdType closest = -1;
+        auto dmin = std::numeric_limits<double>::max();
+        for (vtkIdType i=0; i<cell->GetNumberOfPoints(); i++) {
+            auto id = cell->GetPointId(i);
+            double pt[3];
+            data->GetPoint(id, pt);
+            auto d = std::pow(pt[0]-x[0], 2) + std::pow(pt[1]-x[1], 2) + std::pow(pt[2]-x[2], 2);
+            if (d < dmin) {
+                dmin = d;
+                closest = id;
+            }
+        }
+        auto path_ids = data->GetPointData()->GetArray(path_index_array.c_str());
+        auto point_ids = data->GetPointData()->GetArray(point_index_array.c_str());
+        res.path_index = (path_ids != nullptr && closest >= 0) ? (int64_t)path_ids->GetTuple1(closest) : (int64_t)entry.actor_index;
+        res.point_index = (point_ids != nullptr && closest >= 0) ? (int64_t)point_ids->GetTuple1(closest) : -1;
+        result = res;
+    }
+
+    std::optional<PickResult> Picker::pick(const double p1[3], const double p2[3]) {
+        if (this->dirty || this->outdated())
+            this->build();
+        else if (!this->modified.empty())
+            this->refit();
+        std::optional<PickResult> result;
+        if (this->entries.empty())
+            return result;
+        double d[3] = {p2[0]-p1[0], p2[1]-p1[1], p2[2]-p1[2]};
+        std::vector<size_t> stack = {0};
+        while (!stack.empty()) {
+            auto & node = this->nodes[stack.back()];
+            stack.pop_back();
+            auto tmax = result.has_value() ? result->t : 1.0;
+            if (!segment_crosses_box(p1, d, node.bounds, tmax))
+                continue;
+            if (node.child < 0) {
+                for (auto i=node.first; i<node.first+node.count; i++)
+                    if (segment_crosses_box(p1, d, this->entries[i].bounds, tmax))
+                        this->pick_entry(this->entries[i], p1, p2, result);
+            } else {
+                stack.push_back(node.child);
+                stack.push_back(node.child+1);
+            }
+        }
+        return result;
+    }
+
+
+    int vtkModelPicker::Pick(double x, double y, double z, vtkRenderer * renderer) {
+        this->Initialize();
+        this->result.reset();
+        this->Renderer = renderer;
+        this->SelectionPoint[0] = x;
+        this->SelectionPoint[1] = y;
+        this->SelectionPoint[2] = z;
+        this->InvokeEvent(vtkCommand::StartPickEvent, nullptr);
+        if (this->model == nullptr || renderer == nullptr) {
+            this->InvokeEvent(vtkCommand::EndPickEvent, nullptr);
+            return 0;
+        }
+        // pick line goes from near to far clipping plane
+        double p[2][3];
+        for (auto i=0; i<2; i++) {
+            double w[4];
+            renderer->SetDisplayPoint(x, y, i);
+            renderer->DisplayToWorld();
+            renderer->GetWorldPoint(w);
+            for (auto a=0; a<3; a++)
+                p[i][a] = w[3] != 0 ? w[a]/w[3] : w[a];
+        }
+        this->result = this->model->pick(p[0], p[1]);
+        if (this->result.has_value()) {
+            auto path = vtkSmartPointer<vtkAssemblyPath>::New();
+            path->AddNode(this->result->actor, this->result->actor->GetMatrix());
+            this->SetPath(path);
+            std::copy(this->result->position.begin(), this->result->position.end(), this->PickPosition);
+            this->InvokeEvent(vtkCommand::PickEvent, nullptr);
+        }
+        this->InvokeEvent(vtkCommand::EndPickEvent, nullptr);
+        return this->result.has_value() ? 1 : 0;
+    }
+
+}
@@ -0,0 +1,280 @@
+/** \file picker.h
+ *  \brief Header file for Picker class.
+ *
+ *  Author: Vincent Paeder
+ *  License: MIT
+ */
+#pragma once
+#include <array>
+#include <optional>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include <vtkSmartPointer.h>
+#include <vtkActor.h>
+#include <vtkCellLocator.h>
+#include <vtkCommand.h>
+#include <vtkMapper.h>
+#include <vtkMatrix4x4.h>
+#include <vtkPolyData.h>
+#include <vtkAbstractPropPicker.h>
+
+#include "shape3d.h"
+
+namespace pygraver::render {
+
+    class Model;
+
+    /** \brief Name of point data array holding path index of each point, for shapes merging several paths in one actor. */
+    const std::string path_index_array = "PathIndex";
+
+    /** \brief Name of point data array holding index of source path point for each point. */
+    const std::string point_index_array = "PointIndex";
+
+    /** \brief Result of a pick operation. */
+    struct PickResult {
+        /** \brief Picked shape. */
+        std::shared_ptr<Shape3D> shape;
+
+        /** \brief Picked actor. */
+        vtkSmartPointer<vtkActor> actor;
+
+        /** \brief Path index within shape; this is the actor index unless actor data has a PathIndex array. */
+        int64_t path_index = -1;
+
+        /** \brief Index of closest path point; -1 if actor data has no PointIndex array. */
+        int64_t point_index = -1;
+
+        /** \brief Picked position, in world coordinates. */
+        std::array<double, 3> position = {0, 0, 0};
+
+        /** \brief Relative position along pick segment (0 at start, 1 at end). */
+        double t = 1;
+    };
+
+    /** \brief Spatial index used to pick shapes along a line.
+     *
+     *  Actor bounds are organized in a bounding volume hierarchy (BVH), so that
+     *  only actors whose bounds cross the pick line are tested. Each actor then
+     *  gets its own cell locator, which is built on first use and kept until
+     *  actor data changes. The BVH itself is rebuilt lazily when shapes are
+     *  added or removed, and when actors are added to or removed from a shape.
+     *  Each indexed actor is observed, together with its mapper and mapper input:
+     *  a Modified event marks the actor, and the next pick only updates bounds of
+     *  marked actors and of BVH nodes above them (e.g. after Shape3D::set_item,
+     *  or when Playback changes drawn cells). Changes to a user transform aren't
+     *  observed; call invalidate after modifying one in place.
+     */
+    class Picker {
+    private:
+        /** \brief Command marking an actor as modified. */
+        class Observer;
+
+
+        /** \brief Indexed actor. */
+        struct Entry {
+            /** \brief Shape owning actor. */
+            std::shared_ptr<Shape3D> shape;
+            /** \brief Actor. */
+            vtkSmartPointer<vtkActor> actor;
+            /** \brief Index of actor within shape. */
+            size_t actor_index;
+            /** \brief Actor bounds, in world coordinates. */
+            std::array<double, 6> bounds;
+            /** \brief Inverse of actor transform (nullptr if identity). */
+            vtkSmartPointer<vtkMatrix4x4> inverse;
+            /** \brief Data used to build locator. */
+            vtkSmartPointer<vtkPolyData> data;
+            /** \brief Modification time of data when locator was built. */
+            vtkMTimeType data_time = 0;
+            /** \brief Cell locator for actor data. */
+            vtkSmartPointer<vtkCellLocator> locator;
+            /** \brief BVH leaf holding entry. */
+            size_t leaf = 0;
+            /** \brief Observer of actor, mapper and mapper input. */
+            vtkSmartPointer<vtkCommand> observer;
+            /** \brief Observer tag on actor. */
+            unsigned long actor_tag = 0;
+            /** \brief Observed mapper. */
+            vtkSmartPointer<vtkMapper> mapper;
+            /** \brief Observer tag on mapper. */
+            unsigned long mapper_tag = 0;
+            /** \brief Observed mapper input. */
+            vtkSmartPointer<vtkDataObject> input;
+            /** \brief Observer tag on mapper input. */
+            unsigned long input_tag = 0;
+        };
+
+        /** \brief BVH node. */
+        struct Node {
+            /** \brief Node bounds. */
+            std::array<double, 6> bounds;
+            /** \brief Index of first child node (second child follows); -1 for leaves. */
+            int64_t child = -1;
+            /** \brief Index of parent node; -1 for the root. */
+            int64_t parent = -1;
+            /** \brief First entry of leaf. */
+            size_t first = 0;
+            /** \brief Number of entries in leaf. */
+            size_t count = 0;
+        };
+
+        /** \brief Indexed shape. */
+        struct IndexedShape {
+            /** \brief Shape. */
+            std::shared_ptr<Shape3D> shape;
+            /** \brief Modification time of shape actor collection when indexed. */
+            vtkMTimeType actors_time = 0;
+        };
+
+        /** \brief Indexed shapes. */
+        std::vector<IndexedShape> shapes;
+
+        /** \brief Indexed actors. */
+        std::vector<Entry> entries;
+
+        /** \brief BVH nodes; node 0 is the root. */
+        std::vector<Node> nodes;
+
+        /** \brief Index of entry of each actor, valid after BVH is built. */
+        std::unordered_map<vtkActor*, size_t> entry_index;
+
+        /** \brief Actors modified since their bounds were last updated. */
+        std::unordered_set<vtkActor*> modified;
+
+        /** \brief If true, BVH must be rebuilt before next pick. */
+        bool dirty = true;
+
+        /** \brief Add actors of a shape to indexed actors.
+         *  \param shape: pointer to 3D shape object.
+         */
+        void index_actors(std::shared_ptr<Shape3D> shape);
+
+        /** \brief Remove actors of a shape from indexed actors.
+         *  \param shape: pointer to 3D shape object.
+         *  \returns true if any actor was removed.
+         */
+        bool unindex_actors(std::shared_ptr<Shape3D> shape);
+
+        /** \brief Observe actor of an entry, its mapper and mapper input.
+         *
+         *  Observers of a mapper or input the actor no longer uses are removed.
+         *
+         *  \param entry: indexed actor.
+         */
+        void watch(Entry & entry);
+
+        /** \brief Remove observers of an entry.
+         *  \param entry: indexed actor.
+         */
+        void unwatch(Entry & entry);
+
+        /** \brief Test if actors were added to or removed from a shape since BVH was built.
+         *
+         *  Shapes whose actor collection changed are indexed again.
+         *
+         *  \returns true if BVH must be rebuilt.
+         */
+        bool outdated();
+
+        /** \brief Update bounds and transform of an entry.
+         *  \param entry: indexed actor.
+         */
+        void update_entry(Entry & entry);
+
+        /** \brief Rebuild BVH over actor bounds. */
+        void build();
+
+        /** \brief Update bounds of modified entries, and of BVH nodes holding them. */
+        void refit();
+
+        /** \brief Build BVH node for a range of entries.
+         *  \param node: index of node to fill.
+         *  \param first: first entry.
+         *  \param count: number of entries.
+         */
+        void build_node(const size_t node, const size_t first, const size_t count);
+
+        /** \brief Intersect pick segment with an actor.
+         *  \param entry: indexed actor.
+         *  \param p1: segment start.
+         *  \param p2: segment end.
+         *  \param result: pick result, updated if a closer intersection is found.
+         */
+        void pick_entry(Entry & entry, const double p1[3], const double p2[3], std::optional<PickResult> & result);
+
+    public:
+        Picker() = default;
+        Picker(const Picker &) = delete;
+        Picker & operator=(const Picker &) = delete;
+
+        /** \brief Destructor; removes observers. */
+        ~Picker();
+
+        /** \brief Add shape actors to index.
+         *  \param shape: pointer to 3D shape object.
+         */
+        void add_shape(std::shared_ptr<Shape3D> shape);
+
+        /** \brief Remove shape actors from index.
+         *  \param shape: pointer to 3D shape object.
+         */
+        void remove_shape(std::shared_ptr<Shape3D> shape);
+
+        /** \brief Mark index as outdated; changes to indexed actors are normally detected by pick. */
+        void invalidate();
+
+        /** \brief Find closest visible actor crossed by a line segment.
+         *  \param p1: segment start, in world coordinates.
+         *  \param p2: segment end, in world coordinates.
+         *  \returns pick result, if any actor is crossed.
+         */
+        std::optional<PickResult> pick(const double p1[3], const double p2[3]);
+    };
+
+
+    /** \brief VTK prop picker relying on the spatial index of a model.
+     *
+     *  This can replace the default picker of VTK widgets (e.g. vtkBalloonWidget).
+     */
+    class vtkModelPicker : public vtkAbstractPropPicker {
+    private:
+        /** \brief Pointer to associated model. */
+        Model * model = nullptr;
+
+        /** \brief Result of last pick. */
+        std::optional<PickResult> result;
+
+    public:
+        vtkTypeMacro(vtkModelPicker, vtkAbstractPropPicker);
+
+        /** \brief Create a new instance. This is necessary for VTK. */
+        static vtkModelPicker* New() {
+            return new vtkModelPicker;
+        }
+
+        /** \brief Associate model with picker.
+         *  \param model: pointer to the model to associate.
+         */
+        void set_model(Model * model) {
+            this->model = model;
+        }
+
+        /** \brief Pick at given display position.
+         *  \param x: x display coordinate.
+         *  \param y: y display coordinate.
+         *  \param z: z display coordinate (ignored).
+         *  \param renderer: renderer to pick in.
+         *  \returns 1 if something was picked, 0 otherwise.
+         */
+        int Pick(double x, double y, double z, vtkRenderer * renderer) override;
+
+        /** \brief Get result of last pick.
+         *  \returns pick result, if last pick succeeded.
+         */
+        const std::optional<PickResult> & get_result() const {
+            return this->result;
+        }
+    };
+
+}
@@ -0,0 +1,330 @@
+/** \file playback.cpp
+ *  \brief Implementation file for Playback class.
+ *
+ *  Author: Vincent Paeder
+ *  License: MIT
+ */
+#include <vtkCellArray.h>
+#include <vtkPointData.h>
+#include <vtkDoubleArray.h>
+#include <vtkMapper.h>
+#include <vtkProperty.h>
+#include <vtkCylinderSource.h>
+#include <vtkTransformPolyDataFilter.h>
+
+#include <pybind11/stl.h>
+#include <fmt/core.h>
+#include <algorithm>
+#include <cmath>
+
+#include "../types/point.h"
+
+#include "playback.h"
+#include "picker.h"
+#include "vtkpybind.h"
+#include "../log.h"
+
+namespace pygraver::render {
+
+    Playback::Playback(const std::vector<std::shared_ptr<Path>> & paths,
+                       const std::vector<uint8_t> & color,
+                       const double tool_diameter,
+                       const double tool_length,
+                       const double line_width,
+                       const size_t chunk_size) : Shape3D() {
+        PYG_LOG_V("Creating playback 0x{:x}", (uint64_t)this);
+        if (chunk_size == 0)
+            throw std::invalid_argument("Chunk size must be positive.");
+        if (tool_diameter <= 0 || tool_length <= 0)
+            throw std::invalid_argument("Tool size must be positive.");
+        if (chunk_size > (size_t)std::numeric_limits<int32_t>::max()/2)
+            throw std::invalid_argument("Chunk size is too large.");
+        this->chunk_size = chunk_size;
+        // paths are concatenated; point ids are stored on 32 bits
+        if (paths.size() > (size_t)std::numeric_limits<int32_t>::max())
+            throw std::invalid_argument("Too many paths.");
+        this->path_offsets.reserve(paths.size() + 1);
+        vtkIdType n = 0;
+        for (auto & path: paths) {
+            if (path->size() > (size_t)std::numeric_limits<int32_t>::max())
+                throw std::invalid_argument("Path is too long.");
+            this->path_offsets.emplace_back(n);
+            n += path->size();
+        }
+        this->path_offsets.emplace_back(n);
+        if (n == 0)
+            throw std::invalid_argument("Cannot create playback from empty paths.");
+
+        // chunk k holds segments from point k*chunk_size onwards, and the end
+        // point of its last segment; chunk points are the only copy of the job
+        auto n_segments = n - 1;
+        auto n_chunks = std::max((vtkIdType)1, (n_segments + this->chunk_size - 1)/this->chunk_size);
+        this->chunks.resize(n_chunks);
+        for (vtkIdType k=0; k<n_chunks; k++) {
+            auto & chunk = this->chunks[k];
+            chunk.size = std::min(this->chunk_size, n_segments - k*this->chunk_size);
+            chunk.points = vtkSmartPointer<vtkPoints>::New();
+            chunk.points->SetDataTypeToDouble();
+            chunk.points->SetNumberOfPoints(chunk.size + 1);
+        }
+        for (size_t p=0; p<paths.size(); p++) {
+            auto begin = this->path_offsets[p];
+            auto end = this->path_offsets[p+1];
+            if (begin == end) continue;
+            // first point of a chunk is also the last point of the previous one
+            auto first = begin > 0 ? (begin - 1)/this->chunk_size : 0;
+            auto last = std::min(n_chunks - 1, (end - 1)/this->chunk_size);
+            for (auto k=first; k<=last; k++) {
+                auto lo = std::max(begin, k*this->chunk_size);
+                auto hi = std::min(end, k*this->chunk_size + this->chunks[k].size + 1);
+                if (lo < hi)
+                    copy_points(this->chunks[k].points, lo - k*this->chunk_size, *paths[p], hi - lo, false, lo - begin);
+            }
+        }
+
+        // travelled distance, moves between paths included, and color range
+        double vmin = std::numeric_limits<double>::max();
+        double vmax = -std::numeric_limits<double>::max();
+        double distance = 0;
+        for (auto & chunk: this->chunks) {
+            chunk.distance = distance;
+            auto xyz = vtkDoubleArray::SafeDownCast(chunk.points->GetData())->GetPointer(0);
+            for (vtkIdType j=1; j<=chunk.size; j++) {
+                auto p = xyz + 3*j;
+                distance += sqrt(pow(p[0]-p[-3], 2) + pow(p[1]-p[-2], 2) + pow(p[2]-p[-1], 2));
+            }
+            for (auto vcur: this->color_mapping(chunk.points)) {
+                vmin = std::min(vmin, vcur);
+                vmax = std::max(vmax, vcur);
+            }
+        }
+        this->total_distance = distance;
+        this->set_scalar_color_range(vmin, vmax);
+
+        // cells and point ids use chunk-local indices, which fit on 32 bits
+        size_t path_idx = 0;
+        for (vtkIdType k=0; k<n_chunks; k++) {
+            auto & chunk = this->chunks[k];
+            auto first = k*this->chunk_size;
+            auto path_ids = vtkSmartPointer<vtkTypeInt32Array>::New();
+            path_ids->SetName(path_index_array.c_str());
+            path_ids->SetNumberOfTuples(chunk.size + 1);
+            auto point_ids = vtkSmartPointer<vtkTypeInt32Array>::New();
+            point_ids->SetName(point_index_array.c_str());
+            point_ids->SetNumberOfTuples(chunk.size + 1);
+            chunk.offsets = vtkSmartPointer<vtkTypeInt32Array>::New();
+            chunk.offsets->SetNumberOfTuples(chunk.size + 1);
+            chunk.connectivity = vtkSmartPointer<vtkTypeInt32Array>::New();
+            chunk.connectivity->SetNumberOfTuples(2*chunk.size);
+            for (vtkIdType j=0; j<=chunk.size; j++) {
+                auto i = first + j;
+                while (this->path_offsets[path_idx+1] <= i)
+                    path_idx++;
+                path_ids->SetValue(j, path_idx);
+                point_ids->SetValue(j, i - this->path_offsets[path_idx]);
+                chunk.offsets->SetValue(j, 2*j);
+                if (j == chunk.size) break;
+                // move to next path is a degenerate segment
+                auto next_in_path = i + 1 < this->path_offsets[path_idx+1];
+                chunk.connectivity->SetValue(2*j, j);
+                chunk.connectivity->SetValue(2*j+1, next_in_path ? j+1 : j);
+            }
+
+            auto cells = vtkSmartPointer<vtkCellArray>::New();
+            cells->SetData(chunk.offsets, chunk.connectivity);
+            auto polydata = vtkSmartPointer<vtkPolyData>::New();
+            polydata->SetPoints(chunk.points);
+            polydata->SetLines(cells);
+            polydata->GetPointData()->AddArray(path_ids);
+            polydata->GetPointData()->AddArray(point_ids);
+            this->set_item(k, polydata);
+            // keep data actually rendered, so that cells can be changed later
+            auto actor = static_cast<vtkActor*>(this->actors->GetItemAsObject(k));
+            actor->GetProperty()->SetLineWidth(line_width);
+            chunk.data = dynamic_cast<vtkPolyData*>(actor->GetMapper()->GetInput());
+        }
+
+        // tool with its tip at origin; cylinder source is aligned with y axis
+        auto cylinder = vtkSmartPointer<vtkCylinderSource>::New();
+        cylinder->SetRadius(tool_diameter/2);
+        cylinder->SetHeight(tool_length);
+        cylinder->SetResolution(20);
+        auto transform = vtkSmartPointer<vtkTransform>::New();
+        transform->Translate(0, 0, tool_length/2);
+        transform->RotateX(90);
+        auto trans_filter = vtkSmartPointer<vtkTransformPolyDataFilter>::New();
+        trans_filter->SetTransform(transform);
+        trans_filter->SetInputConnection(cylinder->GetOutputPort());
+        trans_filter->Update();
+        this->set_item(n_chunks, trans_filter->GetOutput());
+        this->tool_transform = vtkSmartPointer<vtkTransform>::New();
+        auto tool = this->get_tool_actor();
+        tool->SetUserTransform(this->tool_transform);
+        // tool moves all the time: picker bounds would be outdated
+        tool->PickableOff();
+
+        // set base colors; tool uses highlight color to stand out
+        this->set_base_color(color);
+        this->set_highlight_color(Shape3D::make_highlight_color(this->base_color));
+        this->set_color(n_chunks, this->highlight_color);
+        this->set_progress(0);
+    }
+
+    Playback::~Playback() {
+        PYG_LOG_V("Deleting playback 0x{:x}", (uint64_t)this);
+    }
+
+    double Playback::color_mapping_function(const double pos[3]) {
+        return pos[2];
+    }
+
+    void Playback::show_cells(const size_t idx, const vtkIdType count) {
+        auto & chunk = this->chunks[idx];
+        if (chunk.shown == count) return;
+        // views on full arrays; nothing is copied
+        auto offsets = vtkSmartPointer<vtkTypeInt32Array>::New();
+        offsets->SetArray(chunk.offsets->GetPointer(0), count + 1, 1);
+        auto connectivity = vtkSmartPointer<vtkTypeInt32Array>::New();
+        connectivity->SetArray(chunk.connectivity->GetPointer(0), 2*count, 1);
+        auto cells = vtkSmartPointer<vtkCellArray>::New();
+        cells->SetData(offsets, connectivity);
+        chunk.data->SetLines(cells);
+        chunk.data->Modified();
+        chunk.shown = count;
+    }
+
+    void Playback::move_tool(const double pos[3]) {
+        this->tool_transform->Identity();
+        this->tool_transform->Translate(pos[0], pos[1], pos[2]);
+    }
+
+    void Playback::get_point(const vtkIdType idx, double pt[3]) const {
+        auto k = std::min(idx/this->chunk_size, (vtkIdType)this->chunks.size() - 1);
+        this->chunks[k].points->GetPoint(idx - k*this->chunk_size, pt);
+    }
+
+    size_t Playback::get_point_count() const {
+        return this->path_offsets.back();
+    }
+
+    size_t Playback::get_chunk_count() const {
+        return this->chunks.size();
+    }
+
+    vtkSmartPointer<vtkActor> Playback::get_tool_actor() {
+        return static_cast<vtkActor*>(this->actors->GetItemAsObject(this->chunks.size()));
+    }
+
+    size_t Playback::get_progress() const {
+        return this->progress;
+    }
+
+    void Playback::set_progress(const size_t idx) {
+        if (idx >= this->get_point_count())
+            throw std::out_of_range(fmt::format("Point index {} is out of range.", idx));
+        vtkIdType value = idx;
+        // only chunks between old and new position change; everything is updated the first time
+        auto lo = this->progress < 0 ? 0 : std::min(this->progress, value);
+        auto hi = this->progress < 0 ? (vtkIdType)this->get_point_count() : std::max(this->progress, value);
+        auto last = std::min((vtkIdType)this->chunks.size() - 1, hi/this->chunk_size);
+        for (auto k=lo/this->chunk_size; k<=last; k++)
+            this->show_cells(k, std::clamp(value - k*this->chunk_size, (vtkIdType)0, this->chunks[k].size));
+        this->progress = value;
+        double pos[3];
+        this->get_point(value, pos);
+        this->move_tool(pos);
+    }
+
+    std::tuple<size_t, size_t> Playback::get_location(const size_t idx) const {
+        if (idx >= this->get_point_count())
+            throw std::out_of_range(fmt::format("Point index {} is out of range.", idx));
+        size_t path_idx = std::upper_bound(this->path_offsets.begin(), this->path_offsets.end(), (vtkIdType)idx) - this->path_offsets.begin() - 1;
+        return std::make_tuple(path_idx, idx - this->path_offsets[path_idx]);
+    }
+
+    size_t Playback::set_position(std::shared_ptr<const Point> position, const size_t search_window) {
+        auto cart = position->to_cartesian();
+        double pos[3] = {cart->x, cart->y, cart->z};
+        // machine only moves forward along job
+        auto end = std::min(this->get_point_count(), (size_t)this->progress + search_window + 1);
+        auto best = (size_t)this->progress;
+        auto dmin = std::numeric_limits<double>::max();
+        for (auto i=best; i<end; i++) {
+            double pt[3];
+            this->get_point(i, pt);
+            auto d = pow(pt[0]-pos[0], 2) + pow(pt[1]-pos[1], 2) + pow(pt[2]-pos[2], 2);
+            if (d < dmin) {
+                dmin = d;
+                best = i;
+            }
+        }
+        this->set_progress(best);
+        this->move_tool(pos);
+        return best;
+    }
+
+    double Playback::get_feed_rate() const {
+        return this->feed_rate;
+    }
+
+    void Playback::set_feed_rate(const double feed_rate) {
+        if (!(feed_rate > 0))
+            throw std::invalid_argument("Feed rate must be positive.");
+        this->feed_rate = feed_rate;
+    }
+
+    double Playback::get_duration() const {
+        return this->total_distance/this->feed_rate;
+    }
+
+    size_t Playback::set_time(const double time) {
+        if (!(time >= 0))
+            throw std::invalid_argument("Time must be positive.");
+        auto distance = std::min(time*this->feed_rate, this->total_distance);
+        // last chunk starting before distance, then last point before distance in chunk
+        auto it = std::upper_bound(this->chunks.begin() + 1, this->chunks.end(), distance,
+                                   [](const double d, const Chunk & c) { return d < c.distance; });
+        auto k = it - this->chunks.begin() - 1;
+        auto & chunk = this->chunks[k];
+        auto xyz = vtkDoubleArray::SafeDownCast(chunk.points->GetData())->GetPointer(0);
+        auto travelled = chunk.distance;
+        auto step = 0.0;
+        vtkIdType j = 0;
+        for (; j<chunk.size; j++) {
+            auto p = xyz + 3*(j+1);
+            step = sqrt(pow(p[0]-p[-3], 2) + pow(p[1]-p[-2], 2) + pow(p[2]-p[-1], 2));
+            if (travelled + step > distance) break;
+            travelled += step;
+        }
+        size_t idx = k*this->chunk_size + j;
+        this->set_progress(idx);
+        if (j < chunk.size) {
+            // place tool between current and next point
+            auto t = step > 0 ? (distance - travelled)/step : 0;
+            auto p1 = xyz + 3*j;
+            double pos[3];
+            for (auto a=0; a<3; a++)
+                pos[a] = p1[a] + t*(p1[a+3]-p1[a]);
+            this->move_tool(pos);
+        }
+        return idx;
+    }
+
+
+    void py_playback_exports(py::module_ & mod) {
+        py::class_<Playback, std::shared_ptr<Playback>, Shape3D>(mod, "Playback")
+            .def(py::init<const std::vector<std::shared_ptr<Path>> &, const std::vector<uint8_t> &, const double, const double, const double, const size_t>(),
+                 py::arg("paths"), py::arg("color"), py::arg("tool_diameter"), py::arg("tool_length"), py::arg("line_width")=2, py::arg("chunk_size")=4096)
+            .def_property_readonly("point_count", &Playback::get_point_count)
+            .def_property_readonly("chunk_count", &Playback::get_chunk_count)
+            .def_property_readonly("tool_actor", &Playback::get_tool_actor, py::return_value_policy::reference)
+            .def_property("progress", &Playback::get_progress, &Playback::set_progress)
+            .def_property("feed_rate", &Playback::get_feed_rate, &Playback::set_feed_rate)
+            .def_property_readonly("duration", &Playback::get_duration)
+            .def("get_location", &Playback::get_location, py::arg("index"))
+            .def("set_position", &Playback::set_position, py::arg("position"), py::arg("search_window")=1000)
+            .def("set_time", &Playback::set_time, py::arg("time"))
+            ;
+    }
+
+}
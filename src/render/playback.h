@@ -0,0 +1,198 @@
+/** \file playback.h
+ *  \brief Header file for Playback class.
+ *
+ *  Author: Vincent Paeder
+ *  License: MIT
+ */
+#pragma once
+#include <vtkTypeInt32Array.h>
+#include <vtkTransform.h>
+
+#include "../types/path.h"
+#include "shape3d.h"
+
+namespace pygraver::render {
+
+    using namespace pygraver::types;
+
+    /** \brief A shape revealing a job progressively, with a tool marker.
+     *
+     *  The whole job geometry is built once, as lines split into chunks of
+     *  fixed size (one actor per chunk); the last actor is the tool. Moving
+     *  the progress index only changes the number of cells drawn by chunks
+     *  between the old and the new position: cell arrays are views on the
+     *  full arrays, so that a chunk update doesn't copy anything. The tool
+     *  is moved with a transform. Per-frame cost is therefore independent
+     *  of the job size. Chunk points are the only copy of the job geometry;
+     *  cells and point ids use 32-bit chunk-local indices.
+     *
+     *  Points of all paths are concatenated; segments joining consecutive
+     *  paths are left out. Progress is the index of the last point reached
+     *  in this sequence.
+     */
+    class Playback : public Shape3D {
+    private:
+        /** \brief Chunk of job geometry. */
+        struct Chunk {
+            /** \brief Data rendered by chunk actor. */
+            vtkSmartPointer<vtkPolyData> data;
+
+            /** \brief Chunk points, in cartesian coordinates. */
+            vtkSmartPointer<vtkPoints> points;
+
+            /** \brief Offsets of all chunk cells. */
+            vtkSmartPointer<vtkTypeInt32Array> offsets;
+
+            /** \brief Connectivity of all chunk cells. */
+            vtkSmartPointer<vtkTypeInt32Array> connectivity;
+
+            /** \brief Number of cells. */
+            vtkIdType size = 0;
+
+            /** \brief Distance travelled from first job point to first chunk point. */
+            double distance = 0;
+
+            /** \brief Number of cells currently drawn. */
+            vtkIdType shown = -1;
+        };
+
+        /** \brief Geometry chunks. */
+        std::vector<Chunk> chunks;
+
+        /** \brief Number of segments per chunk. */
+        vtkIdType chunk_size;
+
+        /** \brief Index of first point of each path, plus total number of points. */
+        std::vector<vtkIdType> path_offsets;
+
+        /** \brief Distance travelled from first to last point. */
+        double total_distance = 0;
+
+        /** \brief Tool transform. */
+        vtkSmartPointer<vtkTransform> tool_transform;
+
+        /** \brief Index of last point reached. */
+        vtkIdType progress = -1;
+
+        /** \brief Feed rate used to convert time to travelled distance. */
+        double feed_rate = 1;
+
+        /** \brief Set number of cells drawn by a chunk.
+         *  \param idx: chunk index.
+         *  \param count: number of cells.
+         */
+        void show_cells(const size_t idx, const vtkIdType count);
+
+        /** \brief Get position of a point.
+         *  \param idx: point index.
+         *  \param pt: point position, in cartesian coordinates.
+         */
+        void get_point(const vtkIdType idx, double pt[3]) const;
+
+        /** \brief Move tool to given position.
+         *  \param pos: position, in cartesian coordinates.
+         */
+        void move_tool(const double pos[3]);
+
+    protected:
+        /** \brief Position to color mapping function.
+         *  \param pos: position.
+         *  \returns index along color scale.
+         */
+        double color_mapping_function(const double pos[3]) override;
+
+    public:
+        /** \brief Constructor with paths.
+         *  \param paths: job paths, in execution order.
+         *  \param color: 3 or 4-valued color (RGB or RGBA).
+         *  \param tool_diameter: tool marker diameter.
+         *  \param tool_length: tool marker length.
+         *  \param line_width: width of path lines, in pixels.
+         *  \param chunk_size: number of segments per chunk (>0, <2^30).
+         */
+        Playback(const std::vector<std::shared_ptr<Path>> & paths,
+                 const std::vector<uint8_t> & color,
+                 const double tool_diameter,
+                 const double tool_length,
+                 const double line_width=2,
+                 const size_t chunk_size=4096);
+
+        /** \brief Default destructor. */
+        ~Playback();
+
+        /** \brief Get number of points.
+         *  \returns number of points of all paths.
+         */
+        size_t get_point_count() const;
+
+        /** \brief Get number of chunks.
+         *  \returns number of chunks (the tool actor comes after them).
+         */
+        size_t get_chunk_count() const;
+
+        /** \brief Get tool actor.
+         *  \returns tool actor.
+         */
+        vtkSmartPointer<vtkActor> get_tool_actor();
+
+        /** \brief Get index of last point reached.
+         *  \returns point index.
+         */
+        size_t get_progress() const;
+
+        /** \brief Reveal job up to given point and move tool there.
+         *  \param idx: point index; throws std::out_of_range if there is no such point.
+         */
+        void set_progress(const size_t idx);
+
+        /** \brief Get path index and point index within path of given point.
+         *  \param idx: point index; throws std::out_of_range if there is no such point.
+         *  \returns path index and point index.
+         */
+        std::tuple<size_t, size_t> get_location(const size_t idx) const;
+
+        /** \brief Follow a machine position report.
+         *
+         *  The tool is moved to the given position, and progress advances to
+         *  the closest point among the next points of the job.
+         *
+         *  \param position: machine position.
+         *  \param search_window: number of points searched after current progress.
+         *  \returns new progress.
+         */
+        size_t set_position(std::shared_ptr<const Point> position, const size_t search_window=1000);
+
+        /** \brief Get feed rate.
+         *  \returns feed rate.
+         */
+        double get_feed_rate() const;
+
+        /** \brief Set feed rate used by set_time.
+         *  \param feed_rate: feed rate (distance per time unit, >0).
+         */
+        void set_feed_rate(const double feed_rate);
+
+        /** \brief Get time needed to run the whole job at current feed rate.
+         *  \returns duration.
+         */
+        double get_duration() const;
+
+        /** \brief Move along job according to a simulated clock.
+         *
+         *  Travelled distance is time multiplied by feed rate, moves between
+         *  paths included; the tool is placed between points.
+         *
+         *  \param time: elapsed time since job start.
+         *  \returns new progress.
+         */
+        size_t set_time(const double time);
+    };
+
+
+    /** \fn void py_playback_exports(py::module_ & mod)
+     *  \brief Export function for Python wrapper.
+     *  \param mod: module or submodule to add content to.
+     */
+    void py_playback_exports(py::module_ & mod);
+
+}
@@ -23,8 +23,10 @@
 #include <vtkMath.h>
 #include <vtkSelectEnclosedPoints.h>
 #include <vtkPoints.h>
+#include <vtkDoubleArray.h>
 
 #include <pybind11/stl.h>
+#include <pybind11/numpy.h>
 
 #include "vtkpybind.h"
 
@@ -119,17 +121,57 @@ namespace pygraver::render {
             auto polydata = dynamic_cast<vtkPolyData*>(actor->GetMapper()->GetInput());
             auto pointdata = polydata->GetPointData();
             auto colors = pointdata->GetScalars("Colors");
-            for (auto idx = 0; idx < polydata->GetNumberOfPoints(); idx++) {
-                double p[3];
+            auto values = this->color_mapping(polydata->GetPoints());
+            for (size_t idx = 0; idx < values.size(); idx++) {
                 double dcolor[3];
-                polydata->GetPoint(idx, p);
-                this->lut->GetColor(this->color_mapping_function(p), dcolor);
+                this->lut->GetColor(values[idx], dcolor);
                 colors->SetTuple3(idx, dcolor[0]*255, dcolor[1]*255, dcolor[2]*255);
             }
             actor = this->actors->GetNextActor();
         }
     }
 
+    std::vector<double> Shape3D::color_mapping(vtkPoints * points) {
+        std::vector<double> values;
+        if (points == nullptr) return values;
+        values.resize(points->GetNumberOfPoints());
+        for (vtkIdType idx = 0; idx < points->GetNumberOfPoints(); idx++) {
+            double p[3];
+            points->GetPoint(idx, p);
+            values[idx] = this->color_mapping_function(p);
+        }
+        return values;
+    }
+
+    std::vector<double> PyShape3D::color_mapping(vtkPoints * points) {
+        py::gil_scoped_acquire gil;
+        auto override = py::get_override(static_cast<const Shape3D*>(this), "color_mapping");
+        if (!override || points == nullptr)
+            return Shape3D::color_mapping(points);
+        auto n = static_cast<size_t>(points->GetNumberOfPoints());
+        py::array_t<double> view;
+        if (auto array = vtkDoubleArray::SafeDownCast(points->GetData()); array != nullptr) {
+            // view on point buffer; capsule keeps VTK array alive as long as the view
+            auto owner = new vtkSmartPointer<vtkDoubleArray>(array);
+            auto base = py::capsule(owner, [](void * p) { delete static_cast<vtkSmartPointer<vtkDoubleArray>*>(p); });
+            view = py::array_t<double>({n, size_t(3)}, array->GetPointer(0), base);
+            view.attr("setflags")(py::arg("write") = false);
+        } else {
+            view = py::array_t<double>({n, size_t(3)});
+            auto data = view.mutable_unchecked<2>();
+            for (size_t idx = 0; idx < n; idx++) {
+                double p[3];
+                points->GetPoint(idx, p);
+                for (auto a = 0; a < 3; a++)
+                    data(idx, a) = p[a];
+            }
+        }
+        auto result = py::array_t<double, py::array::c_style | py::array::forcecast>::ensure(override(view));
+        if (!result || static_cast<size_t>(result.size()) != n)
+            throw std::invalid_argument(fmt::format("Color mapping must return {} values.", n));
+        return std::vector<double>(result.data(), result.data() + n);
+    }
+
     double * Shape3D::get_scalar_color_range() const {
         return this->lut->GetTableRange();
     }
@@ -150,11 +192,10 @@ namespace pygraver::render {
         colors->SetName("Colors");
         colors->SetNumberOfComponents(3);
         colors->SetNumberOfTuples(polydata->GetNumberOfPoints());
-        for (auto idx = 0; idx < polydata->GetNumberOfPoints(); idx++) {
-            double p[3];
+        auto values = this->color_mapping(polydata->GetPoints());
+        for (size_t idx = 0; idx < values.size(); idx++) {
             double dcolor[3];
-            polydata->GetPoint(idx, p);
-            this->lut->GetColor(this->color_mapping_function(p), dcolor);
+            this->lut->GetColor(values[idx], dcolor);
             colors->SetTuple3(idx, dcolor[0]*255, dcolor[1]*255, dcolor[2]*255);
         }
         polydata->GetPointData()->SetScalars(colors);
@@ -559,6 +600,30 @@ namespace pygraver::render {
     }
 
 
+    void copy_points(vtkPoints * points, const size_t offset, const Path & path, const size_t n, const bool reverse, const size_t start) {
+        auto array = vtkDoubleArray::SafeDownCast(points->GetData());
+        if (array == nullptr)
+            throw std::invalid_argument("Points must use double precision.");
+        if (offset + n > (size_t)points->GetNumberOfPoints() || start + n > path.size())
+            throw std::out_of_range("Not enough room to copy points.");
+        auto data = array->GetPointer(3*offset);
+        for (size_t i=0; i<n; i++) {
+            auto & pt = *path[reverse ? path.size()-1-start-i : start+i];
+            if (pt.c == 0) {
+                data[3*i] = pt.x;
+                data[3*i+1] = pt.y;
+            } else {
+                auto c = cos(pt.c/180*M_PI);
+                auto s = sin(pt.c/180*M_PI);
+                data[3*i] = pt.x*c - pt.y*s;
+                data[3*i+1] = pt.x*s + pt.y*c;
+            }
+            data[3*i+2] = pt.z;
+        }
+        points->Modified();
+    }
+
+
     void py_shape3d_exports(py::module_ & mod) {
         py::class_<Shape3D, std::shared_ptr<Shape3D>, PyShape3D>(mod, "Shape3D")
         .def(py::init<>())
@@ -14,10 +14,12 @@
 #include <vtkTexture.h>
 #include <vtkProperty.h>
 #include <vtkPolyData.h>
+#include <vtkPoints.h>
 
 #include <pybind11/pybind11.h>
 
 #include "../types/point.h"
+#include "../types/path.h"
 
 namespace py = pybind11;
 using namespace pygraver::types;
@@ -54,6 +56,16 @@ namespace pygraver::render {
          *  \returns index along color scale.
          */
         virtual double color_mapping_function(const double pos[3]) {return 0;}
+
+        /** \brief Position to color mapping function for a whole point set.
+         *
+         *  The default implementation calls color_mapping_function for each point.
+         *  Overriding this avoids one virtual (or Python) call per point.
+         *
+         *  \param points: positions.
+         *  \returns index along color scale for each point.
+         */
+        virtual std::vector<double> color_mapping(vtkPoints * points);
     
         /** \brief Compute highlight color from given color.
          * 
@@ -334,8 +346,33 @@ namespace pygraver::render {
             using ret_type = std::vector<std::tuple<vtkSmartPointer<vtkActor>, std::string>>;
             PYBIND11_OVERRIDE(ret_type, Shape3D, get_interactive);
         }
+
+        /** \brief Position to color mapping function for a whole point set.
+         *
+         *  If the Python subclass defines color_mapping(points), it is called once
+         *  with a read-only (N,3) array viewing point coordinates and must return
+         *  N values. Otherwise, this falls back to color_mapping_function for each point.
+         *
+         *  \param points: positions.
+         *  \returns index along color scale for each point.
+         */
+        std::vector<double> color_mapping(vtkPoints * points) override;
    };
 
+    /** \brief Copy path points to a vtkPoints object, in cartesian coordinates.
+     * 
+     *  Coordinates are written straight into the points buffer and the rotation
+     *  by c is applied on the fly, so that no cartesian copy of the path is needed.
+     * 
+     *  \param points: double-precision vtkPoints object, with enough room for n points after offset.
+     *  \param offset: index of first point to write.
+     *  \param path: path to copy points from.
+     *  \param n: number of points to copy.
+     *  \param reverse: if true, points are taken backwards from the end of the path.
+     *  \param start: number of path points skipped before copying.
+     */
+    void copy_points(vtkPoints * points, const size_t offset, const Path & path, const size_t n, const bool reverse=false, const size_t start=0);
+
     /** \fn void py_shape3d_exports(py::module_ & mod)
      *  \brief Export function for Python wrapper.
      *  \param mod: module or submodule to add content to.
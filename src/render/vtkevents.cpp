@@ -41,6 +41,10 @@ namespace pygraver::render {
 
 
     void vtkTimerCallback::Execute(vtkObject*, unsigned long, void*) {
+        // hand over shapes built in the background; build errors stay on the model
+        // until next process_pending or wait_pending call
+        if (this->model->collect_pending() > 0)
+            this->model->get_render_window()->Render();
         this->model->timer_callback();
     }
 
@@ -9,43 +9,67 @@
 #include <vtkCellArray.h>
 #include <vtkPolyData.h>
 #include <vtkTubeFilter.h>
+#include <vtkIdTypeArray.h>
+#include <vtkPointData.h>
 #include <pybind11/stl.h>
 
 #include "../types/point.h"
 
 #include "wire.h"
+#include "picker.h"
 #include "../log.h"
 
 namespace pygraver::render {
 
-    /** \brief Make wire out of Path object.
+    /** \brief Make wire points out of Path object.
      *  \param path: pointer to Path object.
+     *  \returns pointer to vtkPoints object, in cartesian coordinates; first point is repeated if path is closed.
+     */
+    static vtkSmartPointer<vtkPoints> make_wire_points(std::shared_ptr<const Path> path) {
+        auto n = path->size();
+        auto closed = path->is_closed();
+        auto points = vtkSmartPointer<vtkPoints>::New();
+        points->SetDataTypeToDouble();
+        points->SetNumberOfPoints(n + closed);
+        copy_points(points, 0, *path, n);
+        if (closed)
+            copy_points(points, n, *path, 1);
+        return points;
+    }
+
+    /** \brief Make wire out of points.
+     * 
+     *  The index of the source path point is stored for each output point;
+     *  see Picker.
+     * 
+     *  \param points: pointer to vtkPoints object (see make_wire_points).
+     *  \param path_size: number of points in source path.
      *  \param diameter: wire diameter.
      *  \param sides: number of sides (>=4).
      *  \returns pointer to vtkPolyData object.
      */
-    static vtkSmartPointer<vtkPolyData> make_wire(std::shared_ptr<Path> path,
+    static vtkSmartPointer<vtkPolyData> make_wire(vtkSmartPointer<vtkPoints> points,
+                                                  const vtkIdType path_size,
                                                   const double diameter,
                                                   const uint16_t sides) {
-        PYG_LOG_V("Creating wire out of path 0x{:x}", (uint64_t)path.get());
-        auto n = path->size();
-        auto points = vtkSmartPointer<vtkPoints>::New();
+        PYG_LOG_V("Creating wire out of points 0x{:x}", (uint64_t)points.GetPointer());
+        auto n = points->GetNumberOfPoints();
         auto polyline = vtkSmartPointer<vtkPolyLine>::New();
-        points->SetNumberOfPoints(n + path->is_closed());
-        polyline->GetPointIds()->SetNumberOfIds(n + path->is_closed());
-        for (auto i=0; i<n; i++) {
-            points->SetPoint(i, (*path)[i]->x, (*path)[i]->y, (*path)[i]->z);
+        auto point_ids = vtkSmartPointer<vtkIdTypeArray>::New();
+        point_ids->SetName(point_index_array.c_str());
+        point_ids->SetNumberOfTuples(n);
+        polyline->GetPointIds()->SetNumberOfIds(n);
+        for (vtkIdType i=0; i<n; i++) {
             polyline->GetPointIds()->SetId(i,i);
-        }
-        if (path->is_closed()) {
-            points->SetPoint(n, (*path)[0]->x, (*path)[0]->y, (*path)[0]->z);
-            polyline->GetPointIds()->SetId(n,n);
+            // closing point repeats first one
+            point_ids->SetValue(i, i < path_size ? i : 0);
         }
         auto cells = vtkSmartPointer<vtkCellArray>::New();
         cells->InsertNextCell(polyline);
         auto polydata = vtkSmartPointer<vtkPolyData>::New();
         polydata->SetPoints(points);
         polydata->SetLines(cells);
+        polydata->GetPointData()->AddArray(point_ids);
 
         auto tube_filter = vtkSmartPointer<vtkTubeFilter>::New();
         tube_filter->SetInputData(polydata);
@@ -77,20 +101,18 @@ namespace pygraver::render {
         if (path->size() == 0)
             std::invalid_argument("Cannot create wire from empty path.");
         // representation is in cartesian coordinates
-        auto cartesian = path->to_cartesian();
+        auto points = make_wire_points(path);
         // define color range
         double vmin = std::numeric_limits<double>::max();
         double vmax = -std::numeric_limits<double>::max();
-        for (auto point: *cartesian) {
-            double pos[3] = {point->x, point->y, point->z};
-            auto vcur = this->color_mapping_function(pos);
+        for (auto vcur: this->color_mapping(points)) {
             vmin = std::min(vmin, vcur);
             vmax = std::max(vmax, vcur);
         }
         this->set_scalar_color_range(vmin, vmax);
         
         // make actor
-        this->set_item(0, make_wire(cartesian, diameter, sides));
+        this->set_item(0, make_wire(points, path->size(), diameter, sides));
         this->set_base_color(color);
         this->set_highlight_color(Shape3D::make_highlight_color(color));
     }
@@ -142,14 +164,21 @@ namespace pygraver::render {
         PYG_LOG_V("Setting {:d} paths for wire collection 0x{:x}", paths.size(), (uint64_t)this);
         if (paths.size() == 0)
             std::invalid_argument("Cannot create wire collection from empty list.");
+        // points are in cartesian coordinates
+        std::vector<vtkSmartPointer<vtkPoints>> all_points;
+        std::vector<vtkIdType> sizes;
+        all_points.reserve(paths.size());
+        sizes.reserve(paths.size());
+        for (auto const path: paths) {
+            if (path->size() == 0) continue;
+            all_points.emplace_back(make_wire_points(path));
+            sizes.emplace_back(path->size());
+        }
         // define color range
         double vmin = std::numeric_limits<double>::max();
         double vmax = -std::numeric_limits<double>::max();
-        for (auto const path: paths) {
-            auto cartesian = path->to_cartesian();
-            for (auto point: *cartesian) {
-                double pos[3] = {point->x, point->y, point->z};
-                auto vcur = this->color_mapping_function(pos);
+        for (auto points: all_points) {
+            for (auto vcur: this->color_mapping(points)) {
                 vmin = std::min(vmin, vcur);
                 vmax = std::max(vmax, vcur);
             }
@@ -159,11 +188,8 @@ namespace pygraver::render {
         // make actors
         this->actors->RemoveAllItems();
         this->diameter = diameter;
-        size_t idx = 0;
-        for (auto const path: paths) {
-            if (path->size()==0) continue;
-            this->set_path(idx++, path->to_cartesian(), sides);
-        }
+        for (size_t idx=0; idx<all_points.size(); idx++)
+            this->set_item(idx, make_wire(all_points[idx], sizes[idx], this->diameter, sides));
         
         this->set_base_color(color);
         this->set_highlight_color(Shape3D::make_highlight_color(color));
@@ -173,7 +199,7 @@ namespace pygraver::render {
                                   const std::shared_ptr<Path> path,
                                   const unsigned int sides) {
         PYG_LOG_V("Adding path 0x{:x} to wire collection 0x{:x} as index {:d}", (uint64_t)path.get(), (uint64_t)this, idx);
-        this->set_item(idx, make_wire(path, this->diameter, sides));
+        this->set_item(idx, make_wire(make_wire_points(path), path->size(), this->diameter, sides));
         
     }
 
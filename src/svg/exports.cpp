@@ -8,6 +8,7 @@
 #include <pybind11/stl.h>
 
 #include "file.h"
+#include "writer.h"
 #include "arc.h"
 #include "exports.h"
 
@@ -20,7 +21,22 @@ namespace pygraver::svg {
         .def("from_memory", &File::from_memory, py::arg("buffer"))
         .def("get_size", &File::get_size, py::return_value_policy::take_ownership)
         .def("get_paths", &File::get_paths, py::arg("layer"), py::arg("step_size"), py::return_value_policy::take_ownership)
+        .def("get_surfaces", &File::get_surfaces, py::arg("layer"), py::arg("step_size"), py::arg("rule")=types::FillRule::EvenOdd, py::return_value_policy::take_ownership)
         .def("get_points", &File::get_points, py::arg("layer"), py::return_value_policy::take_ownership);
+
+        py::class_<Writer>(mod, "Writer")
+        .def(py::init<const std::string&, const number_t, const number_t, const unsigned int, const bool, const number_t>(),
+             py::arg("file_name"), py::arg("width"), py::arg("height"), py::arg("precision")=3, py::arg("relative")=true, py::arg("fit_tolerance")=0)
+        .def("begin_layer", &Writer::begin_layer, py::arg("name"), py::arg("style")=default_layer_style)
+        .def("end_layer", &Writer::end_layer)
+        .def("write", static_cast<void (Writer::*)(std::shared_ptr<const types::Path>, const std::string &)>(&Writer::write), py::arg("path"), py::arg("style")="")
+        .def("write", static_cast<void (Writer::*)(std::shared_ptr<const types::PathGroup>, const std::string &)>(&Writer::write), py::arg("group"), py::arg("style")="")
+        .def("write", static_cast<void (Writer::*)(std::shared_ptr<const types::Surface>, const std::string &)>(&Writer::write), py::arg("surface"), py::arg("style")=default_surface_style)
+        .def("write", static_cast<void (Writer::*)(const std::vector<std::shared_ptr<types::Path>> &, const std::string &)>(&Writer::write), py::arg("paths"), py::arg("style")="")
+        .def("close", &Writer::close)
+        .def_property_readonly("is_open", &Writer::is_open)
+        .def("__enter__", [](Writer & w) -> Writer & { return w; }, py::return_value_policy::reference)
+        .def("__exit__", [](Writer & w, py::args) { w.close(); });
     
         mod.def("elliptic_e", static_cast<double(*)(const double, const double, const double)>(&elliptic_e<double>));
         mod.def("inv_elliptic_e", &inv_elliptic_e<double>);
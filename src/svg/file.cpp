@@ -7,6 +7,7 @@
 #include <locale>
 #include <clocale>
 #include <libxml/parser.h>
+#include <fmt/core.h>
 
 #include "path.h"
 #include "ellipse.h"
@@ -16,6 +17,28 @@
 #include "../log.h"
 
 namespace pygraver::svg {
+
+	/** \brief Tell if a node has a given attribute.
+	 *  \param node: pointer to XML node.
+	 *  \param name: attribute name.
+	 *  \returns true if attribute exists.
+	 */
+	static bool has_prop(const xmlNodePtr node, const std::string & name) {
+		return xmlHasProp(node, (const xmlChar *)name.c_str()) != nullptr;
+	}
+
+	/** \brief Record elements with an id attribute.
+	 *  \param node: pointer to first XML node to look into.
+	 *  \param ids: map to fill.
+	 */
+	static void collect_ids(xmlNodePtr node, std::unordered_map<std::string, xmlNodePtr> & ids) {
+		for (auto cur = node; cur != nullptr; cur = cur->next) {
+			if (cur->type != XML_ELEMENT_NODE) continue;
+			if (has_prop(cur, "id"))
+				ids.emplace(get_prop(cur, "id"), cur);
+			collect_ids(cur->children, ids);
+		}
+	}
     
     File::File(const std::string & filename) {
       // need this otherwise stod is locale-dependent
@@ -45,6 +68,12 @@ namespace pygraver::svg {
     	    xmlFreeDoc(this->root->doc);
 
         this->root = xmlDocGetRootElement(doc);
+		this->ids.clear();
+		collect_ids(this->root, this->ids);
+		{
+			std::lock_guard<std::recursive_mutex> lock(this->symbols_mutex);
+			this->symbols.clear();
+		}
     	// get drawing centre
     	std::string view_box = get_prop(this->root, "viewBox");
     	std::vector<std::string> split_vec = split_string(view_box, " ");
@@ -94,46 +123,133 @@ namespace pygraver::svg {
 		return std::string();
 	}
 
+	std::unique_ptr<Shape<number_t>> File::get_shape(xmlNodePtr node) const {
+		if ((!xmlStrcmp(node->name, (const xmlChar *)"path"))) {
+			return std::make_unique<Path<number_t>>(get_prop(node, "d"));
+		} else if ((!xmlStrcmp(node->name, (const xmlChar *)"polyline"))) {
+			auto points = "M" + get_prop(node, "points");
+			return std::make_unique<Path<number_t>>(points);
+		} else if ((!xmlStrcmp(node->name, (const xmlChar *)"polygon"))) {
+			auto points = "M" + get_prop(node, "points") + "z";
+			return std::make_unique<Path<number_t>>(points);
+		} else if ((!xmlStrcmp(node->name, (const xmlChar *)"circle"))) {
+			return std::make_unique<Ellipse<number_t>>(node);
+		} else if ((!xmlStrcmp(node->name, (const xmlChar *)"ellipse"))) {
+			return std::make_unique<Ellipse<number_t>>(node);
+		} else if ((!xmlStrcmp(node->name, (const xmlChar *)"rect"))) {
+			return std::make_unique<Rectangle<number_t>>(node);
+		}
+		return nullptr;
+	}
+
     std::vector<std::unique_ptr<Shape<number_t>>> File::get_shapes(xmlNodePtr node) const {
     	std::vector<std::unique_ptr<Shape<number_t>>> shapes;
 		auto base_transform = this->get_transform(node);
     	for (auto cur = node->children; cur != nullptr; cur = cur->next) {
-			std::unique_ptr<Shape<number_t>> new_shape;
-    		if ((!xmlStrcmp(cur->name, (const xmlChar *)"path"))) {
-				new_shape = std::make_unique<Path<number_t>>(get_prop(cur, "d"));
-			} else if ((!xmlStrcmp(cur->name, (const xmlChar *)"polyline"))) {
-				auto points = "M" + get_prop(cur, "points");
-				new_shape = std::make_unique<Path<number_t>>(points);
-			} else if ((!xmlStrcmp(cur->name, (const xmlChar *)"polygon"))) {
-				auto points = "M" + get_prop(cur, "points") + "z";
-				new_shape = std::make_unique<Path<number_t>>(points);
-    		} else if ((!xmlStrcmp(cur->name, (const xmlChar *)"circle"))) {
-    			new_shape = std::make_unique<Ellipse<number_t>>(cur);
-    		} else if ((!xmlStrcmp(cur->name, (const xmlChar *)"ellipse"))) {
-    			new_shape = std::make_unique<Ellipse<number_t>>(cur);
-    		} else if ((!xmlStrcmp(cur->name, (const xmlChar *)"rect"))) {
-    			new_shape = std::make_unique<Rectangle<number_t>>(cur);
-    		} else {
-    			if (cur->children != nullptr) {
-    				auto new_shapes = this->get_shapes(cur);
-    				if (new_shapes.size()>0) {
-    					shapes.reserve(shapes.size() + new_shapes.size());
-						for (auto & shape: new_shapes) {
-							shape->transforms.emplace_back(base_transform);
-							shapes.emplace_back(std::move(shape));
-						}
-    				}
-    			}
-    		}
+			auto new_shape = this->get_shape(cur);
 			if (new_shape != nullptr) {
 				new_shape->transforms.emplace_back(this->get_transform(cur));
 				new_shape->transforms.emplace_back(base_transform);
 				shapes.emplace_back(std::move(new_shape));
-			}
+			} else if ((!xmlStrcmp(cur->name, (const xmlChar *)"use"))) {
+				for (auto & shape: this->get_instances(cur)) {
+					shape->transforms.emplace_back(base_transform);
+					shapes.emplace_back(std::move(shape));
+				}
+			} else if ((!xmlStrcmp(cur->name, (const xmlChar *)"defs")) || (!xmlStrcmp(cur->name, (const xmlChar *)"symbol"))) {
+				// definitions are only drawn when referenced
+				continue;
+    		} else if (cur->children != nullptr) {
+				auto new_shapes = this->get_shapes(cur);
+				if (new_shapes.size()>0) {
+					shapes.reserve(shapes.size() + new_shapes.size());
+					for (auto & shape: new_shapes) {
+						shape->transforms.emplace_back(base_transform);
+						shapes.emplace_back(std::move(shape));
+					}
+				}
+    		}
     	}
     	return shapes;
     }
 
+	std::shared_ptr<const Symbol<number_t>> File::get_symbol(const std::string & id) const {
+		std::lock_guard<std::recursive_mutex> lock(this->symbols_mutex);
+		auto found = this->symbols.find(id);
+		if (found != this->symbols.end()) {
+			if (found->second == nullptr)
+				throw std::runtime_error("Circular reference to element: " + id);
+			return found->second;
+		}
+		auto element = this->ids.find(id);
+		if (element == this->ids.end())
+			throw std::runtime_error("Cannot find referenced element: " + id);
+		PYG_LOG_V("Parsing referenced element {}", id);
+		auto node = element->second;
+		// mark element as being parsed to detect circular references
+		this->symbols[id] = nullptr;
+		std::vector<std::unique_ptr<Shape<number_t>>> shapes;
+		try {
+			auto shape = this->get_shape(node);
+			if (shape != nullptr) {
+				shape->transforms.emplace_back(this->get_transform(node));
+				shapes.emplace_back(std::move(shape));
+			} else if ((!xmlStrcmp(node->name, (const xmlChar *)"use"))) {
+				shapes = this->get_instances(node);
+			} else {
+				shapes = this->get_shapes(node);
+			}
+		} catch (...) {
+			this->symbols.erase(id);
+			throw;
+		}
+		auto symbol = std::make_shared<const Symbol<number_t>>(std::move(shapes));
+		this->symbols[id] = symbol;
+		return symbol;
+	}
+
+	std::vector<std::unique_ptr<Shape<number_t>>> File::get_instances(xmlNodePtr node) const {
+		std::vector<std::unique_ptr<Shape<number_t>>> shapes;
+		// xmlGetProp ignores namespaces: this finds both href and xlink:href
+		if (!has_prop(node, "href"))
+			return shapes;
+		auto href = get_prop(node, "href");
+		if (href.empty() || href[0] != '#')
+			throw std::runtime_error("Only references to elements of same document are supported: " + href);
+		auto id = href.substr(1);
+		auto symbol = this->get_symbol(id);
+		auto element = this->ids.at(id);
+		// instance transforms, from innermost to outermost
+		std::string viewport;
+		number_t x = has_prop(node, "x") ? get_number<number_t>(node, "x") : 0;
+		number_t y = has_prop(node, "y") ? get_number<number_t>(node, "y") : 0;
+		if ((!xmlStrcmp(element->name, (const xmlChar *)"symbol")) && has_prop(element, "viewBox")
+				&& has_prop(node, "width") && has_prop(node, "height")) {
+			// fit symbol view box in viewport (centred, keeping aspect ratio unless told otherwise)
+			auto vb = split_string(get_prop(element, "viewBox"), " ");
+			number_t vx = std::stod(vb.at(0)), vy = std::stod(vb.at(1));
+			number_t vw = std::stod(vb.at(2)), vh = std::stod(vb.at(3));
+			number_t w = get_number<number_t>(node, "width"), h = get_number<number_t>(node, "height");
+			if (vw > 0 && vh > 0) {
+				number_t sx = w/vw, sy = h/vh;
+				auto keep_ratio = !has_prop(element, "preserveAspectRatio") || get_prop(element, "preserveAspectRatio") != "none";
+				if (keep_ratio)
+					sx = sy = std::min(sx, sy);
+				viewport = fmt::format("translate({:.12f},{:.12f}) scale({:.12f},{:.12f}) translate({:.12f},{:.12f})",
+									   (w - vw*sx)/2, (h - vh*sy)/2, sx, sy, -vx, -vy);
+			}
+		}
+		auto position = fmt::format("translate({:.12f},{:.12f})", x, y);
+		auto transform = this->get_transform(node);
+		shapes.reserve(symbol->size());
+		for (size_t i=0; i<symbol->size(); i++) {
+			auto shape = std::make_unique<Use<number_t>>(symbol, i);
+			shape->transforms = {viewport, position, transform};
+			shapes.emplace_back(std::move(shape));
+		}
+		return shapes;
+	}
+
 	std::vector<std::unique_ptr<Shape<number_t>>> File::get_shapes(const std::string & layer_name) const {
 		auto layer = this->get_layer(layer_name);
 		if (layer == nullptr)
@@ -155,6 +271,10 @@ namespace pygraver::svg {
     	return paths;
     }
 
+	std::vector<std::shared_ptr<types::Surface>> File::get_surfaces(const std::string & layer_name, const number_t dl, const types::FillRule rule) const {
+		return types::Surface::from_paths(this->get_paths(layer_name, dl), rule);
+	}
+
     std::vector<std::shared_ptr<types::Point>> File::get_points(const std::string & layer_name) const {
 		this->check_opened();
     	std::vector<std::shared_ptr<types::Point>> points;
@@ -162,9 +282,13 @@ namespace pygraver::svg {
     	if (node != nullptr) {
     		auto shapes = this->get_shapes(node);
     		points.reserve(shapes.size());
-    		for (auto & shp : shapes)
-    			if (shp->get_type() == SVG_SHAPETYPE_ELLIPSE || shp->get_type() == SVG_SHAPETYPE_RECTANGLE)
+    		for (auto & shp : shapes) {
+				auto type = shp->get_type();
+				if (type == SVG_SHAPETYPE_USE)
+					type = static_cast<Use<number_t>&>(*shp).get_base_type();
+    			if (type == SVG_SHAPETYPE_ELLIPSE || type == SVG_SHAPETYPE_RECTANGLE)
     				points.emplace_back(shp->centre() - this->centre);
+			}
     	}
     	return points;
     }
@@ -5,13 +5,18 @@
  *  License: MIT
  */
 #pragma once
+#include <map>
+#include <mutex>
+#include <unordered_map>
 #include <vector>
 #include <string>
 #include <libxml/tree.h>
 
 #include "../types/point.h"
 #include "../types/path.h"
+#include "../types/surface.h"
 #include "shape.h"
+#include "use.h"
 
 /** \brief Number type for SVG parser classes. */
 using number_t = double;
@@ -31,6 +36,15 @@ namespace pygraver::svg {
       /** \brief Drawing centre point. */
       std::shared_ptr<types::Point> centre;
 
+      /** \brief Elements with an id attribute, by id. */
+      std::unordered_map<std::string, xmlNodePtr> ids;
+
+      /** \brief Elements referenced by \<use> elements, parsed on first reference (nullptr while being parsed). */
+      mutable std::map<std::string, std::shared_ptr<const Symbol<number_t>>> symbols;
+
+      /** \brief Lock for referenced elements. */
+      mutable std::recursive_mutex symbols_mutex;
+
       /** \brief Check if a document is opened. */
       void check_opened() const;
 
@@ -55,15 +69,37 @@ namespace pygraver::svg {
        */
       std::string get_transform(xmlNodePtr node) const;
 
+      /** \brief Create shape from a basic shape element (path, polyline, polygon, circle, ellipse or rect).
+       *  \param node: pointer to XML node.
+       *  \returns a shape object, or nullptr if node isn't a basic shape.
+       */
+      std::unique_ptr<Shape<number_t>> get_shape(xmlNodePtr node) const;
+
       /** \brief Get shapes contained in given XML node.
        * 
-       *  This searches for SVG shapes inside the XML node.
+       *  This searches for SVG shapes inside the XML node. Content of
+       *  \<defs> and \<symbol> elements is only drawn through \<use> elements.
        * 
        *  \param node: pointer to XML node.
        *  \returns a collection of shape objects.
        */
       std::vector<std::unique_ptr<Shape<number_t>>> get_shapes(xmlNodePtr node) const;
 
+      /** \brief Get element referenced by \<use> elements.
+       *
+       *  The element is parsed on first reference and shared afterwards.
+       *
+       *  \param id: element id.
+       *  \returns symbol holding element shapes.
+       */
+      std::shared_ptr<const Symbol<number_t>> get_symbol(const std::string & id) const;
+
+      /** \brief Get instances produced by a \<use> element.
+       *  \param node: pointer to \<use> XML node.
+       *  \returns one shape object for each shape of referenced element.
+       */
+      std::vector<std::unique_ptr<Shape<number_t>>> get_instances(xmlNodePtr node) const;
+
     public:
       /** \brief Default constructor. */
       File() = default;
@@ -93,6 +129,18 @@ namespace pygraver::svg {
        */
       std::vector<std::shared_ptr<types::Path>> get_paths(const std::string & layer_name, const number_t dl) const;
 
+      /** \brief Get shapes in given layer and convert them to surfaces.
+       * 
+       *  Nested shapes are sorted into contours and holes using the given fill rule.
+       * 
+       *  \param layer_name: layer name.
+       *  \param dl: interpolation step size.
+       *  \param rule: fill rule.
+       *  \returns a collection of Surface objects.
+       */
+      std::vector<std::shared_ptr<types::Surface>> get_surfaces(const std::string & layer_name, const number_t dl,
+                                                                const types::FillRule rule=types::FillRule::EvenOdd) const;
+
       /** \brief Get shapes contained in given XML node.
        * 
        *  This searches for SVG shapes inside the XML node.
@@ -8,6 +8,7 @@
 #include <vector>
 #include <string>
 #include <regex>
+#include <optional>
 
 #include "../types/point.h"
 #include "../types/path.h"
@@ -60,8 +61,23 @@ namespace pygraver::svg {
          */
     	virtual std::shared_ptr<types::Path> to_path(const T dl) const {
             auto new_points = this->interpolate(dl);
-            auto path = std::make_shared<types::Path>(new_points);
-            // apply transforms
+            return this->apply_transforms(std::make_shared<types::Path>(new_points));
+        }
+
+        /** \brief Apply shape transforms to a path.
+         *  \param path: path to transform.
+         *  \returns transformed path, or given path if shape has no transform.
+         */
+        std::shared_ptr<types::Path> apply_transforms(std::shared_ptr<types::Path> path) const {
+            auto matrix = this->get_matrix();
+            if (matrix) return path->matrix_transform(*matrix);
+            return path;
+        }
+
+        /** \brief Compute transform matrix from transform strings.
+         *  \returns a 4x4 matrix (row-major order), or nothing if shape has no transform.
+         */
+        std::optional<std::vector<double>> get_matrix() const {
             bool has_transforms = false; // use flag to avoid applying transform if none were found
             std::vector<double> matrix{1,0,0,0,0,1,0,0,0,0,1,0,0,0,0,1};
             std::regex transform_regex(R"((?:translate|scale|rotate|skewX|skewY|matrix)\((?:[-0-9, .Ee]+)\))");
@@ -157,8 +173,8 @@ namespace pygraver::svg {
             PYG_LOG_D(" {}  {}  {}  {}", matrix[4], matrix[5], matrix[6], matrix[7]);
             PYG_LOG_D(" {}  {}  {}  {}", matrix[8], matrix[9], matrix[10], matrix[11]);
             PYG_LOG_D(" {}  {}  {}  {}", matrix[12], matrix[13], matrix[14], matrix[15]);
-            if (has_transforms) return path->matrix_transform(matrix);
-            return path;
+            if (has_transforms) return matrix;
+            return std::nullopt;
         }
 
         /** \brief Get shape centre point.
@@ -0,0 +1,159 @@
+/** \file use.h
+ *  \brief Definition of Symbol and Use classes.
+ *
+ *  Author: Vincent Paeder
+ *  License: MIT
+ */
+#pragma once
+#include <map>
+#include <mutex>
+#include <vector>
+
+#include "../types/point.h"
+#include "../types/path.h"
+#include "shape.h"
+#include "../log.h"
+
+/** \brief Flag for SVG shape type: instance of a referenced element. */
+#define SVG_SHAPETYPE_USE 3
+
+namespace pygraver::svg {
+
+    /** \brief Symbol class.
+     *
+     *  This holds the shapes of an element referenced by \<use> elements
+     *  (usually a \<symbol> or an element in \<defs>). Shapes are parsed
+     *  once, and rasterized once for each step size; instances share the
+     *  resulting paths.
+     *
+     *  \tparam T: numeric type.
+     */
+    template <typename T> class Symbol {
+    private:
+        /** \brief Shapes of referenced element. */
+        std::vector<std::unique_ptr<Shape<T>>> shapes;
+
+        /** \brief Rasterized shapes, for each step size. */
+        mutable std::map<T, std::vector<std::shared_ptr<types::Path>>> paths;
+
+        /** \brief Lock for rasterized shapes. */
+        mutable std::mutex mutex;
+
+    public:
+        /** \brief Constructor.
+         *  \param shapes: shapes of referenced element.
+         */
+        Symbol(std::vector<std::unique_ptr<Shape<T>>> shapes): shapes(std::move(shapes)) {}
+
+        /** \brief Get number of shapes.
+         *  \returns number of shapes.
+         */
+        size_t size() const { return this->shapes.size(); }
+
+        /** \brief Give access to a shape.
+         *  \param idx: shape index.
+         *  \returns shape.
+         */
+        Shape<T> & get_shape(const size_t idx) const { return *this->shapes.at(idx); }
+
+        /** \brief Get a rasterized shape; shapes are rasterized on first call for each step size.
+         *  \param idx: shape index.
+         *  \param dl: interpolation step size.
+         *  \returns shared path, which must not be modified.
+         */
+        std::shared_ptr<types::Path> get_path(const size_t idx, const T dl) const {
+            std::lock_guard<std::mutex> lock(this->mutex);
+            auto & paths = this->paths[dl];
+            if (paths.empty()) {
+                PYG_LOG_D("Rasterizing {} symbol shapes with step size {}", this->shapes.size(), dl);
+                paths.reserve(this->shapes.size());
+                for (auto & shape: this->shapes)
+                    paths.emplace_back(shape->to_path(dl));
+            }
+            return paths.at(idx);
+        }
+    };
+
+    /** \brief Use class.
+     *
+     *  This is one instance of one shape of a symbol, produced by a \<use>
+     *  element. It only stores the instance transforms; the rasterized shape
+     *  is shared with other instances.
+     *
+     *  \tparam T: numeric type.
+     */
+    template <typename T> class Use : public Shape<T> {
+    private:
+        /** \brief Referenced symbol. */
+        std::shared_ptr<const Symbol<T>> symbol;
+
+        /** \brief Index of shape in symbol. */
+        size_t index;
+
+    public:
+        /** \brief Tell the type of shape. */
+        const unsigned short get_type() override {
+            return SVG_SHAPETYPE_USE;
+        }
+
+        /** \brief Constructor.
+         *  \param symbol: referenced symbol.
+         *  \param index: index of shape in symbol.
+         */
+        Use(std::shared_ptr<const Symbol<T>> symbol, const size_t index): symbol(symbol), index(index) {
+            if (index >= symbol->size())
+                throw std::out_of_range("Symbol shape index out of range.");
+        }
+
+        /** \brief Tell the type of referenced shape.
+         *  \returns shape type (never SVG_SHAPETYPE_USE: nested instances are followed).
+         */
+        const unsigned short get_base_type() const {
+            auto & shape = this->symbol->get_shape(this->index);
+            if (shape.get_type() == SVG_SHAPETYPE_USE)
+                return static_cast<Use<T>&>(shape).get_base_type();
+            return shape.get_type();
+        }
+
+        /** \brief Generate a Path object from shape.
+         *  \param dl: interpolation step size.
+         *  \returns a path object.
+         */
+        std::shared_ptr<types::Path> to_path(const T dl) const override {
+            auto base = this->symbol->get_path(this->index, dl);
+            auto path = this->apply_transforms(base);
+            // shared path must not be handed out
+            return path == base ? base->copy() : path;
+        }
+
+        /** \brief Interpolate the shape with constant step size.
+         *  \param dl: step size.
+         *  \returns a collection of point coordinate values.
+         */
+        std::vector<std::vector<T>> interpolate(const T dl) const override {
+            auto path = this->to_path(dl);
+            std::vector<std::vector<T>> points;
+            points.reserve(path->size());
+            for (auto pt: *path)
+                points.push_back({pt->x, pt->y, pt->z, pt->c});
+            return points;
+        }
+
+        /** \brief Get shape centre point.
+         *  \returns a Point object containing centre point coordinates, with transforms applied.
+         */
+        std::shared_ptr<types::Point> centre() const override {
+            auto & shape = this->symbol->get_shape(this->index);
+            auto c = shape.centre();
+            // referenced shape transforms come first (nested instances already apply theirs), then instance transforms
+            auto nested = shape.get_type() == SVG_SHAPETYPE_USE;
+            for (auto matrix: {nested ? std::nullopt : shape.get_matrix(), this->get_matrix()}) {
+                if (!matrix) continue;
+                auto & m = *matrix;
+                c = std::make_shared<types::Point>(m[0]*c->x + m[1]*c->y + m[3], m[4]*c->x + m[5]*c->y + m[7]);
+            }
+            return c;
+        }
+    };
+
+}
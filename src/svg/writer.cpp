@@ -0,0 +1,422 @@
+/** \file writer.cpp
+ *  \brief Implementation file for Writer class.
+ *
+ *  Author: Vincent Paeder
+ *  License: MIT
+ */
+#include <algorithm>
+#include <charconv>
+#include <cctype>
+#include <cmath>
+
+#include "writer.h"
+#include "util.h"
+#include "../log.h"
+
+namespace pygraver::svg {
+
+    /** \brief Size of the path data buffer above which it gets written to file. */
+    static const size_t max_buffer_size = 1 << 20;
+
+    /** \brief Maximum number of points replaced by a single fitted line or arc. */
+    static const size_t max_fit_run = 64;
+
+    /** \brief Shorthand for 2D point coordinates. */
+    using point2_t = std::array<number_t, 2>;
+
+    /** \brief Append a fixed-point number to a string.
+     *
+     *  Trailing zeros and the leading zero of numbers smaller than 1 are omitted.
+     *
+     *  \param out: string to append to.
+     *  \param value: value in units of 10^-precision.
+     *  \param precision: number of decimals.
+     */
+    static void append_fixed(std::string & out, const int64_t value, const unsigned int precision) {
+        if (value == 0) {
+            out.push_back('0');
+            return;
+        }
+        char digits[24];
+        auto res = std::to_chars(digits, digits + sizeof(digits), value < 0 ? -value : value);
+        std::string_view str(digits, res.ptr - digits);
+        if (value < 0)
+            out.push_back('-');
+        std::string_view frac;
+        size_t leading_zeros = 0;
+        if (str.size() <= precision) {
+            leading_zeros = precision - str.size();
+            frac = str;
+        } else {
+            out.append(str.substr(0, str.size() - precision));
+            frac = str.substr(str.size() - precision);
+        }
+        while (!frac.empty() && frac.back() == '0')
+            frac.remove_suffix(1);
+        if (!frac.empty()) {
+            out.push_back('.');
+            out.append(leading_zeros, '0');
+            out.append(frac);
+        }
+    }
+
+    /** \brief Escape special characters in an XML attribute value.
+     *  \param str: attribute value.
+     *  \returns escaped string.
+     */
+    static std::string escape_attribute(const std::string & str) {
+        std::string escaped;
+        escaped.reserve(str.size());
+        for (auto c: str) {
+            switch (c) {
+                case '&': escaped.append("&amp;"); break;
+                case '<': escaped.append("&lt;"); break;
+                case '>': escaped.append("&gt;"); break;
+                case '"': escaped.append("&quot;"); break;
+                default: escaped.push_back(c);
+            }
+        }
+        return escaped;
+    }
+
+    /** \brief Compute distance between a point and a segment.
+     *  \param p: point.
+     *  \param a: segment start.
+     *  \param b: segment end.
+     *  \returns distance.
+     */
+    static number_t segment_distance(const point2_t & p, const point2_t & a, const point2_t & b) {
+        auto dx = b[0] - a[0];
+        auto dy = b[1] - a[1];
+        auto l2 = dx*dx + dy*dy;
+        auto t = l2 > 0 ? std::clamp(((p[0] - a[0])*dx + (p[1] - a[1])*dy)/l2, 0.0, 1.0) : 0.0;
+        return std::hypot(p[0] - a[0] - t*dx, p[1] - a[1] - t*dy);
+    }
+
+    /** \brief Find the farthest point that can be reached with a straight line.
+     *  \param pts: points.
+     *  \param start: index of line start point.
+     *  \param tolerance: maximum distance between skipped points and line.
+     *  \returns index of line end point.
+     */
+    static size_t fit_line(const std::vector<point2_t> & pts, const size_t start, const number_t tolerance) {
+        auto end = start + 1;
+        auto max_end = std::min(pts.size() - 1, start + max_fit_run);
+        while (end < max_end) {
+            auto candidate = end + 1;
+            for (auto k = start + 1; k < candidate; k++)
+                if (segment_distance(pts[k], pts[start], pts[candidate]) > tolerance)
+                    return end;
+            end = candidate;
+        }
+        return end;
+    }
+
+    /** \brief Result of arc fitting. */
+    struct ArcFit {
+        /** \brief Index of arc end point (equal to start if no arc was found). */
+        size_t end;
+        /** \brief Arc radius. */
+        number_t radius;
+        /** \brief True if arc spans more than 180°. */
+        bool large_arc;
+        /** \brief True if arc is drawn in the direction of positive angles. */
+        bool sweep;
+    };
+
+    /** \brief Find the farthest point that can be reached with a circular arc.
+     *  \param pts: points.
+     *  \param start: index of arc start point.
+     *  \param tolerance: maximum distance between skipped points and arc.
+     *  \returns fitted arc; its end index equals start if no arc could be fitted.
+     */
+    static ArcFit fit_arc(const std::vector<point2_t> & pts, const size_t start, const number_t tolerance) {
+        ArcFit best{start, 0, false, false};
+        auto max_end = std::min(pts.size() - 1, start + max_fit_run);
+        for (auto end = start + 2; end <= max_end; end++) {
+            // circle through start, middle and end points (relative to start point)
+            auto & a = pts[start];
+            auto & m = pts[(start + end)/2];
+            auto bx = m[0] - a[0], by = m[1] - a[1];
+            auto cx = pts[end][0] - a[0], cy = pts[end][1] - a[1];
+            auto d = 2*(bx*cy - by*cx);
+            auto b2 = bx*bx + by*by;
+            auto c2 = cx*cx + cy*cy;
+            if (std::abs(d) <= std::numeric_limits<number_t>::epsilon()*(b2 + c2))
+                break; // collinear points
+            point2_t centre = {a[0] + (cy*b2 - by*c2)/d, a[1] + (bx*c2 - cx*b2)/d};
+            auto radius = std::hypot(a[0] - centre[0], a[1] - centre[1]);
+            // all points must lie on circle and turn in the same direction
+            number_t swept = 0;
+            int direction = 0;
+            bool fits = true;
+            for (auto k = start; k < end && fits; k++) {
+                if (k > start && std::abs(std::hypot(pts[k][0] - centre[0], pts[k][1] - centre[1]) - radius) > tolerance)
+                    fits = false;
+                auto ux = pts[k][0] - centre[0], uy = pts[k][1] - centre[1];
+                auto vx = pts[k+1][0] - centre[0], vy = pts[k+1][1] - centre[1];
+                auto da = std::atan2(ux*vy - uy*vx, ux*vx + uy*vy);
+                auto sign = da > 0 ? 1 : -1;
+                if (direction == 0)
+                    direction = sign;
+                else if (sign != direction)
+                    fits = false;
+                swept += std::abs(da);
+            }
+            if (!fits || swept >= M_2PI)
+                break;
+            best = {end, radius, swept > M_PI, direction > 0};
+        }
+        return best;
+    }
+
+    Writer::Writer(const std::string & file_name,
+                   const number_t width,
+                   const number_t height,
+                   const unsigned int precision,
+                   const bool relative,
+                   const number_t fit_tolerance) {
+        PYG_LOG_V("Creating SVG Writer object 0x{:x} for file {}", (uint64_t)this, file_name);
+        if (width <= 0 || height <= 0)
+            throw std::invalid_argument("Drawing size must be positive.");
+        if (precision > 9)
+            throw std::invalid_argument("Precision must be at most 9 decimals.");
+        this->width = width;
+        this->height = height;
+        this->precision = precision;
+        this->quantum = std::pow(10.0, precision);
+        this->relative = relative;
+        this->fit_tolerance = fit_tolerance;
+
+        this->stream_buffer.resize(max_buffer_size);
+        this->stream.rdbuf()->pubsetbuf(this->stream_buffer.data(), this->stream_buffer.size());
+        this->stream.open(file_name, std::ios::out | std::ios::trunc | std::ios::binary);
+        if (!this->stream.is_open())
+            throw std::runtime_error("Couldn't open file " + file_name);
+        this->buffer.reserve(max_buffer_size + 256);
+
+        // header; view box starts at 0 so that File reads the drawing centre back as origin
+        std::string size;
+        append_fixed(size, std::llround(width*this->quantum), precision);
+        size.push_back(' ');
+        append_fixed(size, std::llround(height*this->quantum), precision);
+        auto space = size.find(' ');
+        this->stream << "<?xml version=\"1.0\" encoding=\"UTF-8\" standalone=\"no\"?>\n"
+                     << "<svg xmlns=\"http://www.w3.org/2000/svg\""
+                     << " xmlns:inkscape=\"http://www.inkscape.org/namespaces/inkscape\" version=\"1.1\""
+                     << " width=\"" << size.substr(0, space) << "\" height=\"" << size.substr(space+1) << "\""
+                     << " viewBox=\"0 0 " << size << "\">\n";
+    }
+
+    Writer::~Writer() {
+        PYG_LOG_V("Deleting SVG Writer object 0x{:x}", (uint64_t)this);
+        if (this->stream.is_open())
+            this->close();
+    }
+
+    void Writer::check_opened() const {
+        if (!this->stream.is_open())
+            throw std::runtime_error("SVG file is closed.");
+    }
+
+    bool Writer::is_open() const {
+        return this->stream.is_open();
+    }
+
+    void Writer::flush_buffer(const bool force) {
+        if (force || this->buffer.size() >= max_buffer_size) {
+            this->stream.write(this->buffer.data(), this->buffer.size());
+            this->buffer.clear();
+        }
+    }
+
+    void Writer::append_number(const int64_t value) {
+        if (!this->buffer.empty()) {
+            auto last = this->buffer.back();
+            // File parser doesn't accept signs as separators
+            if (std::isdigit(last) || last == '.')
+                this->buffer.push_back(' ');
+        }
+        append_fixed(this->buffer, value, this->precision);
+    }
+
+    void Writer::append_point(const char command, const number_t x, const number_t y, const std::vector<int64_t> & arc_args) {
+        std::array<int64_t, 2> target = {
+            std::llround((x + this->width/2)*this->quantum),
+            std::llround((y + this->height/2)*this->quantum)
+        };
+        // skip zero-length segments
+        if (command != 'M' && target == this->current)
+            return;
+        auto dx = target[0] - this->current[0];
+        auto dy = target[1] - this->current[1];
+        auto end_x = this->relative ? dx : target[0];
+        auto end_y = this->relative ? dy : target[1];
+
+        auto cmd = command;
+        if (command == 'L' && dy == 0)
+            cmd = 'H';
+        else if (command == 'L' && dx == 0)
+            cmd = 'V';
+        auto letter = this->relative ? (char)std::tolower(cmd) : cmd;
+        if (letter != this->implied_command)
+            this->buffer.push_back(letter);
+
+        switch (cmd) {
+            case 'H':
+                this->append_number(end_x);
+                break;
+            case 'V':
+                this->append_number(end_y);
+                break;
+            case 'A':
+                // radii, rotation and flags; rotation and flags aren't scaled
+                this->append_number(arc_args[0]);
+                this->append_number(arc_args[0]);
+                this->buffer.append(" 0 ");
+                this->buffer.push_back(arc_args[1] ? '1' : '0');
+                this->buffer.push_back(' ');
+                this->buffer.push_back(arc_args[2] ? '1' : '0');
+                this->append_number(end_x);
+                this->append_number(end_y);
+                break;
+            default:
+                this->append_number(end_x);
+                this->append_number(end_y);
+        }
+
+        if (command == 'M') {
+            this->subpath_start = target;
+            // further coordinates are implicitly treated as lines
+            this->implied_command = this->relative ? 'l' : 'L';
+        } else {
+            this->implied_command = letter;
+        }
+        this->current = target;
+        this->flush_buffer();
+    }
+
+    void Writer::append_path_data(const types::Path & path, const bool force_close) {
+        auto n = path.size();
+        if (n == 0)
+            return;
+        auto closed = path.is_closed();
+        // closing point is replaced by a close command, unless fitting may use it
+        auto count = (closed && this->fit_tolerance <= 0) ? n-1 : n;
+
+        // cartesian coordinates
+        std::vector<point2_t> pts;
+        pts.reserve(count);
+        number_t c = 0, cos_c = 1, sin_c = 0;
+        for (auto it = path.begin(); it != path.begin() + count; ++it) {
+            auto & pt = *it;
+            if (pt->c != c) {
+                c = pt->c;
+                cos_c = std::cos(c/180*M_PI);
+                sin_c = std::sin(c/180*M_PI);
+            }
+            pts.push_back({pt->x*cos_c - pt->y*sin_c, pt->x*sin_c + pt->y*cos_c});
+        }
+
+        this->append_point('M', pts[0][0], pts[0][1]);
+        if (this->fit_tolerance <= 0) {
+            for (size_t i=1; i<count; i++)
+                this->append_point('L', pts[i][0], pts[i][1]);
+        } else {
+            size_t i = 0;
+            while (i < count-1) {
+                auto line_end = fit_line(pts, i, this->fit_tolerance);
+                auto arc = fit_arc(pts, i, this->fit_tolerance);
+                auto radius = std::llround(arc.radius*this->quantum);
+                if (arc.end > line_end && radius > 0) {
+                    this->append_point('A', pts[arc.end][0], pts[arc.end][1], {radius, arc.large_arc, arc.sweep});
+                    i = arc.end;
+                } else {
+                    this->append_point('L', pts[line_end][0], pts[line_end][1]);
+                    i = line_end;
+                }
+            }
+        }
+
+        if (closed || force_close) {
+            this->buffer.push_back(this->relative ? 'z' : 'Z');
+            this->current = this->subpath_start;
+            this->implied_command = 0;
+        }
+    }
+
+    template <typename F> void Writer::write_element(const std::string & style, F data) {
+        this->check_opened();
+        this->stream << "<path";
+        if (!style.empty())
+            this->stream << " style=\"" << escape_attribute(style) << "\"";
+        this->stream << " d=\"";
+        // first move command of an element is absolute even in relative form
+        this->current = {0, 0};
+        this->subpath_start = {0, 0};
+        this->implied_command = 0;
+        data();
+        this->flush_buffer(true);
+        this->stream << "\"/>\n";
+    }
+
+    void Writer::begin_layer(const std::string & name, const std::string & style) {
+        PYG_LOG_V("Opening layer {} in SVG Writer object 0x{:x}", name, (uint64_t)this);
+        this->check_opened();
+        auto escaped = escape_attribute(name);
+        this->stream << "<g id=\"" << escaped << "\" inkscape:label=\"" << escaped << "\" inkscape:groupmode=\"layer\"";
+        if (!style.empty())
+            this->stream << " style=\"" << escape_attribute(style) << "\"";
+        this->stream << ">\n";
+        this->open_layers++;
+    }
+
+    void Writer::end_layer() {
+        PYG_LOG_V("Closing layer in SVG Writer object 0x{:x}", (uint64_t)this);
+        this->check_opened();
+        if (this->open_layers == 0)
+            throw std::runtime_error("No layer to close.");
+        this->stream << "</g>\n";
+        this->open_layers--;
+    }
+
+    void Writer::write(std::shared_ptr<const types::Path> path, const std::string & style) {
+        PYG_LOG_V("Writing path 0x{:x} with SVG Writer object 0x{:x}", (uint64_t)path.get(), (uint64_t)this);
+        if (path->size() == 0)
+            return;
+        this->write_element(style, [&]() { this->append_path_data(*path); });
+    }
+
+    void Writer::write(const std::vector<std::shared_ptr<types::Path>> & paths, const std::string & style) {
+        PYG_LOG_V("Writing {:d} paths with SVG Writer object 0x{:x}", paths.size(), (uint64_t)this);
+        for (auto & path: paths)
+            this->write(path, style);
+    }
+
+    void Writer::write(std::shared_ptr<const types::PathGroup> group, const std::string & style) {
+        PYG_LOG_V("Writing path group 0x{:x} with SVG Writer object 0x{:x}", (uint64_t)group.get(), (uint64_t)this);
+        this->write(group->get_paths(), style);
+    }
+
+    void Writer::write(std::shared_ptr<const types::Surface> surface, const std::string & style) {
+        PYG_LOG_V("Writing surface 0x{:x} with SVG Writer object 0x{:x}", (uint64_t)surface.get(), (uint64_t)this);
+        if (surface->get_contours().size() == 0)
+            return;
+        this->write_element(style, [&]() {
+            for (auto & contour: surface->get_contours())
+                this->append_path_data(*contour, true);
+            for (auto & hole: surface->get_holes())
+                this->append_path_data(*hole, true);
+        });
+    }
+
+    void Writer::close() {
+        PYG_LOG_V("Closing SVG Writer object 0x{:x}", (uint64_t)this);
+        if (!this->stream.is_open())
+            return;
+        while (this->open_layers > 0)
+            this->end_layer();
+        this->stream << "</svg>\n";
+        this->stream.close();
+    }
+}
@@ -0,0 +1,173 @@
+/** \file writer.h
+ *  \brief Header file for Writer class.
+ *
+ *  Author: Vincent Paeder
+ *  License: MIT
+ */
+#pragma once
+#include <vector>
+#include <string>
+#include <fstream>
+#include <array>
+
+#include "../types/point.h"
+#include "../types/path.h"
+#include "../types/pathgroup.h"
+#include "../types/surface.h"
+#include "file.h"
+
+namespace pygraver::svg {
+
+    /** \brief Default style for layers (stroked paths). */
+    const std::string default_layer_style = "fill:none;stroke:#000000;stroke-width:0.1";
+
+    /** \brief Default style for surfaces (filled areas, holes use even-odd rule). */
+    const std::string default_surface_style = "fill:#000000;fill-rule:evenodd;stroke:none";
+
+    /** \brief SVG file writer class.
+     *
+     *  This writes Path, PathGroup and Surface objects to an SVG file.
+     *  Path data is streamed to disk as it is generated, so that very large
+     *  drawings don't need to be held in memory. Coordinates are rounded to
+     *  the requested number of decimals and relative commands are used to keep
+     *  files small. Optionally, runs of points can be replaced by lines and
+     *  circular arcs within a given tolerance.
+     *
+     *  Coordinates are written so that File::get_paths reads them back
+     *  unchanged, i.e. the drawing origin lies at the centre of the view box.
+     */
+    class Writer {
+    private:
+        /** \brief Output file stream. */
+        std::ofstream stream;
+
+        /** \brief Buffer used by output file stream. */
+        std::vector<char> stream_buffer;
+
+        /** \brief Path data buffer for the element being written. */
+        std::string buffer;
+
+        /** \brief Drawing width. */
+        number_t width;
+
+        /** \brief Drawing height. */
+        number_t height;
+
+        /** \brief Number of decimals for coordinates. */
+        unsigned int precision;
+
+        /** \brief Scaling factor used to round coordinates (10^precision). */
+        number_t quantum;
+
+        /** \brief If true, use relative path commands. */
+        bool relative;
+
+        /** \brief Tolerance for line and arc fitting (0 to disable fitting). */
+        number_t fit_tolerance;
+
+        /** \brief Number of currently opened layers. */
+        unsigned int open_layers = 0;
+
+        /** \brief Current pen position, in rounded units. */
+        std::array<int64_t, 2> current = {0, 0};
+
+        /** \brief Start of current sub-path, in rounded units. */
+        std::array<int64_t, 2> subpath_start = {0, 0};
+
+        /** \brief Command implied by previous one; used to omit repeated command letters. */
+        char implied_command = 0;
+
+        /** \brief Throw if the file is not opened. */
+        void check_opened() const;
+
+        /** \brief Write path data buffer to file if it grew beyond a threshold.
+         *  \param force: if true, write buffer regardless of its size.
+         */
+        void flush_buffer(const bool force=false);
+
+        /** \brief Append a rounded number to the path data buffer.
+         *  \param value: value in rounded units.
+         */
+        void append_number(const int64_t value);
+
+        /** \brief Append a move, line or arc to given point.
+         *  \param command: 'M', 'L' or 'A'.
+         *  \param x: x coordinate of end point.
+         *  \param y: y coordinate of end point.
+         *  \param arc_args: radius (in rounded units), large arc flag and sweep flag, for arcs.
+         */
+        void append_point(const char command, const number_t x, const number_t y, const std::vector<int64_t> & arc_args = {});
+
+        /** \brief Append path data for a Path object.
+         *  \param path: path to append.
+         *  \param force_close: if true, close sub-path even if path isn't closed.
+         */
+        void append_path_data(const types::Path & path, const bool force_close=false);
+
+        /** \brief Write a \<path> element from the path data buffer.
+         *  \param style: style attribute; omitted if empty.
+         *  \param data: function filling the path data buffer.
+         */
+        template <typename F> void write_element(const std::string & style, F data);
+
+    public:
+        /** \brief Constructor.
+         *  \param file_name: name of file to write to.
+         *  \param width: drawing width.
+         *  \param height: drawing height.
+         *  \param precision: number of decimals for coordinates.
+         *  \param relative: if true, use relative path commands.
+         *  \param fit_tolerance: if >0, replace runs of points with lines and circular arcs within this tolerance.
+         */
+        Writer(const std::string & file_name,
+               const number_t width,
+               const number_t height,
+               const unsigned int precision=3,
+               const bool relative=true,
+               const number_t fit_tolerance=0);
+
+        /** \brief Destructor. Closes the file if necessary. */
+        ~Writer();
+
+        /** \brief Open a new layer (\<g> element).
+         *  \param name: layer name.
+         *  \param style: style applied to layer content.
+         */
+        void begin_layer(const std::string & name, const std::string & style=default_layer_style);
+
+        /** \brief Close the current layer. */
+        void end_layer();
+
+        /** \brief Write a path.
+         *  \param path: path to write.
+         *  \param style: style attribute; if empty, the layer style applies.
+         */
+        void write(std::shared_ptr<const types::Path> path, const std::string & style="");
+
+        /** \brief Write a collection of paths; each path becomes a \<path> element.
+         *  \param paths: paths to write.
+         *  \param style: style attribute; if empty, the layer style applies.
+         */
+        void write(const std::vector<std::shared_ptr<types::Path>> & paths, const std::string & style="");
+
+        /** \brief Write a path group; each path becomes a \<path> element.
+         *  \param group: path group to write.
+         *  \param style: style attribute; if empty, the layer style applies.
+         */
+        void write(std::shared_ptr<const types::PathGroup> group, const std::string & style="");
+
+        /** \brief Write a surface as a single \<path> element containing contours and holes.
+         *  \param surface: surface to write.
+         *  \param style: style attribute.
+         */
+        void write(std::shared_ptr<const types::Surface> surface, const std::string & style=default_surface_style);
+
+        /** \brief Close all layers and the file. */
+        void close();
+
+        /** \brief Tell if file is opened.
+         *  \returns true if file is opened.
+         */
+        bool is_open() const;
+    };
+}
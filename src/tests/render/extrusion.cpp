@@ -4,6 +4,7 @@
 #include "types/path.h"
 #include "types/point.h"
 
+#include <vtkMapper.h>
 #include <gtest/gtest.h>
 
 using namespace pygraver;
@@ -50,7 +51,7 @@ TEST(ExtrusionTest, ExtrudePolyData) {
     path->emplace_back(std::make_shared<Point>(0, 1, 0, 0));
     path->emplace_back(std::make_shared<Point>(0, 0, 0, 0));
     auto polydata = make_polydata(path);
-    auto extrusion = extrude(polydata, std::make_shared<Point>(0,0,1,0), std::make_shared<Point>(0,0,0,0), 1);
+    auto extrusion = extrude(polydata, std::make_shared<Point>(0,0,1,0), 1);
     auto points = extrusion->GetPoints();
     EXPECT_EQ(points->GetNumberOfPoints(), 10);
     auto polys = extrusion->GetPolys();
@@ -58,9 +59,75 @@ TEST(ExtrusionTest, ExtrudePolyData) {
     // alternative way
     auto surface = std::make_shared<Surface>(path);
     polydata = make_polydata(surface);
-    extrusion = extrude(polydata, std::make_shared<Point>(0,0,1,0), std::make_shared<Point>(0,0,0,0), 1);
+    extrusion = extrude(polydata, std::make_shared<Point>(0,0,1,0), 1);
     points = extrusion->GetPoints();
     EXPECT_EQ(points->GetNumberOfPoints(), 8);
     polys = extrusion->GetPolys();
     EXPECT_EQ(polys->GetNumberOfCells(), 4);
+    // side walls: one closed strip around the square
+    auto strips = extrusion->GetStrips();
+    ASSERT_EQ(strips->GetNumberOfCells(), 1);
+    const vtkIdType *pts;
+    vtkIdType npts;
+    strips->InitTraversal();
+    strips->GetNextCell(npts, pts);
+    EXPECT_EQ(npts, 10);
+    double bounds[6];
+    extrusion->GetBounds(bounds);
+    EXPECT_DOUBLE_EQ(bounds[4], 0);
+    EXPECT_DOUBLE_EQ(bounds[5], 1);
+    // a hole makes its own strip
+    auto hole = path->buffer(-0.2);
+    auto surface_with_hole = std::make_shared<Surface>(path, std::vector<std::shared_ptr<Path>>{hole});
+    extrusion = extrude(make_polydata(surface_with_hole), std::make_shared<Point>(0,0,1,0), -2);
+    EXPECT_EQ(extrusion->GetStrips()->GetNumberOfCells(), 2);
+    EXPECT_EQ(extrusion->GetPolys()->GetNumberOfCells(), 16);
+    extrusion->GetBounds(bounds);
+    EXPECT_DOUBLE_EQ(bounds[4], -2);
+    EXPECT_DOUBLE_EQ(bounds[5], 0);
+}
+
+// exposes cached triangulation
+class CachedExtrusion : public Extrusion {
+public:
+    using Extrusion::caps;
+};
+
+TEST(ExtrusionTest, Cache) {
+    auto path = std::make_shared<Path>(0);
+    path->emplace_back(std::make_shared<Point>(0, 0, 0, 0));
+    path->emplace_back(std::make_shared<Point>(1, 0, 0, 0));
+    path->emplace_back(std::make_shared<Point>(1, 1, 0, 0));
+    path->emplace_back(std::make_shared<Point>(0, 1, 0, 0));
+    path->emplace_back(std::make_shared<Point>(0, 0, 0, 0));
+    auto surface = std::make_shared<Surface>(std::vector<std::shared_ptr<Path>>{path, path->shift(std::make_shared<Point>(2, 0, 0, 0))});
+    CachedExtrusion extrusion;
+    EXPECT_THROW(extrusion.set_extrusion(1, std::make_shared<Point>(0,0,1,0), {255,255,255}), std::out_of_range);
+    extrusion.set_shape(surface, 1, std::make_shared<Point>(0,0,1,0), {255,255,255});
+    ASSERT_EQ(extrusion.caps.size(), 2);
+    auto cap = extrusion.caps[0];
+    // same geometry: triangulation is reused
+    extrusion.set_shape(std::make_shared<Surface>(surface->get_contours()), 2, std::make_shared<Point>(0,0,1,0), {255,0,0});
+    EXPECT_EQ(extrusion.caps[0], cap);
+    extrusion.set_extrusion(3, std::make_shared<Point>(0,0,1,0), {255,0,0});
+    EXPECT_EQ(extrusion.caps[0], cap);
+    // both sub-surfaces are extruded
+    auto actor = static_cast<vtkActor*>(extrusion.get_actors()->GetItemAsObject(0));
+    double bounds[6];
+    actor->GetMapper()->GetInput()->GetBounds(bounds);
+    EXPECT_DOUBLE_EQ(bounds[0], 0);
+    EXPECT_DOUBLE_EQ(bounds[1], 3);
+    EXPECT_DOUBLE_EQ(bounds[5], 3);
+    // same number of points, one of them moved: triangulation is computed again
+    auto moved = path->copy();
+    (*moved)[2]->x = 1.5;
+    extrusion.set_shape(std::make_shared<Surface>(std::vector<std::shared_ptr<Path>>{moved, path->shift(std::make_shared<Point>(2, 0, 0, 0))}),
+                        1, std::make_shared<Point>(0,0,1,0), {255,0,0});
+    EXPECT_NE(extrusion.caps[0], cap);
+    cap = extrusion.caps[0];
+    // new geometry: triangulation is computed again
+    extrusion.set_shape(std::make_shared<Surface>(path), 1, std::make_shared<Point>(0,0,1,0), {255,0,0});
+    ASSERT_EQ(extrusion.caps.size(), 1);
+    EXPECT_NE(extrusion.caps[0], cap);
+    EXPECT_THROW(extrusion.set_extrusion(1, std::make_shared<Point>(0,0,0,0), {255,0,0}), std::invalid_argument);
 }
@@ -0,0 +1,83 @@
+#include "render/picker.h"
+#include "render/wire.h"
+
+#include "types/point.h"
+#include "types/path.h"
+
+#include <gtest/gtest.h>
+
+using namespace pygraver;
+using namespace pygraver::render;
+using namespace pygraver::types;
+using namespace testing;
+
+static std::shared_ptr<WireCollection> make_wires(const size_t n) {
+    std::vector<std::shared_ptr<Path>> paths;
+    for (size_t i=0; i<n; i++) {
+        auto path = std::make_shared<Path>(0);
+        for (auto j=0; j<4; j++)
+            path->emplace_back(std::make_shared<Point>(j, 2.0*i, 0, 0));
+        paths.emplace_back(path);
+    }
+    return std::make_shared<WireCollection>(paths, 0.5, std::vector<uint8_t>{0,0,0});
+}
+
+TEST(PickerTest, Base) {
+    auto wires = make_wires(20);
+    auto picker = Picker();
+    picker.add_shape(wires);
+    double p1[3] = {1, 14, 10};
+    double p2[3] = {1, 14, -10};
+    auto result = picker.pick(p1, p2);
+    ASSERT_TRUE(result.has_value());
+    EXPECT_EQ(result->shape, wires);
+    EXPECT_EQ(result->path_index, 7);
+    EXPECT_EQ(result->point_index, 1);
+    EXPECT_NEAR(result->position[2], 0.25, 0.1);
+    // between wires
+    p1[1] = p2[1] = 15;
+    EXPECT_FALSE(picker.pick(p1, p2).has_value());
+    // segment stopping before wires
+    p1[1] = p2[1] = 14;
+    p2[2] = 1;
+    EXPECT_FALSE(picker.pick(p1, p2).has_value());
+    // removed shape
+    p2[2] = -10;
+    picker.remove_shape(wires);
+    EXPECT_FALSE(picker.pick(p1, p2).has_value());
+}
+
+TEST(PickerTest, ModifiedShape) {
+    auto wires = make_wires(3);
+    auto picker = Picker();
+    picker.add_shape(wires);
+    double p1[3] = {1, 10, 10};
+    double p2[3] = {1, 10, -10};
+    EXPECT_FALSE(picker.pick(p1, p2).has_value());
+    // replaced actor data is found without invalidating index
+    auto path = std::make_shared<Path>(0);
+    for (auto j=0; j<4; j++)
+        path->emplace_back(std::make_shared<Point>(j, 10, 0, 0));
+    wires->set_path(1, path);
+    auto result = picker.pick(p1, p2);
+    ASSERT_TRUE(result.has_value());
+    EXPECT_EQ(result->path_index, 1);
+    // same for added actor
+    path = std::make_shared<Path>(0);
+    for (auto j=0; j<4; j++)
+        path->emplace_back(std::make_shared<Point>(j, 20, 0, 0));
+    wires->set_path(3, path);
+    p1[1] = p2[1] = 20;
+    result = picker.pick(p1, p2);
+    ASSERT_TRUE(result.has_value());
+    EXPECT_EQ(result->path_index, 3);
+    // moved actor is found too
+    auto actor = static_cast<vtkActor*>(wires->get_actors()->GetItemAsObject(2));
+    actor->SetPosition(0, 26, 0);
+    p1[1] = p2[1] = 30;
+    result = picker.pick(p1, p2);
+    ASSERT_TRUE(result.has_value());
+    EXPECT_EQ(result->path_index, 2);
+    p1[1] = p2[1] = 4;
+    EXPECT_FALSE(picker.pick(p1, p2).has_value());
+}
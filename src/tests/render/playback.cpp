@@ -0,0 +1,94 @@
+#include "render/playback.h"
+
+#include "types/point.h"
+#include "types/path.h"
+
+#include <gtest/gtest.h>
+#include <vtkMapper.h>
+#include <vtkPolyData.h>
+
+using namespace pygraver;
+using namespace pygraver::render;
+using namespace pygraver::types;
+using namespace testing;
+
+// path index and point index within path
+using Location = std::tuple<size_t, size_t>;
+
+// straight path along x at given y, with n points 1 apart
+static std::shared_ptr<Path> make_line(const double y, const size_t n) {
+    auto path = std::make_shared<Path>(0);
+    for (size_t i=0; i<n; i++)
+        path->emplace_back(std::make_shared<Point>(i, y, 0, 0));
+    return path;
+}
+
+// number of cells drawn by given actor
+static vtkIdType drawn_cells(vtkSmartPointer<vtkActorCollection> actors, const size_t idx) {
+    auto actor = static_cast<vtkActor*>(actors->GetItemAsObject(idx));
+    return static_cast<vtkPolyData*>(actor->GetMapper()->GetInput())->GetNumberOfLines();
+}
+
+TEST(PlaybackTest, Progress) {
+    std::vector<std::shared_ptr<Path>> paths = {make_line(0, 10), make_line(1, 0), make_line(2, 5)};
+    auto playback = Playback(paths, std::vector<uint8_t>{0,0,0}, 0.5, 2, 1, 4);
+    EXPECT_EQ(playback.get_point_count(), 15);
+    // 14 segments, including move between paths
+    EXPECT_EQ(playback.get_chunk_count(), 4);
+    auto actors = playback.get_actors();
+    EXPECT_EQ(actors->GetNumberOfItems(), 5);
+    EXPECT_EQ(playback.get_tool_actor(), static_cast<vtkActor*>(actors->GetItemAsObject(4)));
+    for (size_t k=0; k<4; k++)
+        EXPECT_EQ(drawn_cells(actors, k), 0);
+
+    playback.set_progress(6);
+    EXPECT_EQ(drawn_cells(actors, 0), 4);
+    EXPECT_EQ(drawn_cells(actors, 1), 2);
+    EXPECT_EQ(drawn_cells(actors, 2), 0);
+    auto pos = playback.get_tool_actor()->GetMatrix();
+    EXPECT_DOUBLE_EQ(pos->GetElement(0, 3), 6);
+    EXPECT_DOUBLE_EQ(pos->GetElement(1, 3), 0);
+
+    // point shared by chunks 2 and 3
+    playback.set_progress(12);
+    pos = playback.get_tool_actor()->GetMatrix();
+    EXPECT_DOUBLE_EQ(pos->GetElement(0, 3), 2);
+    EXPECT_DOUBLE_EQ(pos->GetElement(1, 3), 2);
+
+    playback.set_progress(14);
+    EXPECT_EQ(drawn_cells(actors, 1), 4);
+    EXPECT_EQ(drawn_cells(actors, 3), 2);
+    // going back hides cells again
+    playback.set_progress(1);
+    EXPECT_EQ(drawn_cells(actors, 0), 1);
+    EXPECT_EQ(drawn_cells(actors, 3), 0);
+    EXPECT_EQ(playback.get_progress(), 1);
+
+    EXPECT_EQ(playback.get_location(12), Location(2, 2));
+    EXPECT_THROW(playback.set_progress(15), std::out_of_range);
+    EXPECT_THROW(playback.get_location(15), std::out_of_range);
+}
+
+TEST(PlaybackTest, Drive) {
+    std::vector<std::shared_ptr<Path>> paths = {make_line(0, 11)};
+    auto playback = Playback(paths, std::vector<uint8_t>{0,0,0}, 0.5, 2);
+    EXPECT_EQ(playback.get_chunk_count(), 1);
+    // simulated clock
+    playback.set_feed_rate(2);
+    EXPECT_DOUBLE_EQ(playback.get_duration(), 5);
+    EXPECT_EQ(playback.set_time(1.25), 2);
+    EXPECT_DOUBLE_EQ(playback.get_tool_actor()->GetMatrix()->GetElement(0, 3), 2.5);
+    EXPECT_EQ(playback.set_time(100), 10);
+    EXPECT_THROW(playback.set_time(-1), std::invalid_argument);
+    EXPECT_THROW(playback.set_feed_rate(0), std::invalid_argument);
+    // position reports only move forward, within search window
+    playback.set_progress(0);
+    EXPECT_EQ(playback.set_position(std::make_shared<Point>(4.2, 0.1, 0, 0)), 4);
+    EXPECT_DOUBLE_EQ(playback.get_tool_actor()->GetMatrix()->GetElement(0, 3), 4.2);
+    EXPECT_EQ(playback.set_position(std::make_shared<Point>(1, 0, 0, 0)), 4);
+    EXPECT_EQ(playback.set_position(std::make_shared<Point>(10, 0, 0, 0), 3), 7);
+
+    EXPECT_THROW(Playback({}, std::vector<uint8_t>{0,0,0}, 0.5, 2), std::invalid_argument);
+    EXPECT_THROW(Playback(paths, std::vector<uint8_t>{0,0,0}, 0.5, 2, 1, 0), std::invalid_argument);
+    EXPECT_THROW(Playback(paths, std::vector<uint8_t>{0,0,0}, 0, 2), std::invalid_argument);
+}
@@ -152,3 +152,22 @@ TEST_F(Shape3DTest, IntersectingActor) {
     auto actor5 = this->shape->intersecting_actor(std::vector<double>{0, 0, 5}, std::vector<double>{0, 0, 10});
     EXPECT_EQ(actor5, nullptr);
 }
+
+TEST(CopyPoints, Conversion) {
+    auto path = Path(0);
+    path.emplace_back(std::make_shared<Point>(1, 0, 2, 0));
+    path.emplace_back(std::make_shared<Point>(1, 0, 3, 90));
+    auto points = vtkSmartPointer<vtkPoints>::New();
+    EXPECT_THROW(copy_points(points, 0, path, 2), std::invalid_argument);
+    points->SetDataTypeToDouble();
+    points->SetNumberOfPoints(3);
+    EXPECT_THROW(copy_points(points, 2, path, 2), std::out_of_range);
+    copy_points(points, 0, path, 2);
+    copy_points(points, 2, path, 1, true);
+    auto p1 = points->GetPoint(1);
+    EXPECT_NEAR(p1[0], 0, 1e-12);
+    EXPECT_NEAR(p1[1], 1, 1e-12);
+    EXPECT_EQ(p1[2], 3);
+    // reversed copy starts from last point
+    EXPECT_EQ(points->GetPoint(2)[2], 3);
+}
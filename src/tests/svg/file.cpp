@@ -2,6 +2,7 @@
 #include "svg/rect.h"
 #include "svg/ellipse.h"
 #include "svg/path.h"
+#include "svg/use.h"
 
 #include <gtest/gtest.h>
 
@@ -416,3 +417,56 @@ TEST(FileTest, ParseMultiTransform) {
 
 }
 
+
+TEST(FileTest, ParseUse) {
+    std::string use_svg = "<?xml version=\"1.0\" standalone=\"no\"?>\
+    <svg viewBox=\"0 0 200 200\" xmlns=\"http://www.w3.org/2000/svg\"\
+    xmlns:xlink=\"http://www.w3.org/1999/xlink\" version=\"1.1\">\
+    <defs>\
+    <circle id=\"dot\" cx=\"0\" cy=\"0\" r=\"1\"/>\
+    <g id=\"motif\" transform=\"translate(0,50)\"><path d=\"M0,0 L1,0 L1,1 z\"/><use href=\"#dot\"/></g>\
+    </defs>\
+    <symbol id=\"petal\" viewBox=\"0 0 10 10\"><rect x=\"0\" y=\"0\" width=\"10\" height=\"10\"/></symbol>\
+    <g id=\"layer\">\
+    <use href=\"#dot\" x=\"10\" y=\"20\"/>\
+    <use xlink:href=\"#dot\" transform=\"translate(5,0)\"/>\
+    <use href=\"#petal\" width=\"20\" height=\"40\"/>\
+    <use href=\"#motif\" x=\"100\"/>\
+    <circle cx=\"50\" cy=\"50\" r=\"1\"/>\
+    </g>\
+    <g id=\"loop\"><g id=\"self\"><use href=\"#self\"/></g></g>\
+    <g id=\"missing\"><use href=\"#none\"/></g>\
+    </svg>";
+
+    auto f = File();
+    f.from_memory(use_svg);
+    // definitions are not drawn by themselves
+    auto shapes = f.get_shapes("layer");
+    ASSERT_EQ(shapes.size(), 6);
+    EXPECT_EQ(shapes[0]->get_type(), SVG_SHAPETYPE_USE);
+    EXPECT_EQ(static_cast<Use<number_t>&>(*shapes[0]).get_base_type(), SVG_SHAPETYPE_ELLIPSE);
+    EXPECT_EQ(shapes[5]->get_type(), SVG_SHAPETYPE_ELLIPSE);
+    // use position and transform
+    EXPECT_NEAR(shapes[0]->centre()->x, 10, 1e-9);
+    EXPECT_NEAR(shapes[0]->centre()->y, 20, 1e-9);
+    EXPECT_NEAR(shapes[1]->centre()->x, 5, 1e-9);
+    EXPECT_NEAR(shapes[1]->centre()->y, 0, 1e-9);
+    // symbol view box is fitted in use viewport, keeping aspect ratio
+    EXPECT_NEAR(shapes[2]->centre()->x, 10, 1e-9);
+    EXPECT_NEAR(shapes[2]->centre()->y, 20, 1e-9);
+    // referenced group keeps its own transform, and nested uses work
+    EXPECT_NEAR(shapes[4]->centre()->x, 100, 1e-9);
+    EXPECT_NEAR(shapes[4]->centre()->y, 50, 1e-9);
+    // instances are copies of the same rasterized shape
+    auto paths = f.get_paths("layer", 0.1);
+    ASSERT_EQ(paths.size(), 6);
+    ASSERT_EQ(paths[0]->size(), paths[1]->size());
+    for (size_t i=0; i<paths[0]->size(); i++) {
+        EXPECT_NEAR((*paths[0])[i]->x, (*paths[1])[i]->x + 5, 1e-9);
+        EXPECT_NEAR((*paths[0])[i]->y, (*paths[1])[i]->y + 20, 1e-9);
+    }
+    EXPECT_NE(paths[0], paths[1]);
+    EXPECT_EQ(f.get_points("layer").size(), 5);
+    EXPECT_THROW(f.get_shapes("loop"), std::runtime_error);
+    EXPECT_THROW(f.get_shapes("missing"), std::runtime_error);
+}
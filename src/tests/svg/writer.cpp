@@ -0,0 +1,120 @@
+#include "svg/writer.h"
+#include "svg/file.h"
+#include "svg/path.h"
+#include "types/point.h"
+#include "types/path.h"
+#include "types/pathgroup.h"
+
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <gtest/gtest.h>
+
+using namespace pygraver;
+using namespace pygraver::svg;
+using namespace testing;
+
+class WriterTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        this->file_name = (std::filesystem::temp_directory_path() / "pygraver_writer_test.svg").string();
+        this->square = std::make_shared<types::Path>(0);
+        this->square->emplace_back(std::make_shared<types::Point>(-1, -1, 0, 0));
+        this->square->emplace_back(std::make_shared<types::Point>(1, -1, 0, 0));
+        this->square->emplace_back(std::make_shared<types::Point>(1, 1, 0, 0));
+        this->square->emplace_back(std::make_shared<types::Point>(-1, 1, 0, 0));
+        this->square->emplace_back(std::make_shared<types::Point>(-1, -1, 0, 0));
+    }
+
+    void TearDown() override {
+        std::filesystem::remove(this->file_name);
+    }
+
+    std::string read_file() const {
+        std::ifstream f(this->file_name);
+        std::stringstream ss;
+        ss << f.rdbuf();
+        return ss.str();
+    }
+
+    std::string file_name;
+    std::shared_ptr<types::Path> square;
+};
+
+TEST_F(WriterTest, Compaction) {
+    auto w = Writer(this->file_name, 10, 10, 2);
+    w.begin_layer("layer");
+    w.write(this->square);
+    w.close();
+    auto content = this->read_file();
+    EXPECT_NE(content.find("d=\"m4 4h2v2h-2z\""), std::string::npos);
+    EXPECT_NE(content.find("viewBox=\"0 0 10 10\""), std::string::npos);
+
+    auto w2 = Writer(this->file_name, 10, 10, 2, false);
+    w2.write(this->square);
+    w2.close();
+    content = this->read_file();
+    EXPECT_NE(content.find("d=\"M4 4H6V6H4Z\""), std::string::npos);
+}
+
+TEST_F(WriterTest, RoundTrip) {
+    auto path = std::make_shared<types::Path>(0);
+    path->emplace_back(std::make_shared<types::Point>(0.125, -0.5, 0, 0));
+    path->emplace_back(std::make_shared<types::Point>(1.75, 0.25, 0, 0));
+    path->emplace_back(std::make_shared<types::Point>(1, 0, 0, 90));
+    auto group = std::make_shared<types::PathGroup>();
+    group->push_back(path);
+    group->push_back(this->square);
+    {
+        auto w = Writer(this->file_name, 20, 10, 3);
+        w.begin_layer("layer");
+        w.write(group);
+    }
+    auto f = File(this->file_name);
+    auto shapes = f.get_shapes("layer");
+    EXPECT_EQ(shapes.size(), 2);
+    auto & segs = shapes[0]->get_segments();
+    EXPECT_EQ(segs.size(), 2);
+    auto p0 = segs[0]->point(0);
+    auto p1 = segs[1]->point(0);
+    auto p2 = segs[1]->point(1);
+    EXPECT_DOUBLE_EQ(p0[0], 10.125);
+    EXPECT_DOUBLE_EQ(p0[1], 4.5);
+    EXPECT_DOUBLE_EQ(p1[0], 11.75);
+    EXPECT_DOUBLE_EQ(p1[1], 5.25);
+    // last point is rotated by 90°
+    EXPECT_DOUBLE_EQ(p2[0], 10);
+    EXPECT_DOUBLE_EQ(p2[1], 6);
+    EXPECT_EQ(shapes[1]->get_segments().size(), 4);
+}
+
+TEST_F(WriterTest, ArcFitting) {
+    auto path = std::make_shared<types::Path>(0);
+    for (auto i=0; i<=100; i++)
+        path->emplace_back(std::make_shared<types::Point>(3*cos(i*M_PI/100), 3*sin(i*M_PI/100), 0, 0));
+    {
+        auto w = Writer(this->file_name, 10, 10, 3, true, 1e-3);
+        w.begin_layer("layer");
+        w.write(path);
+    }
+    auto f = File(this->file_name);
+    auto shapes = f.get_shapes("layer");
+    EXPECT_EQ(shapes.size(), 1);
+    auto & segs = shapes[0]->get_segments();
+    EXPECT_EQ(segs.size(), 2); // 2 arcs
+    auto pt = segs[1]->point(1);
+    EXPECT_NEAR(pt[0], 2, 1e-3);
+    EXPECT_NEAR(pt[1], 5, 1e-3);
+}
+
+TEST_F(WriterTest, Layers) {
+    auto w = Writer(this->file_name, 10, 10);
+    EXPECT_THROW(w.end_layer(), std::runtime_error);
+    w.begin_layer("a & b");
+    w.close();
+    EXPECT_THROW(w.begin_layer("layer"), std::runtime_error);
+    auto content = this->read_file();
+    EXPECT_NE(content.find("id=\"a &amp; b\""), std::string::npos);
+    EXPECT_NE(content.find("</g>\n</svg>"), std::string::npos);
+    EXPECT_THROW(Writer(this->file_name, 0, 10), std::invalid_argument);
+}
@@ -0,0 +1,92 @@
+#include "types/point.h"
+#include "types/path.h"
+#include "types/pathgroup.h"
+#include "types/compressedpathgroup.h"
+
+#include <gtest/gtest.h>
+#include <cmath>
+
+using namespace pygraver;
+using namespace pygraver::types;
+
+// spiral-like paths with slowly varying depth, plus an empty path
+static std::shared_ptr<PathGroup> make_paths(const size_t n_paths, const size_t n_points) {
+    auto pg = std::make_shared<PathGroup>();
+    for (size_t k=0; k<n_paths; k++) {
+        auto path = std::make_shared<Path>(0);
+        for (size_t i=0; i<n_points; i++) {
+            auto t = 0.01*i;
+            path->emplace_back(std::make_shared<Point>((1 + 0.1*t)*cos(t) - k, (1 + 0.1*t)*sin(t), -0.05 + 0.01*sin(3*t), 0.5*i));
+        }
+        pg->emplace_back(path);
+    }
+    pg->emplace_back(std::make_shared<Path>(0));
+    return pg;
+}
+
+TEST(CompressedPathGroupTest, RoundTrip) {
+    auto pg = make_paths(5, 1000);
+    CompressedPathGroup cpg(pg, 1e-4, 1e-3);
+    EXPECT_EQ(cpg.size(), 6);
+    EXPECT_EQ(cpg.get_point_count(), 5000);
+    auto decoded = cpg.decompress();
+    ASSERT_EQ(decoded->size(), 6);
+    for (size_t k=0; k<pg->size(); k++) {
+        auto & original = *(*pg)[k];
+        auto & path = *(*decoded)[k];
+        ASSERT_EQ(path.size(), original.size());
+        for (size_t i=0; i<path.size(); i++) {
+            EXPECT_NEAR(path[i]->x, original[i]->x, 0.5e-4 + 1e-12);
+            EXPECT_NEAR(path[i]->y, original[i]->y, 0.5e-4 + 1e-12);
+            EXPECT_NEAR(path[i]->z, original[i]->z, 0.5e-4 + 1e-12);
+            EXPECT_NEAR(path[i]->c, original[i]->c, 0.5e-3 + 1e-12);
+        }
+    }
+    // values on the quantization grid are kept as they are
+    EXPECT_NEAR((*(*decoded)[0])[0]->x, 1, 1e-12);
+    EXPECT_NEAR((*(*decoded)[0])[2]->c, 1, 1e-12);
+
+    auto stats = cpg.get_stats();
+    EXPECT_EQ(stats.paths, 6);
+    EXPECT_EQ(stats.points, 5000);
+    EXPECT_LE(stats.max_error, 0.5e-4 + 1e-12);
+    EXPECT_LE(stats.max_angle_error, 0.5e-3 + 1e-12);
+    EXPECT_GT(stats.ratio, 5);
+    EXPECT_EQ(stats.decoded_points, 5000);
+}
+
+TEST(CompressedPathGroupTest, Streaming) {
+    auto pg = make_paths(3, 100);
+    CompressedPathGroup cpg(pg);
+    // paths are decoded one at a time
+    size_t k = 0;
+    for (auto & path: cpg) {
+        EXPECT_EQ(path->size(), (*pg)[k]->size());
+        EXPECT_EQ(cpg.get_stats().decoded_points, (k+1)*100 - (k == 3 ? 100 : 0));
+        k++;
+    }
+    EXPECT_EQ(k, 4);
+    std::vector<double> xs, ys, zs, cs;
+    cpg.decode(1, xs, ys, zs, cs);
+    ASSERT_EQ(xs.size(), 100);
+    EXPECT_NEAR(xs[0], 0, 1e-12);
+    EXPECT_NEAR(cs[99], 49.5, 1e-12);
+    EXPECT_THROW(cpg.decode(4, xs, ys, zs, cs), std::out_of_range);
+    EXPECT_THROW(cpg.get_path(4), std::out_of_range);
+    EXPECT_GT(cpg.get_stats().decode_rate, 0);
+}
+
+TEST(CompressedPathGroupTest, Errors) {
+    auto pg = make_paths(1, 10);
+    EXPECT_THROW(CompressedPathGroup(pg, 0), std::invalid_argument);
+    EXPECT_THROW(CompressedPathGroup(pg, 1e-4, -1), std::invalid_argument);
+    (*(*pg)[0])[5]->x = 1e30;
+    EXPECT_THROW(CompressedPathGroup(pg, 1e-4), std::invalid_argument);
+    (*(*pg)[0])[5]->x = NAN;
+    EXPECT_THROW(CompressedPathGroup(pg, 1e-4), std::invalid_argument);
+    // empty group
+    CompressedPathGroup empty(std::make_shared<PathGroup>());
+    EXPECT_EQ(empty.size(), 0);
+    EXPECT_EQ(empty.decompress()->size(), 0);
+    EXPECT_TRUE(empty.begin() == empty.end());
+}
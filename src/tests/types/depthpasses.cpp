@@ -0,0 +1,122 @@
+#include "types/point.h"
+#include "types/path.h"
+#include "types/pathgroup.h"
+#include "types/depthpasses.h"
+
+#include <gtest/gtest.h>
+
+using namespace pygraver;
+using namespace pygraver::types;
+
+// straight open path along x, from x0 to x0+n-1, one unit per point
+static std::shared_ptr<Path> make_line(const double x0, const size_t n, const double z=0) {
+    auto path = std::make_shared<Path>(0);
+    for (size_t i=0; i<n; i++)
+        path->emplace_back(std::make_shared<Point>(x0 + i, 0, z, 0));
+    return path;
+}
+
+TEST(DepthPassesTest, Depths) {
+    auto pg = std::make_shared<PathGroup>();
+    pg->emplace_back(make_line(0, 3));
+    auto passes = DepthPasses(pg, std::vector<double>{-0.1, -0.2, -0.3}, std::vector<double>{1, 0.5, 0.25});
+    EXPECT_EQ(passes.get_pass_count(), 3);
+    EXPECT_EQ(passes.size(), 9);
+    std::vector<PassMove> moves(passes.begin(), passes.end());
+    ASSERT_EQ(moves.size(), 9);
+    for (size_t k=0; k<3; k++) {
+        for (size_t i=0; i<3; i++) {
+            auto [x, y, z, c, feed] = moves[3*k + i];
+            EXPECT_NEAR(x, i, 1e-12);
+            EXPECT_NEAR(z, -0.1*(k+1), 1e-12);
+            EXPECT_NEAR(feed, passes.get_feed_factors()[k], 1e-12);
+        }
+    }
+    // a single pass can be built as a path group; original paths are left untouched
+    auto pass = passes.get_pass(1);
+    ASSERT_EQ(pass->size(), 1);
+    EXPECT_NEAR((*(*pass)[0])[2]->z, -0.2, 1e-12);
+    EXPECT_NEAR((*(*pg)[0])[2]->z, 0, 1e-12);
+    EXPECT_THROW(passes.get_pass(3), std::out_of_range);
+    // passes keep their own copy of points
+    (*pg)[0]->emplace_back(std::make_shared<Point>(3, 0, 0, 0));
+    (*(*pg)[0])[0]->x = 5;
+    pg->emplace_back(make_line(0, 2));
+    EXPECT_EQ(passes.size(), 9);
+    EXPECT_EQ(std::vector<PassMove>(passes.begin(), passes.end()), moves);
+    EXPECT_EQ((*passes.get_pass(0))[0]->size(), 3);
+    EXPECT_THROW(DepthPasses(pg, std::vector<double>{}), std::invalid_argument);
+    EXPECT_THROW(DepthPasses(pg, std::vector<double>{-0.1}, std::vector<double>{1, 1}), std::invalid_argument);
+    EXPECT_THROW(DepthPasses(pg, std::vector<double>{-0.1}, std::vector<double>{0}), std::invalid_argument);
+}
+
+TEST(DepthPassesTest, Ramps) {
+    auto pg = std::make_shared<PathGroup>();
+    pg->emplace_back(make_line(0, 11));
+    auto passes = DepthPasses(pg, std::vector<double>{-0.1, -0.2}, std::vector<double>(), 0, 4);
+    std::vector<PassMove> moves(passes.begin(), passes.end());
+    ASSERT_EQ(moves.size(), 22);
+    // first pass enters from stock surface, next one from depth of first pass
+    EXPECT_NEAR(std::get<2>(moves[0]), 0, 1e-12);
+    EXPECT_NEAR(std::get<2>(moves[2]), -0.05, 1e-12);
+    EXPECT_NEAR(std::get<2>(moves[4]), -0.1, 1e-12);
+    EXPECT_NEAR(std::get<2>(moves[11]), -0.1, 1e-12);
+    EXPECT_NEAR(std::get<2>(moves[13]), -0.15, 1e-12);
+    EXPECT_NEAR(std::get<2>(moves[15]), -0.2, 1e-12);
+    EXPECT_NEAR(std::get<2>(moves[21]), -0.2, 1e-12);
+    // points above limit height aren't moved
+    auto lifted = std::make_shared<PathGroup>();
+    lifted->emplace_back(make_line(0, 2, 1));
+    auto above = DepthPasses(lifted, std::vector<double>{-0.1});
+    EXPECT_NEAR(std::get<2>(*above.begin()), 1, 1e-12);
+}
+
+TEST(DepthPassesTest, Order) {
+    auto pg = std::make_shared<PathGroup>();
+    pg->emplace_back(make_line(0, 2));
+    pg->emplace_back(std::make_shared<Path>(0));
+    pg->emplace_back(make_line(10, 2));
+    std::vector<double> depths{-0.1, -0.2};
+    // by depth: every path at 1st depth, then every path at 2nd depth; empty paths are skipped
+    auto by_depth = DepthPasses(pg, depths);
+    std::vector<PassMove> moves(by_depth.begin(), by_depth.end());
+    ASSERT_EQ(moves.size(), 8);
+    EXPECT_NEAR(std::get<0>(moves[2]), 10, 1e-12);
+    EXPECT_NEAR(std::get<2>(moves[2]), -0.1, 1e-12);
+    EXPECT_NEAR(std::get<0>(moves[4]), 0, 1e-12);
+    EXPECT_NEAR(std::get<2>(moves[4]), -0.2, 1e-12);
+    // by path: every depth for 1st path, then every depth for next path
+    auto by_path = DepthPasses(pg, depths, std::vector<double>(), 0, 0, PassOrder::ByPath);
+    moves = std::vector<PassMove>(by_path.begin(), by_path.end());
+    ASSERT_EQ(moves.size(), 8);
+    EXPECT_NEAR(std::get<0>(moves[2]), 0, 1e-12);
+    EXPECT_NEAR(std::get<2>(moves[2]), -0.2, 1e-12);
+    EXPECT_NEAR(std::get<0>(moves[4]), 10, 1e-12);
+    EXPECT_NEAR(std::get<2>(moves[4]), -0.1, 1e-12);
+}
+
+TEST(DepthPassesTest, SafeHeight) {
+    auto pg = std::make_shared<PathGroup>();
+    pg->emplace_back(make_line(0, 2));
+    auto passes = DepthPasses(pg, std::vector<double>{-0.1, -0.2}, std::vector<double>{0.5, 0.5}, 0, 0, PassOrder::ByDepth, 1.0);
+    std::vector<PassMove> moves(passes.begin(), passes.end());
+    // retract above last point, move above first point, then next pass
+    ASSERT_EQ(moves.size(), 6);
+    EXPECT_EQ(passes.size(), 6);
+    EXPECT_NEAR(std::get<0>(moves[2]), 1, 1e-12);
+    EXPECT_NEAR(std::get<2>(moves[2]), 1, 1e-12);
+    EXPECT_NEAR(std::get<4>(moves[2]), 1, 1e-12);
+    EXPECT_NEAR(std::get<0>(moves[3]), 0, 1e-12);
+    EXPECT_NEAR(std::get<2>(moves[3]), 1, 1e-12);
+    EXPECT_NEAR(std::get<2>(moves[4]), -0.2, 1e-12);
+    EXPECT_NEAR(std::get<4>(moves[4]), 0.5, 1e-12);
+    // no retract needed when a pass starts where previous one ends
+    auto closed = std::make_shared<PathGroup>();
+    auto square = std::make_shared<Path>(0);
+    for (auto [x, y]: std::vector<std::pair<double, double>>{{0, 0}, {1, 0}, {1, 1}, {0, 1}, {0, 0}})
+        square->emplace_back(std::make_shared<Point>(x, y, 0, 0));
+    closed->emplace_back(square);
+    auto loops = DepthPasses(closed, std::vector<double>{-0.1, -0.2}, std::vector<double>(), 0, 0, PassOrder::ByDepth, 1.0);
+    EXPECT_EQ(loops.size(), 10);
+    EXPECT_EQ(std::vector<PassMove>(loops.begin(), loops.end()).size(), 10);
+}
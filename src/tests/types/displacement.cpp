@@ -0,0 +1,99 @@
+#include "types/point.h"
+#include "types/path.h"
+#include "types/pathgroup.h"
+#include "types/displacement.h"
+
+#include <gtest/gtest.h>
+
+using namespace pygraver;
+using namespace pygraver::types;
+
+// 11x11 image with values going from 0 (left) to 1 (right), one unit per pixel, centred on integer positions
+static std::vector<double> make_gradient() {
+    std::vector<double> pixels;
+    for (auto j=0; j<11; j++)
+        for (auto i=0; i<11; i++)
+            pixels.push_back(0.1*i);
+    return pixels;
+}
+
+static std::shared_ptr<Path> make_line(const double x0, const double x1, const double y) {
+    auto path = std::make_shared<Path>(0);
+    path->emplace_back(std::make_shared<Point>(x0, y, -1, 0));
+    path->emplace_back(std::make_shared<Point>(x1, y, -1, 0));
+    return path;
+}
+
+TEST(DisplacementTest, Sample) {
+    // row 0 is the top of the image
+    auto disp = Displacement(std::vector<double>{0, 1, 2, 3}, 2, 2, 0, 0, 1);
+    EXPECT_NEAR(disp.sample(0.5, 1.5), 0, 1e-12);
+    EXPECT_NEAR(disp.sample(1.5, 0.5), 3, 1e-12);
+    EXPECT_NEAR(disp.sample(1, 1), 1.5, 1e-12);
+    // outside image, closest edge is used
+    EXPECT_NEAR(disp.sample(-5, -5), 2, 1e-12);
+    // polar point is converted to cartesian coordinates
+    EXPECT_NEAR(disp.sample(1.5, -0.5, 90), 0, 1e-12);
+    EXPECT_THROW(Displacement(std::vector<double>{0, 1, 2}, 2, 2, 0, 0, 1), std::invalid_argument);
+    EXPECT_THROW(Displacement(std::vector<double>{0, 1, 2, 3}, 2, 2, 0, 0, 0), std::invalid_argument);
+}
+
+TEST(DisplacementTest, Transfer) {
+    auto disp = Displacement(make_gradient(), 11, 11, -0.5, -0.5, 1, -0.1, DisplacementMode::Depth, std::vector<double>{0, 0, 1});
+    EXPECT_EQ(disp.get_mode(), DisplacementMode::Depth);
+    EXPECT_NEAR(disp.get_displacement(2.5, 5), 0, 1e-12);
+    EXPECT_NEAR(disp.get_displacement(7.5, 5), -0.05, 1e-12);
+    EXPECT_NEAR(disp.get_displacement(10, 5), -0.1, 1e-12);
+}
+
+TEST(DisplacementTest, Normal) {
+    auto disp = Displacement(make_gradient(), 11, 11, -0.5, -0.5, 1, 2);
+    auto res = disp.apply(make_line(0, 10, 5));
+    ASSERT_EQ(res->size(), 2);
+    EXPECT_NEAR((*res)[0]->y, 5, 1e-12);
+    EXPECT_NEAR((*res)[1]->x, 10, 1e-12);
+    EXPECT_NEAR((*res)[1]->y, 7, 1e-12);
+    EXPECT_NEAR((*res)[1]->z, -1, 1e-12);
+    // vertices move along bisector of adjacent normals; closed paths wrap around
+    auto square = std::make_shared<Path>(0);
+    for (auto [x, y]: std::vector<std::pair<double, double>>{{0, 0}, {1, 0}, {1, 1}, {0, 1}, {0, 0}})
+        square->emplace_back(std::make_shared<Point>(x, y, 0, 0));
+    auto flat = Displacement(std::vector<double>{1}, 1, 1, 0, 0, 1, 1);
+    res = flat.apply(square);
+    ASSERT_EQ(res->size(), 5);
+    EXPECT_NEAR((*res)[0]->x, M_SQRT1_2, 1e-12);
+    EXPECT_NEAR((*res)[0]->y, M_SQRT1_2, 1e-12);
+    EXPECT_NEAR((*res)[2]->x, 1 - M_SQRT1_2, 1e-12);
+    EXPECT_NEAR((*res)[2]->y, 1 - M_SQRT1_2, 1e-12);
+    // result is in cartesian coordinates
+    auto polar = std::make_shared<Path>(0);
+    polar->emplace_back(std::make_shared<Point>(1, 0, 0, 90));
+    polar->emplace_back(std::make_shared<Point>(2, 0, 0, 90));
+    res = flat.apply(polar);
+    EXPECT_NEAR((*res)[1]->x, -1, 1e-12);
+    EXPECT_NEAR((*res)[1]->y, 2, 1e-12);
+    EXPECT_NEAR((*res)[1]->c, 0, 1e-12);
+}
+
+TEST(DisplacementTest, Refinement) {
+    // step in the middle of a 100-pixel strip
+    std::vector<double> pixels(100, 0);
+    std::fill(pixels.begin() + 50, pixels.end(), 1);
+    auto disp = Displacement(pixels, 100, 1, 0, 0, 0.1, 1);
+    auto line = make_line(0, 10, 0.05);
+    EXPECT_EQ(disp.apply(line)->size(), 2);
+    auto res = disp.apply(line, 0.01);
+    EXPECT_GT(res->size(), 10);
+    // added points concentrate around the step
+    size_t near_step = 0;
+    for (size_t i=0; i<res->size(); i++)
+        if (std::abs((*res)[i]->x - 5) < 0.5)
+            near_step++;
+    EXPECT_GT(near_step, res->size()/2);
+    // depth mode keeps coordinates and refines at transfer function kinks only
+    auto depth = Displacement(make_gradient(), 11, 11, -0.5, -0.5, 1, -0.1, DisplacementMode::Depth, std::vector<double>{0, 0, 1});
+    res = depth.apply(make_line(0, 10, 5), 0.001);
+    ASSERT_EQ(res->size(), 3);
+    EXPECT_NEAR((*res)[1]->x, 5, 1e-12);
+    EXPECT_NEAR((*res)[2]->z, -1.1, 1e-12);
+}
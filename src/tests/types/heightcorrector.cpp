@@ -0,0 +1,61 @@
+#include "types/common.h"
+#include "types/point.h"
+#include "types/path.h"
+#include "types/surface.h"
+#include "types/heightcorrector.h"
+
+#include <gtest/gtest.h>
+
+using namespace pygraver;
+using namespace pygraver::types;
+
+class HeightCorrectorTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        // horizontal lines at y=-2, 0, 2, 10
+        for (auto y: {-2.0, 0.0, 2.0, 10.0}) {
+            auto path = std::make_shared<Path>(0);
+            for (auto i=-30; i<=30; i++)
+                path->emplace_back(std::make_shared<Point>(0.1*i, y, 0, 0));
+            this->paths.push_back(path);
+        }
+    }
+
+    std::shared_ptr<Surface> make_square(const double x, const double y, const double size) {
+        auto path = std::make_shared<Path>(0);
+        path->emplace_back(std::make_shared<Point>(x-size/2, y-size/2, 0, 0));
+        path->emplace_back(std::make_shared<Point>(x+size/2, y-size/2, 0, 0));
+        path->emplace_back(std::make_shared<Point>(x+size/2, y+size/2, 0, 0));
+        path->emplace_back(std::make_shared<Point>(x-size/2, y+size/2, 0, 0));
+        path->emplace_back(std::make_shared<Point>(x-size/2, y-size/2, 0, 0));
+        return std::make_shared<Surface>(path);
+    }
+
+    std::vector<std::shared_ptr<Path>> paths;
+};
+
+TEST_F(HeightCorrectorTest, Update) {
+    auto corrector = HeightCorrector(this->paths, 0.1, 1.0);
+    auto mask1 = this->make_square(0, 0, 1);
+    auto & res1 = corrector.update(mask1);
+    EXPECT_EQ(corrector.get_updated().size(), 4);
+    EXPECT_EQ(res1.size(), 4);
+
+    // move mask up: only lines at y=0 and y=2 are affected
+    auto mask2 = this->make_square(0, 1.5, 1);
+    auto res2 = corrector.update(mask2);
+    EXPECT_EQ(corrector.get_updated(), std::vector<size_t>({1, 2}));
+
+    // results must match a full recomputation
+    auto expected = mask2->correct_height(this->paths, 0.1, 1.0);
+    ASSERT_EQ(res2.size(), expected.size());
+    for (size_t i=0; i<expected.size(); i++) {
+        ASSERT_EQ(res2[i]->size(), expected[i]->size());
+        for (size_t j=0; j<expected[i]->size(); j++)
+            EXPECT_EQ((*res2[i])[j]->z, (*expected[i])[j]->z);
+    }
+
+    // unchanged mask: nothing to do
+    corrector.update(mask2);
+    EXPECT_EQ(corrector.get_updated().size(), 0);
+}
@@ -0,0 +1,80 @@
+#include "types/point.h"
+#include "types/path.h"
+#include "types/pathgroup.h"
+#include "types/heightmap.h"
+
+#include <gtest/gtest.h>
+
+using namespace pygraver;
+using namespace pygraver::types;
+
+// plane z = 0.1*x + 0.2*y sampled on a 11x11 grid with unit steps
+static std::shared_ptr<HeightMap> make_plane() {
+    std::vector<double> heights;
+    for (auto j=0; j<11; j++)
+        for (auto i=0; i<11; i++)
+            heights.push_back(0.1*i + 0.2*j);
+    return std::make_shared<HeightMap>(0, 0, 1, 1, 11, 11, heights);
+}
+
+TEST(HeightMapTest, Bilinear) {
+    auto map = make_plane();
+    EXPECT_EQ(map->get_mode(), HeightMapMode::Bilinear);
+    EXPECT_NEAR(map->get_height(2.5, 3.25), 0.9, 1e-12);
+    // polar point is converted to cartesian coordinates
+    EXPECT_NEAR(map->get_height(0, 2, -90), 0.2, 1e-12);
+    // outside grid, closest edge is used
+    EXPECT_NEAR(map->get_height(-5, 0), 0, 1e-12);
+    EXPECT_NEAR(map->get_height(20, 10), 3, 1e-12);
+    EXPECT_THROW(HeightMap(0, 0, 1, 1, 2, 2, std::vector<double>{0, 0, 0}), std::invalid_argument);
+    EXPECT_THROW(HeightMap(0, 0, 0, 1, 2, 2, std::vector<double>{0, 0, 0, 0}), std::invalid_argument);
+}
+
+TEST(HeightMapTest, Axial) {
+    // one ring of 4 positions along c, height equal to ring index
+    std::vector<double> heights = {0, 0, 1, 1, 2, 2, 3, 3};
+    auto map = HeightMap(0, 0, 10, 90, 2, 4, heights, HeightMapCoordinates::Axial, 5);
+    EXPECT_NEAR(map.get_height(3, 0, 45), 0.5, 1e-12);
+    // grid wraps around
+    EXPECT_NEAR(map.get_height(3, 0, 315), 1.5, 1e-12);
+    EXPECT_NEAR(map.get_height(3, 0, -45), 1.5, 1e-12);
+    EXPECT_THROW(HeightMap(0, 0, 10, 90, 2, 3, std::vector<double>(6), HeightMapCoordinates::Axial), std::invalid_argument);
+}
+
+TEST(HeightMapTest, ThinPlateSpline) {
+    std::vector<double> xs = {0, 1, 0, 1, 0.5};
+    std::vector<double> ys = {0, 0, 1, 1, 0.5};
+    // spline reproduces planes exactly
+    auto plane = HeightMap(xs, ys, std::vector<double>{0, 1, 2, 3, 1.5});
+    EXPECT_EQ(plane.get_mode(), HeightMapMode::ThinPlateSpline);
+    EXPECT_NEAR(plane.get_height(0.3, 0.7), 1.7, 1e-9);
+    // and goes through measured points
+    auto bump = HeightMap(xs, ys, std::vector<double>{0, 0, 0, 0, 1});
+    EXPECT_NEAR(bump.get_height(0.5, 0.5), 1, 1e-9);
+    EXPECT_NEAR(bump.get_height(1, 0), 0, 1e-9);
+    auto resampled = bump.resample(0, 0, 0.5, 0.5, 3, 3);
+    EXPECT_EQ(resampled->get_mode(), HeightMapMode::Bilinear);
+    EXPECT_NEAR(resampled->get_height(0.5, 0.5), 1, 1e-9);
+    EXPECT_THROW(HeightMap(std::vector<double>{0, 1, 2}, std::vector<double>{0, 1, 2}, std::vector<double>{0, 0, 0}), std::invalid_argument);
+}
+
+TEST(HeightMapTest, Apply) {
+    auto map = make_plane();
+    auto path = std::make_shared<Path>(0);
+    path->emplace_back(std::make_shared<Point>(0, 0, 0, 0));
+    path->emplace_back(std::make_shared<Point>(10, 0, -1, 0));
+    auto res = map->apply(path);
+    ASSERT_EQ(res->size(), 2);
+    EXPECT_NEAR((*res)[1]->z, 0, 1e-12);
+    // long segments are subdivided
+    res = map->apply(path, 1.0);
+    ASSERT_EQ(res->size(), 11);
+    for (size_t i=0; i<res->size(); i++) {
+        EXPECT_NEAR((*res)[i]->x, i, 1e-12);
+        EXPECT_NEAR((*res)[i]->z, 0, 1e-12);
+    }
+    auto pg = std::make_shared<PathGroup>(std::vector<std::shared_ptr<Path>>{path, path});
+    auto res_pg = map->apply(pg, 2.0);
+    ASSERT_EQ(res_pg->size(), 2);
+    EXPECT_EQ((*res_pg)[1]->size(), 6);
+}
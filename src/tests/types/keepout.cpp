@@ -0,0 +1,130 @@
+#include "types/common.h"
+#include "types/point.h"
+#include "types/path.h"
+#include "types/pathgroup.h"
+#include "types/surface.h"
+#include "types/keepout.h"
+
+#include <gtest/gtest.h>
+#include <algorithm>
+
+using namespace pygraver;
+using namespace pygraver::types;
+
+// path and point (or segment) indices
+using Location = std::pair<size_t, size_t>;
+
+// closed square centred on (x, y)
+static std::shared_ptr<Path> make_square(const double x, const double y, const double size) {
+    auto path = std::make_shared<Path>(0);
+    path->emplace_back(std::make_shared<Point>(x-size/2, y-size/2, 0, 0));
+    path->emplace_back(std::make_shared<Point>(x+size/2, y-size/2, 0, 0));
+    path->emplace_back(std::make_shared<Point>(x+size/2, y+size/2, 0, 0));
+    path->emplace_back(std::make_shared<Point>(x-size/2, y+size/2, 0, 0));
+    path->emplace_back(std::make_shared<Point>(x-size/2, y-size/2, 0, 0));
+    return path;
+}
+
+// straight path from (x0, y0) to (x1, y1) with n points
+static std::shared_ptr<Path> make_line(const double x0, const double y0, const double x1, const double y1, const size_t n) {
+    auto path = std::make_shared<Path>(0);
+    for (size_t i=0; i<n; i++) {
+        auto t = n > 1 ? double(i)/(n-1) : 0.0;
+        path->emplace_back(std::make_shared<Point>(x0 + t*(x1-x0), y0 + t*(y1-y0), 0, 0));
+    }
+    return path;
+}
+
+TEST(KeepOutTest, Distance) {
+    // square ring: 2x2 contour with 1x1 hole
+    auto surface = std::make_shared<Surface>(make_square(0, 0, 2), std::vector<std::shared_ptr<Path>>({make_square(0, 0, 1)}));
+    KeepOut keepout({surface}, 0.05, 1);
+    EXPECT_NEAR(keepout.get_distance(0, 0), 0.5, 1e-9);
+    EXPECT_NEAR(keepout.get_distance(0.75, 0), -0.25, 1e-9);
+    EXPECT_NEAR(keepout.get_distance(3, 0), 2, 1e-9);
+    // c component is projected
+    EXPECT_NEAR(keepout.get_distance(std::make_shared<Point>(3, 0, 0, 90)), 2, 1e-9);
+    auto [nx, ny] = keepout.get_shape();
+    EXPECT_EQ(nx, 81);
+    EXPECT_EQ(ny, 81);
+
+    EXPECT_THROW(KeepOut({surface}, 0, 1), std::invalid_argument);
+    EXPECT_THROW(KeepOut({surface}, 0.1, -1), std::invalid_argument);
+    EXPECT_THROW(KeepOut({}, 0.1, 1), std::invalid_argument);
+}
+
+TEST(KeepOutTest, Check) {
+    auto surface = std::make_shared<Surface>(make_square(0, 0, 2), std::vector<std::shared_ptr<Path>>({make_square(0, 0, 1)}));
+    KeepOut keepout({surface}, 0.05, 1);
+    auto pg = std::make_shared<PathGroup>();
+    // 0.3 away from contour top edge
+    pg->emplace_back(make_line(-3, 1.3, 3, 1.3, 61));
+    // end points are clear, but segment crosses the ring
+    pg->emplace_back(make_line(-3, 0.75, 3, 0.75, 2));
+    // far away
+    pg->emplace_back(make_line(-3, 5, 3, 5, 2));
+
+    auto report = keepout.check(pg, 0.1, 0.1);
+    EXPECT_EQ(report.points_checked, 65);
+    EXPECT_EQ(report.segments_checked, 62);
+    EXPECT_TRUE(report.point_violations.empty());
+    ASSERT_EQ(report.segment_violations.size(), 1);
+    EXPECT_EQ(report.segment_violations[0], Location(1, 0));
+    // deepest point is 0.25 inside the ring
+    EXPECT_NEAR(report.min_clearance, -0.35, 0.01);
+    EXPECT_EQ(report.min_location, Location(1, 0));
+    EXPECT_NEAR(report.min_point->y, 0.75, 1e-9);
+
+    // wider tool: points of first path above the square and next to it are too close
+    report = keepout.check(pg, 0.25, 0.1);
+    EXPECT_EQ(report.point_violations.size(), 23);
+    EXPECT_EQ(report.point_violations.front(), Location(0, 19));
+    EXPECT_EQ(report.point_violations.back(), Location(0, 41));
+    EXPECT_EQ(report.segment_violations.size(), 1);
+
+    // without violations, smallest clearance is exact
+    auto clear = std::make_shared<PathGroup>();
+    clear->emplace_back(make_line(-3, 1.3, 3, 1.3, 61));
+    report = keepout.check(clear, 0.1, 0.1);
+    EXPECT_TRUE(report.point_violations.empty());
+    EXPECT_TRUE(report.segment_violations.empty());
+    EXPECT_NEAR(report.min_clearance, 0.2, 1e-9);
+    // closest approach between points of a clear segment
+    auto chord = std::make_shared<PathGroup>();
+    chord->emplace_back(make_line(-3, 1.5, 3, 1.5, 2));
+    report = keepout.check(chord, 0.1, 0.1);
+    EXPECT_TRUE(report.segment_violations.empty());
+    EXPECT_NEAR(report.min_clearance, 0.4, keepout.get_resolution()/32);
+    EXPECT_EQ(report.min_location, Location(0, 0));
+    EXPECT_NEAR(report.min_point->y, 1.5, 1e-9);
+
+    EXPECT_THROW(keepout.check(pg, -1, 0), std::invalid_argument);
+}
+
+TEST(KeepOutTest, MatchesExactDistance) {
+    auto surface1 = std::make_shared<Surface>(make_square(0, 0, 2));
+    auto surface2 = std::make_shared<Surface>(make_square(3, 1, 1));
+    KeepOut keepout({surface1, surface2}, 0.1, 0.2);
+    // zigzag paths across both zones
+    auto pg = std::make_shared<PathGroup>();
+    for (size_t k=0; k<20; k++) {
+        auto path = std::make_shared<Path>(0);
+        for (size_t i=0; i<200; i++)
+            path->emplace_back(std::make_shared<Point>(-2 + 0.03*i, -2 + 0.2*k + (i%2)*0.07, 0, 0));
+        pg->emplace_back(path);
+    }
+    auto report = keepout.check(pg, 0.05, 0.05);
+    size_t expected = 0;
+    for (size_t k=0; k<pg->size(); k++) {
+        auto & path = *(*pg)[k];
+        for (size_t i=0; i<path.size(); i++) {
+            auto violation = keepout.get_distance(path[i]) < 0.1;
+            expected += violation;
+            EXPECT_EQ(violation, std::binary_search(report.point_violations.begin(), report.point_violations.end(),
+                                                    Location(k, i)));
+        }
+    }
+    EXPECT_EQ(report.point_violations.size(), expected);
+    EXPECT_GT(expected, 0);
+    EXPECT_EQ(report.points_checked, 4000);
+}
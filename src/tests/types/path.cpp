@@ -172,6 +172,26 @@ TEST_F(PathTest, Buffer) {
     EXPECT_EQ(*(*p2)[1], Point(-1.0, 1.0, 0, 0));
 }
 
+TEST_F(PathTest, GeosConversion) {
+    // rotated point is converted to cartesian coordinates
+    this->path->emplace_back(std::make_shared<Point>(1,0,2,90));
+    auto ls = this->path->as_open_geos_geometry();
+    EXPECT_EQ(ls->getNumPoints(), 3);
+    auto p2 = make_path(ls.get());
+    EXPECT_EQ(*(*p2)[1], Point(1, 0, 1, 0));
+    EXPECT_NEAR((*p2)[2]->x, 0, 1e-12);
+    EXPECT_NEAR((*p2)[2]->y, 1, 1e-12);
+    // points of a converted path outlive the path itself
+    auto pt = (*p2)[1];
+    p2.reset();
+    EXPECT_EQ(*pt, Point(1, 0, 1, 0));
+
+    auto lr = this->path->as_closed_geos_geometry();
+    EXPECT_EQ(lr->getNumPoints(), 4);
+    auto p3 = make_path(lr.get());
+    EXPECT_TRUE(p3->is_closed());
+}
+
 TEST_F(PathTest, ClosePath) {
     auto p2 = this->path->close();
     EXPECT_EQ(p2->size(), this->path->size()+1);
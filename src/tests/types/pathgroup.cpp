@@ -2,6 +2,7 @@
 #include "types/path.h"
 #include "types/pathgroup.h"
 
+#include <array>
 #include <gtest/gtest.h>
 
 using namespace pygraver;
@@ -103,6 +104,92 @@ TEST_F(PathGroupTest, Reorder) {
     EXPECT_EQ((*pg2)[2], (*this->pathgroup)[0]);
 }
 
+static std::shared_ptr<Path> make_path(const std::vector<std::array<double, 4>> & coords) {
+    auto path = std::make_shared<Path>(0);
+    for (auto & c: coords)
+        path->emplace_back(std::make_shared<Point>(c[0], c[1], c[2], c[3]));
+    return path;
+}
+
+TEST_F(PathGroupTest, RemoveOverlaps) {
+    auto square = make_path({{0,0,0,0}, {1,0,0,0}, {1,1,0,0}, {0,1,0,0}, {0,0,0,0}});
+    // shares its left edge (reversed) with square
+    auto right = make_path({{1,0,0,0}, {2,0,0,0}, {2,1,0,0}, {1,1,0,0}, {1,0,0,0}});
+    auto [pg, removed] = PathGroup({square, right}).remove_overlaps(1e-6);
+    ASSERT_EQ(pg->size(), 2);
+    EXPECT_EQ((*pg)[0]->size(), 5);
+    EXPECT_EQ((*pg)[1]->size(), 4);
+    EXPECT_NEAR(removed, 1, 1e-12);
+    // closed path cut in the middle is stitched back across its start point
+    auto closed = make_path({{2,0,0,0}, {1,0,0,0}, {1,1,0,0}, {2,1,0,0}, {2,0,0,0}});
+    std::tie(pg, removed) = PathGroup({square, closed}).remove_overlaps(1e-6);
+    ASSERT_EQ(pg->size(), 2);
+    ASSERT_EQ((*pg)[1]->size(), 4);
+    EXPECT_NEAR((*(*pg)[1])[0]->y, 1, 1e-12);
+    EXPECT_NEAR((*(*pg)[1])[3]->x, 1, 1e-12);
+    EXPECT_NEAR((*(*pg)[1])[3]->y, 0, 1e-12);
+    // partial overlap within tolerance is trimmed
+    auto line = make_path({{0,0,0,0}, {10,0,0,0}});
+    auto shifted = make_path({{5,1e-4,0,0}, {15,1e-4,0,0}});
+    std::tie(pg, removed) = PathGroup({line, shifted}).remove_overlaps(1e-3);
+    ASSERT_EQ(pg->size(), 2);
+    ASSERT_EQ((*pg)[1]->size(), 2);
+    EXPECT_NEAR((*(*pg)[1])[0]->x, 10, 1e-9);
+    EXPECT_NEAR(removed, 5, 1e-9);
+    // a path going back over itself is cut where it starts retracing
+    auto hairpin = make_path({{0,0,0,0}, {5,0,0,0}, {2,0,0,0}, {2,3,0,0}});
+    std::tie(pg, removed) = PathGroup({hairpin}).remove_overlaps(1e-6);
+    ASSERT_EQ(pg->size(), 2);
+    EXPECT_EQ((*pg)[0]->size(), 2);
+    EXPECT_EQ((*pg)[1]->size(), 2);
+    EXPECT_NEAR(removed, 3, 1e-12);
+    // collinear continuation, different depths and arcs are left alone
+    auto straight = make_path({{0,0,0,0}, {1,0,0,0}, {2,0,0,0}});
+    auto deeper = make_path({{0,0,-1,0}, {2,0,-1,0}});
+    auto arc = make_path({{1,0,0,0}, {1,0,0,90}});
+    std::tie(pg, removed) = PathGroup({straight, deeper, arc, arc}).remove_overlaps(1e-6);
+    ASSERT_EQ(pg->size(), 4);
+    EXPECT_EQ((*pg)[0]->size(), 3);
+    EXPECT_NEAR(removed, 0, 1e-12);
+    EXPECT_THROW(this->pathgroup->remove_overlaps(-1), std::invalid_argument);
+}
+
+TEST_F(PathGroupTest, Query) {
+    auto line = make_path({{0,0,0,0}, {10,0,0,0}});
+    auto square = make_path({{20,0,0,0}, {21,0,0,0}, {21,1,0,0}, {20,1,0,0}, {20,0,0,0}});
+    // polar coordinates: (1, 0) at c=90 is (0, 1)
+    auto polar = make_path({{1,0,0,90}, {1,0,0,90}});
+    auto pg = PathGroup({line, square, polar});
+    EXPECT_EQ(pg.query({4, -1, 5, 1}), (std::vector<size_t>{0}));
+    // region inside square envelope, but crossing no segment of it
+    EXPECT_EQ(pg.query({20.2, 0.2, 20.8, 0.8}), (std::vector<size_t>{}));
+    EXPECT_EQ(pg.query({-1, -1, 30, 2}), (std::vector<size_t>{0, 1, 2}));
+    EXPECT_EQ(pg.query({-0.5, 0.5, 0.5, 1.5}), (std::vector<size_t>{2}));
+    EXPECT_THROW(pg.query({1, 0, 0, 1}), std::invalid_argument);
+    // index is rebuilt when paths change
+    pg.push_back(make_path({{4.5,0.5,0,0}, {4.5,0.6,0,0}}));
+    EXPECT_EQ(pg.query({4, -1, 5, 1}), (std::vector<size_t>{0, 3}));
+    // points edited in place need an explicit reset
+    (*line)[1]->x = 3;
+    pg.reset_index();
+    EXPECT_EQ(pg.query({4, -1, 5, 1}), (std::vector<size_t>{3}));
+}
+
+TEST_F(PathGroupTest, Nearest) {
+    auto line = make_path({{0,0,-1,0}, {10,0,1,0}});
+    auto square = make_path({{20,0,0,0}, {21,0,0,0}, {21,1,0,0}, {20,1,0,0}, {20,0,0,0}});
+    auto pg = PathGroup({line, square});
+    auto [idx, pt] = pg.nearest(std::make_shared<Point>(5, 3, 0, 0));
+    EXPECT_EQ(idx, 0);
+    EXPECT_NEAR(pt->x, 5, 1e-12);
+    EXPECT_NEAR(pt->y, 0, 1e-12);
+    EXPECT_NEAR(pt->z, 0, 1e-12);
+    std::tie(idx, pt) = pg.nearest(std::make_shared<Point>(20.5, 0.6, 0, 0));
+    EXPECT_EQ(idx, 1);
+    EXPECT_NEAR(pt->y, 1, 1e-12);
+    EXPECT_THROW(PathGroup().nearest(std::make_shared<Point>(0, 0, 0, 0)), std::out_of_range);
+}
+
 TEST_F(PathGroupTest, Arithmetics) {
     auto pg2 = this->pathgroup + this->pathgroup;
     EXPECT_EQ(pg2->size(), 2*this->pathgroup->size());
@@ -0,0 +1,145 @@
+#include "types/point.h"
+#include "types/path.h"
+#include "types/pathgroup.h"
+#include "types/pipeline.h"
+
+#include <gtest/gtest.h>
+
+using namespace pygraver;
+using namespace pygraver::types;
+
+// n single-point paths, with x coordinates 0 to n-1
+static std::shared_ptr<PathGroup> make_points(const size_t n) {
+    auto pg = std::make_shared<PathGroup>();
+    for (size_t i=0; i<n; i++) {
+        auto path = std::make_shared<Path>(0);
+        path->emplace_back(std::make_shared<Point>(i, 0, 0, 0));
+        pg->emplace_back(path);
+    }
+    return pg;
+}
+
+// stage function shifting paths along x
+static StageFunction shift_x(const double dx) {
+    return [=](std::shared_ptr<const PathGroup> pg) {
+        return pg->shift(std::make_shared<Point>(dx, 0, 0, 0));
+    };
+}
+
+// sorted x coordinates of first points of each path
+static std::vector<double> get_x(std::shared_ptr<const PathGroup> pg) {
+    std::vector<double> x;
+    for (auto & path: pg->get_paths())
+        x.push_back((*path)[0]->x);
+    std::sort(x.begin(), x.end());
+    return x;
+}
+
+TEST(PipelineTest, Chain) {
+    Pipeline pipeline(4, 2);
+    pipeline.add_source("src", make_points(10));
+    pipeline.add_stage("a", shift_x(1), {"src"}, 3);
+    pipeline.add_stage("b", shift_x(10), {"a"});
+    EXPECT_EQ(pipeline.get_stage_names(), std::vector<std::string>({"src", "a", "b"}));
+    auto results = pipeline.run();
+    ASSERT_EQ(results.size(), 1);
+    EXPECT_EQ(results[0].first, "b");
+    auto x = get_x(results[0].second);
+    ASSERT_EQ(x.size(), 10);
+    for (size_t i=0; i<10; i++)
+        EXPECT_NEAR(x[i], i + 11, 1e-12);
+    // a pipeline runs once; stages can't be added afterwards
+    EXPECT_THROW(pipeline.start(), std::runtime_error);
+    EXPECT_THROW(pipeline.add_stage("c", shift_x(1), {"b"}), std::runtime_error);
+}
+
+TEST(PipelineTest, Graph) {
+    Pipeline pipeline(2, 1);
+    pipeline.add_source("p", make_points(5));
+    pipeline.add_source("q", []() { return make_points(3); });
+    pipeline.add_stage("a", shift_x(100), {"p"});
+    pipeline.add_stage("b", shift_x(200), {"p"});
+    pipeline.add_stage("merge", shift_x(0), {"a", "b", "q"}, 2);
+    pipeline.add_stage("other", shift_x(0), {"q"});
+    size_t n_merge = 0, n_other = 0;
+    while (auto output = pipeline.next_output()) {
+        EXPECT_LE(output->second->size(), 2);
+        if (output->first == "merge") n_merge += output->second->size();
+        else if (output->first == "other") n_other += output->second->size();
+        else ADD_FAILURE() << "unexpected output " << output->first;
+    }
+    // chunks are shared by consumers
+    EXPECT_EQ(n_merge, 13);
+    EXPECT_EQ(n_other, 3);
+    EXPECT_FALSE(pipeline.next_output());
+}
+
+TEST(PipelineTest, Barrier) {
+    Pipeline pipeline(3, 2);
+    pipeline.add_source("src", make_points(10));
+    size_t calls = 0;
+    pipeline.add_stage("all", [&](std::shared_ptr<const PathGroup> pg) {
+        calls++;
+        return pg->reorder({9, 8, 7, 6, 5, 4, 3, 2, 1, 0});
+    }, {"src"}, 4, true);
+    auto results = pipeline.run();
+    EXPECT_EQ(calls, 1);
+    auto & pg = results[0].second;
+    ASSERT_EQ(pg->size(), 10);
+    // output is re-chunked but keeps order
+    EXPECT_NEAR((*(*pg)[0])[0]->x, 9, 1e-12);
+    EXPECT_NEAR((*(*pg)[9])[0]->x, 0, 1e-12);
+    auto stats = pipeline.get_stats();
+    EXPECT_EQ(stats[1].chunks_in, 4);
+    EXPECT_EQ(stats[1].chunks_out, 4);
+}
+
+TEST(PipelineTest, Errors) {
+    Pipeline pipeline;
+    EXPECT_THROW(pipeline.run(), std::invalid_argument);
+    EXPECT_THROW(Pipeline(0), std::invalid_argument);
+    EXPECT_THROW(Pipeline(1, 0), std::invalid_argument);
+    pipeline.add_source("src", make_points(100));
+    EXPECT_THROW(pipeline.add_source("src", make_points(1)), std::invalid_argument);
+    EXPECT_THROW(pipeline.add_stage("", shift_x(1), {"src"}), std::invalid_argument);
+    EXPECT_THROW(pipeline.add_stage("a", shift_x(1), {}), std::invalid_argument);
+    EXPECT_THROW(pipeline.add_stage("a", shift_x(1), {"none"}), std::invalid_argument);
+    EXPECT_THROW(pipeline.add_stage("a", shift_x(1), {"src", "src"}), std::invalid_argument);
+    EXPECT_THROW(pipeline.add_stage("a", shift_x(1), {"src"}, 0), std::invalid_argument);
+    // stage errors stop pipeline and are raised to caller
+    pipeline.add_stage("fail", [](std::shared_ptr<const PathGroup> pg) -> std::shared_ptr<PathGroup> {
+        if ((*(*pg)[0])[0]->x > 50)
+            throw std::out_of_range("failure");
+        return pg->copy();
+    }, {"src"}, 2);
+    pipeline.add_stage("next", shift_x(1), {"fail"});
+    EXPECT_THROW(pipeline.run(), std::out_of_range);
+}
+
+TEST(PipelineTest, Stats) {
+    Pipeline pipeline(1, 2);
+    pipeline.add_source("src", make_points(20));
+    pipeline.add_stage("slow", [](std::shared_ptr<const PathGroup> pg) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(2));
+        return pg->copy();
+    }, {"src"});
+    pipeline.add_stage("drop", [](std::shared_ptr<const PathGroup> pg) {
+        return std::make_shared<PathGroup>();
+    }, {"slow"});
+    auto results = pipeline.run();
+    EXPECT_EQ(results[0].second->size(), 0);
+    auto stats = pipeline.get_stats();
+    ASSERT_EQ(stats.size(), 3);
+    EXPECT_EQ(stats[0].name, "src");
+    EXPECT_EQ(stats[0].chunks_out, 20);
+    EXPECT_EQ(stats[1].chunks_in, 20);
+    EXPECT_EQ(stats[1].points_out, 20);
+    EXPECT_GE(stats[1].busy_time, 0.03);
+    EXPECT_GE(stats[1].wall_time, stats[1].busy_time*0.9);
+    // bounded queues: source waits for slow stage
+    EXPECT_LE(stats[1].peak_queue_chunks, 2);
+    EXPECT_GT(stats[1].peak_queue_bytes, 0);
+    // empty results aren't passed on
+    EXPECT_EQ(stats[2].chunks_in, 20);
+    EXPECT_EQ(stats[2].chunks_out, 0);
+}
@@ -3,6 +3,8 @@
 #include "types/path.h"
 #include "types/surface.h"
 
+#include <algorithm>
+#include <array>
 #include <gtest/gtest.h>
 
 using namespace pygraver;
@@ -44,10 +46,82 @@ TEST_F(SurfaceTest, MillingPaths) {
     EXPECT_EQ(paths2.size(), 0);
 }
 
+TEST_F(SurfaceTest, SpiralMilling) {
+    auto res = this->surface->get_spiral_milling(0.5, 0.3);
+    // same loops as concentric paths, in a single path
+    EXPECT_EQ(res.loops, 3);
+    ASSERT_EQ(res.paths.size(), 1);
+    EXPECT_EQ(res.retracts, 0);
+    EXPECT_EQ(res.concentric_retracts, 3);
+    EXPECT_LT(res.time, res.concentric_time);
+    auto & spiral = *res.paths[0];
+    EXPECT_EQ(*spiral[0], Point(0, 0, 0, 0));
+    // ends on outermost loop, and stays inside it
+    EXPECT_NEAR(std::max(std::abs(spiral[spiral.size()-1]->x), std::abs(spiral[spiral.size()-1]->y)), 0.75, 1e-9);
+    for (auto pt: spiral) {
+        EXPECT_LE(std::abs(pt->x), 0.75 + 1e-9);
+        EXPECT_LE(std::abs(pt->y), 0.75 + 1e-9);
+    }
+    EXPECT_EQ(this->surface->get_milling_paths(0.5, 0.3, true).size(), 1);
+    EXPECT_EQ(this->surface->get_spiral_milling(2.0, 0.3).paths.size(), 0);
+    EXPECT_THROW(this->surface->get_spiral_milling(0.5, 0.3, 0), std::out_of_range);
+
+    // two squares joined by a narrow bridge: offsets split once the bridge vanishes
+    auto path = std::make_shared<Path>(0);
+    for (auto [x, y]: std::vector<std::array<double, 2>>{{-3, -1}, {-1, -1}, {-1, -0.2}, {1, -0.2}, {1, -1}, {3, -1},
+                                                         {3, 1}, {1, 1}, {1, 0.2}, {-1, 0.2}, {-1, 1}, {-3, 1}, {-3, -1}})
+        path->emplace_back(std::make_shared<Point>(x, y, 0, 0));
+    auto res2 = Surface(path).get_spiral_milling(0.2, 0.2);
+    // one spiral per island, then one for the loops around both
+    ASSERT_EQ(res2.paths.size(), 3);
+    EXPECT_EQ(res2.retracts, 2);
+    EXPECT_EQ(res2.concentric_retracts, res2.loops);
+    EXPECT_LT((*res2.paths[0])[0]->x*(*res2.paths[1])[0]->x, 0);
+    EXPECT_GT(res2.concentric_time - res2.time, 0);
+
+    // U shape: turns blending loops across the notch are replaced by concentric loops
+    auto u = std::make_shared<Path>(0);
+    for (auto [x, y]: std::vector<std::array<double, 2>>{{0, 0}, {3, 0}, {3, 3}, {2, 3}, {2, 1}, {1, 1}, {1, 3}, {0, 3}, {0, 0}})
+        u->emplace_back(std::make_shared<Point>(x, y, 0, 0));
+    auto res3 = Surface(u).get_spiral_milling(0.2, 0.2);
+    ASSERT_GT(res3.paths.size(), 0);
+    for (auto & p: res3.paths) {
+        for (size_t i=0; i<p->size(); i++) {
+            auto pt = (*p)[i];
+            auto prev = (*p)[i > 0 ? i-1 : 0];
+            // points and segment midpoints keep tool radius away from notch (up to arc approximation)
+            for (auto [x, y]: std::vector<std::array<double, 2>>{{pt->x, pt->y}, {(pt->x + prev->x)/2, (pt->y + prev->y)/2}})
+                EXPECT_GT(std::hypot(std::max({1 - x, 0.0, x - 2}), std::max({1 - y, 0.0, y - 3})), 0.1 - 1e-3) << x << ", " << y;
+        }
+    }
+}
+
 TEST_F(SurfaceTest, MilledSurface) {
     auto s2 = this->surface->get_milled_surface(0.5, 0.3);
     EXPECT_EQ(s2.size(), 1);
     EXPECT_EQ(s2[0]->get_contours()[0]->get_largest_radius(), sqrt(2)*0.75+0.25);
+    auto s3 = this->surface->get_milled_surface(0.5, 0.3, MillingMode::Raster, 0.01);
+    EXPECT_EQ(s3.size(), 1);
+    EXPECT_EQ(s3[0]->get_holes().size(), 0);
+    EXPECT_NEAR(s3[0]->get_contours()[0]->get_largest_radius(), sqrt(2)*0.75+0.25, 0.02);
+    EXPECT_THROW(this->surface->get_milled_surface(0.5, 0.3, MillingMode::Raster, 1e-6), std::invalid_argument);
+}
+
+TEST_F(SurfaceTest, Nearest) {
+    auto pt = this->surface->nearest(std::make_shared<Point>(0.2, 0.5, 0, 0));
+    EXPECT_NEAR(pt->x, 0.2, 1e-12);
+    EXPECT_NEAR(pt->y, 1, 1e-12);
+    // a hole boundary can be closer than contours
+    auto hole = std::make_shared<Path>(0);
+    for (auto [x, y]: std::vector<std::pair<double, double>>{{-0.5, -0.5}, {0.5, -0.5}, {0.5, 0.5}, {-0.5, 0.5}})
+        hole->emplace_back(std::make_shared<Point>(x, y, 0, 0));
+    auto holed = Surface(this->surface->get_contours(), std::vector<std::shared_ptr<Path>>{hole});
+    // open hole ring is closed by index
+    pt = holed.nearest(std::make_shared<Point>(-0.6, 0, 0, 0));
+    EXPECT_NEAR(pt->x, -0.5, 1e-12);
+    EXPECT_NEAR(pt->y, 0, 1e-12);
+    EXPECT_FALSE(holed.contains(std::make_shared<Point>(0, 0, 0, 0)));
+    EXPECT_TRUE(holed.contains(std::make_shared<Point>(-0.75, 0, 0, 0)));
 }
 
 TEST_F(SurfaceTest, Centroid) {
@@ -177,3 +251,112 @@ TEST_F(SurfaceTest, CorrectHeight) {
     EXPECT_TRUE(almost_equal((*cpcn[0])[2]->x, -0.9, 6));
     EXPECT_TRUE(almost_equal((*cpcn[0])[5]->x, 0.9, 6));
 }
+
+TEST_F(SurfaceTest, FromPaths) {
+    auto p1 = this->surface->get_contours()[0];
+    // three nested squares with same orientation and a separate one
+    auto paths = std::vector<std::shared_ptr<Path>>{
+        p1->scale(5, std::make_shared<Point>()),
+        p1->scale(3, std::make_shared<Point>()),
+        p1,
+        p1->shift(std::make_shared<Point>(20, 0, 0, 0))
+    };
+    auto s1 = Surface::from_paths(paths, FillRule::EvenOdd);
+    EXPECT_EQ(s1.size(), 3);
+    EXPECT_EQ(s1[0]->get_holes().size(), 1);
+    EXPECT_EQ(s1[0]->get_holes()[0], paths[1]);
+    EXPECT_EQ(s1[1]->get_contours()[0], paths[2]);
+    EXPECT_EQ(s1[1]->get_holes().size(), 0);
+    EXPECT_EQ(s1[2]->get_holes().size(), 0);
+    // same orientation => inner squares don't bound anything
+    auto s2 = Surface::from_paths(paths, FillRule::NonZero);
+    EXPECT_EQ(s2.size(), 2);
+    EXPECT_EQ(s2[0]->get_holes().size(), 0);
+    // reversed orientation => middle square is a hole and inner square a contour
+    paths[1] = paths[1]->flip();
+    auto s3 = Surface::from_paths(paths, FillRule::NonZero);
+    EXPECT_EQ(s3.size(), 3);
+    EXPECT_EQ(s3[0]->get_holes().size(), 1);
+    // open paths get closed, degenerate paths are ignored
+    auto open = std::make_shared<Path>(0);
+    open->emplace_back(std::make_shared<Point>(-1, -1, 0, 0));
+    open->emplace_back(std::make_shared<Point>(1, -1, 0, 0));
+    open->emplace_back(std::make_shared<Point>(1, 1, 0, 0));
+    auto line = std::make_shared<Path>(0);
+    line->emplace_back(std::make_shared<Point>(0, 0, 0, 0));
+    line->emplace_back(std::make_shared<Point>(1, 0, 0, 0));
+    line->emplace_back(std::make_shared<Point>(2, 0, 0, 0));
+    auto s4 = Surface::from_paths({open, line});
+    EXPECT_EQ(s4.size(), 1);
+    EXPECT_TRUE(s4[0]->get_contours()[0]->is_closed());
+}
+
+TEST_F(SurfaceTest, GridSize) {
+    EXPECT_EQ(this->surface->get_grid_size(), 0);
+    EXPECT_THROW(this->surface->set_grid_size(-1), std::invalid_argument);
+    auto p1 = this->surface->get_contours()[0];
+    // vertices are rounded to grid, and resulting surfaces keep grid size
+    auto s1 = Surface({p1, p1->shift(std::make_shared<Point>(0.333,0.333,0,0))});
+    s1.set_grid_size(0.1);
+    auto c1 = s1.combine();
+    ASSERT_EQ(c1.size(), 1);
+    EXPECT_EQ(c1[0]->get_grid_size(), 0.1);
+    for (auto pt: *c1[0]->get_contours()[0]) {
+        EXPECT_NEAR(pt->x*10, std::round(pt->x*10), 1e-9);
+        EXPECT_NEAR(pt->y*10, std::round(pt->y*10), 1e-9);
+    }
+    // overlapping holes need no repair
+    auto ph = p1->buffer(-0.3);
+    auto s2 = Surface(p1, {ph, ph->shift(std::make_shared<Point>(0.2,0.2,0,0))});
+    s2.set_grid_size(1e-6);
+    auto c2 = s2.combine();
+    ASSERT_EQ(c2.size(), 1);
+    EXPECT_EQ(c2[0]->get_holes().size(), 1);
+    // self-intersecting contour is split instead of being dropped
+    auto bowtie = std::make_shared<Path>(0);
+    for (auto [x, y]: std::vector<std::pair<double, double>>{{0, 0}, {1, 1}, {1, 0}, {0, 1}, {0, 0}})
+        bowtie->emplace_back(std::make_shared<Point>(x, y, 0, 0));
+    auto s3 = Surface(bowtie);
+    s3.set_grid_size(1e-6);
+    EXPECT_EQ(s3.combine().size(), 2);
+    // boolean operations use the larger grid size
+    auto s4 = std::make_shared<Surface>(p1->shift(std::make_shared<Point>(0.5,0,0,0)));
+    s4->set_grid_size(1e-3);
+    auto op = this->surface->boolean_operation(s4, BooleanOperation::Difference);
+    ASSERT_EQ(op.size(), 1);
+    EXPECT_EQ(op[0]->get_grid_size(), 1e-3);
+    // milling paths and height correction work on grid as well
+    s4->set_grid_size(1e-6);
+    EXPECT_GT(s4->get_milling_paths(0.2, 0.2).size(), 1);
+    auto path = std::make_shared<Path>(0);
+    path->emplace_back(std::make_shared<Point>(-3, 0, 0, 0));
+    path->emplace_back(std::make_shared<Point>(0, 0, 0, 0));
+    auto corrected = s4->correct_height({path}, 0, 1, true, false);
+    EXPECT_NEAR((*corrected[0])[0]->z, 1, 1e-12);
+    EXPECT_NEAR((*corrected[0])[1]->z, 0, 1e-12);
+}
+
+TEST_F(SurfaceTest, SnapRounding) {
+    // rosettes, each rotated by a tiny angle from the previous one:
+    // edges nearly overlap, which is hard on floating precision overlays
+    std::vector<std::shared_ptr<Path>> loops;
+    for (auto k=0; k<8; k++) {
+        auto path = std::make_shared<Path>(0);
+        path->reserve(721);
+        for (auto i=0; i<=720; i++) {
+            auto t = 2*M_PI*(i % 720)/720 + 1e-9*k;
+            auto r = 1 + 0.2*cos(12*t);
+            path->emplace_back(std::make_shared<Point>(r*cos(t), r*sin(t), 0, 0));
+        }
+        loops.push_back(path);
+    }
+    auto s = Surface(loops);
+    s.set_grid_size(1e-6);
+    EXPECT_EQ(s.combine().size(), 1);
+    for (size_t k=1; k<loops.size(); k++) {
+        auto s1 = std::make_shared<Surface>(loops[k-1]);
+        auto s2 = std::make_shared<Surface>(loops[k]->scale(1 + 1e-9, std::make_shared<Point>()));
+        s1->set_grid_size(1e-6);
+        EXPECT_NO_THROW(s1->boolean_operation(s2, BooleanOperation::SymmetricDifference));
+    }
+}
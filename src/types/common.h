@@ -8,7 +8,13 @@
 #include <geos/geom/PrecisionModel.h>
 #include <geos/geom/GeometryFactory.h>
 #include <pybind11/pybind11.h>
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <mutex>
+#include <thread>
 #include <tuple>
+#include <vector>
 
 namespace py = pybind11;
 namespace gg = geos::geom;
@@ -149,6 +155,43 @@ namespace pygraver::types {
         return x - M_PI;
     }
 
+   /** \brief Run a function on a range of indices with worker threads.
+    *
+    *  Indices are handed out one at a time, so that uneven work is balanced;
+    *  the calling thread takes part. If a call throws, remaining indices are
+    *  skipped and the first exception is thrown again once every thread is
+    *  done.
+    *
+    *  \tparam Function: callable taking an index.
+    *  \param n: number of indices.
+    *  \param fun: function to call for each index.
+    *  \param grain: smallest number of indices per thread, for cheap calls.
+    */
+    template <class Function> static void parallel_for(const size_t n, const Function & fun, const size_t grain=1) {
+        std::atomic<size_t> next = 0;
+        std::exception_ptr error;
+        std::mutex mutex;
+        auto worker = [&]() {
+            try {
+                for (auto k = next++; k < n; k = next++)
+                    fun(k);
+            } catch (...) {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (!error) error = std::current_exception();
+                next = n;
+            }
+        };
+        auto n_threads = std::max<size_t>(1, std::min<size_t>(std::thread::hardware_concurrency(), n/std::max<size_t>(1, grain)));
+        std::vector<std::thread> threads;
+        for (size_t i=1; i<n_threads; i++)
+            threads.emplace_back(worker);
+        worker();
+        for (auto & thread: threads)
+            thread.join();
+        if (error)
+            std::rethrow_exception(error);
+    }
+
    /** \brief Pack a vector into a Python list object.
     *  \tparam T: type of objects in vector.
     *  \param v: vector.
@@ -0,0 +1,311 @@
+/** \file compressedpathgroup.cpp
+ *  \brief Implementation file for CompressedPathGroup class.
+ *
+ *  Author: Vincent Paeder
+ *  License: MIT
+ */
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <stdexcept>
+#include <pybind11/numpy.h>
+#include <pybind11/stl.h>
+
+#include "common.h"
+#include "compressedpathgroup.h"
+#include "path.h"
+#include "pathgroup.h"
+#include "point.h"
+#include "../log.h"
+
+namespace pygraver::types {
+
+    /** \brief Clock used to measure encoding and decoding times. */
+    using CompressionClock = std::chrono::steady_clock;
+
+    /** \brief Size of a std::make_shared control block (virtual table pointer and two counters). */
+    static const size_t control_block_bytes = sizeof(void*) + 2*sizeof(int);
+
+    /** \brief Largest quantized value; differences of quantized values must fit in 64 bits. */
+    static const double max_quantized = 4.0e18;
+
+    /** \brief Quantize a coordinate.
+     *  \param value: coordinate.
+     *  \param inv_step: inverse of quantization step.
+     *  \returns quantized value; throws std::invalid_argument if value can't be represented.
+     */
+    static int64_t quantize(const double value, const double inv_step) {
+        auto q = std::round(value*inv_step);
+        if (!(std::abs(q) < max_quantized))
+            throw std::invalid_argument("Coordinate can't be quantized with given resolution.");
+        return (int64_t)q;
+    }
+
+    /** \brief Append a signed value as a zigzag-encoded variable-length integer.
+     *  \param buffer: output buffer.
+     *  \param value: value to append.
+     */
+    static void write_varint(std::vector<uint8_t> & buffer, const int64_t value) {
+        // zigzag: 0, -1, 1, -2, ... become 0, 1, 2, 3, ...
+        auto v = ((uint64_t)value << 1) ^ (uint64_t)(value >> 63);
+        while (v >= 0x80) {
+            buffer.push_back(uint8_t(v) | 0x80);
+            v >>= 7;
+        }
+        buffer.push_back(uint8_t(v));
+    }
+
+    /** \brief Read a zigzag-encoded variable-length integer.
+     *  \param p: read position, moved past the value.
+     *  \returns decoded value.
+     */
+    static inline int64_t read_varint(const uint8_t * & p) {
+        uint64_t v = *p++;
+        // most differences fit in one byte
+        if (v >= 0x80) {
+            v &= 0x7f;
+            int shift = 7;
+            uint64_t b;
+            do {
+                b = *p++;
+                v |= (b & 0x7f) << shift;
+                shift += 7;
+            } while (b >= 0x80);
+        }
+        return int64_t(v >> 1) ^ -int64_t(v & 1);
+    }
+
+    CompressedPathGroup::const_iterator::const_iterator(const CompressedPathGroup * group, const size_t idx): group(group), idx(idx) {}
+
+    const std::shared_ptr<Path> & CompressedPathGroup::const_iterator::operator*() const {
+        if (!this->path)
+            this->path = this->group->get_path(this->idx);
+        return this->path;
+    }
+
+    CompressedPathGroup::const_iterator & CompressedPathGroup::const_iterator::operator++() {
+        this->idx++;
+        this->path.reset();
+        return *this;
+    }
+
+    bool CompressedPathGroup::const_iterator::operator==(const const_iterator & other) const {
+        return this->group == other.group && this->idx == other.idx;
+    }
+
+    bool CompressedPathGroup::const_iterator::operator!=(const const_iterator & other) const {
+        return !(*this == other);
+    }
+
+    CompressedPathGroup::CompressedPathGroup(std::shared_ptr<const PathGroup> pg, const double resolution, const double angle_resolution) {
+        PYG_LOG_V("Creating compressed path group 0x{:x}", (uint64_t)this);
+        if (resolution <= 0 || angle_resolution <= 0)
+            throw std::invalid_argument("Resolution must be strictly positive.");
+        auto t0 = CompressionClock::now();
+        this->resolution = resolution;
+        this->angle_resolution = angle_resolution;
+        auto inv_step = 1/resolution, inv_angle_step = 1/angle_resolution;
+
+        auto & paths = pg->get_paths();
+        std::vector<std::vector<uint8_t>> buffers(paths.size());
+        this->counts.resize(paths.size());
+        // largest quantization errors of each path
+        std::vector<double> errors(paths.size(), 0), angle_errors(paths.size(), 0);
+        parallel_for(paths.size(), [&](const size_t k) {
+            auto & path = *paths[k];
+            auto & buffer = buffers[k];
+            // 4 one-byte values per point is the usual minimum
+            buffer.reserve(4*path.size());
+            int64_t prev[4] = {0, 0, 0, 0};
+            double path_error = 0, path_angle_error = 0;
+            for (auto & p: path) {
+                int64_t q[4] = {quantize(p->x, inv_step), quantize(p->y, inv_step), quantize(p->z, inv_step), quantize(p->c, inv_angle_step)};
+                for (size_t a=0; a<4; a++) {
+                    write_varint(buffer, q[a] - prev[a]);
+                    prev[a] = q[a];
+                }
+                path_error = std::max({path_error, std::abs(q[0]*resolution - p->x), std::abs(q[1]*resolution - p->y),
+                                       std::abs(q[2]*resolution - p->z)});
+                path_angle_error = std::max(path_angle_error, std::abs(q[3]*angle_resolution - p->c));
+            }
+            buffer.shrink_to_fit();
+            this->counts[k] = path.size();
+            errors[k] = path_error;
+            angle_errors[k] = path_angle_error;
+        });
+        auto max_error = errors.empty() ? 0.0 : *std::max_element(errors.begin(), errors.end());
+        auto max_angle_error = angle_errors.empty() ? 0.0 : *std::max_element(angle_errors.begin(), angle_errors.end());
+
+        // a single buffer avoids one allocation per path
+        this->offsets.resize(paths.size() + 1);
+        this->offsets[0] = 0;
+        for (size_t k=0; k<paths.size(); k++)
+            this->offsets[k+1] = this->offsets[k] + buffers[k].size();
+        this->data.resize(this->offsets.back());
+        for (size_t k=0; k<paths.size(); k++) {
+            std::copy(buffers[k].begin(), buffers[k].end(), this->data.begin() + this->offsets[k]);
+            std::vector<uint8_t>().swap(buffers[k]);
+        }
+
+        auto & stats = this->stats;
+        stats.paths = paths.size();
+        for (auto n: this->counts)
+            stats.points += n;
+        stats.original_bytes = stats.points*(sizeof(Point) + sizeof(std::shared_ptr<Point>) + control_block_bytes)
+                             + stats.paths*(sizeof(Path) + sizeof(std::shared_ptr<Path>) + control_block_bytes);
+        stats.compressed_bytes = sizeof(CompressedPathGroup) + this->data.size() + (this->offsets.size() + this->counts.size())*sizeof(size_t);
+        stats.ratio = double(stats.original_bytes)/stats.compressed_bytes;
+        stats.max_error = max_error;
+        stats.max_angle_error = max_angle_error;
+        stats.encode_time = std::chrono::duration<double>(CompressionClock::now() - t0).count();
+        PYG_LOG_D("Compressed {:d} points from {:d} to {:d} bytes", stats.points, stats.original_bytes, stats.compressed_bytes);
+    }
+
+    CompressedPathGroup::~CompressedPathGroup() {
+        PYG_LOG_V("Deleting compressed path group 0x{:x}", (uint64_t)this);
+    }
+
+    size_t CompressedPathGroup::size() const {
+        return this->counts.size();
+    }
+
+    size_t CompressedPathGroup::get_point_count() const {
+        return this->stats.points;
+    }
+
+    double CompressedPathGroup::get_resolution() const {
+        return this->resolution;
+    }
+
+    double CompressedPathGroup::get_angle_resolution() const {
+        return this->angle_resolution;
+    }
+
+    void CompressedPathGroup::decode(const size_t idx, std::vector<double> & xs, std::vector<double> & ys,
+                                     std::vector<double> & zs, std::vector<double> & cs) const {
+        if (idx >= this->size())
+            throw std::out_of_range("Index out of range.");
+        auto t0 = CompressionClock::now();
+        auto n = this->counts[idx];
+        xs.resize(n);
+        ys.resize(n);
+        zs.resize(n);
+        cs.resize(n);
+        auto p = this->data.data() + this->offsets[idx];
+        int64_t x = 0, y = 0, z = 0, c = 0;
+        for (size_t i=0; i<n; i++) {
+            x += read_varint(p);
+            y += read_varint(p);
+            z += read_varint(p);
+            c += read_varint(p);
+            xs[i] = x*this->resolution;
+            ys[i] = y*this->resolution;
+            zs[i] = z*this->resolution;
+            cs[i] = c*this->angle_resolution;
+        }
+        this->decoded_points += n;
+        this->decode_nanoseconds += std::chrono::duration_cast<std::chrono::nanoseconds>(CompressionClock::now() - t0).count();
+    }
+
+    std::shared_ptr<Path> CompressedPathGroup::get_path(const size_t idx) const {
+        PYG_LOG_V("Decoding path {:d} of compressed path group 0x{:x}", idx, (uint64_t)this);
+        std::vector<double> xs, ys, zs, cs;
+        this->decode(idx, xs, ys, zs, cs);
+        auto pts = make_point_block(xs.size());
+        for (size_t i=0; i<pts.size(); i++) {
+            auto & pt = *pts[i];
+            pt.x = xs[i];
+            pt.y = ys[i];
+            pt.z = zs[i];
+            pt.c = cs[i];
+        }
+        return std::make_shared<Path>(std::move(pts));
+    }
+
+    std::shared_ptr<PathGroup> CompressedPathGroup::decompress() const {
+        PYG_LOG_V("Decompressing path group 0x{:x}", (uint64_t)this);
+        std::vector<std::shared_ptr<Path>> paths(this->size());
+        parallel_for(paths.size(), [&](const size_t k) {
+            paths[k] = this->get_path(k);
+        });
+        return std::make_shared<PathGroup>(paths);
+    }
+
+    CompressionStats CompressedPathGroup::get_stats() const {
+        auto stats = this->stats;
+        stats.decoded_points = this->decoded_points;
+        stats.decode_time = this->decode_nanoseconds*1e-9;
+        stats.decode_rate = stats.decode_time > 0 ? stats.decoded_points/stats.decode_time : 0;
+        return stats;
+    }
+
+    CompressedPathGroup::const_iterator CompressedPathGroup::begin() const {
+        return const_iterator(this, 0);
+    }
+
+    CompressedPathGroup::const_iterator CompressedPathGroup::end() const {
+        return const_iterator(this, this->size());
+    }
+
+    std::shared_ptr<Path> CompressedPathGroup::py_get_item(int idx) const {
+        if (idx<0)
+            idx = this->size() + idx;
+
+        if (idx<0 || idx>=this->size()) {
+            PyErr_SetString(PyExc_ValueError, "Index out of bounds.");
+            throw py::error_already_set();
+        }
+        return this->get_path(idx);
+    }
+
+    py::tuple CompressedPathGroup::py_decode(int idx) const {
+        if (idx<0)
+            idx = this->size() + idx;
+
+        if (idx<0 || idx>=this->size()) {
+            PyErr_SetString(PyExc_ValueError, "Index out of bounds.");
+            throw py::error_already_set();
+        }
+        std::vector<double> xs, ys, zs, cs;
+        {
+            py::gil_scoped_release release;
+            this->decode(idx, xs, ys, zs, cs);
+        }
+        return py::make_tuple(py::array_t<double>(xs.size(), xs.data()),
+                              py::array_t<double>(ys.size(), ys.data()),
+                              py::array_t<double>(zs.size(), zs.data()),
+                              py::array_t<double>(cs.size(), cs.data()));
+    }
+
+    void py_compressedpathgroup_exports(py::module_ & mod) {
+        py::class_<CompressionStats>(mod, "CompressionStats")
+        .def_readonly("paths", &CompressionStats::paths)
+        .def_readonly("points", &CompressionStats::points)
+        .def_readonly("original_bytes", &CompressionStats::original_bytes)
+        .def_readonly("compressed_bytes", &CompressionStats::compressed_bytes)
+        .def_readonly("ratio", &CompressionStats::ratio)
+        .def_readonly("max_error", &CompressionStats::max_error)
+        .def_readonly("max_angle_error", &CompressionStats::max_angle_error)
+        .def_readonly("encode_time", &CompressionStats::encode_time)
+        .def_readonly("decoded_points", &CompressionStats::decoded_points)
+        .def_readonly("decode_time", &CompressionStats::decode_time)
+        .def_readonly("decode_rate", &CompressionStats::decode_rate)
+        ;
+
+        py::class_<CompressedPathGroup, std::shared_ptr<CompressedPathGroup>>(mod, "CompressedPathGroup")
+        .def(py::init<std::shared_ptr<const PathGroup>, const double, const double>(),
+             py::arg("pathgroup"), py::arg("resolution")=1e-4, py::arg("angle_resolution")=1e-4, py::call_guard<py::gil_scoped_release>())
+        .def_property_readonly("resolution", &CompressedPathGroup::get_resolution)
+        .def_property_readonly("angle_resolution", &CompressedPathGroup::get_angle_resolution)
+        .def_property_readonly("point_count", &CompressedPathGroup::get_point_count)
+        .def_property_readonly("stats", &CompressedPathGroup::get_stats)
+        .def("decompress", &CompressedPathGroup::decompress, py::call_guard<py::gil_scoped_release>())
+        .def("decode", &CompressedPathGroup::py_decode, py::arg("idx"))
+        .def("__len__", &CompressedPathGroup::size)
+        .def("__getitem__", &CompressedPathGroup::py_get_item)
+        .def("__iter__", [](std::shared_ptr<const CompressedPathGroup> p){return py::make_iterator(p->begin(), p->end());}
+                       , py::keep_alive<0, 1>())
+        ;
+    }
+
+}
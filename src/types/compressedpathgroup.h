@@ -0,0 +1,223 @@
+/** \file compressedpathgroup.h
+ *  \brief Header file for CompressedPathGroup class and associated statistics structure.
+ *
+ *  Author: Vincent Paeder
+ *  License: MIT
+ */
+#pragma once
+#include <pybind11/pybind11.h>
+#include <atomic>
+#include <cstdint>
+#include <iterator>
+#include <memory>
+#include <vector>
+
+namespace py = pybind11;
+
+namespace pygraver::types {
+
+    class Path;
+    class PathGroup;
+
+    /** \brief Statistics of a compressed path group. */
+    struct CompressionStats {
+        /** \brief Number of paths. */
+        size_t paths = 0;
+        /** \brief Number of points. */
+        size_t points = 0;
+        /** \brief Estimated memory held by the same paths as a PathGroup, in bytes. */
+        size_t original_bytes = 0;
+        /** \brief Memory held by compressed paths, in bytes. */
+        size_t compressed_bytes = 0;
+        /** \brief Ratio of original to compressed memory. */
+        double ratio = 0;
+        /** \brief Largest quantization error on x, y and z. */
+        double max_error = 0;
+        /** \brief Largest quantization error on c. */
+        double max_angle_error = 0;
+        /** \brief Time spent compressing, in seconds. */
+        double encode_time = 0;
+        /** \brief Number of points decoded so far. */
+        size_t decoded_points = 0;
+        /** \brief Time spent decoding so far, summed over threads, in seconds. */
+        double decode_time = 0;
+        /** \brief Decoded points per second (0 if nothing was decoded yet). */
+        double decode_rate = 0;
+    };
+
+    /** \brief Class holding paths in compressed form.
+     *
+     *  Coordinates are quantized to a fixed resolution (one for x, y and z,
+     *  one for c). Each path starts with its first quantized point, followed
+     *  by differences between consecutive points; values are zigzag-encoded
+     *  (small negative numbers become small positive ones) and written as
+     *  variable-length integers (7 bits per byte). Smooth toolpaths then take
+     *  a few bytes per point instead of a Point object, its shared pointer and
+     *  its control block. Paths are decoded independently, so they can be
+     *  streamed one at a time to G-code generation or rendering without
+     *  decompressing the whole group.
+     */
+    class CompressedPathGroup {
+    private:
+        /** \brief Encoded paths, one after another. */
+        std::vector<uint8_t> data;
+
+        /** \brief Offset of each path in data, plus end offset. */
+        std::vector<size_t> offsets;
+
+        /** \brief Number of points of each path. */
+        std::vector<size_t> counts;
+
+        /** \brief Quantization step of x, y and z. */
+        double resolution;
+
+        /** \brief Quantization step of c. */
+        double angle_resolution;
+
+        /** \brief Statistics gathered during compression. */
+        CompressionStats stats;
+
+        /** \brief Number of points decoded so far. */
+        mutable std::atomic<size_t> decoded_points = 0;
+
+        /** \brief Time spent decoding so far, in nanoseconds. */
+        mutable std::atomic<int64_t> decode_nanoseconds = 0;
+
+    public:
+        /** \brief Iterator over paths; each path is decoded when the iterator is dereferenced. */
+        class const_iterator {
+        public:
+            using iterator_category = std::forward_iterator_tag;
+            using value_type = std::shared_ptr<Path>;
+            using difference_type = std::ptrdiff_t;
+            using pointer = const std::shared_ptr<Path> *;
+            using reference = const std::shared_ptr<Path> &;
+
+        private:
+            /** \brief Iterated instance. */
+            const CompressedPathGroup * group;
+
+            /** \brief Current path index. */
+            size_t idx;
+
+            /** \brief Current path, once decoded. */
+            mutable std::shared_ptr<Path> path;
+
+        public:
+            /** \brief Constructor.
+             *  \param group: iterated instance.
+             *  \param idx: path index.
+             */
+            const_iterator(const CompressedPathGroup * group, const size_t idx);
+
+            /** \brief Dereference operator.
+             *  \returns current path.
+             */
+            const std::shared_ptr<Path> & operator*() const;
+
+            /** \brief Increment operator.
+             *  \returns reference to iterator.
+             */
+            const_iterator & operator++();
+
+            /** \brief Equality operator.
+             *  \param other: iterator to compare with.
+             *  \returns true if iterators point to the same path.
+             */
+            bool operator==(const const_iterator & other) const;
+
+            /** \brief Inequality operator.
+             *  \param other: iterator to compare with.
+             *  \returns true if iterators point to different paths.
+             */
+            bool operator!=(const const_iterator & other) const;
+        };
+
+        /** \brief Constructor; paths are compressed in parallel.
+         *  \param pg: paths to compress.
+         *  \param resolution: quantization step of x, y and z (>0).
+         *  \param angle_resolution: quantization step of c, in degrees (>0).
+         */
+        CompressedPathGroup(std::shared_ptr<const PathGroup> pg, const double resolution=1e-4, const double angle_resolution=1e-4);
+
+        /** \brief Destructor. */
+        ~CompressedPathGroup();
+
+        /** \brief Get number of paths.
+         *  \returns number of paths.
+         */
+        size_t size() const;
+
+        /** \brief Get number of points.
+         *  \returns number of points of all paths.
+         */
+        size_t get_point_count() const;
+
+        /** \brief Get quantization step of x, y and z.
+         *  \returns quantization step.
+         */
+        double get_resolution() const;
+
+        /** \brief Get quantization step of c.
+         *  \returns quantization step, in degrees.
+         */
+        double get_angle_resolution() const;
+
+        /** \brief Decode coordinates of a path into caller buffers.
+         *
+         *  This doesn't create any Point object; buffers are resized as needed.
+         *
+         *  \param idx: path index.
+         *  \param xs: x coordinates.
+         *  \param ys: y coordinates.
+         *  \param zs: z coordinates.
+         *  \param cs: c coordinates.
+         */
+        void decode(const size_t idx, std::vector<double> & xs, std::vector<double> & ys,
+                    std::vector<double> & zs, std::vector<double> & cs) const;
+
+        /** \brief Decode a path.
+         *  \param idx: path index; throws std::out_of_range if there is no such path.
+         *  \returns decoded path.
+         */
+        std::shared_ptr<Path> get_path(const size_t idx) const;
+
+        /** \brief Decode every path.
+         *  \returns decoded path group.
+         */
+        std::shared_ptr<PathGroup> decompress() const;
+
+        /** \brief Get compression and decoding statistics.
+         *  \returns statistics.
+         */
+        CompressionStats get_stats() const;
+
+        /** \brief Get iterator to first path.
+         *  \returns iterator.
+         */
+        const_iterator begin() const;
+
+        /** \brief Get iterator past last path.
+         *  \returns iterator.
+         */
+        const_iterator end() const;
+
+        /** \brief Python-specific function to get a path (negative indices count from the end).
+         *  \param idx: path index.
+         *  \returns decoded path.
+         */
+        std::shared_ptr<Path> py_get_item(int idx) const;
+
+        /** \brief Python-specific function to decode coordinates of a path without creating points.
+         *  \param idx: path index (negative indices count from the end).
+         *  \returns x, y, z and c coordinates, as numpy arrays.
+         */
+        py::tuple py_decode(int idx) const;
+    };
+
+    /** \brief Export function for Python wrapper.
+     *  \param mod: module or submodule to add content to.
+     */
+    void py_compressedpathgroup_exports(py::module_ & mod);
+
+}
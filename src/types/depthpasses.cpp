@@ -0,0 +1,264 @@
+/** \file depthpasses.cpp
+ *  \brief Implementation file for DepthPasses class.
+ *
+ *  Author: Vincent Paeder
+ *  License: MIT
+ */
+#include <algorithm>
+#include <pybind11/stl.h>
+
+#include "depthpasses.h"
+#include "path.h"
+#include "pathgroup.h"
+#include "point.h"
+#include "../log.h"
+
+namespace pygraver::types {
+
+    DepthPasses::DepthPasses(std::shared_ptr<const PathGroup> pg, const std::vector<double> & depths,
+                             const std::vector<double> & feed_factors, const double limit_height,
+                             const double ramp_length, const PassOrder order,
+                             const std::optional<double> safe_height) {
+        PYG_LOG_V("Creating {:d} depth passes 0x{:x} for path group 0x{:x}", depths.size(), (uint64_t)this, (uint64_t)pg.get());
+        if (depths.empty())
+            throw std::invalid_argument("At least one pass depth must be given.");
+        if (!feed_factors.empty() && feed_factors.size() != depths.size())
+            throw std::invalid_argument("Number of feed rate factors must match number of passes.");
+        for (auto factor: feed_factors)
+            if (factor <= 0)
+                throw std::invalid_argument("Feed rate factors must be positive.");
+        if (ramp_length < 0)
+            throw std::invalid_argument("Ramp length must be positive or 0.");
+        this->depths = depths;
+        this->feed_factors = feed_factors.empty() ? std::vector<double>(depths.size(), 1) : feed_factors;
+        this->limit_height = limit_height;
+        this->order = order;
+        this->safe_height = safe_height;
+
+        // points are copied so that later changes to paths can't make indices and profiles stale
+        auto & paths = pg->get_paths();
+        this->offsets.reserve(paths.size() + 1);
+        this->offsets.push_back(0);
+        for (auto & path: paths)
+            this->offsets.push_back(this->offsets.back() + path->size());
+        this->points.reserve(this->offsets.back());
+        for (auto & path: paths)
+            for (auto & pt: *path)
+                this->points.push_back(*pt);
+
+        // ramp profile is the lift that create_ramps gives for a unit ramp height
+        this->ramps.resize(paths.size());
+        if (ramp_length > 0) {
+            for (size_t i=0; i<paths.size(); i++) {
+                auto n = paths[i]->size();
+                if (n < 2) continue;
+                auto ramped = paths[i]->create_ramps(limit_height, 1, ramp_length, RampDirection::Backward);
+                auto src = paths[i]->begin();
+                auto dst = ramped->begin();
+                std::vector<double> profile(n);
+                auto lifted = false;
+                for (size_t j=0; j<n; j++) {
+                    profile[j] = std::clamp(dst[j]->z - src[j]->z, 0.0, 1.0);
+                    lifted = lifted || profile[j] > 0;
+                }
+                if (lifted)
+                    this->ramps[i] = std::move(profile);
+            }
+        }
+
+        // count moves: points of every pass, plus retract and approach moves between traversals
+        this->n_moves = this->points.size()*depths.size();
+        if (safe_height) {
+            auto n_paths = paths.size();
+            auto n_passes = depths.size();
+            auto have_prev = false;
+            PassMove prev;
+            for (size_t t=0; t<n_paths*n_passes; t++) {
+                auto pass = this->order == PassOrder::ByDepth ? t/n_paths : t%n_passes;
+                auto path = this->order == PassOrder::ByDepth ? t%n_paths : t/n_passes;
+                auto n = this->get_path_size(path);
+                if (n == 0) continue;
+                auto first = this->get_move(pass, path, 0);
+                if (have_prev && (std::get<0>(prev) != std::get<0>(first) || std::get<1>(prev) != std::get<1>(first)
+                                  || std::get<3>(prev) != std::get<3>(first)))
+                    this->n_moves += 2;
+                prev = this->get_move(pass, path, n-1);
+                have_prev = true;
+            }
+        }
+    }
+
+    DepthPasses::~DepthPasses() {
+        PYG_LOG_V("Deleting depth passes 0x{:x}", (uint64_t)this);
+    }
+
+    size_t DepthPasses::get_path_count() const {
+        return this->offsets.size() - 1;
+    }
+
+    size_t DepthPasses::get_path_size(const size_t path) const {
+        return this->offsets[path+1] - this->offsets[path];
+    }
+
+    PassMove DepthPasses::get_move(const size_t pass, const size_t path, const size_t idx) const {
+        auto & pt = this->points[this->offsets[path] + idx];
+        auto z = pt.z;
+        // points above limit height aren't cutting and are left where they are
+        if (z <= this->limit_height) {
+            z += this->depths[pass];
+            auto & profile = this->ramps[path];
+            if (!profile.empty()) {
+                auto step = (pass == 0 ? 0 : this->depths[pass-1]) - this->depths[pass];
+                z += step*profile[idx];
+            }
+        }
+        return PassMove(pt.x, pt.y, z, pt.c, this->feed_factors[pass]);
+    }
+
+    size_t DepthPasses::get_pass_count() const {
+        return this->depths.size();
+    }
+
+    const std::vector<double> & DepthPasses::get_depths() const {
+        return this->depths;
+    }
+
+    const std::vector<double> & DepthPasses::get_feed_factors() const {
+        return this->feed_factors;
+    }
+
+    size_t DepthPasses::size() const {
+        return this->n_moves;
+    }
+
+    std::shared_ptr<PathGroup> DepthPasses::get_pass(const size_t pass) const {
+        PYG_LOG_V("Building pass {:d} of depth passes 0x{:x}", pass, (uint64_t)this);
+        if (pass >= this->depths.size())
+            throw std::out_of_range("Pass index out of range.");
+        auto n_paths = this->get_path_count();
+        auto new_group = std::make_shared<PathGroup>();
+        new_group->reserve(n_paths);
+        for (size_t i=0; i<n_paths; i++) {
+            auto n = this->get_path_size(i);
+            auto pts = make_point_block(n);
+            for (size_t j=0; j<n; j++) {
+                auto [x, y, z, c, feed] = this->get_move(pass, i, j);
+                *pts[j] = Point(x, y, z, c);
+            }
+            new_group->emplace_back(std::make_shared<Path>(std::move(pts)));
+        }
+        return new_group;
+    }
+
+    DepthPasses::const_iterator DepthPasses::begin() const {
+        return const_iterator(this, false);
+    }
+
+    DepthPasses::const_iterator DepthPasses::end() const {
+        return const_iterator(this, true);
+    }
+
+    DepthPasses::const_iterator::const_iterator(const DepthPasses * passes, const bool end) {
+        this->passes = passes;
+        this->idx = 0;
+        this->stage = 0;
+        this->have_prev = false;
+        auto n_traversals = passes->get_path_count()*passes->depths.size();
+        this->traversal = end ? n_traversals : 0;
+        if (!end)
+            this->settle();
+    }
+
+    void DepthPasses::const_iterator::get_indices(const size_t traversal, size_t & pass, size_t & path) const {
+        auto n_paths = this->passes->get_path_count();
+        auto n_passes = this->passes->depths.size();
+        if (this->passes->order == PassOrder::ByDepth) {
+            pass = traversal/n_paths;
+            path = traversal%n_paths;
+        } else {
+            pass = traversal%n_passes;
+            path = traversal/n_passes;
+        }
+    }
+
+    void DepthPasses::const_iterator::settle() {
+        auto n_traversals = this->passes->get_path_count()*this->passes->depths.size();
+        while (this->traversal < n_traversals) {
+            size_t pass, path;
+            this->get_indices(this->traversal, pass, path);
+            if (this->passes->get_path_size(path) == 0) {
+                this->traversal++;
+                continue;
+            }
+            if (this->stage < 2) {
+                // retract above last point, then move above first point of next traversal
+                auto first = this->passes->get_move(pass, path, 0);
+                if (!this->passes->safe_height || !this->have_prev || (
+                        std::get<0>(this->prev) == std::get<0>(first) && std::get<1>(this->prev) == std::get<1>(first)
+                        && std::get<3>(this->prev) == std::get<3>(first))) {
+                    this->stage = 2;
+                } else {
+                    auto & ref = this->stage == 0 ? this->prev : first;
+                    this->move = PassMove(std::get<0>(ref), std::get<1>(ref), *this->passes->safe_height, std::get<3>(ref), 1);
+                    return;
+                }
+            }
+            this->move = this->passes->get_move(pass, path, this->idx);
+            return;
+        }
+        // end iterator
+        this->idx = 0;
+        this->stage = 0;
+    }
+
+    const PassMove & DepthPasses::const_iterator::operator*() const {
+        return this->move;
+    }
+
+    DepthPasses::const_iterator & DepthPasses::const_iterator::operator++() {
+        if (this->stage < 2) {
+            this->stage++;
+        } else {
+            this->prev = this->move;
+            this->have_prev = true;
+            size_t pass, path;
+            this->get_indices(this->traversal, pass, path);
+            if (++this->idx >= this->passes->get_path_size(path)) {
+                this->traversal++;
+                this->idx = 0;
+                this->stage = 0;
+            }
+        }
+        this->settle();
+        return *this;
+    }
+
+    bool DepthPasses::const_iterator::operator==(const const_iterator & other) const {
+        return this->passes == other.passes && this->traversal == other.traversal
+            && this->stage == other.stage && this->idx == other.idx;
+    }
+
+    bool DepthPasses::const_iterator::operator!=(const const_iterator & other) const {
+        return !(*this == other);
+    }
+
+    void py_depthpasses_exports(py::module_ & mod) {
+        py::enum_<PassOrder>(mod, "PassOrder")
+        .value("ByDepth", PassOrder::ByDepth)
+        .value("ByPath", PassOrder::ByPath);
+
+        py::class_<DepthPasses, std::shared_ptr<DepthPasses>>(mod, "DepthPasses")
+        .def(py::init<std::shared_ptr<const PathGroup>, const std::vector<double> &, const std::vector<double> &, const double, const double, const PassOrder, const std::optional<double>>(),
+             py::arg("pathgroup"), py::arg("depths"), py::arg("feed_factors")=std::vector<double>(), py::arg("limit_height")=0,
+             py::arg("ramp_length")=0, py::arg("order")=PassOrder::ByDepth, py::arg("safe_height")=std::nullopt)
+        .def_property_readonly("pass_count", &DepthPasses::get_pass_count)
+        .def_property_readonly("depths", &DepthPasses::get_depths)
+        .def_property_readonly("feed_factors", &DepthPasses::get_feed_factors)
+        .def("get_pass", &DepthPasses::get_pass, py::arg("index"))
+        .def("__len__", &DepthPasses::size)
+        .def("__iter__", [](std::shared_ptr<const DepthPasses> p){return py::make_iterator(p->begin(), p->end());}
+                       , py::keep_alive<0, 1>())
+        ;
+    }
+
+}
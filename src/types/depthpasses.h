@@ -0,0 +1,221 @@
+/** \file depthpasses.h
+ *  \brief Header file for DepthPasses class and associated enum.
+ *
+ *  Author: Vincent Paeder
+ *  License: MIT
+ */
+#pragma once
+#include <pybind11/pybind11.h>
+#include <iterator>
+#include <optional>
+#include <tuple>
+#include <vector>
+
+#include "point.h"
+
+namespace py = pybind11;
+
+namespace pygraver::types {
+
+    class PathGroup;
+
+    /** \brief Definition of pass orders. */
+    enum class PassOrder : uint8_t {
+        ByDepth = 0, /**< every path at one depth, then every path at next depth */
+        ByPath = 1 /**< every depth for one path, then every depth for next path */
+    };
+
+    /** \brief Move produced by a DepthPasses instance: x, y, z, c and feed rate factor. */
+    using PassMove = std::tuple<double, double, double, double, double>;
+
+    /** \brief Class producing depth-stepped passes of a path group.
+     *
+     *  Passes are computed on the fly from a copy of the original points,
+     *  taken once at construction, and a ramp profile per path point: there
+     *  is no copy of the paths per pass. Changing the original paths later
+     *  doesn't affect passes.
+     *  Each pass is shifted along z by its depth; ramps built with
+     *  Path::create_ramps semantics (backward direction) let the tool enter
+     *  each pass from the depth of the previous one.
+     */
+    class DepthPasses {
+    private:
+        /** \brief Copy of original points, path after path, in a single block. */
+        std::vector<Point> points;
+
+        /** \brief Index of first point of each path in points, plus total number of points. */
+        std::vector<size_t> offsets;
+
+        /** \brief z offset of each pass. */
+        std::vector<double> depths;
+
+        /** \brief Feed rate factor of each pass. */
+        std::vector<double> feed_factors;
+
+        /** \brief Ramp profile of each path (0 = no lift, 1 = depth of previous pass); empty if path has no ramp. */
+        std::vector<std::vector<double>> ramps;
+
+        /** \brief Paths are cut below this height; points above it are left as they are. */
+        double limit_height = 0;
+
+        /** \brief Pass order. */
+        PassOrder order;
+
+        /** \brief Height to retract to between passes, if any. */
+        std::optional<double> safe_height;
+
+        /** \brief Number of moves. */
+        size_t n_moves = 0;
+
+        /** \brief Get number of paths.
+         *  \returns number of paths.
+         */
+        size_t get_path_count() const;
+
+        /** \brief Get number of points of a path.
+         *  \param path: path index.
+         *  \returns number of points.
+         */
+        size_t get_path_size(const size_t path) const;
+
+        /** \brief Get point of a path for a given pass.
+         *  \param pass: pass index.
+         *  \param path: path index.
+         *  \param idx: point index.
+         *  \returns move to point.
+         */
+        PassMove get_move(const size_t pass, const size_t path, const size_t idx) const;
+
+    public:
+        /** \brief Iterator over moves of all passes. */
+        class const_iterator {
+        public:
+            using iterator_category = std::forward_iterator_tag;
+            using value_type = PassMove;
+            using difference_type = std::ptrdiff_t;
+            using pointer = const PassMove *;
+            using reference = const PassMove &;
+
+        private:
+            /** \brief Iterated instance. */
+            const DepthPasses * passes;
+
+            /** \brief Index of current (pass, path) traversal. */
+            size_t traversal;
+
+            /** \brief Index of current point in path. */
+            size_t idx;
+
+            /** \brief Current stage: 0 = retract, 1 = approach, 2 = path points. */
+            int stage;
+
+            /** \brief True if a path point was already produced. */
+            bool have_prev;
+
+            /** \brief Last path point produced. */
+            PassMove prev;
+
+            /** \brief Current move. */
+            PassMove move;
+
+            /** \brief Get pass and path indices of a traversal.
+             *  \param traversal: traversal index.
+             *  \param pass: pass index.
+             *  \param path: path index.
+             */
+            void get_indices(const size_t traversal, size_t & pass, size_t & path) const;
+
+            /** \brief Skip empty paths and compute current move. */
+            void settle();
+
+        public:
+            /** \brief Constructor.
+             *  \param passes: iterated instance.
+             *  \param end: true to create an end iterator.
+             */
+            const_iterator(const DepthPasses * passes, const bool end);
+
+            /** \brief Dereference operator.
+             *  \returns current move.
+             */
+            const PassMove & operator*() const;
+
+            /** \brief Increment operator.
+             *  \returns reference to iterator.
+             */
+            const_iterator & operator++();
+
+            /** \brief Equality operator.
+             *  \param other: iterator to compare with.
+             *  \returns true if iterators point to the same move.
+             */
+            bool operator==(const const_iterator & other) const;
+
+            /** \brief Inequality operator.
+             *  \param other: iterator to compare with.
+             *  \returns true if iterators point to different moves.
+             */
+            bool operator!=(const const_iterator & other) const;
+        };
+
+        /** \brief Constructor.
+         *  \param pg: paths to cut.
+         *  \param depths: z offset of each pass, in cutting order (usually negative and decreasing).
+         *  \param feed_factors: feed rate factor of each pass (empty for 1 everywhere).
+         *  \param limit_height: paths cut below this height; crossing it is a discontinuity where ramps are created.
+         *  \param ramp_length: length of entry ramps (0 for no ramp).
+         *  \param order: pass order.
+         *  \param safe_height: if given, tool retracts to this height between passes (and paths).
+         */
+        DepthPasses(std::shared_ptr<const PathGroup> pg, const std::vector<double> & depths,
+                    const std::vector<double> & feed_factors=std::vector<double>(),
+                    const double limit_height=0, const double ramp_length=0,
+                    const PassOrder order=PassOrder::ByDepth,
+                    const std::optional<double> safe_height=std::nullopt);
+
+        /** \brief Destructor. */
+        ~DepthPasses();
+
+        /** \brief Get number of passes.
+         *  \returns number of passes.
+         */
+        size_t get_pass_count() const;
+
+        /** \brief Get pass depths.
+         *  \returns z offset of each pass.
+         */
+        const std::vector<double> & get_depths() const;
+
+        /** \brief Get pass feed rate factors.
+         *  \returns feed rate factor of each pass.
+         */
+        const std::vector<double> & get_feed_factors() const;
+
+        /** \brief Get number of moves (points of every pass, plus retract moves).
+         *  \returns number of moves.
+         */
+        size_t size() const;
+
+        /** \brief Build paths of one pass.
+         *  \param pass: pass index.
+         *  \returns path group for given pass.
+         */
+        std::shared_ptr<PathGroup> get_pass(const size_t pass) const;
+
+        /** \brief Get iterator to first move.
+         *  \returns iterator.
+         */
+        const_iterator begin() const;
+
+        /** \brief Get iterator past last move.
+         *  \returns iterator.
+         */
+        const_iterator end() const;
+    };
+
+    /** \brief Export function for Python wrapper.
+     *  \param mod: module or submodule to add content to.
+     */
+    void py_depthpasses_exports(py::module_ & mod);
+
+}
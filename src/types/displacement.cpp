@@ -0,0 +1,320 @@
+/** \file displacement.cpp
+ *  \brief Implementation file for Displacement class.
+ *
+ *  Author: Vincent Paeder
+ *  License: MIT
+ */
+#include <algorithm>
+#include <cmath>
+#include <pybind11/stl.h>
+
+#include "common.h"
+#include "displacement.h"
+#include "path.h"
+#include "pathgroup.h"
+#include "point.h"
+#include "../log.h"
+
+namespace pygraver::types {
+
+    /** \brief Maximum number of segment bisections. */
+    static const int max_refinement_depth = 16;
+
+    Displacement::Displacement(const std::vector<double> & pixels, const size_t width, const size_t height,
+                               const double x0, const double y0, const double pixel_size, const double amplitude,
+                               const DisplacementMode mode, const std::vector<double> & transfer) {
+        PYG_LOG_V("Creating {:d}x{:d} displacement 0x{:x}", width, height, (uint64_t)this);
+        if (width == 0 || height == 0)
+            throw std::invalid_argument("Image must have at least one pixel along each dimension.");
+        if (pixels.size() != width*height)
+            throw std::invalid_argument("Number of pixels must match image size.");
+        this->pixels = pixels;
+        this->width = width;
+        this->height = height;
+        this->initialize(x0, y0, pixel_size, amplitude, mode, transfer);
+    }
+
+    Displacement::Displacement(const py::array_t<double, py::array::c_style | py::array::forcecast> & image,
+                               const double x0, const double y0, const double pixel_size, const double amplitude,
+                               const DisplacementMode mode, const std::vector<double> & transfer) {
+        PYG_LOG_V("Creating displacement 0x{:x} from array", (uint64_t)this);
+        if (image.ndim() != 2) {
+            PyErr_SetString(PyExc_ValueError, "image must be an array of dimension 2.");
+            throw py::error_already_set();
+        }
+        if (image.shape(0) == 0 || image.shape(1) == 0)
+            throw std::invalid_argument("Image must have at least one pixel along each dimension.");
+        this->height = image.shape(0);
+        this->width = image.shape(1);
+        auto data = static_cast<const double*>(image.data());
+        this->pixels.assign(data, data + this->width*this->height);
+        this->initialize(x0, y0, pixel_size, amplitude, mode, transfer);
+    }
+
+    Displacement::~Displacement() {
+        PYG_LOG_V("Deleting displacement 0x{:x}", (uint64_t)this);
+    }
+
+    void Displacement::initialize(const double x0, const double y0, const double pixel_size, const double amplitude,
+                                  const DisplacementMode mode, const std::vector<double> & transfer) {
+        if (pixel_size <= 0)
+            throw std::invalid_argument("Pixel size must be positive.");
+        this->x0 = x0;
+        this->y0 = y0;
+        this->pixel_size = pixel_size;
+        this->inv_pixel_size = 1/pixel_size;
+        this->amplitude = amplitude;
+        this->mode = mode;
+        this->transfer = transfer;
+    }
+
+    DisplacementMode Displacement::get_mode() const {
+        return this->mode;
+    }
+
+    double Displacement::value_at(const double x, const double y) const {
+        // pixel centres are at half-integer positions; row 0 is the top of the image
+        auto fu = std::clamp((x - this->x0)*this->inv_pixel_size - 0.5, 0.0, double(this->width - 1));
+        auto fv = std::clamp(double(this->height) - (y - this->y0)*this->inv_pixel_size - 0.5, 0.0, double(this->height - 1));
+        auto i = std::min(static_cast<size_t>(fu), this->width - 1);
+        auto j = std::min(static_cast<size_t>(fv), this->height - 1);
+        auto i1 = std::min(i + 1, this->width - 1);
+        auto j1 = std::min(j + 1, this->height - 1);
+        auto tu = fu - i;
+        auto tv = fv - j;
+        auto row0 = &this->pixels[j*this->width];
+        auto row1 = &this->pixels[j1*this->width];
+        return (1-tv)*((1-tu)*row0[i] + tu*row0[i1]) + tv*((1-tu)*row1[i] + tu*row1[i1]);
+    }
+
+    double Displacement::displacement_at(const double x, const double y) const {
+        auto value = this->value_at(x, y);
+        if (this->transfer.empty())
+            return this->amplitude*value;
+        // transfer function is piecewise linear between its samples
+        auto n = this->transfer.size();
+        auto s = std::clamp(value, 0.0, 1.0)*(n - 1);
+        auto k = std::min(static_cast<size_t>(s), n - 1);
+        auto k1 = std::min(k + 1, n - 1);
+        auto t = s - k;
+        return this->amplitude*((1-t)*this->transfer[k] + t*this->transfer[k1]);
+    }
+
+    double Displacement::sample(const double x, const double y, const double c) const {
+        if (c == 0)
+            return this->value_at(x, y);
+        auto cc = std::cos(c/180*M_PI);
+        auto sc = std::sin(c/180*M_PI);
+        return this->value_at(x*cc - y*sc, x*sc + y*cc);
+    }
+
+    double Displacement::get_displacement(const double x, const double y, const double c) const {
+        if (c == 0)
+            return this->displacement_at(x, y);
+        auto cc = std::cos(c/180*M_PI);
+        auto sc = std::sin(c/180*M_PI);
+        return this->displacement_at(x*cc - y*sc, x*sc + y*cc);
+    }
+
+    std::shared_ptr<Path> Displacement::apply_to_path(const Path & path, const double tolerance) const {
+        auto n = path.size();
+        if (n == 0)
+            return std::make_shared<Path>(0);
+        auto src = path.begin();
+        // cartesian positions, where the image is sampled
+        std::vector<double> qx(n), qy(n);
+        for (size_t k=0; k<n; k++) {
+            auto & pt = *src[k];
+            auto cc = std::cos(pt.c/180*M_PI);
+            auto sc = std::sin(pt.c/180*M_PI);
+            qx[k] = pt.x*cc - pt.y*sc;
+            qy[k] = pt.x*sc + pt.y*cc;
+        }
+        // sampling position along segment k; machine axes move linearly between points
+        auto position = [&](const size_t k, const double t, double & x, double & y) {
+            if (t == 0 || t == 1) {
+                x = t == 0 ? qx[k] : qx[k+1];
+                y = t == 0 ? qy[k] : qy[k+1];
+                return;
+            }
+            auto & p0 = *src[k];
+            auto & p1 = *src[k+1];
+            if (this->mode == DisplacementMode::Normal || p0.c == p1.c) {
+                x = qx[k] + t*(qx[k+1] - qx[k]);
+                y = qy[k] + t*(qy[k+1] - qy[k]);
+            } else {
+                auto px = p0.x + t*(p1.x - p0.x);
+                auto py = p0.y + t*(p1.y - p0.y);
+                auto c = (p0.c + t*(p1.c - p0.c))/180*M_PI;
+                x = px*std::cos(c) - py*std::sin(c);
+                y = px*std::sin(c) + py*std::cos(c);
+            }
+        };
+        auto displacement = [&](const size_t k, const double t) {
+            double x, y;
+            position(k, t, x, y);
+            return this->displacement_at(x, y);
+        };
+
+        // samples are (segment, position along segment, displacement); last point belongs to segment n-2
+        struct Sample { size_t segment; double t; double d; };
+        std::vector<Sample> samples;
+        samples.reserve(n);
+        samples.push_back({0, 0, this->displacement_at(qx[0], qy[0])});
+        struct Interval { double t0; double d0; double t1; double d1; int depth; };
+        std::vector<Interval> stack;
+        for (size_t k=0; k+1<n; k++) {
+            auto d1 = displacement(k, 1);
+            if (tolerance > 0) {
+                auto & p0 = *src[k];
+                auto & p1 = *src[k+1];
+                auto length = std::hypot(qx[k+1]-qx[k], qy[k+1]-qy[k]);
+                if (p0.c != p1.c)
+                    length = std::max(length, std::max(std::hypot(p0.x, p0.y), std::hypot(p1.x, p1.y))*std::abs(p1.c - p0.c)/180*M_PI);
+                stack.push_back({0, samples.back().d, 1, d1, 0});
+                while (!stack.empty()) {
+                    auto iv = stack.back();
+                    stack.pop_back();
+                    // below half a pixel, the image holds no more detail
+                    auto split = iv.depth < max_refinement_depth && length*(iv.t1 - iv.t0) > 0.5*this->pixel_size;
+                    double dq[3];
+                    if (split) {
+                        split = false;
+                        for (auto q=0; q<3; q++) {
+                            auto s = 0.25*(q+1);
+                            dq[q] = displacement(k, iv.t0 + s*(iv.t1 - iv.t0));
+                            if (std::abs(dq[q] - (iv.d0 + s*(iv.d1 - iv.d0))) > tolerance)
+                                split = true;
+                        }
+                    }
+                    if (split) {
+                        auto tm = 0.5*(iv.t0 + iv.t1);
+                        // right half is pushed first so that samples come out in order
+                        stack.push_back({tm, dq[1], iv.t1, iv.d1, iv.depth + 1});
+                        stack.push_back({iv.t0, iv.d0, tm, dq[1], iv.depth + 1});
+                    } else if (iv.t1 < 1) {
+                        samples.push_back({k, iv.t1, iv.d1});
+                    }
+                }
+            }
+            samples.push_back({k, 1, d1});
+        }
+
+        // unit normals to segments (left side), in cartesian coordinates
+        std::vector<double> nx(n > 1 ? n-1 : 0, 0), ny(n > 1 ? n-1 : 0, 0);
+        if (this->mode == DisplacementMode::Normal && n > 1) {
+            auto valid = false;
+            for (size_t k=0; k+1<n; k++) {
+                auto tx = qx[k+1] - qx[k];
+                auto ty = qy[k+1] - qy[k];
+                auto norm = std::hypot(tx, ty);
+                if (norm > 0) {
+                    nx[k] = -ty/norm;
+                    ny[k] = tx/norm;
+                    // back-fill leading degenerate segments
+                    if (!valid)
+                        for (size_t l=0; l<k; l++) {
+                            nx[l] = nx[k];
+                            ny[l] = ny[k];
+                        }
+                    valid = true;
+                } else if (k > 0) {
+                    nx[k] = nx[k-1];
+                    ny[k] = ny[k-1];
+                }
+            }
+        }
+        auto closed = path.is_closed();
+        // normal at a vertex bisects adjacent segment normals
+        auto vertex_normal = [&](const size_t k, double & vx, double & vy) {
+            size_t before, after;
+            if (k == 0) {
+                after = 0;
+                before = closed ? n-2 : 0;
+            } else if (k == n-1) {
+                before = n-2;
+                after = closed ? 0 : n-2;
+            } else {
+                before = k-1;
+                after = k;
+            }
+            vx = nx[before] + nx[after];
+            vy = ny[before] + ny[after];
+            auto norm = std::hypot(vx, vy);
+            if (norm < 1e-9) {
+                // path turns back on itself
+                vx = nx[after];
+                vy = ny[after];
+            } else {
+                vx /= norm;
+                vy /= norm;
+            }
+        };
+
+        auto pts = make_point_block(samples.size());
+        for (size_t i=0; i<samples.size(); i++) {
+            auto & s = samples[i];
+            auto & pt = *pts[i];
+            auto k = s.segment;
+            auto & p0 = *src[k];
+            auto & p1 = n > 1 ? *src[k+1] : p0;
+            pt.z = p0.z + s.t*(p1.z - p0.z);
+            if (this->mode == DisplacementMode::Depth) {
+                pt.x = p0.x + s.t*(p1.x - p0.x);
+                pt.y = p0.y + s.t*(p1.y - p0.y);
+                pt.c = p0.c + s.t*(p1.c - p0.c);
+                pt.z += s.d;
+            } else if (n == 1) {
+                pt.x = qx[0];
+                pt.y = qy[0];
+                pt.c = 0;
+            } else {
+                double vx, vy;
+                if (s.t == 0)
+                    vertex_normal(k, vx, vy);
+                else if (s.t == 1)
+                    vertex_normal(k+1, vx, vy);
+                else {
+                    vx = nx[k];
+                    vy = ny[k];
+                }
+                pt.x = qx[k] + s.t*(qx[k+1] - qx[k]) + s.d*vx;
+                pt.y = qy[k] + s.t*(qy[k+1] - qy[k]) + s.d*vy;
+                pt.c = 0;
+            }
+        }
+        return std::make_shared<Path>(std::move(pts));
+    }
+
+    std::shared_ptr<Path> Displacement::apply(std::shared_ptr<const Path> path, const double tolerance) const {
+        PYG_LOG_V("Displacing path 0x{:x} with displacement 0x{:x}", (uint64_t)path.get(), (uint64_t)this);
+        return this->apply_to_path(*path, tolerance);
+    }
+
+    std::shared_ptr<PathGroup> Displacement::apply(std::shared_ptr<const PathGroup> pg, const double tolerance) const {
+        PYG_LOG_V("Displacing path group 0x{:x} with displacement 0x{:x}", (uint64_t)pg.get(), (uint64_t)this);
+        auto paths = pg->get_paths();
+        std::vector<std::shared_ptr<Path>> displaced(paths.size());
+        parallel_for(paths.size(), [&](const size_t k) {
+            displaced[k] = this->apply_to_path(*paths[k], tolerance);
+        });
+        return std::make_shared<PathGroup>(displaced);
+    }
+
+    void py_displacement_exports(py::module_ & mod) {
+        py::enum_<DisplacementMode>(mod, "DisplacementMode")
+        .value("Normal", DisplacementMode::Normal)
+        .value("Depth", DisplacementMode::Depth);
+
+        py::class_<Displacement, std::shared_ptr<Displacement>>(mod, "Displacement")
+        .def(py::init<const py::array_t<double, py::array::c_style | py::array::forcecast> &, const double, const double, const double, const double, const DisplacementMode, const std::vector<double> &>(),
+             py::arg("image"), py::arg("x0"), py::arg("y0"), py::arg("pixel_size"), py::arg("amplitude")=1, py::arg("mode")=DisplacementMode::Normal, py::arg("transfer")=std::vector<double>())
+        .def_property_readonly("mode", &Displacement::get_mode)
+        .def("sample", &Displacement::sample, py::arg("x"), py::arg("y"), py::arg("c")=0)
+        .def("get_displacement", &Displacement::get_displacement, py::arg("x"), py::arg("y"), py::arg("c")=0)
+        .def("apply", static_cast<std::shared_ptr<Path>(Displacement::*)(std::shared_ptr<const Path>, const double) const>(&Displacement::apply), py::arg("path"), py::arg("tolerance")=0)
+        .def("apply", static_cast<std::shared_ptr<PathGroup>(Displacement::*)(std::shared_ptr<const PathGroup>, const double) const>(&Displacement::apply), py::arg("pathgroup"), py::arg("tolerance")=0, py::call_guard<py::gil_scoped_release>())
+        ;
+    }
+
+}
@@ -0,0 +1,181 @@
+/** \file displacement.h
+ *  \brief Header file for Displacement class and associated enum.
+ *
+ *  Author: Vincent Paeder
+ *  License: MIT
+ */
+#pragma once
+#include <pybind11/pybind11.h>
+#include <pybind11/numpy.h>
+#include <vector>
+
+namespace py = pybind11;
+
+namespace pygraver::types {
+
+    class Point;
+    class Path;
+    class PathGroup;
+
+    /** \brief Definition of displacement directions. */
+    enum class DisplacementMode : uint8_t {
+        Normal = 0, /**< points move along local path normal, in xy plane */
+        Depth = 1 /**< points move along z */
+    };
+
+    /** \brief Class modulating paths with a grayscale image.
+     *
+     *  The image is sampled along paths with bilinear interpolation; sampled
+     *  values go through a transfer function and the result displaces points
+     *  either along the local normal to the path or along z. This is how line
+     *  families are turned into portraits or modulated guilloche patterns.
+     */
+    class Displacement {
+    private:
+        /** \brief Image values, row-major (index is row*width + column); row 0 is the top of the image. */
+        std::vector<double> pixels;
+
+        /** \brief Image width, in pixels. */
+        size_t width = 0;
+
+        /** \brief Image height, in pixels. */
+        size_t height = 0;
+
+        /** \brief Position of the bottom left image corner along x. */
+        double x0 = 0;
+
+        /** \brief Position of the bottom left image corner along y. */
+        double y0 = 0;
+
+        /** \brief Pixel size. */
+        double pixel_size = 1;
+
+        /** \brief Inverse of pixel size, to avoid divisions during sampling. */
+        double inv_pixel_size = 1;
+
+        /** \brief Displacement for a transfer function value of 1. */
+        double amplitude = 1;
+
+        /** \brief Transfer function, sampled evenly over [0, 1] (empty for identity). */
+        std::vector<double> transfer;
+
+        /** \brief Displacement direction. */
+        DisplacementMode mode;
+
+        /** \brief Check parameters and set image placement.
+         *  \param x0: position of the bottom left image corner along x.
+         *  \param y0: position of the bottom left image corner along y.
+         *  \param pixel_size: pixel size (>0).
+         *  \param amplitude: displacement for a transfer function value of 1.
+         *  \param mode: displacement direction.
+         *  \param transfer: transfer function values.
+         */
+        void initialize(const double x0, const double y0, const double pixel_size, const double amplitude,
+                        const DisplacementMode mode, const std::vector<double> & transfer);
+
+        /** \brief Sample image at given cartesian position.
+         *  \param x: x coordinate.
+         *  \param y: y coordinate.
+         *  \returns interpolated image value.
+         */
+        double value_at(const double x, const double y) const;
+
+        /** \brief Compute displacement at given cartesian position.
+         *  \param x: x coordinate.
+         *  \param y: y coordinate.
+         *  \returns displacement.
+         */
+        double displacement_at(const double x, const double y) const;
+
+        /** \brief Displace a path, subdividing segments where displacement varies quickly.
+         *  \param path: path to displace.
+         *  \param tolerance: maximum deviation between displacement and its linear interpolation along a segment (0 to keep segments).
+         *  \returns displaced path.
+         */
+        std::shared_ptr<Path> apply_to_path(const Path & path, const double tolerance) const;
+
+    public:
+        /** \brief Constructor.
+         *  \param pixels: image values, row-major (index is row*width + column); row 0 is the top of the image.
+         *  \param width: image width, in pixels.
+         *  \param height: image height, in pixels.
+         *  \param x0: position of the bottom left image corner along x.
+         *  \param y0: position of the bottom left image corner along y.
+         *  \param pixel_size: pixel size (>0).
+         *  \param amplitude: displacement for a transfer function value of 1.
+         *  \param mode: displacement direction.
+         *  \param transfer: transfer function, sampled evenly over [0, 1]; image values are clamped to this range (empty for identity).
+         */
+        Displacement(const std::vector<double> & pixels, const size_t width, const size_t height,
+                     const double x0, const double y0, const double pixel_size, const double amplitude=1,
+                     const DisplacementMode mode=DisplacementMode::Normal,
+                     const std::vector<double> & transfer=std::vector<double>());
+
+        /** \brief Constructor from a NumPy array.
+         *  \param image: 2D array of image values; row 0 is the top of the image.
+         *  \param x0: position of the bottom left image corner along x.
+         *  \param y0: position of the bottom left image corner along y.
+         *  \param pixel_size: pixel size (>0).
+         *  \param amplitude: displacement for a transfer function value of 1.
+         *  \param mode: displacement direction.
+         *  \param transfer: transfer function, sampled evenly over [0, 1]; image values are clamped to this range (empty for identity).
+         */
+        Displacement(const py::array_t<double, py::array::c_style | py::array::forcecast> & image,
+                     const double x0, const double y0, const double pixel_size, const double amplitude=1,
+                     const DisplacementMode mode=DisplacementMode::Normal,
+                     const std::vector<double> & transfer=std::vector<double>());
+
+        /** \brief Destructor. */
+        ~Displacement();
+
+        /** \brief Get displacement direction.
+         *  \returns displacement direction.
+         */
+        DisplacementMode get_mode() const;
+
+        /** \brief Sample image at given position.
+         *
+         *  Outside the image, the closest edge is used.
+         *
+         *  \param x: x coordinate.
+         *  \param y: y coordinate.
+         *  \param c: c coordinate, in degrees.
+         *  \returns interpolated image value.
+         */
+        double sample(const double x, const double y, const double c=0) const;
+
+        /** \brief Get displacement at given position.
+         *  \param x: x coordinate.
+         *  \param y: y coordinate.
+         *  \param c: c coordinate, in degrees.
+         *  \returns displacement.
+         */
+        double get_displacement(const double x, const double y, const double c=0) const;
+
+        /** \brief Displace path points.
+         *
+         *  In normal mode, the resulting path is in cartesian coordinates.
+         *
+         *  \param path: path to displace.
+         *  \param tolerance: segments are subdivided until displacement deviates from its linear interpolation by less than this (0 to keep segments).
+         *  \returns displaced path.
+         */
+        std::shared_ptr<Path> apply(std::shared_ptr<const Path> path, const double tolerance=0) const;
+
+        /** \brief Displace points of a group of paths.
+         *
+         *  Paths are processed in parallel.
+         *
+         *  \param pg: path group to displace.
+         *  \param tolerance: segments are subdivided until displacement deviates from its linear interpolation by less than this (0 to keep segments).
+         *  \returns displaced path group.
+         */
+        std::shared_ptr<PathGroup> apply(std::shared_ptr<const PathGroup> pg, const double tolerance=0) const;
+    };
+
+    /** \brief Export function for Python wrapper.
+     *  \param mod: module or submodule to add content to.
+     */
+    void py_displacement_exports(py::module_ & mod);
+
+}
@@ -0,0 +1,130 @@
+/** \file heightcorrector.cpp
+ *  \brief Implementation file for HeightCorrector class.
+ *
+ *  Author: Vincent Paeder
+ *  License: MIT
+ */
+#include <geos/geom/prep/PreparedGeometry.h>
+#include <geos/geom/prep/PreparedGeometryFactory.h>
+#include <pybind11/stl.h>
+
+#include "common.h"
+#include "heightcorrector.h"
+#include "surface.h"
+#include "path.h"
+#include "pathgroup.h"
+#include "point.h"
+#include "../log.h"
+
+/** \brief Shorthand for geos::geom::prep::PreparedGeometryFactory class. */
+using GEOSPreparedGeometryFactory = gg::prep::PreparedGeometryFactory;
+
+namespace pygraver::types {
+
+    HeightCorrector::HeightCorrector(const std::vector<std::shared_ptr<Path>> & paths, const double clearance,
+                                     const double safe_height, const bool outside, const bool fix_contours) {
+        PYG_LOG_V("Creating height corrector 0x{:x}", (uint64_t)this);
+        create_geometry_factory();
+        this->paths = paths;
+        this->clearance = clearance;
+        this->safe_height = safe_height;
+        this->outside = outside;
+        this->fix_contours = fix_contours;
+        // one envelope per segment, in cartesian coordinates; a single point gives a degenerate envelope
+        std::vector<size_t> owners;
+        for (size_t i=0; i<paths.size(); i++) {
+            auto path = paths[i];
+            auto n = path->size();
+            if (n == 0) continue;
+            auto p0 = (*path)[0]->to_cartesian();
+            if (n == 1) {
+                this->envelopes.emplace_back(p0->x, p0->x, p0->y, p0->y);
+                owners.push_back(i);
+            }
+            for (size_t j=1; j<n; j++) {
+                auto p1 = (*path)[j]->to_cartesian();
+                this->envelopes.emplace_back(p0->x, p1->x, p0->y, p1->y);
+                owners.push_back(i);
+                p0 = p1;
+            }
+        }
+        // envelopes must not be moved after this
+        this->owners = std::move(owners);
+        for (size_t k=0; k<this->envelopes.size(); k++)
+            this->index.insert(&this->envelopes[k], reinterpret_cast<void*>(k));
+    }
+
+    HeightCorrector::HeightCorrector(std::shared_ptr<const PathGroup> pg, const double clearance,
+                                     const double safe_height, const bool outside, const bool fix_contours)
+        : HeightCorrector(pg->get_paths(), clearance, safe_height, outside, fix_contours) {}
+
+    HeightCorrector::~HeightCorrector() {
+        PYG_LOG_V("Deleting height corrector 0x{:x}", (uint64_t)this);
+    }
+
+    const std::vector<std::shared_ptr<Path>> & HeightCorrector::update(std::shared_ptr<const Surface> mask) {
+        PYG_LOG_V("Updating height corrector 0x{:x}", (uint64_t)this);
+        auto new_mask = mask->as_geos_geometry();
+        this->updated.clear();
+        if (!this->mask) {
+            this->updated.resize(this->paths.size());
+            for (size_t i=0; i<this->paths.size(); i++)
+                this->updated[i] = i;
+        } else {
+            auto diff = this->mask->symDifference(new_mask.get());
+            if (!diff->isEmpty()) {
+                // points whose status may change lie within clearance of the difference
+                auto region = diff->buffer(std::abs(this->clearance));
+                auto prepared = GEOSPreparedGeometryFactory::prepare(region.get());
+                std::vector<bool> selected(this->paths.size(), false);
+                for (size_t g=0; g<region->getNumGeometries(); g++) {
+                    std::vector<void*> candidates;
+                    this->index.query(region->getGeometryN(g)->getEnvelopeInternal(), candidates);
+                    for (auto candidate: candidates) {
+                        auto k = reinterpret_cast<size_t>(candidate);
+                        auto i = this->owners[k];
+                        if (selected[i]) continue;
+                        auto segment = gfactory->toGeometry(&this->envelopes[k]);
+                        if (prepared->intersects(segment.get()))
+                            selected[i] = true;
+                    }
+                }
+                for (size_t i=0; i<selected.size(); i++)
+                    if (selected[i])
+                        this->updated.push_back(i);
+            }
+        }
+        PYG_LOG_D("Correcting {:d} of {:d} paths", this->updated.size(), this->paths.size());
+
+        if (this->corrected.size() != this->paths.size())
+            this->corrected.resize(this->paths.size());
+        std::vector<std::shared_ptr<Path>> subset;
+        subset.reserve(this->updated.size());
+        for (auto i: this->updated)
+            subset.emplace_back(this->paths[i]);
+        auto new_paths = mask->correct_height(subset, this->clearance, this->safe_height, this->outside, this->fix_contours);
+        for (size_t k=0; k<this->updated.size(); k++)
+            this->corrected[this->updated[k]] = new_paths[k];
+
+        this->mask = std::move(new_mask);
+        return this->corrected;
+    }
+
+    const std::vector<std::shared_ptr<Path>> & HeightCorrector::get_paths() const {
+        return this->corrected;
+    }
+
+    const std::vector<size_t> & HeightCorrector::get_updated() const {
+        return this->updated;
+    }
+
+    void py_heightcorrector_exports(py::module_ & mod) {
+        py::class_<HeightCorrector, std::shared_ptr<HeightCorrector>>(mod, "HeightCorrector")
+        .def(py::init<const std::vector<std::shared_ptr<Path>> &, const double, const double, const bool, const bool>(), py::arg("paths"), py::arg("clearance"), py::arg("safe_height"), py::arg("outside")=true, py::arg("fix_contours")=false)
+        .def(py::init<std::shared_ptr<const PathGroup>, const double, const double, const bool, const bool>(), py::arg("pathgroup"), py::arg("clearance"), py::arg("safe_height"), py::arg("outside")=true, py::arg("fix_contours")=false)
+        .def("update", &HeightCorrector::update, py::arg("mask"))
+        .def_property_readonly("paths", &HeightCorrector::get_paths)
+        .def_property_readonly("updated", &HeightCorrector::get_updated)
+        ;
+    }
+}
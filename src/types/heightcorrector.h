@@ -0,0 +1,114 @@
+/** \file heightcorrector.h
+ *  \brief Header file for HeightCorrector class.
+ *
+ *  Author: Vincent Paeder
+ *  License: MIT
+ */
+#pragma once
+#include <geos/geom/Envelope.h>
+#include <geos/geom/Geometry.h>
+#include <geos/index/strtree/STRtree.h>
+#include <pybind11/pybind11.h>
+#include <vector>
+
+namespace py = pybind11;
+
+namespace pygraver::types {
+
+    class Path;
+    class PathGroup;
+    class Surface;
+
+    /** \brief Class correcting path heights incrementally when the mask surface changes.
+     *
+     *  This does the same as Surface::correct_height, but keeps a spatial index
+     *  of path segments and the previous mask. When the mask is updated, only
+     *  paths with segments close to the region where old and new masks differ
+     *  are corrected again; other paths keep their previous result.
+     */
+    class HeightCorrector {
+    private:
+        /** \brief Paths to correct. */
+        std::vector<std::shared_ptr<Path>> paths;
+
+        /** \brief Corrected paths. */
+        std::vector<std::shared_ptr<Path>> corrected;
+
+        /** \brief Indices of paths corrected during last update. */
+        std::vector<size_t> updated;
+
+        /** \brief Segment envelopes (cartesian coordinates); the spatial index points to them. */
+        std::vector<geos::geom::Envelope> envelopes;
+
+        /** \brief Index of the path each segment envelope belongs to. */
+        std::vector<size_t> owners;
+
+        /** \brief Spatial index of path segments; items are envelope indices. */
+        geos::index::strtree::STRtree index;
+
+        /** \brief Mask used during last update. */
+        std::unique_ptr<geos::geom::Geometry> mask;
+
+        /** \brief Clearance near a contour. */
+        double clearance;
+
+        /** \brief Height in exclusion area. */
+        double safe_height;
+
+        /** \brief If true, exclusion area is outside mask. */
+        bool outside;
+
+        /** \brief If true, add points on contours to increase accuracy. */
+        bool fix_contours;
+
+    public:
+        /** \brief Constructor.
+         *  \param paths: a collection of paths to correct.
+         *  \param clearance: clearance near a contour.
+         *  \param safe_height: height in exclusion area (outside or inside).
+         *  \param outside: if true, exclusion area is outside surface; if false, exclusion area is inside.
+         *  \param fix_contours: if true, adds supplementary points on contours to increase accuracy.
+         */
+        HeightCorrector(const std::vector<std::shared_ptr<Path>> & paths, const double clearance,
+                        const double safe_height, const bool outside=true, const bool fix_contours=false);
+
+        /** \brief Constructor with path group.
+         *  \param pg: path group containing paths to correct.
+         *  \param clearance: clearance near a contour.
+         *  \param safe_height: height in exclusion area (outside or inside).
+         *  \param outside: if true, exclusion area is outside surface; if false, exclusion area is inside.
+         *  \param fix_contours: if true, adds supplementary points on contours to increase accuracy.
+         */
+        HeightCorrector(std::shared_ptr<const PathGroup> pg, const double clearance,
+                        const double safe_height, const bool outside=true, const bool fix_contours=false);
+
+        /** \brief Destructor. */
+        ~HeightCorrector();
+
+        /** \brief Correct paths with a new mask.
+         *
+         *  The first call corrects every path. Subsequent calls only correct
+         *  paths near the symmetric difference of previous and new masks.
+         *
+         *  \param mask: mask surface.
+         *  \returns a collection of corrected paths.
+         */
+        const std::vector<std::shared_ptr<Path>> & update(std::shared_ptr<const Surface> mask);
+
+        /** \brief Get corrected paths.
+         *  \returns the collection of paths corrected with last mask.
+         */
+        const std::vector<std::shared_ptr<Path>> & get_paths() const;
+
+        /** \brief Get indices of paths corrected during last update.
+         *  \returns a collection of path indices.
+         */
+        const std::vector<size_t> & get_updated() const;
+    };
+
+    /** \brief Export function for Python wrapper.
+     *  \param mod: module or submodule to add content to.
+     */
+    void py_heightcorrector_exports(py::module_ & mod);
+
+}
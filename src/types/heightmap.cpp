@@ -0,0 +1,302 @@
+/** \file heightmap.cpp
+ *  \brief Implementation file for HeightMap class.
+ *
+ *  Author: Vincent Paeder
+ *  License: MIT
+ */
+#include <algorithm>
+#include <cmath>
+#include <pybind11/stl.h>
+
+#include "common.h"
+#include "heightmap.h"
+#include "path.h"
+#include "pathgroup.h"
+#include "point.h"
+#include "../log.h"
+
+namespace pygraver::types {
+
+    /** \brief Thin-plate spline radial basis function.
+     *  \param r2: squared distance to centre.
+     *  \returns r^2*log(r).
+     */
+    static inline double tps_kernel(const double r2) {
+        return r2 > 0 ? 0.5*r2*std::log(r2) : 0;
+    }
+
+    /** \brief Solve a dense linear system in place with Gaussian elimination and partial pivoting.
+     *  \param a: row-major n x n matrix; overwritten.
+     *  \param b: right-hand side; overwritten with solution.
+     *  \param n: system size.
+     *  \returns false if matrix is singular.
+     */
+    static bool solve_linear_system(std::vector<double> & a, std::vector<double> & b, const size_t n) {
+        auto scale = 0.0;
+        for (auto v: a)
+            scale = std::max(scale, std::abs(v));
+        auto eps = 1e-12*std::max(scale, 1.0);
+        for (size_t k=0; k<n; k++) {
+            auto pivot = k;
+            for (auto i=k+1; i<n; i++)
+                if (std::abs(a[i*n+k]) > std::abs(a[pivot*n+k]))
+                    pivot = i;
+            if (std::abs(a[pivot*n+k]) < eps)
+                return false;
+            if (pivot != k) {
+                std::swap_ranges(a.begin() + k*n, a.begin() + (k+1)*n, a.begin() + pivot*n);
+                std::swap(b[k], b[pivot]);
+            }
+            for (auto i=k+1; i<n; i++) {
+                auto f = a[i*n+k]/a[k*n+k];
+                if (f == 0) continue;
+                for (auto j=k; j<n; j++)
+                    a[i*n+j] -= f*a[k*n+j];
+                b[i] -= f*b[k];
+            }
+        }
+        for (size_t k=n; k-->0;) {
+            auto s = b[k];
+            for (auto j=k+1; j<n; j++)
+                s -= a[k*n+j]*b[j];
+            b[k] = s/a[k*n+k];
+        }
+        return true;
+    }
+
+    HeightMap::HeightMap(const double x0, const double y0, const double dx, const double dy,
+                         const size_t nx, const size_t ny, const std::vector<double> & heights,
+                         const HeightMapCoordinates coordinates, const double radius) {
+        PYG_LOG_V("Creating {:d}x{:d} height map 0x{:x}", nx, ny, (uint64_t)this);
+        if (dx <= 0 || dy <= 0)
+            throw std::invalid_argument("Grid steps must be positive.");
+        if (nx == 0 || ny == 0)
+            throw std::invalid_argument("Grid must have at least one node along each dimension.");
+        if (heights.size() != nx*ny)
+            throw std::invalid_argument("Number of heights must match number of grid nodes.");
+        if (coordinates == HeightMapCoordinates::Axial && std::abs(ny*dy - 360) > 1e-9)
+            throw std::invalid_argument("Axial grid must span one revolution (ny*dy = 360).");
+        if (radius < 0)
+            throw std::invalid_argument("Radius must be positive or 0.");
+        this->mode = HeightMapMode::Bilinear;
+        this->coordinates = coordinates;
+        this->radius = radius;
+        this->x0 = x0;
+        this->y0 = y0;
+        this->dx = dx;
+        this->dy = dy;
+        this->inv_dx = 1/dx;
+        this->inv_dy = 1/dy;
+        this->nx = nx;
+        this->ny = ny;
+        this->heights = heights;
+    }
+
+    HeightMap::HeightMap(const std::vector<double> & xs, const std::vector<double> & ys,
+                         const std::vector<double> & zs, const double regularization) {
+        PYG_LOG_V("Creating spline height map 0x{:x} with {:d} points", (uint64_t)this, xs.size());
+        if (xs.size() != ys.size() || xs.size() != zs.size())
+            throw std::invalid_argument("Provided vectors must have the same length.");
+        if (xs.size() < 3)
+            throw std::invalid_argument("At least 3 points are needed to fit a spline.");
+        if (regularization < 0)
+            throw std::invalid_argument("Regularization must be positive or 0.");
+        this->mode = HeightMapMode::ThinPlateSpline;
+        this->coordinates = HeightMapCoordinates::Cartesian;
+        this->px = xs;
+        this->py = ys;
+        // system is [K+l*I P; P^T 0] [w; a] = [z; 0]
+        auto n = xs.size();
+        auto m = n + 3;
+        std::vector<double> a(m*m, 0), b(m, 0);
+        for (size_t i=0; i<n; i++) {
+            for (size_t j=0; j<n; j++) {
+                auto r2 = std::pow(xs[i]-xs[j], 2) + std::pow(ys[i]-ys[j], 2);
+                a[i*m+j] = tps_kernel(r2);
+            }
+            a[i*m+i] += regularization;
+            a[i*m+n] = a[n*m+i] = 1;
+            a[i*m+n+1] = a[(n+1)*m+i] = xs[i];
+            a[i*m+n+2] = a[(n+2)*m+i] = ys[i];
+            b[i] = zs[i];
+        }
+        if (!solve_linear_system(a, b, m))
+            throw std::invalid_argument("Spline points must not be collinear or duplicated.");
+        this->weights.assign(b.begin(), b.begin() + n);
+        for (auto k=0; k<3; k++)
+            this->affine[k] = b[n+k];
+    }
+
+    HeightMap::~HeightMap() {
+        PYG_LOG_V("Deleting height map 0x{:x}", (uint64_t)this);
+    }
+
+    HeightMapMode HeightMap::get_mode() const {
+        return this->mode;
+    }
+
+    HeightMapCoordinates HeightMap::get_coordinates() const {
+        return this->coordinates;
+    }
+
+    void HeightMap::to_domain(const double x, const double y, const double c, double & u, double & v) const {
+        if (this->coordinates == HeightMapCoordinates::Axial) {
+            u = x;
+            v = c;
+        } else if (c == 0) {
+            u = x;
+            v = y;
+        } else {
+            auto cc = std::cos(c/180*M_PI);
+            auto sc = std::sin(c/180*M_PI);
+            u = x*cc - y*sc;
+            v = x*sc + y*cc;
+        }
+    }
+
+    double HeightMap::interpolate(const double u, const double v) const {
+        if (this->mode == HeightMapMode::ThinPlateSpline) {
+            auto h = this->affine[0] + this->affine[1]*u + this->affine[2]*v;
+            for (size_t k=0; k<this->weights.size(); k++)
+                h += this->weights[k]*tps_kernel(std::pow(u-this->px[k], 2) + std::pow(v-this->py[k], 2));
+            return h;
+        }
+        // outside grid, height of closest edge is used
+        auto fu = std::clamp((u - this->x0)*this->inv_dx, 0.0, double(this->nx - 1));
+        auto i = std::min(static_cast<size_t>(fu), this->nx - 1);
+        auto i1 = std::min(i + 1, this->nx - 1);
+        auto tu = fu - i;
+        size_t j, j1;
+        double tv;
+        if (this->coordinates == HeightMapCoordinates::Axial) {
+            auto fv = std::fmod((v - this->y0)*this->inv_dy, double(this->ny));
+            if (fv < 0) fv += this->ny;
+            j = std::min(static_cast<size_t>(fv), this->ny - 1);
+            j1 = (j + 1) % this->ny;
+            tv = fv - j;
+        } else {
+            auto fv = std::clamp((v - this->y0)*this->inv_dy, 0.0, double(this->ny - 1));
+            j = std::min(static_cast<size_t>(fv), this->ny - 1);
+            j1 = std::min(j + 1, this->ny - 1);
+            tv = fv - j;
+        }
+        auto row0 = &this->heights[j*this->nx];
+        auto row1 = &this->heights[j1*this->nx];
+        return (1-tv)*((1-tu)*row0[i] + tu*row0[i1]) + tv*((1-tu)*row1[i] + tu*row1[i1]);
+    }
+
+    double HeightMap::get_height(const double x, const double y, const double c) const {
+        double u, v;
+        this->to_domain(x, y, c, u, v);
+        return this->interpolate(u, v);
+    }
+
+    double HeightMap::get_height(std::shared_ptr<const Point> point) const {
+        return this->get_height(point->x, point->y, point->c);
+    }
+
+    std::shared_ptr<HeightMap> HeightMap::resample(const double x0, const double y0, const double dx, const double dy,
+                                                   const size_t nx, const size_t ny) const {
+        PYG_LOG_V("Resampling height map 0x{:x} on {:d}x{:d} grid", (uint64_t)this, nx, ny);
+        std::vector<double> heights(nx*ny);
+        for (size_t j=0; j<ny; j++)
+            for (size_t i=0; i<nx; i++)
+                heights[j*nx + i] = this->interpolate(x0 + i*dx, y0 + j*dy);
+        return std::make_shared<HeightMap>(x0, y0, dx, dy, nx, ny, heights, this->coordinates, this->radius);
+    }
+
+    std::shared_ptr<Path> HeightMap::apply_to_path(const Path & path, const double max_segment) const {
+        auto n = path.size();
+        if (n == 0)
+            return std::make_shared<Path>(0);
+        // random access iterator avoids copying point pointers
+        auto src = path.begin();
+        // number of sub-segments for each segment
+        std::vector<size_t> splits(n-1, 1);
+        auto total = n;
+        if (max_segment > 0) {
+            for (size_t k=1; k<n; k++) {
+                auto & p0 = *src[k-1];
+                auto & p1 = *src[k];
+                auto dc = std::abs(p1.c - p0.c)/180*M_PI;
+                double length;
+                if (this->coordinates == HeightMapCoordinates::Axial) {
+                    length = std::sqrt(std::pow(p1.x-p0.x, 2) + std::pow(p1.y-p0.y, 2) + std::pow(this->radius*dc, 2));
+                } else {
+                    double u0, v0, u1, v1;
+                    this->to_domain(p0.x, p0.y, p0.c, u0, v0);
+                    this->to_domain(p1.x, p1.y, p1.c, u1, v1);
+                    length = std::hypot(u1-u0, v1-v0);
+                    // rotation draws an arc, which may be longer than the chord
+                    if (dc > 0)
+                        length = std::max(length, std::max(std::hypot(p0.x, p0.y), std::hypot(p1.x, p1.y))*dc);
+                }
+                splits[k-1] = std::max<size_t>(1, static_cast<size_t>(std::ceil(length/max_segment)));
+                total += splits[k-1] - 1;
+            }
+        }
+        auto pts = make_point_block(total);
+        size_t count = 0;
+        auto add_point = [&](const double x, const double y, const double z, const double c) {
+            auto & pt = *pts[count++];
+            double u, v;
+            this->to_domain(x, y, c, u, v);
+            pt.x = x;
+            pt.y = y;
+            pt.z = z + this->interpolate(u, v);
+            pt.c = c;
+        };
+        auto & first = *src[0];
+        add_point(first.x, first.y, first.z, first.c);
+        for (size_t k=1; k<n; k++) {
+            auto & p0 = *src[k-1];
+            auto & p1 = *src[k];
+            // machine axes move linearly between points
+            for (size_t s=1; s<=splits[k-1]; s++) {
+                auto t = double(s)/splits[k-1];
+                add_point(p0.x + t*(p1.x-p0.x), p0.y + t*(p1.y-p0.y), p0.z + t*(p1.z-p0.z), p0.c + t*(p1.c-p0.c));
+            }
+        }
+        return std::make_shared<Path>(std::move(pts));
+    }
+
+    std::shared_ptr<Path> HeightMap::apply(std::shared_ptr<const Path> path, const double max_segment) const {
+        PYG_LOG_V("Correcting heights of path 0x{:x} with height map 0x{:x}", (uint64_t)path.get(), (uint64_t)this);
+        return this->apply_to_path(*path, max_segment);
+    }
+
+    std::shared_ptr<PathGroup> HeightMap::apply(std::shared_ptr<const PathGroup> pg, const double max_segment) const {
+        PYG_LOG_V("Correcting heights of path group 0x{:x} with height map 0x{:x}", (uint64_t)pg.get(), (uint64_t)this);
+        auto paths = pg->get_paths();
+        std::vector<std::shared_ptr<Path>> corrected(paths.size());
+        parallel_for(paths.size(), [&](const size_t k) {
+            corrected[k] = this->apply_to_path(*paths[k], max_segment);
+        });
+        return std::make_shared<PathGroup>(corrected);
+    }
+
+    void py_heightmap_exports(py::module_ & mod) {
+        py::enum_<HeightMapMode>(mod, "HeightMapMode")
+        .value("Bilinear", HeightMapMode::Bilinear)
+        .value("ThinPlateSpline", HeightMapMode::ThinPlateSpline);
+
+        py::enum_<HeightMapCoordinates>(mod, "HeightMapCoordinates")
+        .value("Cartesian", HeightMapCoordinates::Cartesian)
+        .value("Axial", HeightMapCoordinates::Axial);
+
+        py::class_<HeightMap, std::shared_ptr<HeightMap>>(mod, "HeightMap")
+        .def(py::init<const double, const double, const double, const double, const size_t, const size_t, const std::vector<double> &, const HeightMapCoordinates, const double>(),
+             py::arg("x0"), py::arg("y0"), py::arg("dx"), py::arg("dy"), py::arg("nx"), py::arg("ny"), py::arg("heights"), py::arg("coordinates")=HeightMapCoordinates::Cartesian, py::arg("radius")=0)
+        .def(py::init<const std::vector<double> &, const std::vector<double> &, const std::vector<double> &, const double>(),
+             py::arg("xs"), py::arg("ys"), py::arg("zs"), py::arg("regularization")=0)
+        .def_property_readonly("mode", &HeightMap::get_mode)
+        .def_property_readonly("coordinates", &HeightMap::get_coordinates)
+        .def("get_height", static_cast<double(HeightMap::*)(const double, const double, const double) const>(&HeightMap::get_height), py::arg("x"), py::arg("y"), py::arg("c")=0)
+        .def("get_height", static_cast<double(HeightMap::*)(std::shared_ptr<const Point>) const>(&HeightMap::get_height), py::arg("point"))
+        .def("resample", &HeightMap::resample, py::arg("x0"), py::arg("y0"), py::arg("dx"), py::arg("dy"), py::arg("nx"), py::arg("ny"))
+        .def("apply", static_cast<std::shared_ptr<Path>(HeightMap::*)(std::shared_ptr<const Path>, const double) const>(&HeightMap::apply), py::arg("path"), py::arg("max_segment")=0)
+        .def("apply", static_cast<std::shared_ptr<PathGroup>(HeightMap::*)(std::shared_ptr<const PathGroup>, const double) const>(&HeightMap::apply), py::arg("pathgroup"), py::arg("max_segment")=0, py::call_guard<py::gil_scoped_release>())
+        ;
+    }
+
+}
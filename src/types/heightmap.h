@@ -0,0 +1,210 @@
+/** \file heightmap.h
+ *  \brief Header file for HeightMap class and associated enums.
+ *
+ *  Author: Vincent Paeder
+ *  License: MIT
+ */
+#pragma once
+#include <pybind11/pybind11.h>
+#include <vector>
+
+namespace py = pybind11;
+
+namespace pygraver::types {
+
+    class Point;
+    class Path;
+    class PathGroup;
+
+    /** \brief Definition of height map interpolation modes. */
+    enum class HeightMapMode : uint8_t {
+        Bilinear = 0, /**< bilinear interpolation on a regular grid */
+        ThinPlateSpline = 1 /**< thin-plate spline through scattered points */
+    };
+
+    /** \brief Definition of height map domains. */
+    enum class HeightMapCoordinates : uint8_t {
+        Cartesian = 0, /**< heights depend on cartesian x and y (flat stock) */
+        Axial = 1 /**< heights depend on x and c, c being periodic (cylindrical stock) */
+    };
+
+    /** \brief Class representing a measured stock surface, used to correct path heights.
+     *
+     *  Heights are typically obtained by probing the stock. They are added to
+     *  the z coordinate of path points, so that paths drawn for a flat (or
+     *  perfectly round) stock follow the actual surface.
+     */
+    class HeightMap {
+    private:
+        /** \brief Interpolation mode. */
+        HeightMapMode mode;
+
+        /** \brief Domain of height map. */
+        HeightMapCoordinates coordinates;
+
+        /** \brief Stock radius, used to measure segment lengths along c in axial domain. */
+        double radius = 0;
+
+        /** \brief Grid origin along 1st dimension (x). */
+        double x0 = 0;
+
+        /** \brief Grid origin along 2nd dimension (y, or c in axial domain). */
+        double y0 = 0;
+
+        /** \brief Grid step along 1st dimension. */
+        double dx = 1;
+
+        /** \brief Grid step along 2nd dimension. */
+        double dy = 1;
+
+        /** \brief Inverse of grid step along 1st dimension, to avoid divisions during interpolation. */
+        double inv_dx = 1;
+
+        /** \brief Inverse of grid step along 2nd dimension. */
+        double inv_dy = 1;
+
+        /** \brief Number of grid nodes along 1st dimension. */
+        size_t nx = 0;
+
+        /** \brief Number of grid nodes along 2nd dimension. */
+        size_t ny = 0;
+
+        /** \brief Grid heights, row-major (index is j*nx + i). */
+        std::vector<double> heights;
+
+        /** \brief Spline centres along 1st dimension. */
+        std::vector<double> px;
+
+        /** \brief Spline centres along 2nd dimension. */
+        std::vector<double> py;
+
+        /** \brief Spline weights. */
+        std::vector<double> weights;
+
+        /** \brief Affine part of spline (constant, x and y coefficients). */
+        double affine[3] = {0, 0, 0};
+
+        /** \brief Compute position in height map domain.
+         *  \param x: point x coordinate.
+         *  \param y: point y coordinate.
+         *  \param c: point c coordinate, in degrees.
+         *  \param u: position along 1st dimension.
+         *  \param v: position along 2nd dimension.
+         */
+        void to_domain(const double x, const double y, const double c, double & u, double & v) const;
+
+        /** \brief Interpolate height at given position of height map domain.
+         *  \param u: position along 1st dimension.
+         *  \param v: position along 2nd dimension.
+         *  \returns interpolated height.
+         */
+        double interpolate(const double u, const double v) const;
+
+        /** \brief Correct a path and subdivide its long segments.
+         *  \param path: path to correct.
+         *  \param max_segment: maximum segment length (0 to keep segments).
+         *  \returns corrected path.
+         */
+        std::shared_ptr<Path> apply_to_path(const Path & path, const double max_segment) const;
+
+    public:
+        /** \brief Constructor for a regular grid (bilinear interpolation).
+         *
+         *  In axial domain, the 2nd dimension is c and the grid must span one
+         *  revolution (ny*dy = 360); it wraps around.
+         *
+         *  \param x0: grid origin along 1st dimension.
+         *  \param y0: grid origin along 2nd dimension.
+         *  \param dx: grid step along 1st dimension (>0).
+         *  \param dy: grid step along 2nd dimension (>0).
+         *  \param nx: number of nodes along 1st dimension (>=1).
+         *  \param ny: number of nodes along 2nd dimension (>=1).
+         *  \param heights: node heights, row-major (index is j*nx + i).
+         *  \param coordinates: height map domain.
+         *  \param radius: stock radius, for axial domain.
+         */
+        HeightMap(const double x0, const double y0, const double dx, const double dy,
+                  const size_t nx, const size_t ny, const std::vector<double> & heights,
+                  const HeightMapCoordinates coordinates=HeightMapCoordinates::Cartesian,
+                  const double radius=0);
+
+        /** \brief Constructor for scattered points (thin-plate spline).
+         *
+         *  The spline minimizes bending energy; with regularization>0, it
+         *  smoothes measurements instead of going through them exactly.
+         *
+         *  \param xs: point positions along 1st dimension.
+         *  \param ys: point positions along 2nd dimension.
+         *  \param zs: point heights.
+         *  \param regularization: smoothing parameter (>=0).
+         */
+        HeightMap(const std::vector<double> & xs, const std::vector<double> & ys,
+                  const std::vector<double> & zs, const double regularization=0);
+
+        /** \brief Destructor. */
+        ~HeightMap();
+
+        /** \brief Get interpolation mode.
+         *  \returns interpolation mode.
+         */
+        HeightMapMode get_mode() const;
+
+        /** \brief Get height map domain.
+         *  \returns height map domain.
+         */
+        HeightMapCoordinates get_coordinates() const;
+
+        /** \brief Get height at given position.
+         *  \param x: x coordinate.
+         *  \param y: y coordinate.
+         *  \param c: c coordinate, in degrees.
+         *  \returns interpolated height.
+         */
+        double get_height(const double x, const double y, const double c=0) const;
+
+        /** \brief Get height at given point.
+         *  \param point: point.
+         *  \returns interpolated height.
+         */
+        double get_height(std::shared_ptr<const Point> point) const;
+
+        /** \brief Sample height map on a regular grid.
+         *
+         *  Thin-plate splines cost one term per centre at each point; sampling
+         *  them once on a fine grid makes correction of large path groups fast.
+         *
+         *  \param x0: grid origin along 1st dimension.
+         *  \param y0: grid origin along 2nd dimension.
+         *  \param dx: grid step along 1st dimension (>0).
+         *  \param dy: grid step along 2nd dimension (>0).
+         *  \param nx: number of nodes along 1st dimension (>=1).
+         *  \param ny: number of nodes along 2nd dimension (>=1).
+         *  \returns bilinear height map in the same domain.
+         */
+        std::shared_ptr<HeightMap> resample(const double x0, const double y0, const double dx, const double dy,
+                                            const size_t nx, const size_t ny) const;
+
+        /** \brief Correct path heights.
+         *  \param path: path to correct.
+         *  \param max_segment: segments longer than this are subdivided so that correction is followed (0 to keep segments).
+         *  \returns corrected path.
+         */
+        std::shared_ptr<Path> apply(std::shared_ptr<const Path> path, const double max_segment=0) const;
+
+        /** \brief Correct heights of a group of paths.
+         *
+         *  Paths are processed in parallel.
+         *
+         *  \param pg: path group to correct.
+         *  \param max_segment: segments longer than this are subdivided so that correction is followed (0 to keep segments).
+         *  \returns corrected path group.
+         */
+        std::shared_ptr<PathGroup> apply(std::shared_ptr<const PathGroup> pg, const double max_segment=0) const;
+    };
+
+    /** \brief Export function for Python wrapper.
+     *  \param mod: module or submodule to add content to.
+     */
+    void py_heightmap_exports(py::module_ & mod);
+
+}
@@ -0,0 +1,342 @@
+/** \file keepout.cpp
+ *  \brief Implementation file for KeepOut class.
+ *
+ *  Author: Vincent Paeder
+ *  License: MIT
+ */
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+#include <tuple>
+#include <pybind11/stl.h>
+
+#include "common.h"
+#include "keepout.h"
+#include "pathindex.h"
+#include "surface.h"
+#include "path.h"
+#include "pathgroup.h"
+#include "point.h"
+#include "../log.h"
+
+namespace pygraver::types {
+
+    /** \brief Number of points handled at once by a check worker. */
+    static const size_t check_block_size = 65536;
+
+    /** \brief Largest number of grid nodes. */
+    static const size_t max_grid_size = 400000000;
+
+    KeepOut::KeepOut(const std::vector<std::shared_ptr<Surface>> & surfaces, const double resolution, const double margin) {
+        PYG_LOG_V("Creating keep-out zone checker 0x{:x}", (uint64_t)this);
+        if (resolution <= 0)
+            throw std::invalid_argument("Grid resolution must be strictly positive.");
+        if (margin < 0)
+            throw std::invalid_argument("Grid margin must be positive.");
+        this->surfaces = surfaces;
+        this->resolution = resolution;
+        this->inv_resolution = 1/resolution;
+        this->margin = margin;
+
+        // rings of all surfaces, contours first for each surface
+        std::vector<std::shared_ptr<Path>> rings;
+        auto inf = std::numeric_limits<double>::infinity();
+        double xmin = inf, ymin = inf, xmax = -inf, ymax = -inf;
+        for (size_t s=0; s<surfaces.size(); s++) {
+            for (auto hole: {false, true}) {
+                for (auto & ring: hole ? surfaces[s]->get_holes() : surfaces[s]->get_contours()) {
+                    if (ring->size() == 0) continue;
+                    rings.push_back(ring);
+                    this->ring_surfaces.push_back(s);
+                    this->ring_holes.push_back(hole);
+                    auto cartesian = ring->to_cartesian();
+                    for (auto & p: *cartesian) {
+                        xmin = std::min(xmin, p->x);
+                        ymin = std::min(ymin, p->y);
+                        xmax = std::max(xmax, p->x);
+                        ymax = std::max(ymax, p->y);
+                    }
+                }
+            }
+        }
+        if (rings.empty())
+            throw std::invalid_argument("Keep-out zones must have at least one contour point.");
+        this->index = std::make_shared<const PathIndex>(rings, true);
+
+        this->x0 = xmin - margin;
+        this->y0 = ymin - margin;
+        // at least 2 nodes along each axis, so that every point inside grid has a full cell
+        this->nx = std::max<size_t>(2, (size_t)std::ceil((xmax - xmin + 2*margin)*this->inv_resolution) + 1);
+        this->ny = std::max<size_t>(2, (size_t)std::ceil((ymax - ymin + 2*margin)*this->inv_resolution) + 1);
+        if (this->nx > max_grid_size/this->ny)
+            throw std::invalid_argument("Distance grid is too large; increase resolution step.");
+        PYG_LOG_D("Sampling keep-out distance field on a {:d}x{:d} grid", this->nx, this->ny);
+        this->grid.resize(this->nx*this->ny);
+        parallel_for(this->ny, [&](const size_t j) {
+            auto y = this->y0 + j*resolution;
+            auto row = &this->grid[j*this->nx];
+            for (size_t i=0; i<this->nx; i++)
+                row[i] = this->get_distance(this->x0 + i*resolution, y);
+        });
+    }
+
+    KeepOut::~KeepOut() {
+        PYG_LOG_V("Deleting keep-out zone checker 0x{:x}", (uint64_t)this);
+    }
+
+    const std::vector<std::shared_ptr<Surface>> & KeepOut::get_surfaces() const {
+        return this->surfaces;
+    }
+
+    double KeepOut::get_resolution() const {
+        return this->resolution;
+    }
+
+    std::pair<size_t, size_t> KeepOut::get_shape() const {
+        return {this->nx, this->ny};
+    }
+
+    bool KeepOut::inside(const double x, const double y) const {
+        auto rings = this->index->enclosing(x, y);
+        // rings are sorted and grouped by surface, contours first
+        for (size_t k=0; k<rings.size(); ) {
+            auto s = this->ring_surfaces[rings[k]];
+            bool contour = false, hole = false;
+            for (; k<rings.size() && this->ring_surfaces[rings[k]] == s; k++)
+                (this->ring_holes[rings[k]] ? hole : contour) = true;
+            if (contour && !hole)
+                return true;
+        }
+        return false;
+    }
+
+    double KeepOut::get_distance(const double x, const double y) const {
+        auto distance = std::get<3>(this->index->nearest(x, y));
+        return this->inside(x, y) ? -distance : distance;
+    }
+
+    double KeepOut::get_distance(std::shared_ptr<const Point> p) const {
+        auto pt = p->to_cartesian();
+        return this->get_distance(pt->x, pt->y);
+    }
+
+    void KeepOut::sample(const double * xs, const double * ys, const size_t n, double * bounds) const {
+        // interpolated value differs from exact value by at most the distance to the farthest cell corner
+        const auto slack = this->resolution*M_SQRT2;
+        const auto xmax = this->x0 + (this->nx - 1)*this->resolution;
+        const auto ymax = this->y0 + (this->ny - 1)*this->resolution;
+        const auto imax = double(this->nx - 2), jmax = double(this->ny - 2);
+        const auto data = this->grid.data();
+        const auto nx = this->nx;
+        for (size_t k=0; k<n; k++) {
+            auto x = std::clamp(xs[k], this->x0, xmax);
+            auto y = std::clamp(ys[k], this->y0, ymax);
+            // outside grid, zone boundaries are at least margin away from grid border
+            auto outside = std::hypot(xs[k] - x, ys[k] - y);
+            auto fx = (x - this->x0)*this->inv_resolution;
+            auto fy = (y - this->y0)*this->inv_resolution;
+            auto i = std::min(std::floor(fx), imax);
+            auto j = std::min(std::floor(fy), jmax);
+            auto u = fx - i, v = fy - j;
+            auto cell = data + size_t(j)*nx + size_t(i);
+            auto value = (1-v)*((1-u)*cell[0] + u*cell[1]) + v*((1-u)*cell[nx] + u*cell[nx+1]);
+            bounds[k] = outside > 0 ? this->margin + outside : value - slack;
+        }
+    }
+
+    KeepOutReport KeepOut::check(std::shared_ptr<const PathGroup> pg, const double tool_radius, const double clearance) const {
+        PYG_LOG_V("Checking path group 0x{:x} against keep-out zones 0x{:x}", (uint64_t)pg.get(), (uint64_t)this);
+        if (tool_radius < 0)
+            throw std::invalid_argument("Tool radius must be positive.");
+        auto & paths = pg->get_paths();
+        // points and segments are clear if their distance to zones is at least this
+        auto threshold = tool_radius + clearance;
+        // bisection stops below this length; remaining error is half of it
+        auto tolerance = this->resolution/16;
+
+        // work blocks: path index, first point, end point
+        std::vector<std::tuple<size_t, size_t, size_t>> blocks;
+        for (size_t i=0; i<paths.size(); i++)
+            for (size_t start=0; start<paths[i]->size(); start+=check_block_size)
+                blocks.emplace_back(i, start, std::min(start + check_block_size, paths[i]->size()));
+
+        // one report per block, merged in block order
+        std::vector<KeepOutReport> locals(blocks.size());
+        // smallest clearance found so far in any block, to prune refinement
+        std::atomic<double> best_clearance = std::numeric_limits<double>::infinity();
+        parallel_for(blocks.size(), [&](const size_t b) {
+            auto & local = locals[b];
+            std::vector<double> xs, ys, bounds;
+            // clear points and segments that may hold smallest clearance: lower bound, index, true for segments
+            std::vector<std::tuple<double, size_t, bool>> candidates;
+            auto evaluate = [&](const double x, const double y, double & bound) {
+                if (bound < threshold) {
+                    bound = this->get_distance(x, y);
+                    local.exact_evaluations++;
+                }
+            };
+            auto record = [&](const double distance, const size_t i, const size_t j, const double x, const double y) {
+                if (distance - tool_radius < local.min_clearance) {
+                    local.min_clearance = distance - tool_radius;
+                    local.min_location = {i, j};
+                    local.min_point = std::make_shared<Point>(x, y, 0, 0);
+                    auto best = best_clearance.load();
+                    while (local.min_clearance < best && !best_clearance.compare_exchange_weak(best, local.min_clearance));
+                }
+            };
+            // candidates whose lower bound is above this can't hold smallest clearance
+            auto bar = [&]() {
+                return std::min(local.min_clearance, best_clearance.load());
+            };
+            auto [i, start, stop] = blocks[b];
+            auto & path = *paths[i];
+            // one more point closes last segment of block
+            auto end = std::min(stop + 1, path.size());
+            auto n = end - start;
+            xs.resize(n);
+            ys.resize(n);
+            bounds.resize(n);
+            for (size_t k=0; k<n; k++) {
+                auto & p = *path[start + k];
+                auto c = std::cos(p.c/180*M_PI), s = std::sin(p.c/180*M_PI);
+                xs[k] = p.x*c - p.y*s;
+                ys[k] = p.y*c + p.x*s;
+            }
+            this->sample(xs.data(), ys.data(), n, bounds.data());
+
+            // points
+            for (size_t k=0; k<n; k++) {
+                evaluate(xs[k], ys[k], bounds[k]);
+                if (k + start >= stop) continue;
+                if (bounds[k] < threshold) {
+                    local.point_violations.emplace_back(i, start + k);
+                    record(bounds[k], i, start + k, xs[k], ys[k]);
+                }
+            }
+            local.points_checked += stop - start;
+
+            // segments: distance changes at most as fast as position along segment
+            for (size_t k=0; k+1<n; k++) {
+                local.segments_checked++;
+                if (bounds[k] < threshold || bounds[k+1] < threshold) continue;
+                std::vector<std::array<double, 6>> stack = {{xs[k], ys[k], bounds[k], xs[k+1], ys[k+1], bounds[k+1]}};
+                auto violation = std::numeric_limits<double>::infinity();
+                std::array<double, 2> where = {0, 0};
+                while (!stack.empty()) {
+                    auto [ax, ay, fa, bx, by, fb] = stack.back();
+                    stack.pop_back();
+                    auto length = std::hypot(bx - ax, by - ay);
+                    // once segment is known to violate, bisection goes on to find its deepest point
+                    if ((fa + fb - length)/2 >= std::min(threshold, violation) || length < tolerance)
+                        continue;
+                    double mx = (ax + bx)/2, my = (ay + by)/2, fm;
+                    this->sample(&mx, &my, 1, &fm);
+                    evaluate(mx, my, fm);
+                    if (fm < threshold && fm < violation) {
+                        violation = fm;
+                        where = {mx, my};
+                    }
+                    stack.push_back({ax, ay, fa, mx, my, fm});
+                    stack.push_back({mx, my, fm, bx, by, fb});
+                }
+                if (violation < threshold) {
+                    local.segment_violations.emplace_back(i, start + k);
+                    record(violation, i, start + k, where[0], where[1]);
+                }
+            }
+
+            // smallest clearance of clear points and segments, by branch and bound: candidates are
+            // refined by increasing lower bound, as long as they may beat the best exact value so far
+            candidates.clear();
+            for (size_t k=0; k<n; k++) {
+                if (k + start < stop && bounds[k] >= threshold && bounds[k] - tool_radius < bar())
+                    candidates.emplace_back(bounds[k], k, false);
+                if (k+1 < n && bounds[k] >= threshold && bounds[k+1] >= threshold) {
+                    auto bound = (bounds[k] + bounds[k+1] - std::hypot(xs[k+1] - xs[k], ys[k+1] - ys[k]))/2;
+                    if (bound - tool_radius < bar())
+                        candidates.emplace_back(bound, k, true);
+                }
+            }
+            std::sort(candidates.begin(), candidates.end());
+            for (auto [bound, k, segment]: candidates) {
+                if (bound - tool_radius >= bar())
+                    break;
+                if (!segment) {
+                    record(this->get_distance(xs[k], ys[k]), i, start + k, xs[k], ys[k]);
+                    local.exact_evaluations++;
+                    continue;
+                }
+                // segment interior: bisection, with exact values wherever grid bound doesn't rule them out
+                std::vector<std::array<double, 6>> stack = {{xs[k], ys[k], bounds[k], xs[k+1], ys[k+1], bounds[k+1]}};
+                while (!stack.empty()) {
+                    auto [ax, ay, fa, bx, by, fb] = stack.back();
+                    stack.pop_back();
+                    auto length = std::hypot(bx - ax, by - ay);
+                    if ((fa + fb - length)/2 - tool_radius >= bar() || length < tolerance)
+                        continue;
+                    double mx = (ax + bx)/2, my = (ay + by)/2, fm;
+                    this->sample(&mx, &my, 1, &fm);
+                    if (fm - tool_radius < bar()) {
+                        fm = this->get_distance(mx, my);
+                        local.exact_evaluations++;
+                        record(fm, i, start + k, mx, my);
+                    }
+                    stack.push_back({ax, ay, fa, mx, my, fm});
+                    stack.push_back({mx, my, fm, bx, by, fb});
+                }
+            }
+        });
+
+        KeepOutReport report;
+        for (auto & local: locals) {
+            report.point_violations.insert(report.point_violations.end(), local.point_violations.begin(), local.point_violations.end());
+            report.segment_violations.insert(report.segment_violations.end(), local.segment_violations.begin(), local.segment_violations.end());
+            if (local.min_clearance < report.min_clearance) {
+                report.min_clearance = local.min_clearance;
+                report.min_location = local.min_location;
+                report.min_point = local.min_point;
+            }
+            report.points_checked += local.points_checked;
+            report.segments_checked += local.segments_checked;
+            report.exact_evaluations += local.exact_evaluations;
+        }
+
+        std::sort(report.point_violations.begin(), report.point_violations.end());
+        std::sort(report.segment_violations.begin(), report.segment_violations.end());
+        PYG_LOG_D("Checked {:d} points and {:d} segments: {:d} point and {:d} segment violations, {:d} exact evaluations",
+                  report.points_checked, report.segments_checked, report.point_violations.size(),
+                  report.segment_violations.size(), report.exact_evaluations);
+        return report;
+    }
+
+    void py_keepout_exports(py::module_ & mod) {
+        py::class_<KeepOutReport>(mod, "KeepOutReport")
+        .def_readonly("point_violations", &KeepOutReport::point_violations)
+        .def_readonly("segment_violations", &KeepOutReport::segment_violations)
+        .def_readonly("min_clearance", &KeepOutReport::min_clearance)
+        .def_readonly("min_location", &KeepOutReport::min_location)
+        .def_readonly("min_point", &KeepOutReport::min_point)
+        .def_readonly("points_checked", &KeepOutReport::points_checked)
+        .def_readonly("segments_checked", &KeepOutReport::segments_checked)
+        .def_readonly("exact_evaluations", &KeepOutReport::exact_evaluations)
+        .def_property_readonly("ok", [](const KeepOutReport & report) {
+            return report.point_violations.empty() && report.segment_violations.empty();
+        })
+        ;
+
+        py::class_<KeepOut, std::shared_ptr<KeepOut>>(mod, "KeepOut")
+        .def(py::init<const std::vector<std::shared_ptr<Surface>> &, const double, const double>(),
+             py::arg("surfaces"), py::arg("resolution"), py::arg("margin"), py::call_guard<py::gil_scoped_release>())
+        .def_property_readonly("surfaces", &KeepOut::get_surfaces)
+        .def_property_readonly("resolution", &KeepOut::get_resolution)
+        .def_property_readonly("shape", &KeepOut::get_shape)
+        .def("get_distance", static_cast<double(KeepOut::*)(const double, const double) const>(&KeepOut::get_distance), py::arg("x"), py::arg("y"))
+        .def("get_distance", static_cast<double(KeepOut::*)(std::shared_ptr<const Point>) const>(&KeepOut::get_distance), py::arg("point"))
+        .def("check", &KeepOut::check, py::arg("pathgroup"), py::arg("tool_radius"), py::arg("clearance")=0, py::call_guard<py::gil_scoped_release>())
+        ;
+    }
+
+}
@@ -0,0 +1,173 @@
+/** \file keepout.h
+ *  \brief Header file for KeepOut class and associated report structure.
+ *
+ *  Author: Vincent Paeder
+ *  License: MIT
+ */
+#pragma once
+#include <pybind11/pybind11.h>
+#include <limits>
+#include <memory>
+#include <utility>
+#include <vector>
+
+namespace py = pybind11;
+
+namespace pygraver::types {
+
+    class Point;
+    class Path;
+    class PathGroup;
+    class Surface;
+    class PathIndex;
+
+    /** \brief Result of a keep-out zone check. */
+    struct KeepOutReport {
+        /** \brief Path and point indices of points closer than required to a keep-out zone. */
+        std::vector<std::pair<size_t, size_t>> point_violations;
+        /** \brief Path and segment indices of segments whose end points are clear but which cross a keep-out zone margin. */
+        std::vector<std::pair<size_t, size_t>> segment_violations;
+        /** \brief Smallest distance between tool edge and keep-out zones (negative if tool enters a zone);
+         *  along segments, it may be overestimated by up to a thirty-second of grid step. */
+        double min_clearance = std::numeric_limits<double>::infinity();
+        /** \brief Path and point (or segment start) indices where smallest clearance was found. */
+        std::pair<size_t, size_t> min_location = {0, 0};
+        /** \brief Position where smallest clearance was found (cartesian coordinates). */
+        std::shared_ptr<Point> min_point;
+        /** \brief Number of points checked. */
+        size_t points_checked = 0;
+        /** \brief Number of segments checked. */
+        size_t segments_checked = 0;
+        /** \brief Number of exact distance evaluations (near or inside zone margins). */
+        size_t exact_evaluations = 0;
+    };
+
+    /** \brief Class checking that paths stay away from keep-out zones.
+     *
+     *  Keep-out zones (hallmarks, existing engraving, clamps, ...) are given
+     *  as surfaces. A signed distance field of their boundaries (negative
+     *  inside) is sampled once on a regular grid; checks then interpolate the
+     *  grid over contiguous coordinate blocks, in parallel. Since distance
+     *  changes at most as fast as position, the interpolated value is off by
+     *  at most the grid cell diagonal: only points within that band of the
+     *  required distance are evaluated exactly, so point violations don't
+     *  depend on grid resolution. Segments between points are bisected until
+     *  distances at their ends prove them clear, down to a sixteenth of the
+     *  grid step. The smallest clearance is found by branch and bound: clear
+     *  points and segments are refined by increasing lower bound, for as long
+     *  as a bound is below the best exact value found so far. Checks are
+     *  done on the cartesian projection of paths (xy plane), regardless of
+     *  depth.
+     */
+    class KeepOut {
+    private:
+        /** \brief Keep-out zones. */
+        std::vector<std::shared_ptr<Surface>> surfaces;
+
+        /** \brief Spatial index of zone boundaries (contours then holes of each surface). */
+        std::shared_ptr<const PathIndex> index;
+
+        /** \brief Surface index of each boundary ring. */
+        std::vector<size_t> ring_surfaces;
+
+        /** \brief Tells if each boundary ring is a hole. */
+        std::vector<bool> ring_holes;
+
+        /** \brief Sampled signed distances, row-major (index is row*nx + column). */
+        std::vector<double> grid;
+
+        /** \brief Number of grid columns. */
+        size_t nx = 0;
+
+        /** \brief Number of grid rows. */
+        size_t ny = 0;
+
+        /** \brief Position of the first grid node along x. */
+        double x0 = 0;
+
+        /** \brief Position of the first grid node along y. */
+        double y0 = 0;
+
+        /** \brief Grid step. */
+        double resolution = 1;
+
+        /** \brief Inverse of grid step, to avoid divisions during sampling. */
+        double inv_resolution = 1;
+
+        /** \brief Distance between zone extent and grid border. */
+        double margin = 0;
+
+        /** \brief Tell if a point is inside a keep-out zone.
+         *  \param x: x coordinate.
+         *  \param y: y coordinate.
+         *  \returns true if point is inside a contour of a surface and in none of its holes.
+         */
+        bool inside(const double x, const double y) const;
+
+        /** \brief Compute lower bounds of signed distances from grid.
+         *  \param xs: x coordinates.
+         *  \param ys: y coordinates.
+         *  \param n: number of points.
+         *  \param bounds: output values; the exact distance is never smaller.
+         */
+        void sample(const double * xs, const double * ys, const size_t n, double * bounds) const;
+
+    public:
+        /** \brief Constructor.
+         *
+         *  The distance field is computed here, in parallel.
+         *
+         *  \param surfaces: keep-out zones.
+         *  \param resolution: grid step (>0).
+         *  \param margin: distance between zone extent and grid border (>=0); it should exceed
+         *                 the largest tool radius plus clearance, otherwise points outside the
+         *                 grid but close to it need exact evaluation.
+         */
+        KeepOut(const std::vector<std::shared_ptr<Surface>> & surfaces, const double resolution, const double margin);
+
+        /** \brief Destructor. */
+        ~KeepOut();
+
+        /** \brief Get keep-out zones.
+         *  \returns a collection of surfaces.
+         */
+        const std::vector<std::shared_ptr<Surface>> & get_surfaces() const;
+
+        /** \brief Get grid step.
+         *  \returns grid step.
+         */
+        double get_resolution() const;
+
+        /** \brief Get grid shape.
+         *  \returns number of columns and rows.
+         */
+        std::pair<size_t, size_t> get_shape() const;
+
+        /** \brief Compute exact signed distance to keep-out zones.
+         *  \param x: x coordinate (cartesian).
+         *  \param y: y coordinate (cartesian).
+         *  \returns distance to closest zone boundary, negative inside a zone.
+         */
+        double get_distance(const double x, const double y) const;
+
+        /** \brief Compute exact signed distance to keep-out zones.
+         *  \param p: point (c component is projected).
+         *  \returns distance to closest zone boundary, negative inside a zone.
+         */
+        double get_distance(std::shared_ptr<const Point> p) const;
+
+        /** \brief Check that paths keep away from keep-out zones.
+         *  \param pg: paths to check.
+         *  \param tool_radius: tool radius (>=0).
+         *  \param clearance: smallest allowed distance between tool edge and zones.
+         *  \returns check report.
+         */
+        KeepOutReport check(std::shared_ptr<const PathGroup> pg, const double tool_radius, const double clearance=0) const;
+    };
+
+    /** \brief Export function for Python wrapper.
+     *  \param mod: module or submodule to add content to.
+     */
+    void py_keepout_exports(py::module_ & mod);
+
+}
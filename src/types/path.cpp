@@ -26,8 +26,6 @@ using GEOSCoordinate = geos::geom::Coordinate;
 using GEOSPolygon = geos::geom::Polygon;
 /** \brief Shorthand for geos::geom::CoordinateArraySequence class. */
 using GEOSCoordinateArraySequence = geos::geom::CoordinateArraySequence;
-/** \brief Shorthand for geos::geom::CoordinateSequence class. */
-using GEOSCoordinateSequence = geos::geom::CoordinateSequence;
 /** \brief Shorthand for geos::operation::buffer::BufferParameters class. */
 using GEOSBufferParameters = gob::BufferParameters;
 /** \brief Shorthand for geos::operation::buffer::BufferBuilder class. */
@@ -75,6 +73,23 @@ namespace pygraver::types {
         this->resize(n);
     }
 
+    Path::Path(const GEOSCoordinateSequence & coords) {
+        this->initialize();
+        auto sz = coords.getSize();
+        PYG_LOG_D("Extracting coordinate sequence of size {}", sz);
+        if (sz==0)
+            return;
+        this->pts = make_point_block(sz);
+        auto has_z = coords.hasZ();
+        for (size_t i=0; i<sz; i++) {
+            auto & coord = coords.getAt(i);
+            auto & pt = *this->pts[i];
+            pt.x = coord.x;
+            pt.y = coord.y;
+            pt.z = has_z ? coord.z : 0;
+        }
+    }
+
     Path::Path(std::shared_ptr<const Point> p) {
         PYG_LOG_V("Creating path 0x{:x} with point 0x{:x}", (uint64_t)this, (uint64_t)&p);
         this->reserve(1);
@@ -153,6 +168,11 @@ namespace pygraver::types {
         this->reserve(n);
         std::copy(points.begin(), points.end(), std::back_inserter(this->pts));
     }
+
+    Path::Path(std::vector<std::shared_ptr<Point>> && points) {
+        PYG_LOG_V("Creating path 0x{:x} from {:d} points", (uint64_t)this, points.size());
+        this->pts = std::move(points);
+    }
     
     Path::~Path() {
         PYG_LOG_V("Deleting path 0x{:x}", (uint64_t)this);
@@ -190,36 +210,45 @@ namespace pygraver::types {
         return this->pts[idx];
     }
 
+    /** \brief Build a GEOS coordinate sequence from path points.
+     * 
+     *  Coordinates are gathered in a vector that is moved into the sequence,
+     *  which avoids element-wise virtual calls. Rotation is skipped for points
+     *  with zero c component.
+     * 
+     *  \param pts: path points.
+     *  \param n: number of points to convert.
+     *  \param close: if true, repeat first point at the end.
+     *  \returns pointer to a GEOS CoordinateArraySequence object.
+     */
+    static std::unique_ptr<GEOSCoordinateArraySequence> make_coordinate_sequence(const std::vector<std::shared_ptr<Point>> & pts, const size_t n, const bool close) {
+        std::vector<GEOSCoordinate> coords;
+        coords.reserve(n+1);
+        for (size_t i=0; i<n; i++) {
+            auto & pt = *pts[i];
+            if (pt.c == 0) {
+                coords.emplace_back(pt.x, pt.y, pt.z);
+                continue;
+            }
+            auto c = cos(pt.c/180*M_PI);
+            auto s = sin(pt.c/180*M_PI);
+            coords.emplace_back(pt.x*c - pt.y*s, pt.x*s + pt.y*c, pt.z);
+        }
+        if (close && n > 0)
+            coords.emplace_back(coords.front());
+        return std::make_unique<GEOSCoordinateArraySequence>(std::move(coords), 3);
+    }
+
     std::unique_ptr<GEOSLineString> Path::as_open_geos_geometry() const {
         PYG_LOG_V("Creating open GEOS geometry for path 0x{:x}", (uint64_t)this);
-        std::unique_ptr<GEOSCoordinateArraySequence> cs = std::make_unique<GEOSCoordinateArraySequence>(this->size(), 3);
-        double x, y, c, s;
-        for (auto i=0; i<this->size(); i++) {
-            c = cos(this->pts[i]->c/180*M_PI);
-            s = sin(this->pts[i]->c/180*M_PI);
-            x = this->pts[i]->x*c - this->pts[i]->y*s;
-            y = this->pts[i]->x*s + this->pts[i]->y*c;
-            cs->setAt(GEOSCoordinate(x, y, this->pts[i]->z), i);
-        }
-        std::unique_ptr<GEOSLineString> ls = gfactory->createLineString(std::move(cs));
+        std::unique_ptr<GEOSLineString> ls = gfactory->createLineString(make_coordinate_sequence(this->pts, this->size(), false));
         return ls;
     }
 
     std::unique_ptr<GEOSLinearRing> Path::as_closed_geos_geometry() const {
         PYG_LOG_V("Creating closed GEOS geometry for path 0x{:x}", (uint64_t)this);
-        double x, y, c, s;
         size_t max_n = this->is_closed() ? this->size()-1 : this->size();
-        std::unique_ptr<GEOSCoordinateSequence> cs = std::make_unique<GEOSCoordinateArraySequence>(max_n+1, 3);
-        for (auto i=0; i<max_n; i++) {
-            c = cos(this->pts[i]->c/180*M_PI);
-            s = sin(this->pts[i]->c/180*M_PI);
-            x = this->pts[i]->x*c - this->pts[i]->y*s;
-            y = this->pts[i]->x*s + this->pts[i]->y*c;
-            cs->setAt(GEOSCoordinate(x, y, this->pts[i]->z), i);
-            if (i==0)
-                cs->setAt(GEOSCoordinate(x, y, this->pts[i]->z), max_n);
-        }
-        std::unique_ptr<GEOSLinearRing> lr = gfactory->createLinearRing(std::move(cs));
+        std::unique_ptr<GEOSLinearRing> lr = gfactory->createLinearRing(make_coordinate_sequence(this->pts, max_n, true));
         PYG_LOG_D("Geometry is {}valid", lr->isValid() ? "" : "in");
         PYG_LOG_D("Geometry is {}empty", lr->isEmpty() ? "" : "not ");
         PYG_LOG_D("Geometry is {}simple", lr->isSimple() ? "" : "not ");
@@ -1101,21 +1130,12 @@ namespace pygraver::types {
 
     std::shared_ptr<Path> make_path(const GEOSGeometry * g) {
         PYG_LOG_V("Creating path from GEOS geometry 0x{:x}", (uint64_t)g);
+        // line strings and rings expose their coordinates without copy
+        auto ls = dynamic_cast<const GEOSLineString*>(g);
+        if (ls)
+            return std::make_shared<Path>(*ls->getCoordinatesRO());
         auto coords = g->getCoordinates();
-        auto sz = coords->getSize();
-        PYG_LOG_D("Extracting geometry of size {}", sz);
-        auto new_path = std::make_shared<Path>(0);
-        new_path->reserve(sz);
-        if (coords->hasZ()) {
-            for (auto i=0; i<sz; i++) {
-                auto coord = coords->getAt(i);
-                new_path->emplace_back(std::make_shared<Point>(coord.x, coord.y, coord.z));
-            }
-        } else {
-            for (auto i=0; i<sz; i++)
-                new_path->emplace_back(std::make_shared<Point>(coords->getX(i), coords->getY(i)));
-        }
-        return new_path;
+        return std::make_shared<Path>(*coords);
     }
 
     void py_path_exports(py::module_ & mod) {
@@ -5,6 +5,7 @@
  *  License: MIT
  */
 #pragma once
+#include <geos/geom/CoordinateSequence.h>
 #include <geos/geom/Geometry.h>
 #include <geos/geom/LineString.h>
 #include <geos/geom/LinearRing.h>
@@ -12,6 +13,8 @@
 #include <pybind11/numpy.h>
 #include <vector>
 
+/** \brief Shorthand for geos::geom::CoordinateSequence class. */
+using GEOSCoordinateSequence = geos::geom::CoordinateSequence;
 /** \brief Shorthand for geos::geom::Geometry class. */
 using GEOSGeometry = geos::geom::Geometry;
 /** \brief Shorthand for geos::geom::LineString class. */
@@ -101,11 +104,26 @@ namespace pygraver::types {
              const py::array_t<double> & zs = py::array_t<double>(),
              const py::array_t<double> & cs = py::array_t<double>());
 
+        /** \brief Constructor with GEOS coordinate sequence.
+         * 
+         *  Points are allocated in one contiguous block, which is released
+         *  once no point refers to it anymore. Coordinates are taken as
+         *  cartesian (c=0); z is 0 if the sequence has no z component.
+         * 
+         *  \param coords: coordinate sequence.
+         */
+        Path(const GEOSCoordinateSequence & coords);
+
         /** \brief Constructor with vector of Point objects.
          *  \param points: vector of points.
          */
         Path(const std::vector<std::shared_ptr<Point>> & points);
 
+        /** \brief Constructor taking ownership of a vector of Point objects.
+         *  \param points: vector of points.
+         */
+        Path(std::vector<std::shared_ptr<Point>> && points);
+
         /** \brief Destructor. */
         ~Path();
 
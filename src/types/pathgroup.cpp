@@ -4,17 +4,42 @@
  *  Author: Vincent Paeder
  *  License: MIT
  */
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cmath>
+#include <functional>
+#include <unordered_map>
+#include <geos/geom/Envelope.h>
+#include <geos/index/strtree/STRtree.h>
 #include <pybind11/stl.h>
 
 #include "common.h"
 #include "pathgroup.h"
+#include "pathindex.h"
 #include "path.h"
 #include "surface.h"
 #include "point.h"
 #include "../log.h"
 
+/** \brief Shorthand for geos::index::strtree::STRtree class. */
+using GEOSSTRtree = geos::index::strtree::STRtree;
+
 namespace pygraver::types {
 
+    /** \brief Segment endpoints quantized on a grid, in canonical order. */
+    using SegmentKey = std::array<int64_t, 6>;
+
+    /** \brief Hash function for quantized segments. */
+    struct SegmentKeyHash {
+        size_t operator()(const SegmentKey & key) const {
+            uint64_t h = 0x9e3779b97f4a7c15ull;
+            for (auto v: key)
+                h ^= static_cast<uint64_t>(v) + 0x9e3779b97f4a7c15ull + (h << 6) + (h >> 2);
+            return static_cast<size_t>(h);
+        }
+    };
+
     void PathGroup::initialize() {
         PYG_LOG_V("Creating path group 0x{:x}", (uint64_t)this);
         if (!gfactory.get()) {
@@ -95,6 +120,7 @@ namespace pygraver::types {
 
     void PathGroup::resize(const size_t n) {
         this->paths.resize(n);
+        this->reset_index();
     }
 
     std::shared_ptr<PathGroup> operator+ (std::shared_ptr<const PathGroup> p, std::shared_ptr<const PathGroup> q) {
@@ -161,6 +187,7 @@ namespace pygraver::types {
             for (auto j=0; j<this->paths[i]->size(); j++)
                 (*this->paths[i])[j] += steps[i-1] - dp;
         }
+        this->reset_index();
     }
 
     double PathGroup::get_radius() const {
@@ -430,12 +457,223 @@ namespace pygraver::types {
         return new_group;
     }
     
+    std::pair<std::shared_ptr<PathGroup>, double> PathGroup::remove_overlaps(const double tolerance) const {
+        PYG_LOG_V("Removing overlapping segments from pathgroup 0x{:x}", (uint64_t)this);
+        if (tolerance < 0)
+            throw std::invalid_argument("Tolerance must be positive or 0.");
+        // segments in cartesian coordinates; first_segment[i] is the index of the 1st segment of path i
+        struct Segment { double x0, y0, z0, x1, y1, z1; bool line; };
+        std::vector<Segment> segments;
+        std::vector<size_t> first_segment(this->paths.size() + 1, 0);
+        for (size_t i=0; i<this->paths.size(); i++) {
+            first_segment[i] = segments.size();
+            auto src = this->paths[i]->begin();
+            auto n = this->paths[i]->size();
+            for (size_t j=1; j<n; j++) {
+                auto & p0 = *src[j-1];
+                auto & p1 = *src[j];
+                auto c0 = std::cos(p0.c/180*M_PI), s0 = std::sin(p0.c/180*M_PI);
+                auto c1 = std::cos(p1.c/180*M_PI), s1 = std::sin(p1.c/180*M_PI);
+                segments.push_back({p0.x*c0 - p0.y*s0, p0.x*s0 + p0.y*c0, p0.z,
+                                    p1.x*c1 - p1.y*s1, p1.x*s1 + p1.y*c1, p1.z, p0.c == p1.c});
+            }
+        }
+        first_segment.back() = segments.size();
+        auto n_seg = segments.size();
+
+        // 1st pass: segments equal to an earlier one once quantized are dropped right away
+        auto quantum = std::max(tolerance, 1e-9);
+        std::vector<bool> duplicate(n_seg, false);
+        {
+            std::unordered_map<SegmentKey, size_t, SegmentKeyHash> seen;
+            seen.reserve(n_seg);
+            for (size_t k=0; k<n_seg; k++) {
+                auto & s = segments[k];
+                if (!s.line) continue;
+                std::array<int64_t, 3> a = {std::llround(s.x0/quantum), std::llround(s.y0/quantum), std::llround(s.z0/quantum)};
+                std::array<int64_t, 3> b = {std::llround(s.x1/quantum), std::llround(s.y1/quantum), std::llround(s.z1/quantum)};
+                // a segment and its reverse cut the same groove
+                if (b < a) std::swap(a, b);
+                if (a == b) continue;
+                if (!seen.emplace(SegmentKey{a[0], a[1], a[2], b[0], b[1], b[2]}, k).second)
+                    duplicate[k] = true;
+            }
+        }
+
+        // 2nd pass: other segments are trimmed where earlier segments cover them;
+        // envelopes must not be moved after insertion
+        std::vector<gg::Envelope> envelopes(n_seg);
+        GEOSSTRtree tree;
+        for (size_t k=0; k<n_seg; k++) {
+            auto & s = segments[k];
+            if (!s.line || duplicate[k]) continue;
+            envelopes[k].init(s.x0, s.x1, s.y0, s.y1);
+            envelopes[k].expandBy(tolerance);
+            tree.insert(&envelopes[k], reinterpret_cast<void*>(k));
+        }
+        // tree is built on first query; queries are then safe from several threads
+        {
+            std::vector<void*> candidates;
+            gg::Envelope empty;
+            tree.query(&empty, candidates);
+        }
+        // kept parts of each segment, as intervals of segment parameter
+        std::vector<std::vector<std::pair<double, double>>> kept(n_seg);
+        std::vector<double> removed(n_seg, 0);
+        parallel_for(n_seg, [&](const size_t k) {
+            auto & s = segments[k];
+            auto dx = s.x1 - s.x0, dy = s.y1 - s.y0, dz = s.z1 - s.z0;
+            auto length = std::sqrt(dx*dx + dy*dy + dz*dz);
+            if (duplicate[k]) {
+                removed[k] = length;
+                return;
+            }
+            if (!s.line || length <= tolerance) {
+                kept[k].emplace_back(0, 1);
+                return;
+            }
+            auto ux = dx/length, uy = dy/length, uz = dz/length;
+            // position of a point along segment, or -inf if it is too far from segment line
+            auto project = [&](const double x, const double y, const double z) {
+                auto ax = x - s.x0, ay = y - s.y0, az = z - s.z0;
+                auto t = ax*ux + ay*uy + az*uz;
+                auto d2 = std::pow(ax - t*ux, 2) + std::pow(ay - t*uy, 2) + std::pow(az - t*uz, 2);
+                return d2 <= tolerance*tolerance ? t : -std::numeric_limits<double>::infinity();
+            };
+            std::vector<void*> candidates;
+            tree.query(&envelopes[k], candidates);
+            std::vector<std::pair<double, double>> covered;
+            for (auto candidate: candidates) {
+                auto j = reinterpret_cast<size_t>(candidate);
+                if (j >= k) continue;
+                auto & o = segments[j];
+                auto ta = project(o.x0, o.y0, o.z0);
+                auto tb = project(o.x1, o.y1, o.z1);
+                if (std::isinf(ta) || std::isinf(tb)) continue;
+                auto lo = std::max(0.0, std::min(ta, tb));
+                auto hi = std::min(length, std::max(ta, tb));
+                // segments touching at their ends don't overlap
+                if (hi - lo > tolerance)
+                    covered.emplace_back(lo, hi);
+            }
+            if (covered.empty()) {
+                kept[k].emplace_back(0, 1);
+                return;
+            }
+            std::sort(covered.begin(), covered.end());
+            // gaps shorter than tolerance are considered covered
+            auto start = 0.0;
+            for (auto & [lo, hi]: covered) {
+                if (lo - start > tolerance)
+                    kept[k].emplace_back(start/length, lo/length);
+                start = std::max(start, hi);
+            }
+            if (length - start > tolerance)
+                kept[k].emplace_back(start/length, 1);
+            auto remaining = 0.0;
+            for (auto & [lo, hi]: kept[k])
+                remaining += hi - lo;
+            removed[k] = (1 - remaining)*length;
+        }, 1024);
+
+        // stitch kept parts back into paths
+        std::vector<std::vector<std::shared_ptr<Path>>> pieces(this->paths.size());
+        parallel_for(this->paths.size(), [&](const size_t i) {
+            auto & path = this->paths[i];
+            auto src = path->begin();
+            auto n = path->size();
+            if (n < 2) {
+                pieces[i].emplace_back(std::make_shared<Path>(*path));
+                return;
+            }
+            auto interpolate = [&](const size_t j, const double t) {
+                auto & p0 = *src[j];
+                auto & p1 = *src[j+1];
+                return std::make_shared<Point>(p0.x + t*(p1.x - p0.x), p0.y + t*(p1.y - p0.y), p0.z + t*(p1.z - p0.z), p0.c + t*(p1.c - p0.c));
+            };
+            std::vector<std::vector<std::shared_ptr<Point>>> parts;
+            std::vector<std::shared_ptr<Point>> current;
+            // true if current part ends at an original point
+            auto at_vertex = false;
+            for (size_t j=0; j+1<n; j++) {
+                auto & intervals = kept[first_segment[i] + j];
+                if (intervals.empty())
+                    at_vertex = false;
+                for (auto & [lo, hi]: intervals) {
+                    if (lo > 0 || !at_vertex) {
+                        if (current.size() > 1)
+                            parts.emplace_back(std::move(current));
+                        current.clear();
+                        current.emplace_back(lo > 0 ? interpolate(j, lo) : src[j]);
+                    }
+                    current.emplace_back(hi < 1 ? interpolate(j, hi) : src[j+1]);
+                    at_vertex = hi == 1;
+                }
+            }
+            if (current.size() > 1)
+                parts.emplace_back(std::move(current));
+            // a closed path cut in several parts is joined back across its start point
+            if (parts.size() > 1 && path->is_closed() && parts.front().front() == src[0] && parts.back().back() == src[n-1]) {
+                parts.back().insert(parts.back().end(), parts.front().begin() + 1, parts.front().end());
+                parts.front() = std::move(parts.back());
+                parts.pop_back();
+            }
+            for (auto & part: parts)
+                pieces[i].emplace_back(std::make_shared<Path>(std::move(part)));
+        }, 1024);
+
+        auto new_group = std::make_shared<PathGroup>();
+        new_group->reserve(this->size());
+        for (auto & group: pieces)
+            for (auto & path: group)
+                new_group->emplace_back(path);
+        auto total = 0.0;
+        for (auto length: removed)
+            total += length;
+        PYG_LOG_D("Removed {:f} units of overlapping segments", total);
+        return std::make_pair(new_group, total);
+    }
+
+    std::shared_ptr<const PathIndex> PathGroup::get_index() const {
+        auto index = std::atomic_load(&this->index);
+        // paths appended since last build aren't indexed yet
+        if (!index || index->size() != this->paths.size()) {
+            // concurrent first queries may each build an index; only one is kept
+            index = std::make_shared<const PathIndex>(this->paths);
+            std::atomic_store(&this->index, index);
+        }
+        return index;
+    }
+
+    void PathGroup::reset_index() {
+        std::atomic_store(&this->index, std::shared_ptr<const PathIndex>());
+    }
+
+    std::vector<size_t> PathGroup::query(const std::array<double, 4> & bbox) const {
+        PYG_LOG_V("Querying paths of pathgroup 0x{:x} in region", (uint64_t)this);
+        auto [xmin, ymin, xmax, ymax] = bbox;
+        if (xmin > xmax || ymin > ymax)
+            throw std::invalid_argument("Region lower bounds must not exceed upper bounds.");
+        return this->get_index()->query(xmin, ymin, xmax, ymax);
+    }
+
+    std::pair<size_t, std::shared_ptr<Point>> PathGroup::nearest(std::shared_ptr<const Point> pt) const {
+        PYG_LOG_V("Looking for path of pathgroup 0x{:x} closest to point 0x{:x}", (uint64_t)this, (uint64_t)pt.get());
+        auto ref = pt->to_cartesian();
+        auto [path, segment, t, distance] = this->get_index()->nearest(ref->x, ref->y);
+        auto & p = *this->paths[path];
+        auto a = p[segment]->to_cartesian();
+        auto b = p[std::min(segment + 1, p.size() - 1)]->to_cartesian();
+        return std::make_pair(path, std::make_shared<Point>(a->x + t*(b->x - a->x), a->y + t*(b->y - a->y), a->z + t*(b->z - a->z), 0));
+    }
+
     const std::vector<std::shared_ptr<Path>> & PathGroup::get_paths() const {
         return this->paths;
     }
 
     void PathGroup::set_paths(const std::vector<std::shared_ptr<Path>> & paths) {
         this->paths = paths;
+        this->reset_index();
     }
 
     std::shared_ptr<Path> PathGroup::py_get_item(int idx) const {
@@ -462,6 +700,7 @@ namespace pygraver::types {
 
     void PathGroup::py_set_item(int idx, std::shared_ptr<Path> path) {
         this->paths[idx] = path;
+        this->reset_index();
     }
 
     void PathGroup::py_set_item_slice(const py::slice & slice, const std::vector<std::shared_ptr<Path>> & ps) {
@@ -473,6 +712,7 @@ namespace pygraver::types {
         auto p_it = ps.begin();
         for (auto it = this->paths.begin()+start; it<this->paths.begin()+stop; std::advance(it,step))
             *it = *p_it++;
+        this->reset_index();
     }
 
     void py_pathgroup_exports(py::module_ & mod) {
@@ -511,6 +751,13 @@ namespace pygraver::types {
         .def("sort_paths", &PathGroup::sort_paths, py::arg("ref_point"), py::arg("predicate")=SortPredicate::EndToStart)
         .def("rearrange", &PathGroup::rearrange, py::arg("limit_height"))
         .def("reorder", &PathGroup::reorder, py::arg("order"))
+        .def("remove_overlaps", &PathGroup::remove_overlaps, py::arg("tolerance")=1e-6, py::call_guard<py::gil_scoped_release>())
+        .def("query", &PathGroup::query, py::arg("bbox"), py::call_guard<py::gil_scoped_release>(),
+             "Indices of paths crossing region (xmin, ymin, xmax, ymax). Call reset_index() first if points were edited in place.")
+        .def("nearest", &PathGroup::nearest, py::arg("point"), py::call_guard<py::gil_scoped_release>(),
+             "Index of closest path to point, and closest point on it. Call reset_index() first if points were edited in place.")
+        .def("reset_index", &PathGroup::reset_index,
+             "Discard spatial index. Needed after points or paths were edited in place (e.g. pg[0][1].x = 2); group methods and appends are handled automatically.")
         .def("__getitem__", &PathGroup::py_get_item)
         .def("__getitem__", &PathGroup::py_get_item_slice)
         .def("__setitem__", &PathGroup::py_set_item)
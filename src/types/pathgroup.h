@@ -7,6 +7,7 @@
 #pragma once
 #include <pybind11/pybind11.h>
 #include <pybind11/numpy.h>
+#include <array>
 #include <vector>
 
 #include "path.h"
@@ -18,6 +19,7 @@ namespace pygraver::types {
     class Path;
     class Surface;
     class Point;
+    class PathIndex;
 
     /** \brief Definition of sorting strategies for sort_paths method. */
     enum class SortPredicate : uint8_t {
@@ -32,9 +34,21 @@ namespace pygraver::types {
         /** \brief Paths. */
         std::vector<std::shared_ptr<Path>> paths;
 
+        /** \brief Spatial index over paths, built on first query (nullptr until then).
+         *
+         *  Appending paths doesn't discard it: an index covering fewer paths
+         *  than the group is rebuilt at next query.
+         */
+        mutable std::shared_ptr<const PathIndex> index;
+
         /** \brief Initialize instance. */
         void initialize();
 
+        /** \brief Get spatial index, building it if necessary.
+         *  \returns spatial index.
+         */
+        std::shared_ptr<const PathIndex> get_index() const;
+
     public:
 
         /** \brief Default constructor. */
@@ -308,6 +322,45 @@ namespace pygraver::types {
          *  \returns path group containing reordered paths.
          */
         std::shared_ptr<PathGroup> reorder(const std::vector<unsigned int> & order) const;
+
+        /** \brief Remove duplicated and overlapping segments.
+         *
+         *  Segments lying along an earlier segment (within tolerance) are
+         *  trimmed or removed, so that the same groove isn't cut twice. Paths
+         *  are split where parts are removed; a closed path split this way is
+         *  stitched back across its start point. Segments are compared as
+         *  straight lines in cartesian coordinates; segments along which c
+         *  changes are arcs and are kept as they are.
+         *
+         *  \param tolerance: maximum distance between overlapping segments.
+         *  \returns path group without overlaps, and removed length.
+         */
+        std::pair<std::shared_ptr<PathGroup>, double> remove_overlaps(const double tolerance) const;
+
+        /** \brief Find paths crossing a rectangular region.
+         *
+         *  Paths are looked up in a spatial index (bounding volume tree over
+         *  paths, and over segments of long paths), built in parallel on first
+         *  query. Coordinates are cartesian; segments are taken as straight lines.
+         *
+         *  \param bbox: region bounds, as (xmin, ymin, xmax, ymax).
+         *  \returns indices of paths with at least one segment inside or across the region, in increasing order.
+         */
+        std::vector<size_t> query(const std::array<double, 4> & bbox) const;
+
+        /** \brief Find closest path to a point.
+         *  \param pt: reference point.
+         *  \returns index of closest path, and closest point on it (in cartesian coordinates).
+         */
+        std::pair<size_t, std::shared_ptr<Point>> nearest(std::shared_ptr<const Point> pt) const;
+
+        /** \brief Discard spatial index.
+         *
+         *  Path group methods that change paths do this themselves (appended
+         *  paths are detected at next query); this is needed only after points
+         *  or paths of the group were modified in place.
+         */
+        void reset_index();
     
         /** \brief Get paths.
          *  \returns the paths contained in the path group.
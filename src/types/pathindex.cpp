@@ -0,0 +1,272 @@
+/** \file pathindex.cpp
+ *  \brief Implementation file for PathIndex class.
+ *
+ *  Author: Vincent Paeder
+ *  License: MIT
+ */
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+#include <geos/index/strtree/ItemBoundable.h>
+#include <geos/index/strtree/ItemDistance.h>
+
+#include "common.h"
+#include "pathindex.h"
+#include "path.h"
+#include "point.h"
+#include "../log.h"
+
+/** \brief Shorthand for geos::geom::Envelope class. */
+using GEOSEnvelope = geos::geom::Envelope;
+/** \brief Shorthand for geos::index::strtree::STRtree class. */
+using GEOSSTRtree = geos::index::strtree::STRtree;
+/** \brief Shorthand for geos::index::strtree::ItemBoundable class. */
+using GEOSItemBoundable = geos::index::strtree::ItemBoundable;
+/** \brief Shorthand for geos::index::strtree::ItemDistance class. */
+using GEOSItemDistance = geos::index::strtree::ItemDistance;
+
+namespace pygraver::types {
+
+    /** \brief Paths with at least this number of segments get their own segment tree. */
+    static const size_t segment_tree_threshold = 32;
+
+    /** \brief Vertex coordinates. */
+    using Vertex = std::array<double, 2>;
+
+    /** \brief Find closest point of a segment.
+     *  \param a: segment start.
+     *  \param b: segment end.
+     *  \param x: x coordinate of reference point.
+     *  \param y: y coordinate of reference point.
+     *  \returns position along segment (0 to 1) and distance.
+     */
+    static std::pair<double, double> segment_distance(const Vertex & a, const Vertex & b, const double x, const double y) {
+        auto dx = b[0] - a[0], dy = b[1] - a[1];
+        auto l2 = dx*dx + dy*dy;
+        auto t = l2 > 0 ? std::clamp(((x - a[0])*dx + (y - a[1])*dy)/l2, 0.0, 1.0) : 0.0;
+        return {t, std::hypot(a[0] + t*dx - x, a[1] + t*dy - y)};
+    }
+
+    /** \brief Tell if a segment crosses a rectangle (Liang-Barsky clipping).
+     *  \param a: segment start.
+     *  \param b: segment end.
+     *  \param env: rectangle.
+     *  \returns true if part of the segment is inside the rectangle.
+     */
+    static bool segment_intersects(const Vertex & a, const Vertex & b, const GEOSEnvelope & env) {
+        double t0 = 0, t1 = 1;
+        auto dx = b[0] - a[0], dy = b[1] - a[1];
+        const double p[4] = {-dx, dx, -dy, dy};
+        const double q[4] = {a[0] - env.getMinX(), env.getMaxX() - a[0], a[1] - env.getMinY(), env.getMaxY() - a[1]};
+        for (auto i=0; i<4; i++) {
+            if (p[i] == 0) {
+                if (q[i] < 0) return false;
+            } else {
+                auto r = q[i]/p[i];
+                if (p[i] < 0) t0 = std::max(t0, r);
+                else t1 = std::min(t1, r);
+                if (t0 > t1) return false;
+            }
+        }
+        return true;
+    }
+
+    /** \brief Force tree construction; tree is built on first query, and queries are then safe from several threads.
+     *  \param tree: tree to build.
+     */
+    static void build_tree(GEOSSTRtree & tree) {
+        std::vector<void*> candidates;
+        GEOSEnvelope empty;
+        tree.query(&empty, candidates);
+    }
+
+    /** \brief Distance between a tree item and a query point, computed by a function of item index. */
+    template <class Function> class IndexDistance : public GEOSItemDistance {
+    private:
+        /** \brief Query point envelope, used to tell query item from tree items. */
+        const GEOSEnvelope * query;
+
+        /** \brief Distance function. */
+        const Function & fun;
+
+    public:
+        /** \brief Constructor.
+         *  \param query: query point envelope.
+         *  \param fun: function computing the distance from an item index.
+         */
+        IndexDistance(const GEOSEnvelope * query, const Function & fun): query(query), fun(fun) {}
+
+        /** \brief Compute distance between two tree items.
+         *  \param item1: first item.
+         *  \param item2: second item.
+         *  \returns distance.
+         */
+        double distance(const GEOSItemBoundable * item1, const GEOSItemBoundable * item2) override {
+            auto item = item1->getBounds() == this->query ? item2 : item1;
+            return this->fun(reinterpret_cast<size_t>(item->getItem()));
+        }
+    };
+
+    PathIndex::PathIndex(const std::vector<std::shared_ptr<Path>> & paths, const bool close) {
+        PYG_LOG_V("Creating path index 0x{:x} for {:d} paths", (uint64_t)this, paths.size());
+        auto n = paths.size();
+        this->pts.resize(n);
+        this->envelopes.resize(n);
+        this->segment_envelopes.resize(n);
+        this->segment_trees.resize(n);
+        parallel_for(n, [&](const size_t k) {
+            auto & path = paths[k];
+            auto & pts = this->pts[k];
+            pts.reserve(path->size() + 1);
+            auto it = path->begin();
+            for (size_t i=0; i<path->size(); i++) {
+                auto & pt = *it[i];
+                auto t = pt.c/180*M_PI;
+                pts.push_back({pt.x*cos(t) - pt.y*sin(t), pt.y*cos(t) + pt.x*sin(t)});
+                this->envelopes[k].expandToInclude(pts.back()[0], pts.back()[1]);
+            }
+            if (close && pts.size() > 1 && pts.front() != pts.back())
+                pts.push_back(pts.front());
+            auto n_seg = this->get_segment_count(k);
+            if (n_seg < segment_tree_threshold) return;
+            // envelopes must not be moved after insertion
+            auto & envs = this->segment_envelopes[k];
+            envs.resize(n_seg);
+            auto tree = std::make_unique<GEOSSTRtree>();
+            for (size_t i=0; i<n_seg; i++) {
+                envs[i].init(pts[i][0], pts[i+1][0], pts[i][1], pts[i+1][1]);
+                tree->insert(&envs[i], reinterpret_cast<void*>(i));
+            }
+            build_tree(*tree);
+            this->segment_trees[k] = std::move(tree);
+        });
+        this->tree = std::make_unique<GEOSSTRtree>();
+        for (size_t k=0; k<n; k++) {
+            if (this->envelopes[k].isNull()) continue;
+            this->tree->insert(&this->envelopes[k], reinterpret_cast<void*>(k));
+            this->extent.expandToInclude(&this->envelopes[k]);
+        }
+        build_tree(*this->tree);
+    }
+
+    PathIndex::~PathIndex() {
+        PYG_LOG_V("Deleting path index 0x{:x}", (uint64_t)this);
+    }
+
+    size_t PathIndex::size() const {
+        return this->pts.size();
+    }
+
+    size_t PathIndex::get_segment_count(const size_t path) const {
+        auto n = this->pts[path].size();
+        return n == 1 ? 1 : (n == 0 ? 0 : n - 1);
+    }
+
+    std::vector<size_t> PathIndex::get_segments(const size_t path, const GEOSEnvelope & env) const {
+        std::vector<size_t> segments;
+        if (this->segment_trees[path]) {
+            std::vector<void*> candidates;
+            this->segment_trees[path]->query(&env, candidates);
+            segments.reserve(candidates.size());
+            for (auto item: candidates)
+                segments.push_back(reinterpret_cast<size_t>(item));
+        } else {
+            auto & pts = this->pts[path];
+            auto n_seg = this->get_segment_count(path);
+            for (size_t i=0; i<n_seg; i++) {
+                auto & a = pts[i];
+                auto & b = pts[std::min(i+1, pts.size()-1)];
+                if (env.intersects(GEOSEnvelope(a[0], b[0], a[1], b[1])))
+                    segments.push_back(i);
+            }
+        }
+        return segments;
+    }
+
+    std::vector<size_t> PathIndex::query(const double xmin, const double ymin, const double xmax, const double ymax) const {
+        PYG_LOG_V("Querying path index 0x{:x}", (uint64_t)this);
+        GEOSEnvelope env(xmin, xmax, ymin, ymax);
+        std::vector<void*> candidates;
+        this->tree->query(&env, candidates);
+        std::vector<size_t> found;
+        for (auto item: candidates) {
+            auto k = reinterpret_cast<size_t>(item);
+            auto & pts = this->pts[k];
+            for (auto i: this->get_segments(k, env)) {
+                if (segment_intersects(pts[i], pts[std::min(i+1, pts.size()-1)], env)) {
+                    found.push_back(k);
+                    break;
+                }
+            }
+        }
+        std::sort(found.begin(), found.end());
+        return found;
+    }
+
+    std::tuple<size_t, double, double> PathIndex::nearest_on_path(const size_t path, const double x, const double y) const {
+        auto & pts = this->pts[path];
+        auto distance = [&](const size_t i) {
+            return segment_distance(pts[i], pts[std::min(i+1, pts.size()-1)], x, y);
+        };
+        size_t best = 0;
+        if (this->segment_trees[path]) {
+            GEOSEnvelope env(x, x, y, y);
+            auto fun = [&](const size_t i) { return distance(i).second; };
+            IndexDistance<decltype(fun)> item_distance(&env, fun);
+            best = reinterpret_cast<size_t>(this->segment_trees[path]->nearestNeighbour(&env, &env, &item_distance));
+        } else {
+            auto dmin = std::numeric_limits<double>::infinity();
+            auto n_seg = this->get_segment_count(path);
+            for (size_t i=0; i<n_seg; i++) {
+                auto d = distance(i).second;
+                if (d < dmin) {
+                    dmin = d;
+                    best = i;
+                }
+            }
+        }
+        auto [t, d] = distance(best);
+        return {best, t, d};
+    }
+
+    std::tuple<size_t, size_t, double, double> PathIndex::nearest(const double x, const double y) const {
+        PYG_LOG_V("Looking for nearest path in path index 0x{:x}", (uint64_t)this);
+        if (this->extent.isNull())
+            throw std::out_of_range("Index has no point.");
+        GEOSEnvelope env(x, x, y, y);
+        auto fun = [&](const size_t k) { return std::get<2>(this->nearest_on_path(k, x, y)); };
+        IndexDistance<decltype(fun)> item_distance(&env, fun);
+        auto path = reinterpret_cast<size_t>(this->tree->nearestNeighbour(&env, &env, &item_distance));
+        auto [segment, t, d] = this->nearest_on_path(path, x, y);
+        return {path, segment, t, d};
+    }
+
+    std::vector<size_t> PathIndex::enclosing(const double x, const double y) const {
+        PYG_LOG_V("Looking for rings enclosing a point in path index 0x{:x}", (uint64_t)this);
+        std::vector<size_t> found;
+        if (this->extent.isNull() || x > this->extent.getMaxX())
+            return found;
+        // segments crossed by a ray going from point towards +x
+        GEOSEnvelope ray(x, this->extent.getMaxX(), y, y);
+        std::vector<void*> candidates;
+        this->tree->query(&ray, candidates);
+        for (auto item: candidates) {
+            auto k = reinterpret_cast<size_t>(item);
+            auto & pts = this->pts[k];
+            if (pts.size() < 3) continue;
+            bool inside = false;
+            for (auto i: this->get_segments(k, ray)) {
+                auto & a = pts[i];
+                auto & b = pts[i+1];
+                if ((a[1] > y) != (b[1] > y) && x < (b[0] - a[0])*(y - a[1])/(b[1] - a[1]) + a[0])
+                    inside = !inside;
+            }
+            if (inside)
+                found.push_back(k);
+        }
+        std::sort(found.begin(), found.end());
+        return found;
+    }
+
+}
@@ -0,0 +1,112 @@
+/** \file pathindex.h
+ *  \brief Header file for PathIndex class.
+ *
+ *  Author: Vincent Paeder
+ *  License: MIT
+ */
+#pragma once
+#include <array>
+#include <memory>
+#include <tuple>
+#include <vector>
+#include <geos/geom/Envelope.h>
+#include <geos/index/strtree/STRtree.h>
+
+namespace pygraver::types {
+
+    class Path;
+
+    /** \brief Spatial index over a set of paths.
+     *
+     *  Paths are indexed by their cartesian envelope in a bounding volume tree
+     *  (GEOS STRtree); long paths also get a tree over their own segments, so
+     *  that region and nearest point queries take logarithmic time instead of
+     *  walking every point. Segments are taken as straight lines between
+     *  cartesian points. The index is immutable: it reflects paths as they
+     *  were when it was built.
+     */
+    class PathIndex {
+    private:
+        /** \brief Cartesian vertices of each path (closing vertex included for rings). */
+        std::vector<std::vector<std::array<double, 2>>> pts;
+
+        /** \brief Envelope of each path. */
+        std::vector<geos::geom::Envelope> envelopes;
+
+        /** \brief Envelope of each segment of long paths (empty for short paths). */
+        std::vector<std::vector<geos::geom::Envelope>> segment_envelopes;
+
+        /** \brief Tree over path envelopes. */
+        std::unique_ptr<geos::index::strtree::STRtree> tree;
+
+        /** \brief Tree over segments of each long path (nullptr for short paths). */
+        std::vector<std::unique_ptr<geos::index::strtree::STRtree>> segment_trees;
+
+        /** \brief Envelope of all paths. */
+        geos::geom::Envelope extent;
+
+        /** \brief Get number of segments of a path.
+         *  \param path: path index.
+         *  \returns number of segments (a single point counts as a degenerate segment).
+         */
+        size_t get_segment_count(const size_t path) const;
+
+        /** \brief Get indices of path segments whose envelope intersects given envelope.
+         *  \param path: path index.
+         *  \param env: envelope to test.
+         *  \returns segment indices.
+         */
+        std::vector<size_t> get_segments(const size_t path, const geos::geom::Envelope & env) const;
+
+        /** \brief Find closest point of a path.
+         *  \param path: path index.
+         *  \param x: x coordinate of reference point.
+         *  \param y: y coordinate of reference point.
+         *  \returns segment index, position along segment (0 to 1) and distance.
+         */
+        std::tuple<size_t, double, double> nearest_on_path(const size_t path, const double x, const double y) const;
+
+    public:
+        /** \brief Constructor.
+         *
+         *  Paths are converted and segment trees are built in parallel.
+         *
+         *  \param paths: paths to index.
+         *  \param close: if true, paths are treated as closed rings.
+         */
+        PathIndex(const std::vector<std::shared_ptr<Path>> & paths, const bool close=false);
+
+        /** \brief Destructor. */
+        ~PathIndex();
+
+        /** \brief Get number of indexed paths.
+         *  \returns number of paths.
+         */
+        size_t size() const;
+
+        /** \brief Find paths crossing a rectangular region.
+         *  \param xmin: lower x bound.
+         *  \param ymin: lower y bound.
+         *  \param xmax: upper x bound.
+         *  \param ymax: upper y bound.
+         *  \returns indices of paths with at least one segment inside or across the region, in increasing order.
+         */
+        std::vector<size_t> query(const double xmin, const double ymin, const double xmax, const double ymax) const;
+
+        /** \brief Find closest path to a point.
+         *  \param x: x coordinate of reference point.
+         *  \param y: y coordinate of reference point.
+         *  \returns path index, segment index, position along segment (0 to 1) and distance;
+         *           throws std::out_of_range if there is no point to find.
+         */
+        std::tuple<size_t, size_t, double, double> nearest(const double x, const double y) const;
+
+        /** \brief Find rings enclosing a point (crossing number test).
+         *  \param x: x coordinate of point.
+         *  \param y: y coordinate of point.
+         *  \returns indices of enclosing rings, in increasing order.
+         */
+        std::vector<size_t> enclosing(const double x, const double y) const;
+    };
+
+}
@@ -0,0 +1,591 @@
+/** \file pipeline.cpp
+ *  \brief Implementation file for Pipeline class.
+ *
+ *  Author: Vincent Paeder
+ *  License: MIT
+ */
+#include <algorithm>
+#include <chrono>
+#include <stdexcept>
+#include <pybind11/stl.h>
+
+#include "pipeline.h"
+#include "point.h"
+#include "path.h"
+#include "surface.h"
+#include "heightmap.h"
+#include "displacement.h"
+#include "../log.h"
+
+namespace pygraver::types {
+
+    /** \brief Clock used for stage telemetry. */
+    using PipelineClock = std::chrono::steady_clock;
+
+    /** \brief Pipeline stage (source or processing stage) and its input queue. */
+    struct PipelineNode {
+        /** \brief Stage name. */
+        std::string name;
+
+        /** \brief Indices of input stages. */
+        std::vector<size_t> inputs;
+
+        /** \brief Indices of stages taking chunks from this one. */
+        std::vector<size_t> consumers;
+
+        /** \brief Processing function (processing stages only). */
+        StageFunction fun;
+
+        /** \brief Source function (function sources only). */
+        SourceFunction source;
+
+        /** \brief Source paths (path group sources only). */
+        std::shared_ptr<const PathGroup> source_group;
+
+        /** \brief True for sources. */
+        bool is_source = false;
+
+        /** \brief Number of worker threads. */
+        size_t workers = 1;
+
+        /** \brief True if whole input is gathered before processing. */
+        bool barrier = false;
+
+        /** \brief Chunks waiting to be processed. */
+        std::deque<std::shared_ptr<const PathGroup>> queue;
+
+        /** \brief Estimated memory held by waiting chunks, in bytes. */
+        size_t queued_bytes = 0;
+
+        /** \brief Number of input stages still running. */
+        size_t open_inputs = 0;
+
+        /** \brief Number of workers still running. */
+        size_t running = 0;
+
+        /** \brief Lock for queue, counters and telemetry. */
+        std::mutex mutex;
+
+        /** \brief Signalled when queue or counters change. */
+        std::condition_variable changed;
+
+        /** \brief Telemetry. */
+        StageStats stats;
+
+        /** \brief Time when first chunk was taken (or source started). */
+        std::optional<PipelineClock::time_point> first;
+
+        /** \brief Time when last chunk was produced. */
+        std::optional<PipelineClock::time_point> last;
+    };
+
+    /** \brief Count paths and points of a path group.
+     *  \param pg: path group.
+     *  \returns number of paths and number of points.
+     */
+    static std::pair<size_t, size_t> count_items(const PathGroup & pg) {
+        size_t n_points = 0;
+        for (auto & path: pg.get_paths())
+            n_points += path->size();
+        return {pg.size(), n_points};
+    }
+
+    /** \brief Estimate memory held by a path group.
+     *  \param pg: path group.
+     *  \returns estimated size in bytes.
+     */
+    static size_t estimate_bytes(const PathGroup & pg) {
+        auto [n_paths, n_points] = count_items(pg);
+        return n_points*(sizeof(Point) + sizeof(std::shared_ptr<Point>)) + n_paths*(sizeof(Path) + sizeof(std::shared_ptr<Path>));
+    }
+
+    /** \brief Get time elapsed between two time points.
+     *  \param t0: start time.
+     *  \param t1: end time.
+     *  \returns elapsed time in seconds.
+     */
+    static double seconds(const PipelineClock::time_point & t0, const PipelineClock::time_point & t1) {
+        return std::chrono::duration<double>(t1 - t0).count();
+    }
+
+    Pipeline::Pipeline(const size_t chunk_size, const size_t capacity) {
+        PYG_LOG_V("Creating pipeline 0x{:x}", (uint64_t)this);
+        if (chunk_size == 0)
+            throw std::invalid_argument("Chunk size must be positive.");
+        if (capacity == 0)
+            throw std::invalid_argument("Queue capacity must be positive.");
+        this->chunk_size = chunk_size;
+        this->capacity = capacity;
+    }
+
+    Pipeline::~Pipeline() {
+        PYG_LOG_V("Deleting pipeline 0x{:x}", (uint64_t)this);
+        this->abort(nullptr);
+        // Python stage functions need the GIL to return
+        if (Py_IsInitialized() && PyGILState_Check()) {
+            py::gil_scoped_release release;
+            this->join();
+        } else {
+            this->join();
+        }
+    }
+
+    size_t Pipeline::find_stage(const std::string & name) const {
+        for (size_t i=0; i<this->stages.size(); i++)
+            if (this->stages[i]->name == name)
+                return i;
+        throw std::invalid_argument("Unknown stage '" + name + "'.");
+    }
+
+    void Pipeline::insert_stage(std::unique_ptr<PipelineNode> stage, const std::vector<std::string> & inputs) {
+        if (this->started)
+            throw std::runtime_error("Stages can't be added to a started pipeline.");
+        if (stage->name.empty())
+            throw std::invalid_argument("Stage name must not be empty.");
+        for (auto & other: this->stages)
+            if (other->name == stage->name)
+                throw std::invalid_argument("Stage '" + stage->name + "' already exists.");
+        for (auto & input: inputs) {
+            auto idx = this->find_stage(input);
+            if (std::find(stage->inputs.begin(), stage->inputs.end(), idx) != stage->inputs.end())
+                throw std::invalid_argument("Stage '" + input + "' is given twice as input.");
+            stage->inputs.push_back(idx);
+        }
+        auto idx = this->stages.size();
+        for (auto input: stage->inputs)
+            this->stages[input]->consumers.push_back(idx);
+        stage->stats.name = stage->name;
+        this->stages.push_back(std::move(stage));
+    }
+
+    void Pipeline::add_source(const std::string & name, std::shared_ptr<const PathGroup> pg) {
+        PYG_LOG_V("Adding source '{}' to pipeline 0x{:x}", name, (uint64_t)this);
+        if (!pg)
+            throw std::invalid_argument("Source paths must be given.");
+        auto stage = std::make_unique<PipelineNode>();
+        stage->name = name;
+        stage->is_source = true;
+        stage->source_group = pg;
+        this->insert_stage(std::move(stage), {});
+    }
+
+    void Pipeline::add_source(const std::string & name, const SourceFunction & fun) {
+        PYG_LOG_V("Adding source '{}' to pipeline 0x{:x}", name, (uint64_t)this);
+        if (!fun)
+            throw std::invalid_argument("Source function must be given.");
+        auto stage = std::make_unique<PipelineNode>();
+        stage->name = name;
+        stage->is_source = true;
+        stage->source = fun;
+        this->insert_stage(std::move(stage), {});
+    }
+
+    void Pipeline::add_stage(const std::string & name, const StageFunction & fun, const std::vector<std::string> & inputs,
+                             const size_t workers, const bool barrier) {
+        PYG_LOG_V("Adding stage '{}' to pipeline 0x{:x}", name, (uint64_t)this);
+        if (!fun)
+            throw std::invalid_argument("Stage function must be given.");
+        if (inputs.empty())
+            throw std::invalid_argument("Stage needs at least one input.");
+        if (workers == 0)
+            throw std::invalid_argument("Number of workers must be positive.");
+        auto stage = std::make_unique<PipelineNode>();
+        stage->name = name;
+        stage->fun = fun;
+        stage->workers = barrier ? 1 : workers;
+        stage->barrier = barrier;
+        this->insert_stage(std::move(stage), inputs);
+    }
+
+    std::vector<std::string> Pipeline::get_stage_names() const {
+        std::vector<std::string> names;
+        for (auto & stage: this->stages)
+            names.push_back(stage->name);
+        return names;
+    }
+
+    bool Pipeline::emit(const size_t idx, std::shared_ptr<PathGroup> chunk) {
+        auto & node = *this->stages[idx];
+        auto [n_paths, n_points] = count_items(*chunk);
+        {
+            std::lock_guard<std::mutex> lock(node.mutex);
+            node.stats.chunks_out++;
+            node.stats.paths_out += n_paths;
+            node.stats.points_out += n_points;
+            node.last = PipelineClock::now();
+        }
+        if (node.consumers.empty()) {
+            std::unique_lock<std::mutex> lock(this->mutex);
+            this->output_changed.wait(lock, [&]() { return this->outputs.size() < this->capacity || this->aborted; });
+            if (this->aborted) return false;
+            this->outputs.emplace_back(idx, chunk);
+            this->output_changed.notify_all();
+            return true;
+        }
+        auto bytes = estimate_bytes(*chunk);
+        // consumers share the chunk
+        for (auto c: node.consumers) {
+            auto & consumer = *this->stages[c];
+            std::unique_lock<std::mutex> lock(consumer.mutex);
+            consumer.changed.wait(lock, [&]() { return consumer.queue.size() < this->capacity || this->aborted; });
+            if (this->aborted) return false;
+            consumer.queue.push_back(chunk);
+            consumer.queued_bytes += bytes;
+            consumer.stats.peak_queue_chunks = std::max(consumer.stats.peak_queue_chunks, consumer.queue.size());
+            consumer.stats.peak_queue_bytes = std::max(consumer.stats.peak_queue_bytes, consumer.queued_bytes);
+            consumer.changed.notify_all();
+        }
+        return true;
+    }
+
+    bool Pipeline::emit_chunks(const size_t idx, std::shared_ptr<const PathGroup> pg) {
+        auto & paths = pg->get_paths();
+        for (size_t i=0; i<paths.size(); i+=this->chunk_size) {
+            auto end = std::min(i + this->chunk_size, paths.size());
+            auto chunk = std::make_shared<PathGroup>(std::vector<std::shared_ptr<Path>>(paths.begin() + i, paths.begin() + end));
+            if (!this->emit(idx, chunk))
+                return false;
+        }
+        return true;
+    }
+
+    void Pipeline::close(const size_t idx) {
+        auto & node = *this->stages[idx];
+        if (node.consumers.empty()) {
+            std::lock_guard<std::mutex> lock(this->mutex);
+            this->open_outputs--;
+            this->output_changed.notify_all();
+            return;
+        }
+        for (auto c: node.consumers) {
+            auto & consumer = *this->stages[c];
+            std::lock_guard<std::mutex> lock(consumer.mutex);
+            consumer.open_inputs--;
+            consumer.changed.notify_all();
+        }
+    }
+
+    std::shared_ptr<const PathGroup> Pipeline::take(const size_t idx) {
+        auto & node = *this->stages[idx];
+        std::unique_lock<std::mutex> lock(node.mutex);
+        node.changed.wait(lock, [&]() { return !node.queue.empty() || node.open_inputs == 0 || this->aborted; });
+        if (this->aborted || node.queue.empty())
+            return nullptr;
+        auto chunk = node.queue.front();
+        node.queue.pop_front();
+        node.queued_bytes -= estimate_bytes(*chunk);
+        auto [n_paths, n_points] = count_items(*chunk);
+        node.stats.chunks_in++;
+        node.stats.paths_in += n_paths;
+        node.stats.points_in += n_points;
+        if (!node.first)
+            node.first = PipelineClock::now();
+        // there's room for producers again
+        node.changed.notify_all();
+        return chunk;
+    }
+
+    void Pipeline::run_stage(const size_t idx) {
+        auto & node = *this->stages[idx];
+        auto process = [&](std::shared_ptr<const PathGroup> pg) {
+            auto t0 = PipelineClock::now();
+            auto result = node.fun(pg);
+            auto t1 = PipelineClock::now();
+            std::lock_guard<std::mutex> lock(node.mutex);
+            node.stats.busy_time += seconds(t0, t1);
+            return result;
+        };
+        try {
+            if (node.is_source) {
+                auto t0 = PipelineClock::now();
+                {
+                    std::lock_guard<std::mutex> lock(node.mutex);
+                    node.first = t0;
+                }
+                auto pg = node.source_group;
+                if (!pg) {
+                    pg = node.source();
+                    std::lock_guard<std::mutex> lock(node.mutex);
+                    node.stats.busy_time += seconds(t0, PipelineClock::now());
+                }
+                if (pg)
+                    this->emit_chunks(idx, pg);
+            } else if (node.barrier) {
+                std::vector<std::shared_ptr<Path>> paths;
+                auto any = false;
+                while (auto chunk = this->take(idx)) {
+                    auto & chunk_paths = chunk->get_paths();
+                    paths.insert(paths.end(), chunk_paths.begin(), chunk_paths.end());
+                    any = true;
+                }
+                if (any && !this->aborted) {
+                    auto result = process(std::make_shared<PathGroup>(paths));
+                    if (result)
+                        this->emit_chunks(idx, result);
+                }
+            } else {
+                while (auto chunk = this->take(idx)) {
+                    auto result = process(chunk);
+                    if (result && result->size() > 0 && !this->emit(idx, result))
+                        break;
+                }
+            }
+        } catch (...) {
+            this->abort(std::current_exception());
+        }
+        bool last_worker;
+        {
+            std::lock_guard<std::mutex> lock(node.mutex);
+            last_worker = --node.running == 0;
+        }
+        if (last_worker)
+            this->close(idx);
+    }
+
+    void Pipeline::abort(std::exception_ptr err) {
+        {
+            std::lock_guard<std::mutex> lock(this->mutex);
+            if (err && !this->error)
+                this->error = err;
+            this->aborted = true;
+            this->output_changed.notify_all();
+        }
+        for (auto & stage: this->stages) {
+            std::lock_guard<std::mutex> lock(stage->mutex);
+            stage->changed.notify_all();
+        }
+    }
+
+    void Pipeline::join() {
+        for (auto & thread: this->threads)
+            if (thread.joinable())
+                thread.join();
+        this->threads.clear();
+    }
+
+    void Pipeline::start() {
+        PYG_LOG_V("Starting pipeline 0x{:x}", (uint64_t)this);
+        if (this->started)
+            throw std::runtime_error("Pipeline was already started.");
+        if (this->stages.empty())
+            throw std::invalid_argument("Pipeline has no stage.");
+        // GEOS geometry factories are created along with first objects; do it now rather than concurrently from workers
+        Path init_path(0);
+        PathGroup init_pathgroup;
+        Surface init_surface;
+
+        this->open_outputs = 0;
+        for (auto & stage: this->stages) {
+            stage->open_inputs = stage->inputs.size();
+            stage->running = stage->is_source ? 1 : stage->workers;
+            if (stage->consumers.empty())
+                this->open_outputs++;
+        }
+        this->started = true;
+        for (size_t i=0; i<this->stages.size(); i++) {
+            auto n_workers = this->stages[i]->is_source ? 1 : this->stages[i]->workers;
+            for (size_t j=0; j<n_workers; j++)
+                this->threads.emplace_back(&Pipeline::run_stage, this, i);
+        }
+    }
+
+    std::optional<std::pair<std::string, std::shared_ptr<PathGroup>>> Pipeline::next_output() {
+        if (!this->started)
+            this->start();
+        std::unique_lock<std::mutex> lock(this->mutex);
+        this->output_changed.wait(lock, [&]() { return !this->outputs.empty() || this->open_outputs == 0 || this->aborted; });
+        if (this->error) {
+            auto err = this->error;
+            lock.unlock();
+            this->join();
+            std::rethrow_exception(err);
+        }
+        if (!this->outputs.empty() && !this->aborted) {
+            auto [idx, chunk] = this->outputs.front();
+            this->outputs.pop_front();
+            this->output_changed.notify_all();
+            return std::make_pair(this->stages[idx]->name, chunk);
+        }
+        lock.unlock();
+        this->join();
+        return std::nullopt;
+    }
+
+    std::vector<std::pair<std::string, std::shared_ptr<PathGroup>>> Pipeline::run() {
+        PYG_LOG_V("Running pipeline 0x{:x}", (uint64_t)this);
+        std::vector<std::pair<std::string, std::shared_ptr<PathGroup>>> results;
+        std::vector<size_t> slots(this->stages.size());
+        for (size_t i=0; i<this->stages.size(); i++) {
+            if (!this->stages[i]->consumers.empty()) continue;
+            slots[i] = results.size();
+            results.emplace_back(this->stages[i]->name, std::make_shared<PathGroup>());
+        }
+        while (auto output = this->next_output()) {
+            auto & pg = results[slots[this->find_stage(output->first)]].second;
+            for (auto & path: output->second->get_paths())
+                pg->push_back(path);
+        }
+        return results;
+    }
+
+    std::vector<StageStats> Pipeline::get_stats() const {
+        std::vector<StageStats> stats;
+        for (auto & stage: this->stages) {
+            std::lock_guard<std::mutex> lock(stage->mutex);
+            stats.push_back(stage->stats);
+            if (stage->first && stage->last)
+                stats.back().wall_time = std::max(0.0, seconds(*stage->first, *stage->last));
+        }
+        return stats;
+    }
+
+    StageFunction Pipeline::correct_height(std::shared_ptr<const Surface> surface, const double clearance, const double safe_height,
+                                           const bool outside, const bool fix_contours) {
+        return [=](std::shared_ptr<const PathGroup> pg) {
+            return surface->correct_height(pg, clearance, safe_height, outside, fix_contours);
+        };
+    }
+
+    StageFunction Pipeline::apply_height_map(std::shared_ptr<const HeightMap> hmap, const double max_segment) {
+        return [=](std::shared_ptr<const PathGroup> pg) {
+            return hmap->apply(pg, max_segment);
+        };
+    }
+
+    StageFunction Pipeline::displace(std::shared_ptr<const Displacement> displacement, const double tolerance) {
+        return [=](std::shared_ptr<const PathGroup> pg) {
+            return displacement->apply(pg, tolerance);
+        };
+    }
+
+    StageFunction Pipeline::create_ramps(const double limit_height, const double ramp_height, const double ramp_length,
+                                         const RampDirection direction) {
+        return [=](std::shared_ptr<const PathGroup> pg) {
+            return pg->create_ramps(limit_height, ramp_height, ramp_length, direction);
+        };
+    }
+
+    StageFunction Pipeline::sort_paths(std::shared_ptr<const Point> ref_point, const SortPredicate predicate) {
+        return [=](std::shared_ptr<const PathGroup> pg) {
+            return pg->sort_paths(ref_point->copy(), predicate);
+        };
+    }
+
+    StageFunction Pipeline::simplify(const double tolerance) {
+        return [=](std::shared_ptr<const PathGroup> pg) {
+            return pg->simplify(tolerance);
+        };
+    }
+
+    StageFunction Pipeline::interpolate(const double dl) {
+        return [=](std::shared_ptr<const PathGroup> pg) {
+            return pg->interpolate(dl);
+        };
+    }
+
+    StageFunction Pipeline::remove_overlaps(const double tolerance) {
+        return [=](std::shared_ptr<const PathGroup> pg) {
+            return pg->remove_overlaps(tolerance).first;
+        };
+    }
+
+    /** \brief Stage function implemented in C++; it runs without holding the GIL. */
+    struct NativeStageFunction {
+        /** \brief Wrapped function. */
+        StageFunction fun;
+    };
+
+    /** \brief Keep a Python object in a shared pointer that can be copied and released without holding the GIL.
+     *  \param obj: Python object.
+     *  \returns shared pointer to object.
+     */
+    static std::shared_ptr<py::object> share_py_object(py::object obj) {
+        return std::shared_ptr<py::object>(new py::object(std::move(obj)), [](py::object * p) {
+            py::gil_scoped_acquire gil;
+            delete p;
+        });
+    }
+
+    void py_pipeline_exports(py::module_ & mod) {
+        py::class_<StageStats>(mod, "StageStats")
+        .def_readonly("name", &StageStats::name)
+        .def_readonly("chunks_in", &StageStats::chunks_in)
+        .def_readonly("chunks_out", &StageStats::chunks_out)
+        .def_readonly("paths_in", &StageStats::paths_in)
+        .def_readonly("paths_out", &StageStats::paths_out)
+        .def_readonly("points_in", &StageStats::points_in)
+        .def_readonly("points_out", &StageStats::points_out)
+        .def_readonly("busy_time", &StageStats::busy_time)
+        .def_readonly("wall_time", &StageStats::wall_time)
+        .def_readonly("peak_queue_chunks", &StageStats::peak_queue_chunks)
+        .def_readonly("peak_queue_bytes", &StageStats::peak_queue_bytes)
+        ;
+
+        py::class_<NativeStageFunction>(mod, "StageFunction")
+        .def("__call__", [](const NativeStageFunction & f, std::shared_ptr<const PathGroup> pg){return f.fun(pg);}, py::arg("pathgroup")
+                       , py::call_guard<py::gil_scoped_release>())
+        .def_static("correct_height", [](std::shared_ptr<const Surface> surface, const double clearance, const double safe_height, const bool outside, const bool fix_contours){
+                return NativeStageFunction{Pipeline::correct_height(surface, clearance, safe_height, outside, fix_contours)};
+            }, py::arg("surface"), py::arg("clearance"), py::arg("safe_height"), py::arg("outside")=true, py::arg("fix_contours")=false)
+        .def_static("apply_height_map", [](std::shared_ptr<const HeightMap> hmap, const double max_segment){
+                return NativeStageFunction{Pipeline::apply_height_map(hmap, max_segment)};
+            }, py::arg("height_map"), py::arg("max_segment")=0)
+        .def_static("displace", [](std::shared_ptr<const Displacement> displacement, const double tolerance){
+                return NativeStageFunction{Pipeline::displace(displacement, tolerance)};
+            }, py::arg("displacement"), py::arg("tolerance")=0)
+        .def_static("create_ramps", [](const double limit_height, const double ramp_height, const double ramp_length, const RampDirection direction){
+                return NativeStageFunction{Pipeline::create_ramps(limit_height, ramp_height, ramp_length, direction)};
+            }, py::arg("limit_height"), py::arg("ramp_height"), py::arg("ramp_length"), py::arg("direction"))
+        .def_static("sort_paths", [](std::shared_ptr<const Point> ref_point, const SortPredicate predicate){
+                return NativeStageFunction{Pipeline::sort_paths(ref_point, predicate)};
+            }, py::arg("ref_point"), py::arg("predicate")=SortPredicate::EndToStart)
+        .def_static("simplify", [](const double tolerance){return NativeStageFunction{Pipeline::simplify(tolerance)};}, py::arg("tolerance"))
+        .def_static("interpolate", [](const double dl){return NativeStageFunction{Pipeline::interpolate(dl)};}, py::arg("dl"))
+        .def_static("remove_overlaps", [](const double tolerance){return NativeStageFunction{Pipeline::remove_overlaps(tolerance)};}, py::arg("tolerance")=1e-6)
+        ;
+
+        py::class_<Pipeline, std::shared_ptr<Pipeline>>(mod, "Pipeline")
+        .def(py::init<const size_t, const size_t>(), py::arg("chunk_size")=64, py::arg("capacity")=8)
+        .def("add_source", static_cast<void (Pipeline::*)(const std::string &, std::shared_ptr<const PathGroup>)>(&Pipeline::add_source), py::arg("name"), py::arg("pathgroup"))
+        .def("add_source", [](Pipeline & p, const std::string & name, py::function fun){
+                auto f = share_py_object(fun);
+                p.add_source(name, [f](){
+                    py::gil_scoped_acquire gil;
+                    return (*f)().cast<std::shared_ptr<PathGroup>>();
+                });
+            }, py::arg("name"), py::arg("function"))
+        .def("add_stage", [](Pipeline & p, const std::string & name, const NativeStageFunction & fun, const std::vector<std::string> & inputs, const size_t workers, const bool barrier){
+                p.add_stage(name, fun.fun, inputs, workers, barrier);
+            }, py::arg("name"), py::arg("function"), py::arg("inputs"), py::arg("workers")=1, py::arg("barrier")=false)
+        .def("add_stage", [](Pipeline & p, const std::string & name, py::function fun, const std::vector<std::string> & inputs, const size_t workers, const bool barrier){
+                auto f = share_py_object(fun);
+                p.add_stage(name, [f](std::shared_ptr<const PathGroup> pg){
+                    py::gil_scoped_acquire gil;
+                    return (*f)(std::const_pointer_cast<PathGroup>(pg)).cast<std::shared_ptr<PathGroup>>();
+                }, inputs, workers, barrier);
+            }, py::arg("name"), py::arg("function"), py::arg("inputs"), py::arg("workers")=1, py::arg("barrier")=false)
+        .def_property_readonly("stage_names", &Pipeline::get_stage_names)
+        .def_property_readonly("stats", &Pipeline::get_stats)
+        .def("start", &Pipeline::start)
+        .def("run", [](Pipeline & p){
+                std::vector<std::pair<std::string, std::shared_ptr<PathGroup>>> results;
+                {
+                    py::gil_scoped_release release;
+                    results = p.run();
+                }
+                py::dict outputs;
+                for (auto & [name, pg]: results)
+                    outputs[py::str(name)] = py::cast(pg);
+                return outputs;
+            })
+        .def("__iter__", [](py::object self){return self;})
+        .def("__next__", [](Pipeline & p){
+                auto output = p.next_output();
+                if (!output)
+                    throw py::stop_iteration();
+                return *output;
+            }, py::call_guard<py::gil_scoped_release>())
+        ;
+    }
+
+}
@@ -0,0 +1,288 @@
+/** \file pipeline.h
+ *  \brief Header file for Pipeline class and associated types.
+ *
+ *  Author: Vincent Paeder
+ *  License: MIT
+ */
+#pragma once
+#include <pybind11/pybind11.h>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "pathgroup.h"
+
+namespace py = pybind11;
+
+namespace pygraver::types {
+
+    class Point;
+    class Surface;
+    class HeightMap;
+    class Displacement;
+    struct PipelineNode;
+
+    /** \brief Function applied by a pipeline stage to a chunk of paths.
+     *
+     *  Input chunks may be shared by several stages and must not be modified.
+     */
+    using StageFunction = std::function<std::shared_ptr<PathGroup>(std::shared_ptr<const PathGroup>)>;
+
+    /** \brief Function producing the paths of a pipeline source. */
+    using SourceFunction = std::function<std::shared_ptr<PathGroup>()>;
+
+    /** \brief Telemetry of a pipeline stage. */
+    struct StageStats {
+        /** \brief Stage name. */
+        std::string name;
+        /** \brief Number of chunks received. */
+        size_t chunks_in = 0;
+        /** \brief Number of chunks produced. */
+        size_t chunks_out = 0;
+        /** \brief Number of paths received. */
+        size_t paths_in = 0;
+        /** \brief Number of paths produced. */
+        size_t paths_out = 0;
+        /** \brief Number of points received. */
+        size_t points_in = 0;
+        /** \brief Number of points produced. */
+        size_t points_out = 0;
+        /** \brief Time spent in stage function, summed over workers, in seconds. */
+        double busy_time = 0;
+        /** \brief Time from first chunk taken to last chunk produced, in seconds. */
+        double wall_time = 0;
+        /** \brief Largest number of chunks waiting in stage queue. */
+        size_t peak_queue_chunks = 0;
+        /** \brief Largest estimated memory held by chunks waiting in stage queue, in bytes. */
+        size_t peak_queue_bytes = 0;
+    };
+
+    /** \brief Class running chains of path processing stages.
+     *
+     *  Stages form a directed acyclic graph: a stage takes chunks of paths
+     *  from one or more earlier stages (or sources), processes them with its
+     *  own worker threads and passes results on through bounded queues, so
+     *  that downstream stages (and G-code streaming, through output
+     *  iteration) start before upstream ones are done. Independent branches
+     *  run concurrently. A barrier stage gathers its whole input before
+     *  processing it, for operations that need every path at once (e.g.
+     *  sort_paths). Chunks reaching stages without consumers are pipeline
+     *  outputs.
+     */
+    class Pipeline {
+    private:
+        /** \brief Stages, in insertion order (inputs always come before consumers). */
+        std::vector<std::unique_ptr<PipelineNode>> stages;
+
+        /** \brief Maximum number of paths per chunk produced by sources and barrier stages. */
+        size_t chunk_size;
+
+        /** \brief Maximum number of chunks waiting in a stage queue (and in output queue). */
+        size_t capacity;
+
+        /** \brief Worker threads. */
+        std::vector<std::thread> threads;
+
+        /** \brief Lock for output queue and pipeline state. */
+        std::mutex mutex;
+
+        /** \brief Signalled when output queue or pipeline state changes. */
+        std::condition_variable output_changed;
+
+        /** \brief Output chunks, with index of producing stage. */
+        std::deque<std::pair<size_t, std::shared_ptr<PathGroup>>> outputs;
+
+        /** \brief Number of output stages still running. */
+        size_t open_outputs = 0;
+
+        /** \brief True once pipeline was started. */
+        bool started = false;
+
+        /** \brief True if pipeline must stop (error, or destruction while running). */
+        std::atomic<bool> aborted = false;
+
+        /** \brief First error raised by a stage. */
+        std::exception_ptr error;
+
+        /** \brief Find a stage by name.
+         *  \param name: stage name.
+         *  \returns stage index; throws std::invalid_argument if there is no such stage.
+         */
+        size_t find_stage(const std::string & name) const;
+
+        /** \brief Add a stage after checking its name and inputs.
+         *  \param stage: stage to add.
+         *  \param inputs: names of input stages.
+         */
+        void insert_stage(std::unique_ptr<PipelineNode> stage, const std::vector<std::string> & inputs);
+
+        /** \brief Pass a chunk to consumers of a stage (or to output queue).
+         *  \param idx: producing stage index.
+         *  \param chunk: chunk to pass.
+         *  \returns false if pipeline was aborted.
+         */
+        bool emit(const size_t idx, std::shared_ptr<PathGroup> chunk);
+
+        /** \brief Split a path group into chunks and pass them on.
+         *  \param idx: producing stage index.
+         *  \param pg: paths to pass.
+         *  \returns false if pipeline was aborted.
+         */
+        bool emit_chunks(const size_t idx, std::shared_ptr<const PathGroup> pg);
+
+        /** \brief Tell consumers of a stage that it won't produce any more chunks.
+         *  \param idx: stage index.
+         */
+        void close(const size_t idx);
+
+        /** \brief Take next chunk from a stage queue, waiting if necessary.
+         *  \param idx: stage index.
+         *  \returns chunk, or nullptr once stage inputs are exhausted or pipeline was aborted.
+         */
+        std::shared_ptr<const PathGroup> take(const size_t idx);
+
+        /** \brief Run a stage worker.
+         *  \param idx: stage index.
+         */
+        void run_stage(const size_t idx);
+
+        /** \brief Stop pipeline after an error.
+         *  \param err: error to report (nullptr when stopping without error).
+         */
+        void abort(std::exception_ptr err);
+
+        /** \brief Wait for worker threads to finish. */
+        void join();
+
+    public:
+        /** \brief Constructor.
+         *  \param chunk_size: maximum number of paths per chunk produced by sources and barrier stages (>0).
+         *  \param capacity: maximum number of chunks waiting in each queue (>0).
+         */
+        Pipeline(const size_t chunk_size=64, const size_t capacity=8);
+
+        /** \brief Destructor; running stages are stopped. */
+        ~Pipeline();
+
+        /** \brief Add a source producing given paths.
+         *  \param name: stage name (must be unique).
+         *  \param pg: paths to feed pipeline with.
+         */
+        void add_source(const std::string & name, std::shared_ptr<const PathGroup> pg);
+
+        /** \brief Add a source computing its paths when pipeline runs.
+         *  \param name: stage name (must be unique).
+         *  \param fun: function producing paths; it runs in its own thread.
+         */
+        void add_source(const std::string & name, const SourceFunction & fun);
+
+        /** \brief Add a processing stage.
+         *  \param name: stage name (must be unique).
+         *  \param fun: function applied to each chunk.
+         *  \param inputs: names of stages to take chunks from (must already exist).
+         *  \param workers: number of worker threads (>0; forced to 1 for barrier stages).
+         *  \param barrier: if true, the whole input is gathered and processed at once.
+         */
+        void add_stage(const std::string & name, const StageFunction & fun, const std::vector<std::string> & inputs,
+                       const size_t workers=1, const bool barrier=false);
+
+        /** \brief Get stage names.
+         *  \returns stage names, in insertion order.
+         */
+        std::vector<std::string> get_stage_names() const;
+
+        /** \brief Start worker threads. */
+        void start();
+
+        /** \brief Get next output chunk, waiting if necessary; starts pipeline if needed.
+         *
+         *  Errors raised by stages are rethrown here.
+         *
+         *  \returns name of producing stage and chunk, or nothing once every stage is done.
+         */
+        std::optional<std::pair<std::string, std::shared_ptr<PathGroup>>> next_output();
+
+        /** \brief Run pipeline to completion.
+         *  \returns output paths of each output stage, chunks being concatenated in arrival order.
+         */
+        std::vector<std::pair<std::string, std::shared_ptr<PathGroup>>> run();
+
+        /** \brief Get stage telemetry.
+         *  \returns statistics of each stage, in insertion order.
+         */
+        std::vector<StageStats> get_stats() const;
+
+        /** \brief Stage function correcting path heights with a surface (see Surface::correct_height).
+         *  \param surface: surface defining the stock.
+         *  \param clearance: clearance to surface.
+         *  \param safe_height: height of moves outside of surface.
+         *  \param outside: if true, paths are kept outside of surface.
+         *  \param fix_contours: if true, contour points are fixed.
+         *  \returns stage function.
+         */
+        static StageFunction correct_height(std::shared_ptr<const Surface> surface, const double clearance, const double safe_height,
+                                            const bool outside=true, const bool fix_contours=false);
+
+        /** \brief Stage function adding measured stock heights (see HeightMap::apply).
+         *  \param hmap: height map.
+         *  \param max_segment: maximum segment length (0 to keep segments).
+         *  \returns stage function.
+         */
+        static StageFunction apply_height_map(std::shared_ptr<const HeightMap> hmap, const double max_segment=0);
+
+        /** \brief Stage function modulating paths with an image (see Displacement::apply).
+         *  \param displacement: displacement object.
+         *  \param tolerance: subdivision tolerance (0 to keep segments).
+         *  \returns stage function.
+         */
+        static StageFunction displace(std::shared_ptr<const Displacement> displacement, const double tolerance=0);
+
+        /** \brief Stage function creating ramps (see PathGroup::create_ramps).
+         *  \param limit_height: limit height.
+         *  \param ramp_height: ramp height.
+         *  \param ramp_length: ramp length.
+         *  \param direction: ramp direction.
+         *  \returns stage function.
+         */
+        static StageFunction create_ramps(const double limit_height, const double ramp_height, const double ramp_length,
+                                          const RampDirection direction);
+
+        /** \brief Stage function sorting paths (see PathGroup::sort_paths); usually needs a barrier stage.
+         *  \param ref_point: reference point.
+         *  \param predicate: sorting predicate.
+         *  \returns stage function.
+         */
+        static StageFunction sort_paths(std::shared_ptr<const Point> ref_point, const SortPredicate predicate=SortPredicate::EndToStart);
+
+        /** \brief Stage function simplifying paths (see PathGroup::simplify).
+         *  \param tolerance: simplification tolerance.
+         *  \returns stage function.
+         */
+        static StageFunction simplify(const double tolerance);
+
+        /** \brief Stage function interpolating paths (see PathGroup::interpolate).
+         *  \param dl: step size.
+         *  \returns stage function.
+         */
+        static StageFunction interpolate(const double dl);
+
+        /** \brief Stage function removing overlapping segments (see PathGroup::remove_overlaps); usually needs a barrier stage.
+         *  \param tolerance: maximum distance between overlapping segments.
+         *  \returns stage function.
+         */
+        static StageFunction remove_overlaps(const double tolerance=1e-6);
+    };
+
+    /** \brief Export function for Python wrapper.
+     *  \param mod: module or submodule to add content to.
+     */
+    void py_pipeline_exports(py::module_ & mod);
+
+}
@@ -198,6 +198,17 @@ namespace pygraver::types {
             || !almost_equal(p.z, q.z, 6) || !almost_equal(p.c, q.c, 6);
     }
 
+    std::vector<std::shared_ptr<Point>> make_point_block(const size_t n) {
+        std::vector<std::shared_ptr<Point>> pts;
+        if (n == 0)
+            return pts;
+        auto block = std::make_shared<Point[]>(n);
+        pts.reserve(n);
+        for (size_t i=0; i<n; i++)
+            pts.emplace_back(block, &block[i]);
+        return pts;
+    }
+
     void py_point_exports(py::module_ & mod) {
         py::class_<Point, std::shared_ptr<Point>>(mod, "Point")
             .def(py::init<float, float, float, float>(), py::arg("x")=0, py::arg("y")=0, py::arg("z")=0, py::arg("c")=0)
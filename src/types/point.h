@@ -7,6 +7,8 @@
 #pragma once
 #include <geos/geom/Point.h>
 #include <pybind11/pybind11.h>
+#include <memory>
+#include <vector>
 
 namespace py = pybind11;
 
@@ -243,6 +245,17 @@ namespace pygraver::types {
      */
     bool operator!=(const Point & p, const Point & q);
 
+    /** \brief Allocate points in a single block.
+     *
+     *  Every returned pointer shares ownership of the block, which is freed
+     *  with the last of them: this costs one allocation instead of one per
+     *  point.
+     *
+     *  \param n: number of points.
+     *  \returns pointers to points, all at origin.
+     */
+    std::vector<std::shared_ptr<Point>> make_point_block(const size_t n);
+
     /** \brief Export function for Python wrapper.
      *  \param mod: module or submodule to add content to.
      */
@@ -4,6 +4,12 @@
  *  Author: Vincent Paeder
  *  License: MIT
  */
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <functional>
+#include <limits>
+#include <unordered_map>
 #include <geos/geom/Coordinate.h>
 #include "geos/geom/CoordinateArraySequence.h"
 #include "geos/geom/CoordinateSequence.h"
@@ -12,6 +18,12 @@
 #include <geos/geom/prep/PreparedGeometry.h>
 #include <geos/geom/prep/PreparedGeometryFactory.h>
 #include <geos/linearref/LengthIndexedLine.h>
+#include <geos/geom/Envelope.h>
+#include <geos/index/strtree/STRtree.h>
+#include <geos/operation/overlayng/OverlayNG.h>
+#include <geos/operation/overlayng/UnaryUnionNG.h>
+#include <geos/operation/polygonize/BuildArea.h>
+#include <geos/precision/GeometryPrecisionReducer.h>
 
 #include <pybind11/stl.h>
 
@@ -19,6 +31,7 @@
 #include "surface.h"
 #include "path.h"
 #include "pathgroup.h"
+#include "pathindex.h"
 #include "../log.h"
 
 /** \brief Shorthand for geos::geom::Coordinate class. */
@@ -39,6 +52,18 @@ using GEOSPreparedGeometry = const gg::prep::PreparedGeometry;
 using GEOSCoordinateArraySequence = geos::geom::CoordinateArraySequence;
 /** \brief Shorthand for geos::geom::CoordinateSequence class. */
 using GEOSCoordinateSequence = geos::geom::CoordinateSequence;
+/** \brief Shorthand for geos::geom::Envelope class. */
+using GEOSEnvelope = geos::geom::Envelope;
+/** \brief Shorthand for geos::index::strtree::STRtree class. */
+using GEOSSTRtree = geos::index::strtree::STRtree;
+/** \brief Shorthand for geos::operation::overlayng::OverlayNG class. */
+using GEOSOverlayNG = geos::operation::overlayng::OverlayNG;
+/** \brief Shorthand for geos::operation::overlayng::UnaryUnionNG class. */
+using GEOSUnaryUnionNG = geos::operation::overlayng::UnaryUnionNG;
+/** \brief Shorthand for geos::operation::polygonize::BuildArea class. */
+using GEOSBuildArea = geos::operation::polygonize::BuildArea;
+/** \brief Shorthand for geos::precision::GeometryPrecisionReducer class. */
+using GEOSPrecisionReducer = geos::precision::GeometryPrecisionReducer;
 
 namespace pygraver::types {
 
@@ -59,6 +84,560 @@ namespace pygraver::types {
         return geoms;
     }
 
+    /** \brief Create the precision model of a fixed-precision grid.
+     *  \param grid_size: grid size (>0).
+     *  \returns precision model.
+     */
+    static gg::PrecisionModel make_precision_model(const double grid_size) {
+        return gg::PrecisionModel(1.0/grid_size);
+    }
+
+    /** \brief Build polygons from rings, with snap-rounding.
+     *
+     *  Valid rings give a polygon as they are; self-intersecting rings are
+     *  noded on the grid and their faces are filled with the even-odd rule.
+     *
+     *  \param paths: paths to convert (closed if needed).
+     *  \param pm: fixed precision model.
+     *  \returns union of polygons, with vertices on the grid.
+     */
+    static std::unique_ptr<GEOSGeometry> make_snapped_area(const std::vector<std::shared_ptr<Path>> & paths, const gg::PrecisionModel & pm) {
+        std::vector<std::unique_ptr<GEOSGeometry>> polygons;
+        polygons.reserve(paths.size());
+        for (auto p: paths) {
+            auto ring = p->as_closed_geos_geometry();
+            if (ring->isEmpty()) continue;
+            if (ring->isValid()) {
+                polygons.emplace_back(gfactory->createPolygon(std::move(ring)));
+            } else {
+                auto noded = GEOSUnaryUnionNG::Union(ring.get(), pm);
+                polygons.emplace_back(GEOSBuildArea().build(noded.get()));
+            }
+        }
+        auto collection = gfactory->createGeometryCollection(std::move(polygons));
+        return GEOSUnaryUnionNG::Union(collection.get(), pm);
+    }
+
+    /** \brief Apply a boolean operation between two geometries.
+     *  \param g1: first geometry.
+     *  \param g2: second geometry.
+     *  \param operation_type: the type of boolean operation to apply.
+     *  \param grid_size: grid size for snap-rounding (0 for floating precision).
+     *  \returns resulting geometry.
+     */
+    static std::unique_ptr<GEOSGeometry> overlay(const GEOSGeometry * g1, const GEOSGeometry * g2, const BooleanOperation operation_type, const double grid_size) {
+        if (grid_size > 0) {
+            auto pm = make_precision_model(grid_size);
+            int op_code = GEOSOverlayNG::UNION;
+            if (operation_type == BooleanOperation::Difference) op_code = GEOSOverlayNG::DIFFERENCE;
+            else if (operation_type == BooleanOperation::SymmetricDifference) op_code = GEOSOverlayNG::SYMDIFFERENCE;
+            else if (operation_type == BooleanOperation::Intersection) op_code = GEOSOverlayNG::INTERSECTION;
+            return GEOSOverlayNG::overlay(g1, g2, op_code, &pm);
+        }
+        if (operation_type == BooleanOperation::Difference) return g1->difference(g2);
+        if (operation_type == BooleanOperation::SymmetricDifference) return g1->symDifference(g2);
+        if (operation_type == BooleanOperation::Intersection) return g1->intersection(g2);
+        return g1->Union(g2);
+    }
+
+    /** \brief Round path to a fixed-precision grid, keeping it valid.
+     *  \param path: closed path to round.
+     *  \param grid_size: grid size (>0).
+     *  \returns rounded path (empty if it collapses).
+     */
+    static std::shared_ptr<Path> snap_path(std::shared_ptr<const Path> path, const double grid_size) {
+        auto pm = make_precision_model(grid_size);
+        auto area = make_snapped_area({std::const_pointer_cast<Path>(path)}, pm);
+        if (area->isEmpty())
+            return std::make_shared<Path>(0);
+        return make_path(area->getBoundary().get());
+    }
+
+    /** \brief Ring data used to build a containment tree. */
+    struct Ring {
+        /** \brief Closed source path. */
+        std::shared_ptr<Path> path;
+        /** \brief Cartesian coordinates of ring vertices (without closing point). */
+        std::vector<std::array<double, 2>> pts;
+        /** \brief Ring envelope. */
+        GEOSEnvelope envelope;
+        /** \brief Signed area (positive if counter-clockwise). */
+        double area = 0;
+    };
+
+    /** \brief Convert a path to ring data.
+     *  \param path: path to convert.
+     *  \returns ring data; area is zero if path is degenerate.
+     */
+    static Ring make_ring(std::shared_ptr<Path> path) {
+        Ring ring;
+        ring.path = path->is_closed() ? path : path->close();
+        auto n = path->size() - path->is_closed();
+        ring.pts.reserve(n);
+        for (auto i=0; i<n; i++) {
+            auto pt = (*path)[i];
+            auto t = pt->c/180*M_PI;
+            double x = pt->x*cos(t) - pt->y*sin(t);
+            double y = pt->y*cos(t) + pt->x*sin(t);
+            ring.pts.push_back({x, y});
+            ring.envelope.expandToInclude(x, y);
+        }
+        // shoelace formula
+        for (auto i=0; i<n; i++) {
+            auto & p = ring.pts[i];
+            auto & q = ring.pts[(i+1)%n];
+            ring.area += (p[0]*q[1] - q[0]*p[1])/2;
+        }
+        return ring;
+    }
+
+    /** \brief Tell if a point is inside a ring (crossing number test).
+     *  \param pts: ring vertices.
+     *  \param p: point to test.
+     *  \returns true if point is inside ring.
+     */
+    static bool ring_contains(const std::vector<std::array<double, 2>> & pts, const std::array<double, 2> & p) {
+        bool inside = false;
+        auto n = pts.size();
+        for (size_t i=0, j=n-1; i<n; j=i++) {
+            auto & a = pts[i];
+            auto & b = pts[j];
+            if ((a[1] > p[1]) != (b[1] > p[1])
+                && p[0] < (b[0] - a[0])*(p[1] - a[1])/(b[1] - a[1]) + a[0])
+                inside = !inside;
+        }
+        return inside;
+    }
+
+    /** \brief 2D loop vertices, without closing point. */
+    using Loop = std::vector<std::array<double, 2>>;
+
+    /** \brief Offset loop in a spiral milling tree. */
+    struct OffsetLoop {
+        /** \brief Loop vertices (counter-clockwise). */
+        Loop pts;
+        /** \brief Indices of loops offset from this one (more than one where offsets split). */
+        std::vector<size_t> children;
+    };
+
+    /** \brief Offset a closed path inwards, keeping resulting islands apart.
+     *  \param path: closed path in cartesian coordinates.
+     *  \param amount: offset distance.
+     *  \param grid_size: grid size to snap loops to (0 for floating precision).
+     *  \returns one counter-clockwise loop per island.
+     */
+    static std::vector<Loop> offset_loops(const Path & path, const double amount, const double grid_size) {
+        auto boundary = path.as_closed_geos_geometry();
+        auto factory = boundary->getFactory();
+        auto polygon = std::unique_ptr<GEOSPolygon>(factory->createPolygon(std::move(boundary)));
+        auto offset = polygon->buffer(-amount, 16);
+        std::vector<Loop> loops;
+        for (size_t i=0; i<offset->getNumGeometries(); i++) {
+            auto poly = dynamic_cast<const GEOSPolygon*>(offset->getGeometryN(i));
+            if (!poly || poly->isEmpty())
+                continue;
+            auto loop_path = make_path(poly->getExteriorRing());
+            if (grid_size > 0)
+                loop_path = snap_path(loop_path, grid_size);
+            if (loop_path->size() < 4)
+                continue;
+            auto ring = make_ring(loop_path);
+            if (ring.area == 0)
+                continue;
+            if (ring.area < 0)
+                std::reverse(ring.pts.begin(), ring.pts.end());
+            loops.emplace_back(std::move(ring.pts));
+        }
+        return loops;
+    }
+
+    /** \brief Compute loop centroid.
+     *  \param loop: loop vertices.
+     *  \returns centroid coordinates.
+     */
+    static std::array<double, 2> loop_centroid(const Loop & loop) {
+        double area = 0, cx = 0, cy = 0;
+        auto n = loop.size();
+        for (size_t i=0; i<n; i++) {
+            auto & p = loop[i];
+            auto & q = loop[(i+1)%n];
+            auto w = p[0]*q[1] - q[0]*p[1];
+            area += w;
+            cx += (p[0] + q[0])*w;
+            cy += (p[1] + q[1])*w;
+        }
+        if (area == 0)
+            return loop[0];
+        return {cx/(3*area), cy/(3*area)};
+    }
+
+    /** \brief Rotate a loop so that it starts at its closest point to a given point.
+     *  \param loop: loop vertices.
+     *  \param p: reference point.
+     *  \returns closed loop (first point repeated at end), starting at projected point.
+     */
+    static Loop rotate_loop(const Loop & loop, const std::array<double, 2> & p) {
+        auto n = loop.size();
+        size_t best = 0;
+        double best_t = 0, best_d = std::numeric_limits<double>::max();
+        for (size_t i=0; i<n; i++) {
+            auto & a = loop[i];
+            auto & b = loop[(i+1)%n];
+            double dx = b[0] - a[0], dy = b[1] - a[1];
+            double l2 = dx*dx + dy*dy;
+            double t = l2 > 0 ? std::clamp(((p[0] - a[0])*dx + (p[1] - a[1])*dy)/l2, 0.0, 1.0) : 0;
+            double ex = a[0] + t*dx - p[0], ey = a[1] + t*dy - p[1];
+            if (ex*ex + ey*ey < best_d) {
+                best_d = ex*ex + ey*ey;
+                best = i;
+                best_t = t;
+            }
+        }
+        auto & a = loop[best];
+        auto & b = loop[(best+1)%n];
+        std::array<double, 2> start = {a[0] + best_t*(b[0] - a[0]), a[1] + best_t*(b[1] - a[1])};
+        Loop rotated;
+        rotated.reserve(n + 2);
+        rotated.push_back(start);
+        for (size_t k=1; k<=n; k++) {
+            auto & q = loop[(best + k)%n];
+            auto & r = rotated.back();
+            // skip vertices merged with projected point
+            if (std::abs(q[0] - r[0]) > 1e-12 || std::abs(q[1] - r[1]) > 1e-12)
+                rotated.push_back(q);
+        }
+        if (std::abs(start[0] - rotated.back()[0]) <= 1e-12 && std::abs(start[1] - rotated.back()[1]) <= 1e-12)
+            rotated.pop_back();
+        rotated.push_back(start);
+        return rotated;
+    }
+
+    /** \brief Compute normalized arc length at each vertex of a closed loop.
+     *  \param loop: closed loop.
+     *  \returns arc length parameters, from 0 to 1.
+     */
+    static std::vector<double> arc_parameters(const Loop & loop) {
+        std::vector<double> t(loop.size(), 0);
+        for (size_t i=1; i<loop.size(); i++)
+            t[i] = t[i-1] + std::hypot(loop[i][0] - loop[i-1][0], loop[i][1] - loop[i-1][1]);
+        auto length = t.back();
+        for (auto & v: t)
+            v = length > 0 ? v/length : 0;
+        t.back() = 1;
+        return t;
+    }
+
+    /** \brief Interpolate a closed loop at given arc length parameter.
+     *  \param loop: closed loop.
+     *  \param t: arc length parameters of loop vertices.
+     *  \param i: index of segment end, such that t[i-1] <= u <= t[i].
+     *  \param u: arc length parameter.
+     *  \returns interpolated point.
+     */
+    static std::array<double, 2> interpolate_loop(const Loop & loop, const std::vector<double> & t, const size_t i, const double u) {
+        auto dt = t[i] - t[i-1];
+        auto s = dt > 0 ? (u - t[i-1])/dt : 1.0;
+        return {loop[i-1][0] + s*(loop[i][0] - loop[i-1][0]), loop[i-1][1] + s*(loop[i][1] - loop[i-1][1])};
+    }
+
+    /** \brief Append a spiral turn morphing a closed loop into another one.
+     *
+     *  Points are matched by normalized arc length; the weight of the second
+     *  loop grows linearly from 0 to 1 along the turn. Every vertex of both
+     *  loops gives a point, so that the turn is exact between them.
+     *
+     *  \param path: path to append to (expected to end at first point of a).
+     *  \param a: closed loop the turn starts on.
+     *  \param b: closed loop the turn ends on.
+     */
+    static void append_turn(Loop & path, const Loop & a, const Loop & b) {
+        auto ta = arc_parameters(a);
+        auto tb = arc_parameters(b);
+        size_t i = 1, j = 1;
+        while (i < a.size() && j < b.size()) {
+            auto u = std::min(ta[i], tb[j]);
+            // vertices at (almost) the same parameter give a single point
+            auto at_a = ta[i] - u < 1e-9, at_b = tb[j] - u < 1e-9;
+            auto pa = at_a ? a[i] : interpolate_loop(a, ta, i, u);
+            auto pb = at_b ? b[j] : interpolate_loop(b, tb, j, u);
+            path.push_back({(1 - u)*pa[0] + u*pb[0], (1 - u)*pa[1] + u*pb[1]});
+            if (at_a) i++;
+            if (at_b) j++;
+        }
+    }
+
+    /** \brief Signed distance of a point from the line through two others.
+     *  \param a: first line point.
+     *  \param b: second line point.
+     *  \param p: point.
+     *  \returns distance, positive if p lies left of a->b (0 if a and b coincide).
+     */
+    static double line_side(const std::array<double, 2> & a, const std::array<double, 2> & b, const std::array<double, 2> & p) {
+        auto length = std::hypot(b[0] - a[0], b[1] - a[1]);
+        if (length == 0)
+            return 0;
+        return ((b[0] - a[0])*(p[1] - a[1]) - (b[1] - a[1])*(p[0] - a[0]))/length;
+    }
+
+    /** \brief Check that a path stays inside a closed loop.
+     *
+     *  Path vertices must lie inside the loop or within tolerance of its
+     *  boundary, and no path segment may cross a loop edge; touching the
+     *  boundary is allowed.
+     *
+     *  \param loop: closed loop (first point repeated at end).
+     *  \param path: path vertices.
+     *  \param tolerance: distance below which points are considered on boundary.
+     *  \returns true if path lies inside loop.
+     */
+    static bool loop_encloses(const Loop & loop, const Loop & path, const double tolerance) {
+        for (auto & p: path) {
+            if (ring_contains(loop, p))
+                continue;
+            bool on_boundary = false;
+            for (size_t k=1; k<loop.size() && !on_boundary; k++) {
+                auto & a = loop[k-1];
+                auto & b = loop[k];
+                double dx = b[0] - a[0], dy = b[1] - a[1];
+                double l2 = dx*dx + dy*dy;
+                double t = l2 > 0 ? std::clamp(((p[0] - a[0])*dx + (p[1] - a[1])*dy)/l2, 0.0, 1.0) : 0;
+                on_boundary = std::hypot(a[0] + t*dx - p[0], a[1] + t*dy - p[1]) <= tolerance;
+            }
+            if (!on_boundary)
+                return false;
+        }
+        for (size_t i=1; i<path.size(); i++) {
+            auto & p = path[i-1];
+            auto & q = path[i];
+            for (size_t k=1; k<loop.size(); k++) {
+                auto & a = loop[k-1];
+                auto & b = loop[k];
+                // bounding boxes first
+                if (std::max(p[0], q[0]) < std::min(a[0], b[0]) || std::min(p[0], q[0]) > std::max(a[0], b[0])
+                    || std::max(p[1], q[1]) < std::min(a[1], b[1]) || std::min(p[1], q[1]) > std::max(a[1], b[1]))
+                    continue;
+                auto sp = line_side(a, b, p), sq = line_side(a, b, q);
+                auto sa = line_side(p, q, a), sb = line_side(p, q, b);
+                // proper crossing only: every end point clearly on its side
+                if (((sp > tolerance && sq < -tolerance) || (sp < -tolerance && sq > tolerance))
+                    && ((sa > tolerance && sb < -tolerance) || (sa < -tolerance && sb > tolerance)))
+                    return false;
+            }
+        }
+        return true;
+    }
+
+    /** \brief Estimate duration of a sequence of milling paths.
+     *  \param paths: paths, as 2D point sequences.
+     *  \param feed_rate: cutting feed rate, in units per minute.
+     *  \param rapid_rate: travel rate, in units per minute.
+     *  \param clearance: retract height between paths.
+     *  \returns duration in seconds.
+     */
+    static double estimate_milling_time(const std::vector<Loop> & paths, const double feed_rate, const double rapid_rate, const double clearance) {
+        double cut = 0, travel = 0;
+        for (size_t n=0; n<paths.size(); n++) {
+            auto & path = paths[n];
+            for (size_t i=1; i<path.size(); i++)
+                cut += std::hypot(path[i][0] - path[i-1][0], path[i][1] - path[i-1][1]);
+            if (n == 0)
+                continue;
+            // retract and travel at rapid rate, plunge at feed rate
+            auto & last = paths[n-1].back();
+            travel += clearance + std::hypot(path[0][0] - last[0], path[0][1] - last[1]);
+            cut += clearance;
+        }
+        return 60*(cut/feed_rate + travel/rapid_rate);
+    }
+
+    /** \brief Maximum number of pixels for rasterized computations. */
+    static const size_t max_raster_size = 1 << 28;
+
+    /** \brief Tile size (in pixels) for parallel rasterization. */
+    static const size_t raster_tile_size = 64;
+
+    /** \brief Binary bitmap used for rasterized computations. */
+    struct Raster {
+        /** \brief Position of pixel (0,0) centre. */
+        double x0, y0;
+        /** \brief Pixel size. */
+        double resolution;
+        /** \brief Number of pixels along x and y. */
+        size_t width, height;
+        /** \brief Pixel values (row-major, 1 if set). */
+        std::vector<uint8_t> pixels;
+    };
+
+    /** \brief Stamp a disc along paths into a bitmap.
+     * 
+     *  The bitmap is split into tiles which are processed in parallel;
+     *  each tile only considers segments whose envelope touches it.
+     * 
+     *  \param paths: paths in cartesian coordinates.
+     *  \param radius: disc radius.
+     *  \param resolution: pixel size.
+     *  \returns bitmap with a margin of at least one empty pixel around stamped area.
+     */
+    static Raster stamp_paths(const std::vector<std::shared_ptr<Path>> & paths, const double radius, const double resolution) {
+        PYG_LOG_V("Stamping disc of radius {} along {:d} paths", radius, paths.size());
+        // gather segments
+        std::vector<std::array<double, 4>> segments;
+        auto xmin = std::numeric_limits<double>::max(), ymin = xmin;
+        auto xmax = -std::numeric_limits<double>::max(), ymax = xmax;
+        for (auto path: paths) {
+            auto n = path->size();
+            // a single point gives a degenerate segment
+            for (size_t i=0; i==0 || i+1<n; i++) {
+                auto p = (*path)[i];
+                auto q = (*path)[std::min(i+1, n-1)];
+                segments.push_back({p->x, p->y, q->x, q->y});
+                xmin = std::min({xmin, p->x, q->x});
+                xmax = std::max({xmax, p->x, q->x});
+                ymin = std::min({ymin, p->y, q->y});
+                ymax = std::max({ymax, p->y, q->y});
+            }
+        }
+        Raster raster{0, 0, resolution, 0, 0, {}};
+        if (segments.empty())
+            return raster;
+        auto margin = radius + 2*resolution;
+        raster.x0 = xmin - margin;
+        raster.y0 = ymin - margin;
+        raster.width = (size_t)std::ceil((xmax - xmin + 2*margin)/resolution) + 1;
+        raster.height = (size_t)std::ceil((ymax - ymin + 2*margin)/resolution) + 1;
+        if (raster.width*raster.height > max_raster_size)
+            throw std::invalid_argument("Raster resolution is too fine for surface size.");
+        raster.pixels.assign(raster.width*raster.height, 0);
+
+        // bin segments into tiles
+        auto tiles_x = (raster.width + raster_tile_size - 1)/raster_tile_size;
+        auto tiles_y = (raster.height + raster_tile_size - 1)/raster_tile_size;
+        std::vector<std::vector<size_t>> tiles(tiles_x*tiles_y);
+        auto to_pixel = [&](const double v, const double v0, const size_t n) {
+            return (size_t)std::clamp(std::floor((v - v0)/resolution), 0.0, double(n - 1));
+        };
+        for (size_t k=0; k<segments.size(); k++) {
+            auto & seg = segments[k];
+            auto i0 = to_pixel(std::min(seg[0], seg[2]) - radius, raster.x0, raster.width)/raster_tile_size;
+            auto i1 = to_pixel(std::max(seg[0], seg[2]) + radius, raster.x0, raster.width)/raster_tile_size;
+            auto j0 = to_pixel(std::min(seg[1], seg[3]) - radius, raster.y0, raster.height)/raster_tile_size;
+            auto j1 = to_pixel(std::max(seg[1], seg[3]) + radius, raster.y0, raster.height)/raster_tile_size;
+            for (auto tj=j0; tj<=j1; tj++)
+                for (auto ti=i0; ti<=i1; ti++)
+                    tiles[tj*tiles_x + ti].push_back(k);
+        }
+
+        // stamp tiles in parallel; tiles don't share pixels
+        auto r2 = radius*radius;
+        parallel_for(tiles.size(), [&](const size_t t) {
+            auto ti = t % tiles_x, tj = t / tiles_x;
+            auto tile_i1 = std::min((ti+1)*raster_tile_size, raster.width) - 1;
+            auto tile_j1 = std::min((tj+1)*raster_tile_size, raster.height) - 1;
+            for (auto k: tiles[t]) {
+                auto & seg = segments[k];
+                auto dx = seg[2] - seg[0], dy = seg[3] - seg[1];
+                auto l2 = dx*dx + dy*dy;
+                auto i0 = std::max(ti*raster_tile_size, to_pixel(std::min(seg[0], seg[2]) - radius, raster.x0, raster.width));
+                auto i1 = std::min(tile_i1, to_pixel(std::max(seg[0], seg[2]) + radius, raster.x0, raster.width) + 1);
+                auto j0 = std::max(tj*raster_tile_size, to_pixel(std::min(seg[1], seg[3]) - radius, raster.y0, raster.height));
+                auto j1 = std::min(tile_j1, to_pixel(std::max(seg[1], seg[3]) + radius, raster.y0, raster.height) + 1);
+                for (auto j=j0; j<=j1; j++) {
+                    auto py = raster.y0 + j*resolution - seg[1];
+                    auto row = &raster.pixels[j*raster.width];
+                    for (auto i=i0; i<=i1; i++) {
+                        if (row[i]) continue;
+                        auto px = raster.x0 + i*resolution - seg[0];
+                        auto t_seg = l2 > 0 ? std::clamp((px*dx + py*dy)/l2, 0.0, 1.0) : 0.0;
+                        auto ex = px - t_seg*dx, ey = py - t_seg*dy;
+                        if (ex*ex + ey*ey <= r2)
+                            row[i] = 1;
+                    }
+                }
+            }
+        });
+        return raster;
+    }
+
+    /** \brief Trace contours of a bitmap with marching squares.
+     * 
+     *  Iso-lines pass through the middle of edges between set and unset pixels.
+     *  Collinear points are dropped.
+     * 
+     *  \param raster: bitmap; its border pixels must be unset.
+     *  \returns closed paths.
+     */
+    static std::vector<std::shared_ptr<Path>> trace_contours(const Raster & raster) {
+        PYG_LOG_V("Tracing contours of {:d}x{:d} bitmap", raster.width, raster.height);
+        auto w = raster.width, h = raster.height;
+        // edge ids: 2*pixel index for edge towards +x neighbour, 2*pixel index+1 towards +y neighbour
+        auto h_edge = [w](const size_t i, const size_t j) -> int64_t { return 2*(j*w + i); };
+        auto v_edge = [w](const size_t i, const size_t j) -> int64_t { return 2*(j*w + i) + 1; };
+        // cell edges: bottom, right, top, left; segments per case as pairs of edge indices
+        static const int8_t cases[16][4] = {
+            {-1,-1,-1,-1}, {3,0,-1,-1}, {0,1,-1,-1}, {3,1,-1,-1},
+            {1,2,-1,-1}, {3,0,1,2}, {0,2,-1,-1}, {3,2,-1,-1},
+            {2,3,-1,-1}, {0,2,-1,-1}, {0,1,2,3}, {1,2,-1,-1},
+            {3,1,-1,-1}, {0,1,-1,-1}, {3,0,-1,-1}, {-1,-1,-1,-1}
+        };
+        std::vector<std::array<int64_t, 2>> segments;
+        std::unordered_map<int64_t, std::array<int64_t, 2>> edge_segments;
+        auto px = [&](const size_t i, const size_t j) { return raster.pixels[j*w + i]; };
+        for (size_t j=0; j+1<h; j++) {
+            for (size_t i=0; i+1<w; i++) {
+                auto idx = px(i,j) | (px(i+1,j) << 1) | (px(i+1,j+1) << 2) | (px(i,j+1) << 3);
+                if (idx == 0 || idx == 15) continue;
+                int64_t edges[4] = {h_edge(i,j), v_edge(i+1,j), h_edge(i,j+1), v_edge(i,j)};
+                for (auto s=0; s<4 && cases[idx][s] >= 0; s+=2) {
+                    int64_t seg_id = segments.size();
+                    segments.push_back({edges[cases[idx][s]], edges[cases[idx][s+1]]});
+                    for (auto e: segments.back()) {
+                        auto it = edge_segments.try_emplace(e, std::array<int64_t, 2>{-1, -1}).first;
+                        it->second[it->second[0] < 0 ? 0 : 1] = seg_id;
+                    }
+                }
+            }
+        }
+
+        // link segments into loops; every edge is shared by exactly two segments
+        auto edge_point = [&](const int64_t e) {
+            auto pixel = e/2;
+            auto i = pixel % w, j = pixel / w;
+            auto x = raster.x0 + (i + (e % 2 == 0 ? 0.5 : 0.0))*raster.resolution;
+            auto y = raster.y0 + (j + (e % 2 == 1 ? 0.5 : 0.0))*raster.resolution;
+            return std::array<double, 2>{x, y};
+        };
+        std::vector<bool> visited(segments.size(), false);
+        std::vector<std::shared_ptr<Path>> loops;
+        auto eps = 1e-9*raster.resolution*raster.resolution;
+        for (size_t start=0; start<segments.size(); start++) {
+            if (visited[start]) continue;
+            std::vector<std::array<double, 2>> pts;
+            auto seg = (int64_t)start;
+            auto edge = segments[start][0];
+            while (!visited[seg]) {
+                visited[seg] = true;
+                pts.push_back(edge_point(edge));
+                edge = segments[seg][segments[seg][0] == edge ? 1 : 0];
+                auto & pair = edge_segments[edge];
+                seg = pair[0] == seg ? pair[1] : pair[0];
+            }
+            // drop collinear points
+            auto path = std::make_shared<Path>(0);
+            auto n = pts.size();
+            for (size_t k=0; k<n; k++) {
+                auto & a = pts[(k+n-1)%n];
+                auto & b = pts[k];
+                auto & c = pts[(k+1)%n];
+                auto cross = (b[0]-a[0])*(c[1]-b[1]) - (b[1]-a[1])*(c[0]-b[0]);
+                if (std::abs(cross) > eps)
+                    path->emplace_back(std::make_shared<Point>(b[0], b[1], 0, 0));
+            }
+            if (path->size() >= 3)
+                loops.emplace_back(path->close());
+        }
+        return loops;
+    }
+
     void Surface::initialize() {
         PYG_LOG_V("Creating surface 0x{:x}", (uint64_t)this);
         if (!gfactory.get()) {
@@ -96,6 +675,7 @@ namespace pygraver::types {
 
     Surface::Surface(const std::shared_ptr<Surface> surface, const std::vector<std::shared_ptr<Path>> & holes) {
         this->initialize();
+        this->grid_size = surface->grid_size;
         auto surfs = surface->combine();
         std::vector<std::shared_ptr<Path>> contours;
         for (auto surf: surfs)
@@ -108,6 +688,7 @@ namespace pygraver::types {
 
     Surface::Surface(const std::shared_ptr<Surface> surface, const std::shared_ptr<Surface> holes) {
         this->initialize();
+        this->grid_size = surface->grid_size;
         auto surfs = surface->combine();
         auto hole_surfs = holes->combine();
         std::vector<std::shared_ptr<Path>> contours;
@@ -127,6 +708,93 @@ namespace pygraver::types {
         PYG_LOG_V("Deleting surface 0x{:x}", (uint64_t)this);
     }
     
+    std::vector<std::shared_ptr<Surface>> Surface::from_paths(const std::vector<std::shared_ptr<Path>> & paths, const FillRule rule) {
+        PYG_LOG_V("Building surfaces from {:d} paths", paths.size());
+        std::vector<Ring> rings;
+        rings.reserve(paths.size());
+        for (auto path: paths) {
+            if (path->size() < 3) continue;
+            auto ring = make_ring(path);
+            if (ring.area != 0)
+                rings.emplace_back(std::move(ring));
+        }
+        auto n = rings.size();
+        // index ring envelopes; rings must not be moved after this
+        GEOSSTRtree tree;
+        for (size_t i=0; i<n; i++)
+            tree.insert(&rings[i].envelope, reinterpret_cast<void*>(i));
+
+        // containment tree: every ring knows its direct parent, its depth
+        // and the winding number of the rings enclosing it
+        std::vector<int64_t> parents(n, -1);
+        std::vector<int> depths(n, 0), windings(n, 0);
+        for (size_t i=0; i<n; i++) {
+            std::vector<void*> candidates;
+            tree.query(&rings[i].envelope, candidates);
+            auto area_i = std::abs(rings[i].area);
+            auto parent_area = std::numeric_limits<double>::max();
+            for (auto candidate: candidates) {
+                auto j = reinterpret_cast<size_t>(candidate);
+                auto area_j = std::abs(rings[j].area);
+                // a ring can only be enclosed by a larger one; identical rings are ordered by index
+                if (j == i || area_j < area_i || (area_j == area_i && j > i))
+                    continue;
+                if (!rings[j].envelope.covers(rings[i].envelope))
+                    continue;
+                // rings don't cross => testing one vertex is enough
+                if (!ring_contains(rings[j].pts, rings[i].pts[0]))
+                    continue;
+                depths[i]++;
+                windings[i] += rings[j].area > 0 ? 1 : -1;
+                if (area_j < parent_area) {
+                    parent_area = area_j;
+                    parents[i] = j;
+                }
+            }
+        }
+
+        // a ring is a contour if the area it encloses is filled but not the area around it,
+        // and a hole if it is the other way around; otherwise it doesn't bound anything
+        auto is_filled = [rule](const int depth, const int winding) {
+            return rule == FillRule::EvenOdd ? (depth % 2 == 1) : (winding != 0);
+        };
+        std::vector<int8_t> kinds(n, 0); // 1: contour, -1: hole, 0: none
+        for (size_t i=0; i<n; i++) {
+            auto inside = is_filled(depths[i] + 1, windings[i] + (rings[i].area > 0 ? 1 : -1));
+            auto outside = is_filled(depths[i], windings[i]);
+            if (inside && !outside)
+                kinds[i] = 1;
+            else if (!inside && outside)
+                kinds[i] = -1;
+        }
+
+        // gather surfaces: holes belong to the closest enclosing contour
+        std::vector<int64_t> surface_index(n, -1);
+        std::vector<std::shared_ptr<Path>> contours;
+        for (size_t i=0; i<n; i++) {
+            if (kinds[i] == 1) {
+                surface_index[i] = contours.size();
+                contours.emplace_back(rings[i].path);
+            }
+        }
+        std::vector<std::vector<std::shared_ptr<Path>>> holes(contours.size());
+        for (size_t i=0; i<n; i++) {
+            if (kinds[i] != -1) continue;
+            auto parent = parents[i];
+            while (parent >= 0 && kinds[parent] != 1)
+                parent = parents[parent];
+            if (parent >= 0)
+                holes[surface_index[parent]].emplace_back(rings[i].path);
+        }
+
+        std::vector<std::shared_ptr<Surface>> surfaces;
+        surfaces.reserve(contours.size());
+        for (size_t i=0; i<contours.size(); i++)
+            surfaces.emplace_back(std::make_shared<Surface>(contours[i], holes[i]));
+        PYG_LOG_D("Built {} surfaces from {} rings", surfaces.size(), n);
+        return surfaces;
+    }
+
     const std::vector<std::shared_ptr<Path>> & Surface::get_contours() const {
         return this->contours;
     }
@@ -142,6 +810,7 @@ namespace pygraver::types {
         this->contours.reserve(n);
         for (auto bnd: contours)
             this->contours.emplace_back(std::move(bnd));
+        this->reset_index();
     }
 
     void Surface::set_holes(const std::vector<std::shared_ptr<Path>> & holes) {
@@ -151,32 +820,72 @@ namespace pygraver::types {
         this->holes.reserve(n);
         for (auto h: holes)
             this->holes.emplace_back(std::move(h));
+        this->reset_index();
+    }
+
+    double Surface::get_grid_size() const {
+        return this->grid_size;
+    }
+
+    void Surface::set_grid_size(const double grid_size) {
+        if (grid_size < 0)
+            throw std::invalid_argument("Grid size must be positive or 0.");
+        this->grid_size = grid_size;
+    }
+
+    std::shared_ptr<const PathIndex> Surface::get_index() const {
+        auto index = std::atomic_load(&this->index);
+        if (!index) {
+            // concurrent first queries may each build an index; only one is kept
+            auto rings = this->contours;
+            rings.insert(rings.end(), this->holes.begin(), this->holes.end());
+            index = std::make_shared<const PathIndex>(rings, true);
+            std::atomic_store(&this->index, index);
+        }
+        return index;
+    }
+
+    void Surface::reset_index() {
+        std::atomic_store(&this->index, std::shared_ptr<const PathIndex>());
     }
         
     bool Surface::contains(std::shared_ptr<const Point> p) const {
         PYG_LOG_V("Checking if surface 0x{:x} contains point 0x{:x}", (uint64_t)this, (uint64_t)p.get());
-        bool is_inside = false;
-        auto point = p->as_geos_geometry();
-        auto geom_holes = compile_rings(this->holes);
-        for (auto bnd: this->contours) {
-            auto contour = bnd->as_closed_geos_geometry();
-            auto poly = gfactory->createPolygon(std::move(contour), std::forward<std::vector<std::unique_ptr<GEOSLinearRing> > >(geom_holes));
-            is_inside = poly->contains(point.get()) || is_inside;
-        }
-        return is_inside;
+        auto pt = p->to_cartesian();
+        auto rings = this->get_index()->enclosing(pt->x, pt->y);
+        // rings are sorted, contours first: point must be in a contour and in no hole
+        auto nc = this->contours.size();
+        return rings.size() > 0 && rings.front() < nc && rings.back() < nc;
+    }
+
+    std::shared_ptr<Point> Surface::nearest(std::shared_ptr<const Point> p) const {
+        PYG_LOG_V("Looking for boundary point of surface 0x{:x} closest to point 0x{:x}", (uint64_t)this, (uint64_t)p.get());
+        auto pt = p->to_cartesian();
+        auto [ring, segment, t, distance] = this->get_index()->nearest(pt->x, pt->y);
+        auto & path = ring < this->contours.size() ? *this->contours[ring] : *this->holes[ring - this->contours.size()];
+        // last segment of an open ring goes back to first point
+        auto a = path[segment]->to_cartesian();
+        auto b = path[segment + 1 < path.size() ? segment + 1 : 0]->to_cartesian();
+        return std::make_shared<Point>(a->x + t*(b->x - a->x), a->y + t*(b->y - a->y), a->z + t*(b->z - a->z), 0);
     }
     
-    std::vector<std::shared_ptr<Path>> Surface::get_milling_paths(const double tool_size, const double increment) const {
+    std::vector<std::shared_ptr<Path>> Surface::get_milling_paths(const double tool_size, const double increment, const bool spiral) const {
         PYG_LOG_V("Computing milling paths for surface 0x{:x}", (uint64_t)this);
         if(increment<=0)
 			throw std::out_of_range("Increment must be larger than 0.");
+        if (spiral)
+            return this->get_spiral_milling(tool_size, increment).paths;
         
         std::vector<std::shared_ptr<Path>> paths;
         for (auto bnd: this->contours) {
             auto cartesian = bnd->to_cartesian();
+            if (this->grid_size > 0)
+                cartesian = snap_path(cartesian, this->grid_size);
             double reduction = tool_size/2.0;
             for (;;) {
                 auto new_path = cartesian->buffer(-reduction);
+                if (new_path->size() > 0 && this->grid_size > 0)
+                    new_path = snap_path(new_path, this->grid_size);
                 if (new_path->size()==0) break;
                 paths.emplace_back(new_path);
                 reduction += increment;
@@ -189,21 +898,162 @@ namespace pygraver::types {
         return paths;
     }
     
-    std::vector<std::shared_ptr<Surface>> Surface::get_milled_surface(const double tool_size, const double increment) const {
+    SpiralMilling Surface::get_spiral_milling(const double tool_size, const double increment, const double feed_rate,
+                                              const double rapid_rate, const double clearance) const {
+        PYG_LOG_V("Computing spiral milling paths for surface 0x{:x}", (uint64_t)this);
+        if (increment <= 0)
+            throw std::out_of_range("Increment must be larger than 0.");
+        if (feed_rate <= 0 || rapid_rate <= 0)
+            throw std::out_of_range("Feed and rapid rates must be larger than 0.");
+
+        SpiralMilling result;
+        std::vector<Loop> spirals, concentric;
+        std::array<double, 2> cursor = {0, 0};
+        size_t fallbacks = 0;
+        // same order as get_milling_paths: last contour first
+        for (auto it = this->contours.rbegin(); it != this->contours.rend(); it++) {
+            auto cartesian = (*it)->to_cartesian();
+            if (this->grid_size > 0)
+                cartesian = snap_path(cartesian, this->grid_size);
+            if (cartesian->size() < 3)
+                continue;
+            // offset tree, level by level; loops of a level lie inside a loop of the previous level
+            std::vector<OffsetLoop> tree;
+            std::vector<size_t> roots, level;
+            double reduction = tool_size/2.0;
+            for (;;) {
+                auto loops = offset_loops(*cartesian, reduction, this->grid_size);
+                if (loops.empty())
+                    break;
+                std::vector<size_t> next;
+                for (auto & loop: loops) {
+                    auto idx = tree.size();
+                    size_t parent = level.size();
+                    auto centre = loop_centroid(loop);
+                    for (size_t k=0; k<level.size() && parent == level.size(); k++)
+                        if (ring_contains(tree[level[k]].pts, loop[0]) || ring_contains(tree[level[k]].pts, centre))
+                            parent = k;
+                    // a loop escaping every loop of previous level (snapping, round-off) starts its own spiral
+                    if (parent < level.size())
+                        tree[level[parent]].children.push_back(idx);
+                    else
+                        roots.push_back(idx);
+                    tree.push_back({std::move(loop), {}});
+                    next.push_back(idx);
+                }
+                level = std::move(next);
+                reduction += increment;
+            }
+            if (tree.empty())
+                continue;
+            result.loops += tree.size();
+
+            // concentric estimate: centroid, then loops from the inside out
+            concentric.push_back({loop_centroid(tree.back().pts)});
+            for (auto n = tree.size(); n > 0; n--) {
+                auto loop = tree[n-1].pts;
+                loop.push_back(loop[0]);
+                concentric.emplace_back(std::move(loop));
+            }
+
+            // each chain of loops without split gives one spiral; inner islands come first
+            auto tolerance = std::max(this->grid_size, 1e-9);
+            std::function<void(size_t)> mill = [&](size_t outer) {
+                std::vector<size_t> chain = {outer};
+                while (tree[chain.back()].children.size() == 1)
+                    chain.push_back(tree[chain.back()].children[0]);
+                auto & inner = tree[chain.back()];
+                for (auto child: inner.children)
+                    mill(child);
+                Loop spiral;
+                if (inner.children.empty()) {
+                    cursor = loop_centroid(inner.pts);
+                    spiral.push_back(cursor);
+                }
+                // full innermost loop, turns towards outer loops, full outermost loop
+                auto loop = rotate_loop(inner.pts, cursor);
+                spiral.insert(spiral.end(), loop.begin(), loop.end());
+                bool closed = true;
+                for (auto n = chain.size() - 1; n > 0; n--) {
+                    auto next = rotate_loop(tree[chain[n-1]].pts, loop[0]);
+                    Loop turn;
+                    append_turn(turn, loop, next);
+                    if (loop_encloses(next, turn, tolerance)) {
+                        spiral.insert(spiral.end(), turn.begin(), turn.end());
+                        closed = false;
+                    } else {
+                        // a turn leaving the region milled at this level would gouge the part:
+                        // step over to the closest point of next loop and follow it completely instead
+                        spiral.insert(spiral.end(), next.begin(), next.end());
+                        closed = true;
+                        fallbacks++;
+                    }
+                    loop = std::move(next);
+                }
+                if (!closed)
+                    spiral.insert(spiral.end(), loop.begin() + 1, loop.end());
+                cursor = spiral.back();
+                spirals.emplace_back(std::move(spiral));
+            };
+            for (auto root: roots)
+                mill(root);
+        }
+
+        result.paths.reserve(spirals.size());
+        for (auto & spiral: spirals) {
+            auto path = std::make_shared<Path>(0);
+            path->reserve(spiral.size());
+            for (auto & p: spiral)
+                path->emplace_back(std::make_shared<Point>(p[0], p[1], 0, 0));
+            result.paths.emplace_back(path);
+        }
+        result.retracts = spirals.size() > 0 ? spirals.size() - 1 : 0;
+        result.concentric_retracts = concentric.size() > 0 ? concentric.size() - 1 : 0;
+        result.time = estimate_milling_time(spirals, feed_rate, rapid_rate, clearance);
+        result.concentric_time = estimate_milling_time(concentric, feed_rate, rapid_rate, clearance);
+        PYG_LOG_D("Spiral milling: {} loops, {} retracts instead of {}, {:.1f} s instead of {:.1f} s, {} concentric turns",
+                  result.loops, result.retracts, result.concentric_retracts, result.time, result.concentric_time, fallbacks);
+        return result;
+    }
+    
+    std::vector<std::shared_ptr<Surface>> Surface::get_milled_surface(const double tool_size, const double increment,
+                                                                      const MillingMode mode, const double resolution) const {
         PYG_LOG_V("Computing milled surface for surface 0x{:x}", (uint64_t)this);
         // we take milling paths and generate surface considering tool size
         auto paths = this->get_milling_paths(tool_size, increment);
         std::vector<std::shared_ptr<Path>> new_paths;
         new_paths.reserve(paths.size());
+        if (mode == MillingMode::Raster) {
+            for (auto p: paths)
+                if (p->size()>=4)
+                    new_paths.emplace_back(p->to_cartesian());
+            auto raster = stamp_paths(new_paths, tool_size/2.0, resolution > 0 ? resolution : tool_size/20.0);
+            return Surface::from_paths(trace_contours(raster));
+        }
         for (auto p: paths)
             if (p->size()>=4)
                 new_paths.emplace_back(p->buffer(tool_size/2.0));
         
-        return Surface(new_paths).combine();
+        auto milled = Surface(new_paths);
+        milled.grid_size = this->grid_size;
+        return milled.combine();
     }
 
     std::unique_ptr<GEOSGeometry> Surface::as_geos_geometry() const {
+        return this->as_geos_geometry(this->grid_size);
+    }
+
+    std::unique_ptr<GEOSGeometry> Surface::as_geos_geometry(const double grid_size) const {
         PYG_LOG_V("Converting surface 0x{:x} to GEOS geometry", (uint64_t)this);
+        if (grid_size > 0) {
+            // snap-rounding gives valid results from the start: holes are cut from merged contours
+            auto pm = make_precision_model(grid_size);
+            auto merged = make_snapped_area(this->contours, pm);
+            if (this->holes.empty())
+                return merged;
+            auto cut = make_snapped_area(this->holes, pm);
+            return GEOSOverlayNG::overlay(merged.get(), cut.get(), GEOSOverlayNG::DIFFERENCE, &pm);
+        }
         // create GEOS collection containing surface contours
         // gather holes
         auto geom_holes = compile_rings(this->holes);
@@ -250,6 +1100,7 @@ namespace pygraver::types {
                 } else {
                     surfaces.emplace_back(std::make_shared<Surface>(new_path));
                 }
+                surfaces.back()->grid_size = this->grid_size;
             }
         }
         return surfaces;
@@ -273,28 +1124,22 @@ namespace pygraver::types {
 
     std::vector<std::shared_ptr<Surface>> Surface::boolean_operation(std::shared_ptr<const Surface> other, const BooleanOperation operation_type) const {
         PYG_LOG_V("Computing boolean operation for surface 0x{:x}", (uint64_t)this);
-        auto this_merged = this->as_geos_geometry();
-        auto other_merged = other->as_geos_geometry();
+        // both operands must be on the same grid
+        auto grid_size = std::max(this->grid_size, other->grid_size);
+        auto this_merged = this->as_geos_geometry(grid_size);
+        auto other_merged = other->as_geos_geometry(grid_size);
         std::vector<std::shared_ptr<Surface>> new_surfaces;
         auto ng = this_merged->getNumGeometries();
         new_surfaces.reserve(ng);
         for (auto i=0; i<ng; i++) {
             auto env_i = this_merged->getGeometryN(i);
-            std::unique_ptr<GEOSGeometry> diff_i;
-            if (operation_type == BooleanOperation::Union) {
-                diff_i = env_i->Union(other_merged.get());
-            } else if (operation_type == BooleanOperation::Difference) {
-                diff_i = env_i->difference(other_merged.get());
-            } else if (operation_type == BooleanOperation::SymmetricDifference) {
-                diff_i = env_i->symDifference(other_merged.get());
-            } else if (operation_type == BooleanOperation::Intersection) {
-                diff_i = env_i->intersection(other_merged.get());
-            }
+            auto diff_i = overlay(env_i, other_merged.get(), operation_type, grid_size);
             auto ndiff = diff_i->getNumGeometries();
             for (auto j=0; j<ndiff; j++) {
                 auto env_j = diff_i->getGeometryN(j);
                 auto new_path = make_path(env_j->getBoundary().get());
                 new_surfaces.emplace_back(std::make_shared<Surface>(new_path));
+                new_surfaces.back()->grid_size = grid_size;
             }
         }
         return new_surfaces;
@@ -316,6 +1161,8 @@ namespace pygraver::types {
         PYG_LOG_V("Correcting {:d} paths using surface 0x{:x} as mask", paths.size(), (uint64_t)this);
         // build a prepared geometry
         auto merged = this->as_geos_geometry()->buffer(clearance);
+        if (this->grid_size > 0)
+            merged = GEOSPrecisionReducer::reduce(*merged, make_precision_model(this->grid_size));
         auto prepared = GEOSPreparedGeometryFactory::prepare(merged.get());
         auto contour = merged->getBoundary();
         auto prep_bnd = GEOSPreparedGeometryFactory::prepare(contour.get());
@@ -450,7 +1297,24 @@ namespace pygraver::types {
         .value("Difference", BooleanOperation::Difference)
         .value("SymmetricDifference", BooleanOperation::SymmetricDifference)
         .value("Intersection", BooleanOperation::Intersection);
+
+        py::enum_<MillingMode>(mod, "MillingMode")
+        .value("Exact", MillingMode::Exact)
+        .value("Raster", MillingMode::Raster);
+
+        py::enum_<FillRule>(mod, "FillRule")
+        .value("EvenOdd", FillRule::EvenOdd)
+        .value("NonZero", FillRule::NonZero);
     
+        py::class_<SpiralMilling>(mod, "SpiralMilling")
+        .def_readonly("paths", &SpiralMilling::paths)
+        .def_readonly("loops", &SpiralMilling::loops)
+        .def_readonly("retracts", &SpiralMilling::retracts)
+        .def_readonly("concentric_retracts", &SpiralMilling::concentric_retracts)
+        .def_readonly("time", &SpiralMilling::time)
+        .def_readonly("concentric_time", &SpiralMilling::concentric_time)
+        .def_property_readonly("time_saved", [](const SpiralMilling & s) { return s.concentric_time - s.time; });
+
         py::class_<Surface, std::shared_ptr<Surface>>(mod, "Surface")
         .def(py::init<>())
         .def(py::init<std::shared_ptr<Path>>())
@@ -459,11 +1323,17 @@ namespace pygraver::types {
         .def(py::init<const std::vector<std::shared_ptr<Path>> &, const std::vector<std::shared_ptr<Path>> &>(), py::arg("contours"), py::arg("holes"))
         .def(py::init<const std::shared_ptr<Surface>, const std::vector<std::shared_ptr<Path>> &>(), py::arg("contours"), py::arg("holes"))
         .def(py::init<const std::shared_ptr<Surface>, const std::shared_ptr<Surface>>(), py::arg("contours"), py::arg("holes"))
+        .def_static("from_paths", &Surface::from_paths, py::arg("paths"), py::arg("rule")=FillRule::EvenOdd)
         .def_property("contours", &Surface::get_contours, &Surface::set_contours, py::return_value_policy::reference)
         .def_property("holes", &Surface::get_holes, &Surface::set_holes, py::return_value_policy::reference)
-        .def("get_milling_paths", &Surface::get_milling_paths, py::arg("tool_size"), py::arg("increment"))
-        .def("get_milled_surface", &Surface::get_milled_surface, py::arg("tool_size"), py::arg("increment"))
+        .def_property("grid_size", &Surface::get_grid_size, &Surface::set_grid_size)
+        .def("get_milling_paths", &Surface::get_milling_paths, py::arg("tool_size"), py::arg("increment"), py::arg("spiral")=false)
+        .def("get_spiral_milling", &Surface::get_spiral_milling, py::arg("tool_size"), py::arg("increment"), py::arg("feed_rate")=100,
+             py::arg("rapid_rate")=1000, py::arg("clearance")=1)
+        .def("get_milled_surface", &Surface::get_milled_surface, py::arg("tool_size"), py::arg("increment"), py::arg("mode")=MillingMode::Exact, py::arg("resolution")=0)
         .def("contains", &Surface::contains, py::arg("point"))
+        .def("nearest", &Surface::nearest, py::arg("point"))
+        .def("reset_index", &Surface::reset_index)
         .def("combine", &Surface::combine)
         .def("boolean_operation", &Surface::boolean_operation, py::arg("other"), py::arg("operation_type"))
         .def("__add__", &add_objects<Surface>, py::is_operator()) // boolean union
@@ -18,6 +18,7 @@ using GEOSGeometry = geos::geom::Geometry;
 namespace pygraver::types {
 
     class Path;
+    class PathIndex;
     class PathGroup;
 
     /** \brief Definition of boolean operation types. */
@@ -28,6 +29,34 @@ namespace pygraver::types {
         Intersection = 3 /**< intersection */
     };
 
+    /** \brief Definition of computation modes for milled surfaces. */
+    enum class MillingMode : uint8_t {
+        Exact = 0, /**< buffer milling paths with GEOS and merge results */
+        Raster = 1 /**< stamp tool footprint into a bitmap and trace its contours */
+    };
+
+    /** \brief Definition of fill rules used to tell contours from holes. */
+    enum class FillRule : uint8_t {
+        EvenOdd = 0, /**< a region is filled if it is enclosed by an odd number of paths */
+        NonZero = 1 /**< a region is filled if the winding number of enclosing paths is not zero */
+    };
+
+    /** \brief Spiral milling paths and comparison with concentric milling paths. */
+    struct SpiralMilling {
+        /** \brief Continuous milling paths (one per island), in milling order. */
+        std::vector<std::shared_ptr<Path>> paths;
+        /** \brief Number of offset loops. */
+        size_t loops = 0;
+        /** \brief Number of retracts between spiral paths. */
+        size_t retracts = 0;
+        /** \brief Number of retracts between concentric paths (one path per loop). */
+        size_t concentric_retracts = 0;
+        /** \brief Estimated duration of spiral paths, in seconds. */
+        double time = 0;
+        /** \brief Estimated duration of concentric paths, in seconds. */
+        double concentric_time = 0;
+    };
+
     /** \brief Class representing a surface composed of one or more contours. */
     class Surface {
     private:
@@ -40,8 +69,25 @@ namespace pygraver::types {
          */
         std::vector<std::shared_ptr<Path>> holes;
 
+        /** \brief Spatial index over contours, then holes; built on first query (nullptr until then). */
+        mutable std::shared_ptr<const PathIndex> index;
+
+        /** \brief Grid size of fixed-precision mode (0 for floating precision). */
+        double grid_size = 0;
+
         /** \brief Initialize instance. */
         void initialize();
+
+        /** \brief Get spatial index, building it if necessary.
+         *  \returns spatial index.
+         */
+        std::shared_ptr<const PathIndex> get_index() const;
+
+        /** \brief Convert surface to a GEOS Geometry object on a given grid.
+         *  \param grid_size: grid size for snap-rounding (0 for floating precision).
+         *  \returns a GEOS Geometry object containing surface data.
+         */
+        std::unique_ptr<GEOSGeometry> as_geos_geometry(const double grid_size) const;
     
     public:
         /** \brief Default constructor. */
@@ -84,6 +130,19 @@ namespace pygraver::types {
         /** \brief Destructor. */
         ~Surface();
         
+        /** \brief Build surfaces from a collection of closed paths.
+         * 
+         *  Paths are arranged in a containment tree, which is then used to
+         *  tell contours from holes according to the given fill rule. This
+         *  assumes that paths don't intersect each other; overlapping paths
+         *  should go through combine instead. Open paths are closed.
+         * 
+         *  \param paths: a collection of paths.
+         *  \param rule: fill rule.
+         *  \returns a collection of surfaces, each with one contour and its holes.
+         */
+        static std::vector<std::shared_ptr<Surface>> from_paths(const std::vector<std::shared_ptr<Path>> & paths, const FillRule rule=FillRule::EvenOdd);
+
         /** \brief Get surface contours.
          *  \returns the collection of paths representing the surface contours.
          */
@@ -104,6 +163,22 @@ namespace pygraver::types {
          */
         void set_holes(const std::vector<std::shared_ptr<Path>> & holes);
 
+        /** \brief Get grid size of fixed-precision mode.
+         *  \returns grid size (0 for floating precision).
+         */
+        double get_grid_size() const;
+
+        /** \brief Set grid size of fixed-precision mode.
+         *
+         *  With a grid size, overlay operations (combine, boolean_operation,
+         *  correct_height, get_milling_paths) use GEOS OverlayNG with snap-rounding:
+         *  vertices are rounded to the grid and results are always valid,
+         *  so inputs need no repair. Resulting surfaces keep the grid size.
+         *
+         *  \param grid_size: grid size (0 for floating precision).
+         */
+        void set_grid_size(const double grid_size);
+
         /** \brief Compute path necessary to mill surface with given parameters.
          * 
          *  Paths are computed incrementally from centroid point with given increment.
@@ -112,23 +187,77 @@ namespace pygraver::types {
          * 
          *  \param tool_size: diameter of endmill.
          *  \param increment: increment between consecutive paths (>0).
+         *  \param spiral: if true, offset loops are linked into spirals (see get_spiral_milling).
          *  \returns a collection of milling paths.
          */
-        std::vector<std::shared_ptr<Path>> get_milling_paths(const double tool_size, const double increment) const;
+        std::vector<std::shared_ptr<Path>> get_milling_paths(const double tool_size, const double increment, const bool spiral=false) const;
+
+        /** \brief Compute continuous spiral paths necessary to mill surface.
+         *
+         *  Offset loops are the same as with get_milling_paths, but islands
+         *  are kept apart: loops form a tree in which a loop with several
+         *  inner loops is where offsets split. Each chain of loops without
+         *  splits becomes one path, milled from the inside out: innermost
+         *  loop, then one turn per offset level in which a loop morphs into
+         *  the next one (points are matched by normalized arc length), then
+         *  outermost loop. Inner islands are milled before the chain that
+         *  encloses them. A turn that would leave the loop it ends on (which
+         *  happens with concave shapes) is replaced by a step over to that
+         *  loop and a full concentric pass along it. A loop lying outside
+         *  every loop of the previous level (round-off) starts its own path.
+         *
+         *  Durations assume that moves between paths retract by clearance at
+         *  rapid rate, travel at rapid rate and plunge at feed rate.
+         *
+         *  \param tool_size: diameter of endmill.
+         *  \param increment: increment between consecutive loops (>0).
+         *  \param feed_rate: cutting feed rate, in units per minute (>0).
+         *  \param rapid_rate: travel rate, in units per minute (>0).
+         *  \param clearance: retract height between paths.
+         *  \returns spiral paths and statistics.
+         */
+        SpiralMilling get_spiral_milling(const double tool_size, const double increment, const double feed_rate=100,
+                                         const double rapid_rate=1000, const double clearance=1) const;
 
         /** \brief Compute surface milled with given parameters.
+         * 
+         *  In exact mode, milling paths are buffered by the tool radius and merged.
+         *  In raster mode, the tool footprint is stamped along milling paths into
+         *  a bitmap, whose contours are then traced; this is much faster but
+         *  only accurate to the given resolution.
+         * 
          *  \param tool_size: diameter of endmill.
          *  \param increment: increment between consecutive paths (>0).
+         *  \param mode: computation mode.
+         *  \param resolution: pixel size in raster mode; if <=0, tool_size/20 is used.
          *  \returns a collection of milled surfaces.
          */
-        std::vector<std::shared_ptr<Surface>> get_milled_surface(const double tool_size, const double increment) const;
+        std::vector<std::shared_ptr<Surface>> get_milled_surface(const double tool_size, const double increment,
+                                                                 const MillingMode mode=MillingMode::Exact,
+                                                                 const double resolution=0) const;
 
         /** \brief Tell if given point is inside surface.
+         *
+         *  Only contours and holes whose bounding volume lies across a ray
+         *  from the point are tested, using a spatial index built on first call.
+         *
          *  \param p: point to test for.
          *  \returns true if point is inside surface, false otherwise.
          */
         bool contains(std::shared_ptr<const Point> p) const;
 
+        /** \brief Find closest point of surface boundary (contours and holes).
+         *  \param p: reference point.
+         *  \returns closest boundary point (in cartesian coordinates).
+         */
+        std::shared_ptr<Point> nearest(std::shared_ptr<const Point> p) const;
+
+        /** \brief Discard spatial index.
+         *
+         *  This is needed only after contour or hole points were modified in place.
+         */
+        void reset_index();
+
         /** \brief Convert surface to a GEOS Geometry object.
          *  \returns a GEOS Geometry object containing surface data.
          */
@@ -149,6 +278,9 @@ namespace pygraver::types {
         std::shared_ptr<Point> get_centroid() const;
 
         /** \brief Apply a boolean operation between two surfaces.
+         *
+         *  If either surface has a grid size, the larger one is used.
+         *
          *  \param other: second surface to perform operation with.
          *  \param operation_type: the type of boolean operation to apply.
          *  \returns a collection of surfaces resulting from the boolean operation.
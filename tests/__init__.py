@@ -1,5 +1,6 @@
 import unittest
 from .machine import *
+from .dispatch import *
 from .render import *
 from .types import *
 
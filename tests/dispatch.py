@@ -0,0 +1,117 @@
+import asyncio
+import unittest
+from pygraver.core.types import Path, PathGroup, DepthPasses, CompressedPathGroup
+from pygraver.machine import Machine
+from pygraver.dispatch import Job, Dispatcher
+
+from .common import *
+from .emulator import FirmwareEmulator
+
+__all__ = ["TestJob", "TestDispatcher"]
+
+def make_job(n_points:int, name:str="") -> Job:
+    xs = [float(i) for i in range(n_points)]
+    return Job(PathGroup([Path(xs=xs, ys=[0.0]*n_points, zs=[0.0]*n_points, cs=[0.0]*n_points)]), name)
+
+
+class TestJob(unittest.TestCase):
+    def test_commands(self):
+        machine = Machine()
+        job = make_job(5)
+        self.assertFalse(job.is_gcode())
+        commands = job.get_commands(machine)
+        self.assertEqual(commands[0], "G90")
+        self.assertEqual(len(commands), 6)
+        job = Job(DepthPasses(job.content, [-0.1, -0.2, -0.3]))
+        self.assertFalse(job.is_gcode())
+        self.assertEqual(len(job.get_commands(machine)), 16)
+        compressed = Job(CompressedPathGroup(make_job(5).content, resolution=1e-3))
+        self.assertFalse(compressed.is_gcode())
+        self.assertEqual(compressed.get_commands(machine), commands)
+        job = Job("G90\n; comment\nG1 X10 F600 ; move\n\nG4 P500")
+        self.assertTrue(job.is_gcode())
+        self.assertEqual(job.get_commands(machine), ["G90", "G1 X10 F600", "G4 P500"])
+        with self.assertRaises(ValueError):
+            Job([])
+
+    def test_estimate(self):
+        machine = Machine()
+        job = Job(["G1 X10 F600", "G1 X10 Y10", "G4 P500", "M114"])
+        self.assertAlmostEqual(job.estimate_duration(machine), 2.5)
+        machine.feed_rate = 60
+        self.assertAlmostEqual(make_job(11).estimate_duration(machine), 10)
+
+
+class TestDispatcher(unittest.TestCase):
+    def setUp(self):
+        self.emulators = []
+
+    def tearDown(self):
+        for emulator in self.emulators:
+            emulator.close()
+
+    def make_machines(self, n:int, **kwargs) -> 'list[Machine]':
+        machines = []
+        for _ in range(n):
+            emulator = FirmwareEmulator(**kwargs)
+            self.emulators.append(emulator)
+            machines.append(Machine(emulator.port))
+        return machines
+
+    def test_arguments(self):
+        with self.assertRaises(ValueError):
+            Dispatcher([])
+        with self.assertRaises(ValueError):
+            Dispatcher([Machine()], max_attempts=0)
+        with self.assertRaises(ValueError):
+            Dispatcher([Machine()], window=0)
+
+    def test_order(self):
+        dispatcher = Dispatcher([Machine()])
+        short = dispatcher.add_job(make_job(3, "short"))
+        long = dispatcher.add_job(make_job(30, "long"))
+        self.assertEqual(dispatcher.pending, [long, short])
+
+    @run_async
+    async def test_run(self):
+        dispatcher = Dispatcher(self.make_machines(3), timeout=2)
+        sizes = [40, 10, 25, 5, 30, 15]
+        for k, n in enumerate(sizes):
+            dispatcher.add_job(make_job(n, "job {}".format(k)))
+        self.assertTrue(await dispatcher.run())
+        metrics = dispatcher.metrics
+        self.assertEqual(metrics["completed"], len(sizes))
+        self.assertEqual(metrics["failed"], 0)
+        self.assertEqual(metrics["pending"], 0)
+        self.assertEqual(metrics["lines"], sum(sizes) + len(sizes))
+        self.assertEqual(sum(len(e.lines) for e in self.emulators), metrics["lines"])
+        # every machine got some work
+        for stats in dispatcher.stats:
+            self.assertGreater(stats.jobs, 0)
+        self.assertGreater(metrics["lines_per_second"], 0)
+
+    @run_async
+    async def test_failure(self):
+        machines = self.make_machines(2)
+        # first machine stops answering during its first job
+        self.emulators[0].fail_after = 5
+        dispatcher = Dispatcher(machines, window=4, timeout=0.5)
+        for k in range(4):
+            dispatcher.add_job(make_job(20, "job {}".format(k)))
+        self.assertTrue(await dispatcher.run())
+        metrics = dispatcher.metrics
+        self.assertEqual(metrics["completed"], 4)
+        self.assertEqual(metrics["requeued"], 1)
+        self.assertEqual(metrics["online"], 1)
+        self.assertFalse(dispatcher.stats[0].online)
+        self.assertEqual(dispatcher.stats[1].jobs, 4)
+        for job in dispatcher.completed:
+            self.assertIs(job.machine, machines[1])
+
+    @run_async
+    async def test_no_machine_left(self):
+        dispatcher = Dispatcher(self.make_machines(1, fail_after=0), max_attempts=1, timeout=0.2)
+        job = dispatcher.add_job(make_job(5))
+        self.assertFalse(await dispatcher.run())
+        self.assertEqual(dispatcher.failed, [job])
+        self.assertIsNotNone(job.error)
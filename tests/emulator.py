@@ -0,0 +1,103 @@
+import os
+import pty
+import select
+import threading
+import time
+import tty
+
+__all__ = ["FirmwareEmulator"]
+
+class FirmwareEmulator(object):
+    '''
+    Minimal RepRap firmware emulator on a pseudo-terminal.
+
+    Every received line is acknowledged with "ok"; M114 also returns the last
+    position and G30 the stock height at the probed position. The emulator
+    can be told to stop answering after a number of lines to simulate a
+    machine failure, to reply with an error to a given line, or to send
+    informative lines before acknowledgements.
+
+    Attributes:
+        port (str): path to the serial device to open
+        lines (list[str]): received command lines
+    '''
+    def __init__(self, delay:float=0.0, fail_after:int|None=None, surface=None, error_at:int|None=None, busy:bool=False):
+        '''
+        Constructor.
+
+        Args:
+            delay (float): time to process a command line, in seconds
+            fail_after (int|None): number of lines after which the emulator stops answering, or None
+            surface (callable|None): stock height as a function of x, y and c, for G30 (default: flat stock at 0)
+            error_at (int|None): number of the line (starting at 1) answered with an error instead of "ok", or None
+            busy (bool): if True, every move is preceded by a busy line before "ok"
+        '''
+        self.delay = delay
+        self.fail_after = fail_after
+        self.error_at = error_at
+        self.busy = busy
+        self.surface = surface if surface is not None else (lambda x, y, c: 0.0)
+        self.lines = []
+        self.__position = {"X":0.0, "Y":0.0, "Z":0.0, "C":0.0}
+        self.__master, self.__slave = pty.openpty()
+        tty.setraw(self.__slave)
+        self.port = os.ttyname(self.__slave)
+        self.__running = True
+        self.__thread = threading.Thread(target=self.__run, daemon=True)
+        self.__thread.start()
+
+    def __reply(self, line:str) -> None:
+        os.write(self.__master, "{}\n".format(line).encode("utf-8"))
+
+    def __handle(self, cmd:str) -> None:
+        self.lines.append(cmd)
+        if self.fail_after is not None and len(self.lines) > self.fail_after:
+            return
+        if self.delay > 0:
+            time.sleep(self.delay)
+        if self.error_at is not None and len(self.lines) == self.error_at:
+            self.__reply("Error: unknown command")
+            return
+        words = cmd.split()
+        if self.busy and len(words) > 0 and words[0] in ("G0", "G1"):
+            self.__reply("echo:busy: processing")
+        if len(words) > 0 and words[0] in ("G0", "G1"):
+            for word in words[1:]:
+                if word[0] in self.__position:
+                    self.__position[word[0]] = float(word[1:])
+        elif len(words) > 0 and words[0] == "G30":
+            pos = dict(self.__position)
+            for word in words[1:]:
+                if word[0] in "XY":
+                    pos[word[0]] = float(word[1:])
+            z = self.surface(pos["X"], pos["Y"], pos["C"])
+            self.__reply("Bed X:{:.4f} Y:{:.4f} Z:{:.4f}".format(pos["X"], pos["Y"], z))
+        elif len(words) > 0 and words[0] == "M114":
+            self.__reply(" ".join("{}:{:f}".format(k, v) for k, v in self.__position.items()))
+        self.__reply("ok")
+
+    def __run(self) -> None:
+        buffer = b""
+        while self.__running:
+            ready, _, _ = select.select([self.__master], [], [], 0.05)
+            if not ready:
+                continue
+            try:
+                data = os.read(self.__master, 4096)
+            except OSError:
+                break
+            buffer += data
+            while b"\n" in buffer:
+                line, buffer = buffer.split(b"\n", 1)
+                line = line.decode("utf-8").strip()
+                if len(line) > 0:
+                    self.__handle(line)
+
+    def close(self) -> None:
+        '''
+        Stop emulator and release pseudo-terminal.
+        '''
+        self.__running = False
+        self.__thread.join()
+        os.close(self.__master)
+        os.close(self.__slave)
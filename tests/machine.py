@@ -1,13 +1,18 @@
 import asyncio
+import os
+import tempfile
 import unittest
 import pygraver
-from pygraver.machine import Machine, serial_asyncio
-from unittest.mock import Mock
+from pygraver.machine import Machine, Checkpoint, MoveLog, PathIndex, serial_asyncio
+from unittest.mock import Mock, patch
+from pygraver.core.types import Path, PathGroup, Point, HeightMapMode, DepthPasses, Pipeline
 from serial import SerialException
 
 from .common import *
+from pygraver.exceptions import InvalidAnswerException
+from .emulator import FirmwareEmulator
 
-__all__ = ["MachineTestCase", "TestOpenMachine", "TestCloseMachine", "TestMachineBaseCommands", "TestMachineCommands"]
+__all__ = ["MachineTestCase", "TestOpenMachine", "TestCloseMachine", "TestMachineBaseCommands", "TestMachineCommands", "TestProbing", "TestDepthPasses", "TestPipeline", "TestMoveLog", "TestCheckpoint"]
 
 class MachineTestCase(unittest.TestCase):
     def setUp(self):
@@ -27,15 +32,15 @@ class TestOpenMachine(MachineTestCase):
         for asyncio-serial; we mock the asyncio-serial coroutine
         to return something.
         '''
-        serial_asyncio.open_serial_connection = AsyncMock(return_value=(object(), object()))
         self.machine.port = "some_port"
-        result = await self.machine.open()
+        with patch.object(serial_asyncio, "open_serial_connection", AsyncMock(return_value=(object(), object()))):
+            result = await self.machine.open()
         self.assertTrue(result)
 
     @run_async
     async def test_already_open(self):
-        self.machine._Machine_writer = Mock()
         self.machine.port = "some_port"
+        self.machine._Machine__writer = Mock()
         with self.assertRaises(SerialException):
             await self.machine.open()
     
@@ -261,3 +266,229 @@ class TestMachineCommands(MachineTestCase):
     async def test_trace_pattern(self):
         v1 = [1, 2, 3, 4]
         await self.machine.trace_pattern(xs=v1, ys=v1, zs=v1, cs=v1)
+
+
+class TestProbing(unittest.TestCase):
+    def setUp(self):
+        # slanted stock, with a height varying with c on cylinders
+        self.emulator = FirmwareEmulator(surface=lambda x, y, c: 0.01*x + 0.02*y + (0.1 if c==90 else 0.0))
+        self.machine = Machine(self.emulator.port)
+
+    def tearDown(self):
+        self.emulator.close()
+
+    @run_async
+    async def test_probe_not_open(self):
+        with self.assertRaises(SerialException):
+            await self.machine.probe(0, 0)
+
+    @run_async
+    async def test_probe_grid(self):
+        self.assertTrue(await self.machine.open())
+        height = await self.machine.probe(10, 5, timeout=2)
+        hmap = await self.machine.probe_grid(0, 0, 10, 10, 3, 3, timeout=2)
+        await self.machine.close()
+        self.assertAlmostEqual(height, 0.2)
+        self.assertEqual(hmap.mode, HeightMapMode.Bilinear)
+        self.assertAlmostEqual(hmap.get_height(15, 5), 0.25)
+        # a groove at constant depth follows the slanted stock
+        path = Path(xs=[0.0, 20.0], ys=[10.0, 10.0], zs=[-0.1, -0.1], cs=[0.0, 0.0])
+        res = hmap.apply(PathGroup([path]), max_segment=5)
+        self.assertEqual(len(res[0]), 5)
+        for pt in res[0]:
+            self.assertAlmostEqual(pt.z, 0.1 + 0.01*pt.x)
+
+    @run_async
+    async def test_probe_ring(self):
+        self.assertTrue(await self.machine.open())
+        hmap = await self.machine.probe_ring(0, 10, 2, 4, 5, timeout=2)
+        await self.machine.close()
+        self.assertAlmostEqual(hmap.get_height(0, 0, 90), 0.1)
+        self.assertAlmostEqual(hmap.get_height(5, 0, 45), 0.1)
+        self.assertAlmostEqual(hmap.get_height(5, 0, 180), 0.05)
+
+    @run_async
+    async def test_probe_points(self):
+        self.assertTrue(await self.machine.open())
+        points = [Point(x, y, 0, 0) for x, y in [(0, 0), (20, 0), (0, 20), (20, 20), (10, 10)]]
+        hmap = await self.machine.probe_points(points, timeout=2)
+        await self.machine.close()
+        self.assertEqual(hmap.mode, HeightMapMode.ThinPlateSpline)
+        self.assertAlmostEqual(hmap.get_height(5, 15), 0.35)
+
+
+class TestDepthPasses(unittest.TestCase):
+    def setUp(self):
+        self.emulator = FirmwareEmulator()
+        self.machine = Machine(self.emulator.port)
+        self.machine.feed_rate = 100
+        path = Path(xs=[0.0, 1.0, 2.0], ys=[0.0]*3, zs=[0.0]*3, cs=[0.0]*3)
+        self.passes = DepthPasses(PathGroup([path]), [-0.1, -0.2], [1.0, 0.5], safe_height=1.0)
+
+    def tearDown(self):
+        self.emulator.close()
+
+    def test_make_pass_commands(self):
+        commands = list(self.machine.make_pass_commands(self.passes))
+        self.assertEqual(len(commands), 8)
+        self.assertTrue(commands[0].startswith("G1 X0.000000 Y0.000000 Z-0.100000 C0.000000 F100.000000"))
+        self.assertTrue(commands[3].startswith("G1 X2.000000 Y0.000000 Z1.000000 C0.000000 F100.000000"))
+        self.assertTrue(commands[7].startswith("G1 X2.000000 Y0.000000 Z-0.200000 C0.000000 F50.000000"))
+
+    @run_async
+    async def test_trace_passes(self):
+        self.assertTrue(await self.machine.open())
+        with self.assertRaises(ValueError):
+            await self.machine.trace_passes(self.passes, window=0)
+        self.assertTrue(await self.machine.trace_passes(self.passes, window=3, timeout=2))
+        await self.machine.close()
+        moves = [line for line in self.emulator.lines if line.startswith("G1")]
+        self.assertEqual(len(moves), 8)
+        self.assertAlmostEqual(self.machine.history[-1][-1].z, -0.2)
+
+
+class TestPipeline(unittest.TestCase):
+    def setUp(self):
+        self.emulator = FirmwareEmulator()
+        self.machine = Machine(self.emulator.port)
+        paths = [Path(xs=[0.0, 1.0], ys=[float(i)]*2, zs=[0.0]*2, cs=[0.0]*2) for i in range(3)]
+        self.pipeline = Pipeline(chunk_size=1)
+        self.pipeline.add_source("paths", PathGroup(paths))
+        self.pipeline.add_stage("cut", lambda pg: pg.shift(Point(0, 0, -0.1, 0)), ["paths"])
+        self.pipeline.add_stage("preview", lambda pg: pg, ["paths"])
+
+    def tearDown(self):
+        self.emulator.close()
+
+    @run_async
+    async def test_trace_pipeline(self):
+        self.assertTrue(await self.machine.open())
+        with self.assertRaises(ValueError):
+            await self.machine.trace_pipeline(self.pipeline, window=0)
+        self.assertTrue(await self.machine.trace_pipeline(self.pipeline, outputs=["cut"], window=4, timeout=2))
+        await self.machine.close()
+        moves = [line for line in self.emulator.lines if line.startswith("G1")]
+        self.assertEqual(len(moves), 6)
+        self.assertTrue(all("Z-0.100000" in line for line in moves))
+        self.assertAlmostEqual(self.machine.history[-1][-1].z, -0.1)
+
+
+class TestMoveLog(unittest.TestCase):
+    def test_path_index(self):
+        paths = [Path(xs=[0.0, 1.0], ys=[0.0]*2, zs=[0.0]*2, cs=[0.0]*2), Path(), Path(xs=[2.0, 3.0, 4.0], ys=[1.0]*3, zs=[0.0]*3, cs=[0.0]*3)]
+        index = PathIndex(PathGroup(paths))
+        self.assertEqual(len(index), 5)
+        self.assertEqual(index.locate(2), (2, 0))
+        self.assertEqual(index.index(2, 1), 3)
+        self.assertAlmostEqual(index.point(4).x, 4.0)
+        with self.assertRaises(IndexError):
+            index.locate(5)
+        with self.assertRaises(IndexError):
+            index.index(1, 0)
+        self.assertEqual(index.digest(), PathIndex(PathGroup(paths)).digest())
+        self.assertNotEqual(index.digest(), PathIndex(PathGroup(paths[:1])).digest())
+
+    def test_log(self):
+        log = MoveLog()
+        self.assertEqual(len(log), 1)
+        self.assertEqual(len(log[-1]), 1)
+        index = PathIndex(Path(xs=[0.0, 1.0, 2.0], ys=[0.0]*3, zs=[-0.1]*3, cs=[0.0]*3))
+        for n in range(3):
+            log.append_index(index, n)
+        # consecutive indices are stored as one run
+        self.assertEqual(len(log[-1]._runs), 2)
+        self.assertAlmostEqual(log.last.x, 2.0)
+        log.set_tool_size(2.0)
+        log.append(Point(5, 5, 5, 0))
+        self.assertEqual(len(log), 2)
+        self.assertEqual(len(log[-1]), 2)
+        self.assertAlmostEqual(log[-1][0].x, 2.0)
+        log.last = Point(6, 6, 6, 0)
+        self.assertEqual(len(log[-1]), 2)
+        self.assertAlmostEqual(log.last.x, 6.0)
+        path = log[0].to_path()
+        self.assertEqual(len(path), 4)
+        self.assertAlmostEqual(path[2].x, 1.0)
+
+
+class TestCheckpoint(unittest.TestCase):
+    def setUp(self):
+        self.paths = PathGroup([Path(xs=[0.0, 1.0, 2.0, 3.0], ys=[float(i)]*4, zs=[-0.1]*4, cs=[0.0]*4) for i in range(3)])
+        self.filename = os.path.join(tempfile.mkdtemp(), "job.json")
+
+    def tearDown(self):
+        if os.path.exists(self.filename):
+            os.remove(self.filename)
+
+    @run_async
+    async def test_resume(self):
+        # link drops after G90 and 5 moves
+        emulator = FirmwareEmulator(fail_after=6)
+        machine = Machine(emulator.port)
+        self.assertTrue(await machine.open())
+        self.assertFalse(await machine.trace_group(self.paths, checkpoint=self.filename, window=2, timeout=0.5))
+        await machine.close()
+        emulator.close()
+        checkpoint = Checkpoint.load(self.filename)
+        self.assertEqual(checkpoint.total, 12)
+        self.assertEqual(checkpoint.done, 5)
+        self.assertFalse(checkpoint.is_complete())
+
+        emulator = FirmwareEmulator()
+        machine = Machine(emulator.port)
+        self.assertTrue(await machine.open())
+        with self.assertRaises(ValueError):
+            await machine.trace_group(PathGroup([self.paths[0]]), checkpoint=self.filename)
+        self.assertTrue(await machine.trace_group(self.paths, checkpoint=self.filename, safe_height=1.0, window=2, timeout=2))
+        await machine.close()
+        emulator.close()
+        moves = [line for line in emulator.lines if line.startswith("G0") or line.startswith("G1")]
+        # re-approach above last acknowledged point (path 1, point 0), then remaining moves
+        self.assertTrue(moves[0].startswith("G0 Z1.000000"))
+        self.assertTrue(moves[1].startswith("G0 X0.000000 Y1.000000 C0.000000"))
+        self.assertTrue(moves[2].startswith("G1 X0.000000 Y1.000000 Z-0.100000"))
+        self.assertEqual(len(moves), 3 + 7)
+        self.assertTrue(moves[3].startswith("G1 X1.000000 Y1.000000"))
+        self.assertTrue(Checkpoint.load(self.filename).is_complete())
+        self.assertAlmostEqual(machine.history.last.x, 3.0)
+        self.assertAlmostEqual(machine.history.last.y, 2.0)
+
+    @run_async
+    async def test_start(self):
+        emulator = FirmwareEmulator()
+        machine = Machine(emulator.port)
+        self.assertTrue(await machine.open())
+        with self.assertRaises(IndexError):
+            await machine.trace_group(self.paths, start=(3, 0))
+        # resuming needs a safe height, as cuts are all below stock top
+        with self.assertRaises(ValueError):
+            await machine.trace_group(self.paths, start=(2, 2), timeout=2)
+        self.assertTrue(await machine.trace_group(self.paths, start=(2, 2), safe_height=0.5, timeout=2))
+        await machine.close()
+        emulator.close()
+        moves = [line for line in emulator.lines if line.startswith("G0") or line.startswith("G1")]
+        self.assertTrue(moves[0].startswith("G0 Z0.500000"))
+        self.assertEqual(len(moves), 3 + 2)
+
+    @run_async
+    async def test_acknowledgements(self):
+        # informative lines don't count as acknowledgements
+        emulator = FirmwareEmulator(busy=True)
+        machine = Machine(emulator.port)
+        checkpoint = Checkpoint()
+        self.assertTrue(await machine.open())
+        self.assertTrue(await machine.trace_group(self.paths, checkpoint=checkpoint, window=3, timeout=2))
+        await machine.close()
+        emulator.close()
+        self.assertEqual(checkpoint.done, 12)
+
+        # error reply stops job; rejected move isn't counted
+        emulator = FirmwareEmulator(error_at=5)
+        machine = Machine(emulator.port)
+        checkpoint = Checkpoint()
+        self.assertTrue(await machine.open())
+        with self.assertRaises(InvalidAnswerException):
+            await machine.trace_group(self.paths, checkpoint=checkpoint, window=1, timeout=2)
+        await machine.close()
+        emulator.close()
+        self.assertEqual(checkpoint.done, 3)
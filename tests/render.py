@@ -1,10 +1,10 @@
 import unittest
-from pygraver.core.render import Model, Extrusion, Cylinder, Marker, MarkerCollection, Wire, WireCollection
+from pygraver.core.render import Model, Shape3D, Extrusion, Cylinder, Marker, MarkerCollection, Wire, WireCollection, Playback
 from pygraver.core.types import Path, Point, Surface
 from vtkmodules.vtkInteractionWidgets import vtkTextWidget
 from vtkmodules.vtkRenderingCore import vtkActor
 
-__all__ = ["TestModel", "TestShape3D", "TestCylinder", "TestExtrusion", "TestMarker", "TestWire"]
+__all__ = ["TestModel", "TestShape3D", "TestCylinder", "TestExtrusion", "TestMarker", "TestWire", "TestPlayback"]
 
 class TestModel(unittest.TestCase):
     def setUp(self):
@@ -28,6 +28,19 @@ class TestModel(unittest.TestCase):
         self.model.remove_shape(shp1)
         self.assertFalse(self.model.has_shape(shp1))
 
+    def test_async_shapes(self):
+        path = Path()
+        path.append(Point(0,0,0,0))
+        path.append(Point(1,0,0,0))
+        path.append(Point(1,1,0,0))
+        path.append(Point(0,1,0,0))
+        path.append(Point(0,0,0,0))
+        self.model.add_wires_async([path, path], 0.1, [255,255,255,255])
+        self.model.add_extrusion_async(Surface(path), 1, Point(0,0,1), [255,255,255,255])
+        self.assertEqual(self.model.wait_pending(), 2)
+        self.assertEqual(self.model.pending_count, 0)
+        self.assertEqual(self.model.process_pending(), 0)
+
     def test_widgets(self):
         widget1 = vtkTextWidget()
         self.assertFalse(self.model.has_widget(widget1))
@@ -109,6 +122,30 @@ class TestShape3D(unittest.TestCase):
         self.assertEqual(type(self.shape.intersecting_actor(Point(0,0,-1), Point(0,0,2))), vtkActor)
         self.assertEqual(self.shape.intersecting_actor(Point(), Point()), None)
 
+    def test_color_mapping(self):
+        from vtkmodules.vtkFiltersSources import vtkSphereSource
+        class HeightShape(Shape3D):
+            def __init__(self):
+                super().__init__()
+                self.calls = 0
+                self.shape = None
+            def color_mapping(self, points):
+                self.calls += 1
+                self.shape = points.shape
+                return points[:,2]
+        shape = HeightShape()
+        source = vtkSphereSource()
+        source.Update()
+        polydata = source.GetOutput()
+        shape.set_item(0, polydata)
+        self.assertEqual(shape.calls, 1)
+        self.assertEqual(shape.shape, (polydata.GetNumberOfPoints(), 3))
+        shape.set_scalar_color_range(-0.5, 0.5)
+        self.assertEqual(shape.calls, 2)
+        colors = shape.actors[0].GetMapper().GetInput().GetPointData().GetScalars("Colors")
+        self.assertEqual(colors.GetNumberOfTuples(), polydata.GetNumberOfPoints())
+        self.assertNotEqual(colors.GetTuple3(0), colors.GetTuple3(1))
+
 
 class TestExtrusion(unittest.TestCase):
     def setUp(self):
@@ -130,6 +167,10 @@ class TestExtrusion(unittest.TestCase):
         shape = Extrusion(self.path, 1, Point(0,0,1), [255,255,255,255])
         shape.set_shape(self.path, 1, Point(0,0,1), [255,255,255,255])
         shape.set_shape(Surface(self.path), 1, Point(0,0,1), [255,255,255,255])
+        shape.set_extrusion(2, Point(0,0,-1), [255,0,0,255])
+        self.assertEqual(len(shape.actors), 1)
+        with self.assertRaises(ValueError):
+            shape.set_extrusion(1, Point(), [255,255,255,255])
     
 
 class TestMarker(unittest.TestCase):
@@ -163,3 +204,34 @@ class TestWire(unittest.TestCase):
         wires.set_paths([self.path]*3, 1, [255, 255, 255, 255])
         self.assertEqual(len(wires.actors), 3)
         wires.set_path(1, self.path)
+
+
+class TestPlayback(unittest.TestCase):
+    def setUp(self):
+        super().setUp()
+        self.path = Path()
+        for x in range(11):
+            self.path.append(Point(x,0,0,0))
+
+    def test_progress(self):
+        model = Model()
+        playback = model.add_playback([self.path]*2, [255, 255, 255, 255], 0.5, 2, chunk_size=4)
+        self.assertTrue(model.has_shape(playback))
+        self.assertEqual(playback.point_count, 22)
+        self.assertEqual(playback.chunk_count, 6)
+        self.assertEqual(len(playback.actors), 7)
+        self.assertEqual(playback.progress, 0)
+        playback.progress = 15
+        self.assertEqual(playback.get_location(15), (1, 4))
+        with self.assertRaises(IndexError):
+            playback.progress = 22
+
+    def test_drive(self):
+        playback = Playback([self.path], [255, 255, 255, 255], 0.5, 2)
+        playback.feed_rate = 2
+        self.assertAlmostEqual(playback.duration, 5)
+        self.assertEqual(playback.set_time(2.6), 5)
+        self.assertEqual(playback.set_position(Point(7.9,0,0,0)), 8)
+        self.assertEqual(playback.progress, 8)
+        with self.assertRaises(ValueError):
+            playback.feed_rate = 0
@@ -1,8 +1,8 @@
 import unittest
-from pygraver.core.types import Point, Path, PathGroup, Surface, DivComponent, SortPredicate
+from pygraver.core.types import Point, Path, PathGroup, Surface, DivComponent, SortPredicate, FillRule, MillingMode, HeightCorrector, Displacement, DisplacementMode, DepthPasses, PassOrder, Pipeline, StageFunction, KeepOut, CompressedPathGroup
 import numpy as np
 
-__all__ = ["TestPoint", "TestPath", "TestPathGroup", "TestSurface"]
+__all__ = ["TestPoint", "TestPath", "TestPathGroup", "TestSurface", "TestDisplacement", "TestDepthPasses", "TestPipeline"]
 
 class TestPoint(unittest.TestCase):
     def test_base(self):
@@ -234,6 +234,51 @@ class TestPathGroup(unittest.TestCase):
         with self.assertRaises(ValueError):
             pathgroup.reorder(range(11))
         self.assertEqual(type(pathgroup.reorder(range(5))), PathGroup)
+        line = Path(xs, xs, xs)
+        cleaned, removed = PathGroup([line]*5).remove_overlaps(1e-6)
+        self.assertEqual(len(cleaned), 1)
+        self.assertAlmostEqual(removed, 4*np.sqrt(3))
+        group = PathGroup([line, line.shift(Point(5, 0, 0, 0))])
+        self.assertEqual(group.query((5.2, 0.2, 5.3, 0.3)), [1])
+        self.assertEqual(group.query((-1, -1, 10, 10)), [0, 1])
+        with self.assertRaises(ValueError):
+            group.query((1, 0, 0, 1))
+        idx, pt = group.nearest(Point(0.5, 0.3, 0, 0))
+        self.assertEqual(idx, 0)
+        self.assertAlmostEqual(pt.x, 0.4)
+        self.assertAlmostEqual(pt.y, 0.4)
+        group.append(Path([0.5], [0.3], [0], [0]))
+        self.assertEqual(group.nearest(Point(0.5, 0.3, 0, 0))[0], 2)
+
+
+class TestCompressedPathGroup(unittest.TestCase):
+    def test_compress(self):
+        ts = np.linspace(0, 10, 1001)
+        pg = PathGroup([Path(np.cos(ts) + k, np.sin(ts), -0.01*ts, 10*ts) for k in range(3)])
+        cpg = CompressedPathGroup(pg, resolution=1e-4, angle_resolution=1e-3)
+        self.assertEqual(len(cpg), 3)
+        self.assertEqual(cpg.point_count, 3003)
+        for path, original in zip(cpg, pg):
+            self.assertEqual(len(path), len(original))
+            self.assertLessEqual(np.max(np.abs(path.xs - original.xs)), 0.5e-4 + 1e-12)
+            self.assertLessEqual(np.max(np.abs(path.cs - original.cs)), 0.5e-3 + 1e-12)
+        self.assertAlmostEqual(cpg[-1][0].x, 3.0)
+        xs, ys, zs, cs = cpg.decode(-1)
+        self.assertEqual(len(xs), 1001)
+        self.assertTrue(np.array_equal(xs, cpg[2].xs))
+        self.assertTrue(np.array_equal(cs, cpg[2].cs))
+        self.assertEqual(len(cpg.decompress()), 3)
+        stats = cpg.stats
+        self.assertGreater(stats.ratio, 5)
+        self.assertGreater(stats.original_bytes, stats.compressed_bytes)
+        self.assertGreater(stats.decoded_points, 0)
+        self.assertGreater(stats.decode_rate, 0)
+        with self.assertRaises(ValueError):
+            cpg[3]
+        with self.assertRaises(ValueError):
+            cpg.decode(3)
+        with self.assertRaises(ValueError):
+            CompressedPathGroup(pg, resolution=0)
 
 
 class TestSurface(unittest.TestCase):
@@ -277,12 +322,184 @@ class TestSurface(unittest.TestCase):
     def test_methods(self):
         surf = Surface(self.path)
         self.assertEqual(type(surf.get_milling_paths(0.5, 0.3)), list)
+        self.assertEqual(len(surf.get_milling_paths(0.5, 0.3, spiral=True)), 1)
+        spiral = surf.get_spiral_milling(0.5, 0.3, feed_rate=100, rapid_rate=1000, clearance=1)
+        self.assertEqual(spiral.retracts, 0)
+        self.assertGreater(spiral.concentric_retracts, 0)
+        self.assertGreater(spiral.time_saved, 0)
         self.assertEqual(type(surf.get_milled_surface(0.5, 0.3)), list)
+        self.assertEqual(type(surf.get_milled_surface(0.5, 0.3, MillingMode.Raster, 0.05)), list)
         self.assertTrue(surf.contains(Point()))
         self.assertFalse(surf.contains(Point(3,3,0,0)))
+        self.assertAlmostEqual(surf.nearest(Point(3,0,0,0)).x, 1.0)
         self.assertEqual(type(surf.combine()), list)
+        surfs = Surface.from_paths([self.path, self.path.scale(0.5, Point())], FillRule.EvenOdd)
+        self.assertEqual(len(surfs), 1)
+        self.assertEqual(len(surfs[0].holes), 1)
         self.assertEqual(type(surf.correct_height([self.path], 0, 1.0)), list)
         # because of automatic typecasting and PathGroup.__iter__, this calls
         # the method taking std::vector<Path> instead of PathGroup argument
         self.assertEqual(type(surf.correct_height(PathGroup([self.path]), 0, 1.0)), list)
         self.assertEqual(type(surf.correct_height(pathgroup=PathGroup([self.path]), clearance=0, safe_height=1.0)), PathGroup)
+        corrector = HeightCorrector([self.path, self.path.shift(Point(10,0,0,0))], 0, 1.0)
+        self.assertEqual(len(corrector.update(surf)), 2)
+        corrector.update(Surface(self.path.scale(0.5, Point())))
+        self.assertEqual(corrector.updated, [0])
+
+    def test_grid_size(self):
+        surf1 = Surface(self.path)
+        self.assertEqual(surf1.grid_size, 0)
+        with self.assertRaises(ValueError):
+            surf1.grid_size = -1
+        surf1.grid_size = 1e-3
+        surf2 = Surface(self.path.shift(Point(0.5,0.5,0,0)))
+        union = surf1 + surf2
+        self.assertEqual(len(union), 1)
+        self.assertEqual(union[0].grid_size, 1e-3)
+        for pt in union[0].contours[0]:
+            self.assertAlmostEqual(pt.x*1e3, round(pt.x*1e3))
+        self.assertEqual(len(surf1.combine()), 1)
+        self.assertEqual(surf1.combine()[0].grid_size, 1e-3)
+
+
+class TestDisplacement(unittest.TestCase):
+    def setUp(self):
+        # horizontal gradient from 0 (left) to 1 (right), one unit per pixel
+        self.image = np.tile(np.linspace(0, 1, 11), (11, 1))
+        self.path = Path(xs=[0.0, 10.0], ys=[5.0, 5.0], zs=[-1.0, -1.0], cs=[0.0, 0.0])
+
+    def test_sample(self):
+        disp = Displacement(self.image, -0.5, -0.5, 1.0, 2.0)
+        self.assertEqual(disp.mode, DisplacementMode.Normal)
+        self.assertAlmostEqual(disp.sample(5, 5), 0.5)
+        self.assertAlmostEqual(disp.get_displacement(5, 5), 1.0)
+        with self.assertRaises(ValueError):
+            Displacement(np.zeros(10), 0, 0, 1.0)
+
+    def test_apply(self):
+        disp = Displacement(self.image, -0.5, -0.5, 1.0, 2.0)
+        res = disp.apply(self.path)
+        self.assertAlmostEqual(res[1].y, 7.0)
+        self.assertAlmostEqual(res[1].z, -1.0)
+        disp = Displacement(self.image, -0.5, -0.5, 1.0, -0.1, DisplacementMode.Depth, [0, 0, 1])
+        res = disp.apply(PathGroup([self.path, self.path]), tolerance=0.001)
+        self.assertEqual(len(res), 2)
+        # transfer function has a kink at 0.5; a point is added there
+        self.assertEqual(len(res[0]), 3)
+        self.assertAlmostEqual(res[0][1].x, 5.0)
+        self.assertAlmostEqual(res[0][2].z, -1.1)
+
+
+class TestDepthPasses(unittest.TestCase):
+    def setUp(self):
+        xs = [float(i) for i in range(11)]
+        self.pg = PathGroup([Path(xs=xs, ys=[0.0]*11, zs=[0.0]*11, cs=[0.0]*11)])
+
+    def test_passes(self):
+        passes = DepthPasses(self.pg, [-0.1, -0.2], [1.0, 0.5])
+        self.assertEqual(passes.pass_count, 2)
+        self.assertEqual(len(passes), 22)
+        moves = list(passes)
+        self.assertEqual(len(moves), 22)
+        self.assertAlmostEqual(moves[0][2], -0.1)
+        self.assertAlmostEqual(moves[11][2], -0.2)
+        self.assertAlmostEqual(moves[11][4], 0.5)
+        self.assertAlmostEqual(passes.get_pass(1)[0][5].z, -0.2)
+        with self.assertRaises(ValueError):
+            DepthPasses(self.pg, [])
+        with self.assertRaises(IndexError):
+            passes.get_pass(2)
+
+    def test_ramps(self):
+        passes = DepthPasses(self.pg, [-0.1, -0.2], ramp_length=4.0, order=PassOrder.ByPath, safe_height=1.0)
+        moves = list(passes)
+        # ramp from stock surface, retract, move, then ramp from first pass depth
+        self.assertEqual(len(moves), 24)
+        self.assertAlmostEqual(moves[0][2], 0.0)
+        self.assertAlmostEqual(moves[2][2], -0.05)
+        self.assertAlmostEqual(moves[11][2], 1.0)
+        self.assertAlmostEqual(moves[13][2], -0.1)
+        self.assertAlmostEqual(moves[15][2], -0.15)
+
+
+class TestPipeline(unittest.TestCase):
+    def setUp(self):
+        # 10 straight paths, shifted along y
+        self.pg = PathGroup([Path(xs=[0.0, 1.0, 2.0], ys=[float(i)]*3, zs=[0.0]*3, cs=[0.0]*3) for i in range(10)])
+
+    def test_run(self):
+        pipeline = Pipeline(chunk_size=3, capacity=2)
+        pipeline.add_source("paths", self.pg)
+        pipeline.add_source("extra", lambda: PathGroup([Path(xs=[5.0, 6.0], ys=[0.0]*2, zs=[0.0]*2, cs=[0.0]*2)]))
+        pipeline.add_stage("lift", lambda pg: pg.shift(Point(0, 0, 1, 0)), ["paths", "extra"], workers=2)
+        pipeline.add_stage("simplify", StageFunction.simplify(0.01), ["lift"], workers=2)
+        pipeline.add_stage("sort", StageFunction.sort_paths(Point()), ["simplify"], barrier=True)
+        self.assertEqual(pipeline.stage_names, ["paths", "extra", "lift", "simplify", "sort"])
+        outputs = pipeline.run()
+        self.assertEqual(list(outputs.keys()), ["sort"])
+        self.assertEqual(len(outputs["sort"]), 11)
+        for path in outputs["sort"]:
+            self.assertAlmostEqual(path[0].z, 1.0)
+        # collinear points are simplified
+        self.assertEqual(sum(len(path) for path in outputs["sort"]), 22)
+        stats = {s.name: s for s in pipeline.stats}
+        self.assertEqual(stats["paths"].chunks_out, 4)
+        self.assertEqual(stats["lift"].paths_in, 11)
+        self.assertEqual(stats["sort"].chunks_in, stats["simplify"].chunks_out)
+        self.assertLessEqual(stats["lift"].peak_queue_chunks, 2)
+        self.assertGreaterEqual(stats["lift"].busy_time, 0)
+
+    def test_iterate(self):
+        pipeline = Pipeline(chunk_size=4)
+        pipeline.add_source("paths", self.pg)
+        pipeline.add_stage("a", StageFunction.interpolate(0.5), ["paths"])
+        pipeline.add_stage("b", lambda pg: pg, ["paths"])
+        counts = {"a": 0, "b": 0}
+        for name, chunk in pipeline:
+            self.assertLessEqual(len(chunk), 4)
+            counts[name] += len(chunk)
+        self.assertEqual(counts, {"a": 10, "b": 10})
+
+    def test_errors(self):
+        pipeline = Pipeline()
+        pipeline.add_source("paths", self.pg)
+        with self.assertRaises(ValueError):
+            pipeline.add_stage("paths", lambda pg: pg, ["paths"])
+        with self.assertRaises(ValueError):
+            pipeline.add_stage("a", lambda pg: pg, ["none"])
+        def fail(pg):
+            raise RuntimeError("stage failure")
+        pipeline.add_stage("fail", fail, ["paths"])
+        with self.assertRaises(RuntimeError):
+            pipeline.run()
+
+
+class TestKeepOut(unittest.TestCase):
+    def setUp(self):
+        # unit disc centred on origin
+        ts = np.linspace(0, 2*np.pi, 101)
+        self.zone = Surface(Path(np.cos(ts), np.sin(ts), 0, 0))
+
+    def test_check(self):
+        keepout = KeepOut([self.zone], resolution=0.05, margin=0.5)
+        self.assertEqual(len(keepout.surfaces), 1)
+        self.assertAlmostEqual(keepout.get_distance(3, 0), 2.0)
+        self.assertLess(keepout.get_distance(Point()), 0)
+        # horizontal lines at y=1.2 and y=3
+        pg = PathGroup([Path(xs=list(np.linspace(-2, 2, 41)), ys=[y]*41, zs=[0.0]*41, cs=[0.0]*41) for y in (1.2, 3.0)])
+        report = keepout.check(pg, tool_radius=0.1, clearance=0.05)
+        self.assertTrue(report.ok)
+        self.assertEqual(report.points_checked, 82)
+        self.assertAlmostEqual(report.min_clearance, 0.1, places=6)
+        report = keepout.check(pg, tool_radius=0.2, clearance=0.05)
+        self.assertFalse(report.ok)
+        self.assertIn((0, 20), report.point_violations)
+        self.assertTrue(all(path == 0 for path, _ in report.point_violations))
+        self.assertEqual(report.min_location, (0, 20))
+        # a segment jumping over the zone
+        report = keepout.check(PathGroup([Path(xs=[-2.0, 2.0], ys=[0.0]*2, zs=[0.0]*2, cs=[0.0]*2)]), tool_radius=0.1)
+        self.assertEqual(report.point_violations, [])
+        self.assertEqual(report.segment_violations, [(0, 0)])
+        self.assertLess(report.min_clearance, -0.9)
+        with self.assertRaises(ValueError):
+            KeepOut([self.zone], resolution=0, margin=0.5)